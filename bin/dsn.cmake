@@ -495,6 +495,21 @@ function(dsn_setup_packages)
         set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} ${DSN_LIB_CRYPTO})
     endif()
 
+    # for compressing rpc message bodies
+    if(ENABLE_RPC_COMPRESSION)
+        find_library(DSN_LIB_LZ4 NAMES lz4)
+        if(DSN_LIB_LZ4 STREQUAL "DSN_LIB_LZ4-NOTFOUND")
+            message(FATAL_ERROR "Cannot find library lz4")
+        endif()
+        set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} ${DSN_LIB_LZ4})
+
+        find_library(DSN_LIB_ZSTD NAMES zstd)
+        if(DSN_LIB_ZSTD STREQUAL "DSN_LIB_ZSTD-NOTFOUND")
+            message(FATAL_ERROR "Cannot find library zstd")
+        endif()
+        set(DSN_SYSTEM_LIBS ${DSN_SYSTEM_LIBS} ${DSN_LIB_ZSTD})
+    endif()
+
     if((CMAKE_SYSTEM_NAME STREQUAL "FreeBSD"))
         find_library(DSN_LIB_UTIL NAMES util)
         if(DSN_LIB_UTIL STREQUAL "DSN_LIB_UTIL-NOTFOUND")
@@ -102,6 +102,15 @@ checkpointing)
   ; what kind of header format for this kind of rpc calls
   rpc_call_header_format = NET_HDR_DSN
 
+  ; how many milliseconds to delay recving rpc session for
+  ; when rpc_request_admission_mode = TM_DELAY
+  rpc_request_admission_delay_milliseconds = 10
+
+  ; admission mode for rpc requests when they are not accepted by the admission controller
+  ; of the task queue: TM_NONE to accept them anyway, TM_REJECT to reply ERR_BUSY,
+  ; TM_DELAY to accept them but delay recving from their sessions
+  rpc_request_admission_mode = TM_REJECT
+
   ; how many milliseconds to delay recving rpc session for
   ; when queue length ~= [1.0, 1.2, 1.4, 1.6, 1.8, >=2.0] x pool.queue_length_throttling_threshold,
   ; e.g., 0, 0, 1, 2, 5, 10
@@ -111,6 +120,10 @@ checkpointing)
   ; is already greater than its timeout value
   rpc_request_dropped_before_execution_when_timeout = false
 
+  ; whether to reply ERR_TIMEOUT to the client when a request is dropped
+  ; due to timeout, or stay silent
+  rpc_request_reply_when_dropped_for_timeout = false
+
   ; for how long (ms) the request will be resent if no response
   ; is received yet, 0 for disable this feature
   rpc_request_resend_timeout_milliseconds = 0
@@ -138,16 +151,50 @@ dsn_threadpool_code_register.
   ; one dequeue call for best batching performance
   dequeue_batch_size = 5
 
+  ; elastic: interval (ms) of the auto-scaler checking the queue of the pool
+  elastic_check_interval_ms = 1000
+
+  ; elastic: max worker count the auto-scaler may grow the pool to, 0 to disable
+  ; auto-scaling; only valid when partitioned = false and work_stealing = false
+  elastic_max_worker_count = 0
+
+  ; elastic: min worker count the auto-scaler may shrink the pool to
+  elastic_min_worker_count = 1
+
+  ; elastic: shrink the pool by one worker when the queue is found empty in so
+  ; many consecutive checks
+  elastic_scale_down_idle_checks = 10
+
+  ; elastic: grow the pool by one worker when the estimated queueing time (ms)
+  ; exceeds this value
+  elastic_scale_up_queueing_time_ms = 100
+
   ; throttling: whether to enable throttling with virtual queues
   enable_virtual_queue_throttling = false
 
+  ; idle strategy: how many times an idle worker busy-polls its queue before yielding,
+  ; 0 for no spinning
+  idle_spin_count = 0
+
+  ; idle strategy: how many times an idle worker yields its cpu before parking,
+  ; 0 for no yielding
+  idle_yield_count = 0
+
   ; thread pool name
   name = THREAD_POOL_INVALID
 
+  ; whether to spread the threads across numa nodes by contiguous index ranges
+  ; and bind each of them to the cores and the memory of its node
+  numa_aware = false
+
   ; whethe the threads share a single queue(partitioned=false) or not;
   ; the latter is usually for workload hash partitioning for avoiding locking
   partitioned = false
 
+  ; whether each thread owns a private queue and steals tasks from its peers when idle;
+  ; only valid when partitioned = false
+  work_stealing = false
+
   ; task queue aspects names, usually for tooling purpose
   queue_aspects =
 
@@ -524,6 +571,15 @@ extern DSN_API dsn::error_code dsn_file_close(dsn_handle_t file);
 /*! flush the buffer of the given file */
 extern DSN_API dsn::error_code dsn_file_flush(dsn_handle_t file);
 
+/*!
+ flush the written data of the given file asynchronously (fdatasync where supported),
+ the writes not completed yet are not necessarily covered
+
+ \param file   file handle
+ \param cb     callback aio task to be executed on completion
+ */
+extern DSN_API void dsn_file_flush_async(dsn_handle_t file, dsn::aio_task *cb);
+
 /*! get native handle: HANDLE for windows, int for non-windows */
 extern DSN_API void *dsn_file_native_handle(dsn_handle_t file);
 
@@ -546,7 +602,8 @@ dsn_file_read(dsn_handle_t file, char *buffer, int count, uint64_t offset, dsn::
  \param buffer write buffer
  \param count  byte size of the to-be-written content
  \param offset offset in the file to start write
- \param cb     callback aio task to be executed on completion
+ \param cb     callback aio task to be executed on completion, the data is synced to disk
+               before the completion when cb->aio()->sync_data is set
  */
 extern DSN_API void dsn_file_write(
     dsn_handle_t file, const char *buffer, int count, uint64_t offset, dsn::aio_task *cb);
@@ -558,7 +615,8 @@ extern DSN_API void dsn_file_write(
  \param buffers       write buffers
  \param buffer_count  number of write buffers
  \param offset        offset in the file to start write
- \param cb            callback aio task to be executed on completion
+ \param cb            callback aio task to be executed on completion, the data is synced
+                      to disk before the completion when cb->aio()->sync_data is set
  */
 extern DSN_API void dsn_file_write_vector(dsn_handle_t file,
                                           const dsn_file_buffer_t *buffers,
@@ -37,6 +37,7 @@
 
 #include <dsn/c/api_common.h>
 #include <dsn/utility/error_code.h>
+#include <dsn/utility/inline_function.h>
 #include <dsn/tool-api/threadpool_code.h>
 #include <dsn/tool-api/task_code.h>
 
@@ -46,13 +47,16 @@
  */
 
 namespace dsn {
-typedef std::function<void()> task_handler;
+/// the callbacks of tasks are inline_functions rather than std::functions, so that the
+/// lambdas captured with a few more states don't go to the heap, see inline_function.h.
+typedef inline_function<void()> task_handler;
 
-/// A callback to handle rpc requests.
+/// A callback to handle rpc requests, which is copied into each rpc_request_task, so it
+/// is an inline_function as well.
 ///
 /// Parameters:
 ///  - dsn_message_t: the received rpc request
-typedef std::function<void(dsn_message_t)> rpc_request_handler;
+typedef inline_function<void(dsn_message_t)> rpc_request_handler;
 
 /// A callback to handle rpc responses.
 ///
@@ -60,12 +64,12 @@ typedef std::function<void(dsn_message_t)> rpc_request_handler;
 ///  - error_code
 ///  - dsn_message_t: the sent rpc request
 ///  - dsn_message_t: the received rpc response
-typedef std::function<void(dsn::error_code, dsn_message_t, dsn_message_t)> rpc_response_handler;
+typedef inline_function<void(dsn::error_code, dsn_message_t, dsn_message_t)> rpc_response_handler;
 
 /// Parameters:
 ///  - error_code
 ///  - size_t: the read or written size of bytes from file.
-typedef std::function<void(dsn::error_code, size_t)> aio_handler;
+typedef inline_function<void(dsn::error_code, size_t)> aio_handler;
 
 class task;
 class raw_task;
@@ -118,6 +118,10 @@ inline task_ptr enqueue(task_code code,
     return tsk;
 }
 
+// enqueue the tasks created by create_task, e.g., when scattering the work to the replicas;
+// the tasks going to the same thread pool are appended to their queues in one go
+inline void enqueue_batch(const std::vector<task_ptr> &tasks) { task::enqueue_batch(tasks); }
+
 inline task_ptr enqueue_timer(task_code evt,
                               task_tracker *tracker,
                               task_handler &&callback,
@@ -296,9 +300,11 @@ inline aio_task_ptr write(dsn_handle_t fh,
                           task_code callback_code,
                           task_tracker *tracker,
                           aio_handler &&callback,
-                          int hash = 0)
+                          int hash = 0,
+                          bool sync_data = false)
 {
     auto tsk = create_aio_task(callback_code, tracker, std::move(callback), hash);
+    tsk->aio()->sync_data = sync_data;
     dsn_file_write(fh, buffer, count, offset, tsk);
     return tsk;
 }
@@ -310,13 +316,26 @@ inline aio_task_ptr write_vector(dsn_handle_t fh,
                                  task_code callback_code,
                                  task_tracker *tracker,
                                  aio_handler &&callback,
-                                 int hash = 0)
+                                 int hash = 0,
+                                 bool sync_data = false)
 {
     auto tsk = create_aio_task(callback_code, tracker, std::move(callback), hash);
+    tsk->aio()->sync_data = sync_data;
     dsn_file_write_vector(fh, buffers, buffer_count, offset, tsk.get());
     return tsk;
 }
 
+inline aio_task_ptr flush(dsn_handle_t fh,
+                          task_code callback_code,
+                          task_tracker *tracker,
+                          aio_handler &&callback,
+                          int hash = 0)
+{
+    auto tsk = create_aio_task(callback_code, tracker, std::move(callback), hash);
+    dsn_file_flush_async(fh, tsk.get());
+    return tsk;
+}
+
 void copy_remote_files_impl(rpc_address remote,
                             const std::string &source_dir,
                             const std::vector<std::string> &files, // empty for all
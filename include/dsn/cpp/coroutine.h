@@ -0,0 +1,336 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     awaitables for tasks, rpc and file io, for code compiled with c++20 coroutines
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+//
+// this layer is opt-in: the core is built as c++14, and only the translation units compiled
+// with coroutine support (e.g., -std=c++20) see the definitions below.
+//
+// a typical pipelined write path looks like:
+//
+//   dsn::coro::async replica::write_path(mutation_ptr mu)
+//   {
+//       auto r = co_await dsn::coro::write(
+//           _log_fh, buffer, size, offset, LPC_WRITE_LOG, &_tracker, get_gpid().thread_hash());
+//       if (r.first != ERR_OK)
+//           co_return;
+//
+//       auto resp = co_await dsn::coro::call<prepare_ack>(
+//           node, RPC_PREPARE, request, &_tracker, timeout, get_gpid().thread_hash());
+//       ...
+//   }
+//
+// - each awaitable creates exactly one task, whose callback resumes the coroutine on the
+//   worker selected by the given thread hash, so the code after co_await runs on the same
+//   thread as the equivalent callback would
+// - when the task is cancelled (e.g., by task_tracker::cancel_outstanding_tasks), the callback
+//   is released without being called, and the suspended coroutine frame is destroyed, so the
+//   locals are released and the code after co_await never runs
+// - coroutine frames are allocated from the transient memory of the calling thread
+//
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <dsn/cpp/clientlet.h>
+#include <dsn/utility/transient_memory.h>
+
+namespace dsn {
+namespace coro {
+
+namespace detail {
+
+// resumes the coroutine when called, or destroys the coroutine frame when the
+// task callback holding it is released without being called
+class resumer
+{
+public:
+    explicit resumer(std::coroutine_handle<> h) : _h(h) {}
+    ~resumer()
+    {
+        if (_h)
+            _h.destroy();
+    }
+
+    resumer(const resumer &) = delete;
+    resumer &operator=(const resumer &) = delete;
+
+    void resume()
+    {
+        auto h = _h;
+        _h = nullptr;
+        h.resume();
+    }
+
+private:
+    std::coroutine_handle<> _h;
+};
+
+typedef std::shared_ptr<resumer> resumer_ptr;
+
+// awaitable with result type T, the result is set by the task callback before resuming
+template <typename T>
+class result_awaitable
+{
+public:
+    bool await_ready() const noexcept { return false; }
+    T await_resume() { return std::move(_result); }
+
+protected:
+    T _result;
+};
+}
+
+//
+// coroutine return type for fire-and-forget coroutines
+//
+struct async
+{
+    struct promise_type
+    {
+        static void *operator new(size_t sz) { return tls_trans_malloc(sz); }
+        static void operator delete(void *ptr) { tls_trans_free(ptr); }
+
+        async get_return_object() noexcept { return async(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+//
+// co_await enqueue(...): resume on the worker of the pool of "code" selected by "hash",
+// after "delay"
+//
+class enqueue_awaitable
+{
+public:
+    enqueue_awaitable(task_code code,
+                      task_tracker *tracker,
+                      int hash,
+                      std::chrono::milliseconds delay)
+        : _code(code), _tracker(tracker), _hash(hash), _delay(delay)
+    {
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        detail::resumer_ptr r = std::make_shared<detail::resumer>(h);
+        tasking::enqueue(_code, _tracker, [r]() { r->resume(); }, _hash, _delay);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    task_code _code;
+    task_tracker *_tracker;
+    int _hash;
+    std::chrono::milliseconds _delay;
+};
+
+inline enqueue_awaitable enqueue(task_code code,
+                                 task_tracker *tracker,
+                                 int hash = 0,
+                                 std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+{
+    return enqueue_awaitable(code, tracker, hash, delay);
+}
+
+// timer: resume after "delay"
+inline enqueue_awaitable
+sleep_for(task_code code, task_tracker *tracker, std::chrono::milliseconds delay, int hash = 0)
+{
+    return enqueue_awaitable(code, tracker, hash, delay);
+}
+
+//
+// co_await call<TResponse>(...): send the request and resume with (error, response) on the
+// worker selected by "reply_thread_hash"
+//
+template <typename TResponse>
+class call_awaitable : public detail::result_awaitable<std::pair<error_code, TResponse>>
+{
+public:
+    call_awaitable(rpc_address server,
+                   dsn_message_t request,
+                   task_tracker *tracker,
+                   int reply_thread_hash)
+        : _server(server),
+          _request(request),
+          _tracker(tracker),
+          _reply_thread_hash(reply_thread_hash)
+    {
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        detail::resumer_ptr r = std::make_shared<detail::resumer>(h);
+        auto result = &this->_result;
+        rpc::call(_server,
+                  _request,
+                  _tracker,
+                  [r, result](error_code err, dsn_message_t, dsn_message_t resp) {
+                      result->first = err;
+                      if (err == ERR_OK) {
+                          unmarshall(resp, result->second);
+                      }
+                      r->resume();
+                  },
+                  _reply_thread_hash);
+    }
+
+private:
+    rpc_address _server;
+    dsn_message_t _request;
+    task_tracker *_tracker;
+    int _reply_thread_hash;
+};
+
+template <typename TResponse, typename TRequest>
+call_awaitable<TResponse>
+call(rpc_address server,
+     task_code code,
+     TRequest &&req,
+     task_tracker *tracker,
+     std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+     int thread_hash = 0, ///< if thread_hash == 0 && partition_hash != 0, thread_hash is
+                          /// computed from partition_hash
+     uint64_t partition_hash = 0,
+     int reply_thread_hash = 0)
+{
+    dsn_message_t msg = dsn_msg_create_request(
+        code, static_cast<int>(timeout.count()), thread_hash, partition_hash);
+    marshall(msg, std::forward<TRequest>(req));
+    return call_awaitable<TResponse>(server, msg, tracker, reply_thread_hash);
+}
+
+//
+// co_await read(...) / write(...): resume with (error, transferred size) on the worker
+// of the pool of "callback_code" selected by "hash"
+//
+class aio_awaitable : public detail::result_awaitable<std::pair<error_code, size_t>>
+{
+public:
+    aio_awaitable(dsn_handle_t fh,
+                  char *buffer,
+                  int count,
+                  uint64_t offset,
+                  task_code callback_code,
+                  task_tracker *tracker,
+                  int hash,
+                  bool is_write)
+        : _fh(fh),
+          _buffer(buffer),
+          _count(count),
+          _offset(offset),
+          _callback_code(callback_code),
+          _tracker(tracker),
+          _hash(hash),
+          _is_write(is_write)
+    {
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        detail::resumer_ptr r = std::make_shared<detail::resumer>(h);
+        auto result = &this->_result;
+        aio_handler callback = [r, result](error_code err, size_t sz) {
+            result->first = err;
+            result->second = sz;
+            r->resume();
+        };
+
+        if (_is_write) {
+            file::write(_fh,
+                        _buffer,
+                        _count,
+                        _offset,
+                        _callback_code,
+                        _tracker,
+                        std::move(callback),
+                        _hash);
+        } else {
+            file::read(_fh,
+                       _buffer,
+                       _count,
+                       _offset,
+                       _callback_code,
+                       _tracker,
+                       std::move(callback),
+                       _hash);
+        }
+    }
+
+private:
+    dsn_handle_t _fh;
+    char *_buffer;
+    int _count;
+    uint64_t _offset;
+    task_code _callback_code;
+    task_tracker *_tracker;
+    int _hash;
+    bool _is_write;
+};
+
+inline aio_awaitable read(dsn_handle_t fh,
+                          char *buffer,
+                          int count,
+                          uint64_t offset,
+                          task_code callback_code,
+                          task_tracker *tracker,
+                          int hash = 0)
+{
+    return aio_awaitable(fh, buffer, count, offset, callback_code, tracker, hash, false);
+}
+
+inline aio_awaitable write(dsn_handle_t fh,
+                           const char *buffer,
+                           int count,
+                           uint64_t offset,
+                           task_code callback_code,
+                           task_tracker *tracker,
+                           int hash = 0)
+{
+    return aio_awaitable(
+        fh, const_cast<char *>(buffer), count, offset, callback_code, tracker, hash, true);
+}
+}
+}
+
+#endif
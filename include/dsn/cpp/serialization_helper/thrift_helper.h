@@ -71,10 +71,86 @@ public:
         return (uint32_t)l;
     }
 
+    // lend the unread bytes in place, so that TBinaryProtocol assigns strings from them
+    // directly instead of reading them into a temporary buffer first
+    const uint8_t *borrow(uint8_t *buf, uint32_t *len)
+    {
+        const void *data;
+        int size;
+        if (!_reader.next(&data, &size))
+            return nullptr;
+        _reader.backup(size);
+        if ((uint32_t)size < *len)
+            return nullptr;
+        *len = (uint32_t)size;
+        return (const uint8_t *)data;
+    }
+
+    void consume(uint32_t len)
+    {
+        if (len > (uint32_t)_reader.get_remaining_size()) {
+            throw TTransportException(TTransportException::BAD_ARGS,
+                                      "consume length exceeds the borrowed bytes");
+        }
+        _reader.skip(static_cast<int>(len));
+    }
+
+    // a slice keeps the whole buffer alive, which may be a pooled receive buffer of up to
+    // 8MB, and a blob may be kept long (e.g., in a mutation), so smaller fields are copied
+    static const uint32_t BLOB_SLICE_MIN_SIZE = 16 * 1024;
+
+    // read the next 'len' bytes as a slice sharing the buffer of the reader, e.g., the
+    // receive buffer of a message, or as a copy otherwise. only a field of no less than
+    // BLOB_SLICE_MIN_SIZE covering most of the reader is sliced, so that a field does not
+    // pin a buffer much larger than itself; the reader stands for the whole buffer, as a
+    // message larger than a receive block is given a receive buffer of its own size
+    void read_blob(/*out*/ blob &bb, uint32_t len)
+    {
+        if (len > (uint32_t)_reader.get_remaining_size()) {
+            throw TTransportException(TTransportException::END_OF_FILE,
+                                      "no more data to read after end-of-buffer");
+        }
+        if (len < BLOB_SLICE_MIN_SIZE || len * 2 < (uint32_t)_reader.total_size()) {
+            std::shared_ptr<char> buffer(utils::make_shared_array<char>(len));
+            _reader.read(buffer.get(), static_cast<int>(len));
+            bb.assign(std::move(buffer), 0, len);
+        } else {
+            _reader.read(bb, static_cast<int>(len));
+        }
+    }
+
 private:
     binary_reader &_reader;
 };
 
+class binary_reader_protocol;
+
+// the innermost binary_reader_protocol alive in the current thread
+extern __thread binary_reader_protocol *tls_binary_reader_protocol;
+
+// the binary protocol over a binary_reader_transport, which blob::read recognizes by
+// tls_binary_reader_protocol to read blob fields by binary_reader_transport::read_blob,
+// instead of by a dynamic_cast of the transport for each field
+class binary_reader_protocol : public ::apache::thrift::protocol::TBinaryProtocol
+{
+public:
+    explicit binary_reader_protocol(const boost::shared_ptr<binary_reader_transport> &trans)
+        : ::apache::thrift::protocol::TBinaryProtocol(trans),
+          _reader_transport(trans.get()),
+          _outer(tls_binary_reader_protocol)
+    {
+        tls_binary_reader_protocol = this;
+    }
+
+    ~binary_reader_protocol() { tls_binary_reader_protocol = _outer; }
+
+    binary_reader_transport *reader_transport() const { return _reader_transport; }
+
+private:
+    binary_reader_transport *_reader_transport;
+    binary_reader_protocol *_outer; // restored on destruction, as protocols may be nested
+};
+
 class binary_writer_transport : public TVirtualTransport<binary_writer_transport>
 {
 public:
@@ -466,6 +542,21 @@ inline uint32_t blob::read(apache::thrift::protocol::TProtocol *iprot)
     // for optimization, it is dangerous if the oprot is not a binary proto
     apache::thrift::protocol::TBinaryProtocol *binary_proto =
         static_cast<apache::thrift::protocol::TBinaryProtocol *>(iprot);
+
+    // zero-copy for large fields: refer to the bytes in the buffer being unmarshalled (usually
+    // the receive buffer of a message), see binary_reader_transport::read_blob
+    if (iprot == tls_binary_reader_protocol) {
+        int32_t size;
+        uint32_t xfer = binary_proto->readI32(size);
+        if (size < 0) {
+            throw ::apache::thrift::protocol::TProtocolException(
+                ::apache::thrift::protocol::TProtocolException::NEGATIVE_SIZE);
+        }
+        tls_binary_reader_protocol->reader_transport()->read_blob(*this,
+                                                                  static_cast<uint32_t>(size));
+        return xfer + static_cast<uint32_t>(size);
+    }
+
     blob_string str(*this);
     return binary_proto->readString<blob_string>(str);
 }
@@ -711,7 +802,7 @@ inline void unmarshall_thrift_binary(binary_reader &reader, T &val)
     ::dsn::binary_reader_transport trans(reader);
     boost::shared_ptr<::dsn::binary_reader_transport> transport(
         &trans, [](::dsn::binary_reader_transport *) {});
-    ::apache::thrift::protocol::TBinaryProtocol proto(transport);
+    ::dsn::binary_reader_protocol proto(transport);
     unmarshall_thrift_internal(val, &proto);
 }
 
@@ -197,6 +197,19 @@ public:
                 m_count.compare_exchange_strong(oldCount, oldCount - 1, std::memory_order_acquire));
     }
 
+    // Take up to maxCount without blocking, and return how many are taken.
+    int tryWaitMany(int maxCount)
+    {
+        int oldCount = m_count.load(std::memory_order_relaxed);
+        while (oldCount > 0) {
+            int count = oldCount < maxCount ? oldCount : maxCount;
+            if (m_count.compare_exchange_weak(
+                    oldCount, oldCount - count, std::memory_order_acquire))
+                return count;
+        }
+        return 0;
+    }
+
     void wait()
     {
         if (!tryWait())
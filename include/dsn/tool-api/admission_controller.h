@@ -52,8 +52,14 @@ public:
     admission_controller(task_queue *q, std::vector<std::string> &sargs) : _queue(q) {}
     virtual ~admission_controller() {}
 
+    // called before an rpc request is enqueued into the bound queue; when it returns false,
+    // the request is throttled according to rpc_request_admission_mode of its task spec
     virtual bool is_task_accepted(task *task) = 0;
 
+    // called by the worker right after an rpc request is dequeued from the bound queue,
+    // with the time (ns) it has stayed in the queue
+    virtual void on_task_dequeued(task *task, uint64_t sojourn_ns, uint64_t now_ns) {}
+
     task_queue *bound_queue() const { return _queue; }
 
 private:
@@ -81,6 +81,10 @@ public:
     virtual void aio(aio_task *aio) = 0;
     virtual disk_aio *prepare_aio_context(aio_task *) = 0;
 
+    // whether AIO_Sync and disk_aio::sync_data are handled by aio() itself,
+    // otherwise the disk engine syncs by flush() upon completion of the write
+    virtual bool support_async_sync() const { return false; }
+
     virtual void start(io_modifer &ctx) = 0;
 
 protected:
@@ -66,6 +66,8 @@ struct network_server_config
 
     std::string factory_name;
     int message_buffer_block_size;
+    int listener_count; // listening sockets sharing the port by SO_REUSEPORT, each on its own
+                        // io looper, so the connections are sharded among them by the kernel
 
     DSN_API network_server_config();
     DSN_API network_server_config(int p, rpc_channel c);
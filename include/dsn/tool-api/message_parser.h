@@ -137,6 +137,10 @@ public:
     // may be invoked for mutiple times if the message is reused for resending.
     virtual int get_buffers_on_send(message_ex *msg, /*out*/ send_buf *buffers) = 0;
 
+    // all the buffers got by get_buffers_on_send() are sent or dropped, so the
+    // buffers owned by the parser (not by the messages) can be reused.
+    virtual void on_buffers_sent() {}
+
 public:
     DSN_API static network_header_format
     get_header_type(const char *bytes); // buffer size >= sizeof(uint32_t)
@@ -41,6 +41,7 @@
 #include <dsn/tool-api/rpc_address.h>
 #include <dsn/utility/exp_delay.h>
 #include <dsn/utility/dlib.h>
+#include <dsn/cpp/perf_counter_wrapper.h>
 #include <atomic>
 
 namespace dsn {
@@ -139,6 +140,7 @@ public:
     network_header_format client_hdr_format() const { return _client_hdr_format; }
     network_header_format unknown_msg_hdr_format() const { return _unknown_msg_header_format; }
     int message_buffer_block_size() const { return _message_buffer_block_size; }
+    int listener_count() const { return _listener_count; }
 
 protected:
     DSN_API static uint32_t get_local_ipv4();
@@ -148,6 +150,7 @@ protected:
     network_header_format _client_hdr_format;
     network_header_format _unknown_msg_header_format; // default is NET_HDR_INVALID
     int _message_buffer_block_size;
+    int _listener_count; // see network_server_config::listener_count
     int _max_buffer_block_count_per_send;
     int _send_queue_threshold;
 
@@ -155,6 +158,7 @@ private:
     friend class rpc_engine;
     DSN_API void reset_parser_attr(network_header_format client_hdr_format,
                                    int message_buffer_block_size);
+    DSN_API void reset_listener_attr(int listener_count);
 };
 
 /*!
@@ -172,7 +176,7 @@ public:
     DSN_API void on_server_session_disconnected(rpc_session_ptr &s);
 
     // client session management
-    DSN_API rpc_session_ptr get_client_session(::dsn::rpc_address ep);
+    DSN_API rpc_session_ptr get_client_session(::dsn::rpc_address ep, int stripe = 0);
     DSN_API void on_client_session_connected(rpc_session_ptr &s);
     DSN_API void on_client_session_disconnected(rpc_session_ptr &s);
 
@@ -185,10 +189,32 @@ public:
     // to be defined
     virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) = 0;
 
+    // the stripe of the client sessions to the remote address for the request
+    DSN_API int get_client_stripe(message_ex *request) const;
+
 protected:
-    typedef std::unordered_map<::dsn::rpc_address, rpc_session_ptr> client_sessions;
-    client_sessions _clients; // to_address => rpc_session
+    struct stripe_counters
+    {
+        perf_counter_wrapper session_count;
+        perf_counter_wrapper connect_qps;
+        perf_counter_wrapper send_qps;
+    };
+
+    // the client sessions to a remote address are striped, each stripe being a session
+    // created, connected and reconnected independently; a request always goes to the
+    // same stripe for the same gpid (or thread hash), so per-partition ordering is kept
+    struct client_stripes
+    {
+        std::vector<rpc_session_ptr> sessions;                  // one per stripe
+        std::vector<std::unique_ptr<stripe_counters>> counters; // empty if not striped
+    };
+    typedef std::unordered_map<::dsn::rpc_address, client_stripes> client_sessions;
+    client_sessions _clients; // to_address => rpc_session of each stripe
     utils::rw_lock_nr _clients_lock;
+    int _client_stripe_count;
+
+    // the counters of each stripe to the remote address, as client.stripe.<address>.<stripe>.*
+    void init_stripe_counters(::dsn::rpc_address to, client_stripes &stripes);
 
     typedef std::unordered_map<::dsn::rpc_address, rpc_session_ptr> server_sessions;
     server_sessions _servers; // from_address => rpc_session
@@ -263,6 +289,8 @@ protected:
     bool is_disconnected() const { return _connect_state == SS_DISCONNECTED; }
     bool is_connecting() const { return _connect_state == SS_CONNECTING; }
     bool is_connected() const { return _connect_state == SS_CONNECTED; }
+    // whether delay_recv() is called but not yet applied by start_read_next()
+    bool has_pending_recv_delay() const { return _delay_server_receive_ms.load() > 0; }
     DSN_API void on_send_completed(uint64_t signature = 0); // default value for nothing is sent
 
 private:
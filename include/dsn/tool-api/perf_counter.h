@@ -135,6 +135,10 @@ public:
     // return the latest sample value
     virtual uint64_t get_latest_sample() const { return 0; }
 
+    // return the accumulated value of a RATE counter since created, which does not start
+    // a new rate window as get_value() does
+    virtual uint64_t get_total() const { return 0; }
+
     const char *full_name() const { return _full_name.c_str(); }
     const char *app() const { return _app.c_str(); }
     const char *section() const { return _section.c_str(); }
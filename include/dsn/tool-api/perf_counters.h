@@ -27,14 +27,21 @@
 #pragma once
 
 #include <dsn/tool-api/perf_counter.h>
+#include <dsn/tool-api/task_code.h>
+#include <dsn/tool-api/threadpool_code.h>
+#include <dsn/utility/binary_writer.h>
 #include <dsn/utility/singleton.h>
 #include <dsn/utility/synchronize.h>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <queue>
 
 namespace dsn {
 
+// http GET /metrics, see perf_counters::start_http_metrics
+DEFINE_TASK_CODE_RPC(RPC_HTTP_METRICS, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
+
 // manager of all perf counters of the process, perf counter users can use get_xxx_counter
 // functions to get a specific perf counter and change the value.
 // monitor system can user get_all_counters to get all the perf counters values and push it to
@@ -74,11 +81,34 @@ public:
     static std::string get_counter_value(const std::vector<std::string> &args);
     static std::string get_counter_sample(const std::vector<std::string> &args);
 
+    // serve write_metrics() at http GET /metrics on all the nodes
+    void start_http_metrics();
+
+    // write all the counters in OpenMetrics text format, as metric families named
+    // "<section>_<name>" labeled by the apps, where the rate counters are exposed as counters
+    // of their totals, the percentile counters as summaries, and the volatile numbers are
+    // skipped as they are reset on get. the counters are iterated over a snapshot, so
+    // _lock is held only to take the snapshot.
+    void write_metrics(binary_writer &writer);
+
 private:
     // full_name = perf_counter::build_full_name(...);
     perf_counter_ptr get_counter(const char *full_name);
     std::string list_counter_internal(const std::vector<std::string> &args);
 
+    // the counters sorted by the metric families, with their names and labels formatted
+    struct metric
+    {
+        perf_counter_ptr counter;
+        std::string family_header; // "# TYPE" and "# HELP" lines for the first of a family
+        std::string sample_prefix; // e.g., network_rpc_compress_raw_bytes_total{app="replica"
+    };
+    typedef std::vector<metric> metrics_snapshot;
+
+    // rebuilt on the first call after the counters are changed
+    std::shared_ptr<const metrics_snapshot> get_metrics_snapshot();
+    static void on_http_metrics(dsn_message_t req);
+
     mutable utils::rw_lock_nr _lock;
 
     // keep counter as a refptr to make the counter can be safely accessed
@@ -93,6 +123,9 @@ private:
     };
     std::map<std::string, counter_object> _counters;
     perf_counter::factory _factory;
+
+    uint64_t _version; // changed as counters are added or removed
+    std::shared_ptr<const metrics_snapshot> _metrics_snapshot;
 };
 
 } // end namespace dsn::utils
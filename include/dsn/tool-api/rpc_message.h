@@ -49,6 +49,7 @@
 
 namespace dsn {
 class rpc_session;
+class rpc_engine;
 typedef ::dsn::ref_ptr<rpc_session> rpc_session_ptr;
 
 typedef struct dsn_buffer_t // binary compatible with WSABUF on windows
@@ -110,7 +111,7 @@ typedef struct message_header
 
 class message_ex : public ref_counter,
                    public extensible_object<message_ex, 4>,
-                   public transient_object
+                   public pooled_object
 {
 public:
     message_header *header;
@@ -129,6 +130,9 @@ public:
     dsn::task_code local_rpc_code;
     network_header_format hdr_format;
     int send_retry_count;
+    // set when the message is delivered within the process without network, it is the
+    // engine at the other end, e.g., the caller's engine which the response is delivered to
+    rpc_engine *local_peer;
 
     // by message queuing
     dlink dl;
@@ -158,6 +162,9 @@ public:
     DSN_API message_ex *create_response();
     DSN_API message_ex *copy(bool clone_content, bool copy_for_receive);
     DSN_API message_ex *copy_and_prepare_send(bool clone_content);
+    // make a received message from a sent message without copying the body,
+    // for delivering messages within the process
+    DSN_API message_ex *copy_for_local_receive();
 
     //
     // routines for buffer management
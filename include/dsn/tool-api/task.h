@@ -38,6 +38,7 @@
 
 #include <functional>
 #include <tuple>
+#include <vector>
 #include <dsn/utility/ports.h>
 #include <dsn/utility/extensible_object.h>
 #include <dsn/utility/callocator.h>
@@ -188,7 +189,7 @@ extern __thread struct __tls_dsn__ tls_dsn;
 /// functions for different purposes on these hook points, you may want to refer to
 /// "tracer", "profiler" and "fault_injector" for details.
 ///
-class task : public ref_counter, public extensible_object<task, 4>, public transient_object
+class task : public ref_counter, public extensible_object<task, 4>, public pooled_object
 {
 public:
     task(task_code code, int hash = 0, service_node *node = nullptr);
@@ -219,6 +220,11 @@ public:
         enqueue();
     }
 
+    // enqueue the tasks as calling enqueue() on each of them, except that the tasks going
+    // to the same thread pool are appended to their queues in one go, and only as many
+    // workers as needed are woken up
+    static void enqueue_batch(const std::vector<dsn::ref_ptr<task>> &tasks);
+
     // used for task_worker to execute the task
     void exec_internal();
 
@@ -330,6 +336,15 @@ private:
 public:
     // used by task queue only
     task *next;
+
+    // used by timer service only, while the task is waiting for its delay
+    struct timer_link
+    {
+        timer_service *owner; // notified when the task is cancelled
+        task **slot;          // the list holding the task, or nullptr when unlinked
+        task *prev;
+        uint32_t expire_tick;
+    } timer;
 };
 typedef dsn::ref_ptr<dsn::task> task_ptr;
 
@@ -439,28 +454,41 @@ public:
 
     DSN_API void enqueue() override;
 
+    // absolute deadline (ns) derived from the client timeout when the request is enqueued,
+    // 0 if the request has no timeout
+    uint64_t deadline_ns() const { return _deadline_ns; }
+    // when the request is enqueued (ns), 0 if it is not enqueued by enqueue(), or has
+    // neither a timeout nor an admission controller on its pool
+    uint64_t enqueue_ts_ns() const { return _enqueue_ts_ns; }
+
+    // called by the task executors (task_worker::loop, io_looper_task_queue) right after
+    // dequeue, return true if the request is cancelled as its deadline has passed, so that
+    // the following exec_internal() only releases it
+    DSN_API bool drop_if_expired(uint64_t now_ns);
+
+    // return true if the request should be checked against its deadline after dequeue
+    bool need_drop_check() const
+    {
+        return 0 != _deadline_ns && spec().rpc_request_dropped_before_execution_when_timeout;
+    }
+
     void exec() override
     {
-        if (0 == _enqueue_ts_ns ||
-            dsn_now_ns() - _enqueue_ts_ns <
-                static_cast<uint64_t>(_request->header->client.timeout_ms) * 1000000ULL) {
-            if (dsn_likely(nullptr != _handler)) {
-                _handler(_request);
-            }
-        } else {
-            dwarn("rpc_request_task(%s) from(%s) stop to execute due to timeout_ms(%d) exceed",
-                  spec().name.c_str(),
-                  _request->header->from_address.to_string(),
-                  _request->header->client.timeout_ms);
+        if (dsn_likely(nullptr != _handler)) {
+            _handler(_request);
         }
     }
 
 protected:
     void clear_non_trivial_on_task_end() override { _handler = nullptr; }
 
+private:
+    void on_dropped();
+
 protected:
     message_ex *_request;
     rpc_request_handler _handler;
+    uint64_t _deadline_ns;
     uint64_t _enqueue_ts_ns;
 };
 typedef dsn::ref_ptr<rpc_request_task> rpc_request_task_ptr;
@@ -549,7 +577,8 @@ enum aio_type
 {
     AIO_Invalid,
     AIO_Read,
-    AIO_Write
+    AIO_Write,
+    AIO_Sync // fdatasync, see dsn_file_flush_async
 };
 
 class disk_engine;
@@ -561,6 +590,7 @@ public:
     void *buffer;
     uint32_t buffer_size;
     uint64_t file_offset;
+    bool sync_data; // for AIO_Write, sync the data to disk before completion
 
     // filled by frameworks
     aio_type type;
@@ -572,6 +602,7 @@ public:
           buffer(nullptr),
           buffer_size(0),
           file_offset(0),
+          sync_data(false),
           type(AIO_Invalid),
           engine(nullptr),
           file_object(nullptr)
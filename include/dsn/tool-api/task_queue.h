@@ -73,33 +73,67 @@ public:
     // are balanced,
     // returned batch size is stored in parameter batch_size
     virtual task *dequeue(/*inout*/ int &batch_size) = 0;
+    // enqueue a batch of tasks, which should be added to the queue at once
+    // and wake up at most "count" workers; the default one enqueues them one by one
+    DSN_API virtual void enqueue_batch(task **tasks, int count);
 
     int count() const { return _queue_length.load(std::memory_order_relaxed); }
+    // whether the worker of this queue has nothing to take, which is polled by
+    // the idle worker before parking; the work-stealing queue also checks its peers
+    virtual bool is_empty() const { return count() == 0; }
     int decrease_count(int count = 1)
     {
         _queue_length_counter->add((uint64_t)(-count));
+        if (_node_queue_length_counter)
+            _node_queue_length_counter->add((uint64_t)(-count));
         return _queue_length.fetch_sub(count, std::memory_order_relaxed) - count;
     }
     int increase_count(int count = 1)
     {
         _queue_length_counter->add(count);
+        if (_node_queue_length_counter)
+            _node_queue_length_counter->add(count);
         return _queue_length.fetch_add(count, std::memory_order_relaxed) + count;
     }
     const std::string &get_name() { return _name; }
     task_worker_pool *pool() const { return _pool; }
-    bool is_shared() const { return _worker_count > 1; }
-    int worker_count() const { return _worker_count; }
+    DSN_API service_node *node() const; // node of the pool
+    bool is_shared() const { return _is_shared; }
+    // how many workers are serving the queue, which changes when an elastic pool is resized
+    int worker_count() const { return _worker_count.load(std::memory_order_relaxed); }
     task_worker *owner_worker() const { return _owner_worker; } // when not is_shared()
     int index() const { return _index; }
+    int numa_node() const { return _numa_node; } // -1 when not bound to a numa node
     volatile int *get_virtual_length_ptr() { return &_virtual_queue_length; }
 
     admission_controller *controller() const { return _controller; }
     void set_controller(admission_controller *controller) { _controller = controller; }
 
+protected:
+    // the implementations wrap their blocking waits for new tasks with these, so that
+    // only the time really parked is accounted to the idle park time of the pool
+    uint64_t park_begin() const { return _park_time_counter ? dsn_now_ns() : 0; }
+    void park_end(uint64_t start_ns) const
+    {
+        if (start_ns != 0)
+            _park_time_counter->add(dsn_now_ns() - start_ns);
+    }
+
 private:
     friend class task_worker_pool;
     void set_owner_worker(task_worker *worker) { _owner_worker = worker; }
+    void set_worker_count(int count) { _worker_count.store(count, std::memory_order_relaxed); }
+    void set_park_time_counter(perf_counter *park_time) { _park_time_counter = park_time; }
+    void set_numa_node(int node, perf_counter *queue_length, perf_counter *remote_enqueue)
+    {
+        _numa_node = node;
+        _node_queue_length_counter = queue_length;
+        _node_remote_enqueue_counter = remote_enqueue;
+    }
     void enqueue_internal(task *task);
+    void enqueue_internal_batch(task **tasks, int count);
+    // return false if the rpc request is rejected by the admission controller
+    bool admit(task *task);
 
 private:
     task_worker_pool *_pool;
@@ -107,9 +141,14 @@ private:
     std::string _name;
     int _index;
     admission_controller *_controller;
-    int _worker_count;
+    std::atomic<int> _worker_count;
+    bool _is_shared;
     std::atomic<int> _queue_length;
     dsn::perf_counter_wrapper _queue_length_counter;
+    int _numa_node;
+    perf_counter *_node_queue_length_counter;   // owned by the pool
+    perf_counter *_node_remote_enqueue_counter; // owned by the pool
+    perf_counter *_park_time_counter;           // owned by the pool
     threadpool_spec *_spec;
     volatile int _virtual_queue_length;
 };
@@ -134,6 +134,20 @@ ENUM_REG(TM_REJECT)
 ENUM_REG(TM_DELAY)
 ENUM_END(throttling_mode_t)
 
+typedef enum rpc_compression_type_t {
+    RPC_COMPRESSION_NONE, // the message body is sent as it is
+    RPC_COMPRESSION_LZ4,  // fast, for the bodies sent frequently
+    RPC_COMPRESSION_ZSTD, // better ratio, for the large bodies, e.g., learning and copying
+    RPC_COMPRESSION_COUNT,
+    RPC_COMPRESSION_INVALID
+} rpc_compression_type_t;
+
+ENUM_BEGIN(rpc_compression_type_t, RPC_COMPRESSION_INVALID)
+ENUM_REG(RPC_COMPRESSION_NONE)
+ENUM_REG(RPC_COMPRESSION_LZ4)
+ENUM_REG(RPC_COMPRESSION_ZSTD)
+ENUM_END(rpc_compression_type_t)
+
 ENUM_BEGIN(dsn_msg_serialize_format, DSF_INVALID)
 ENUM_REG(DSF_THRIFT_BINARY)
 ENUM_REG(DSF_THRIFT_COMPACT)
@@ -211,12 +225,17 @@ public:
     dsn_msg_serialize_format rpc_msg_payload_serialize_default_format;
     rpc_channel rpc_call_channel;
     bool rpc_message_crc_required;
+    rpc_compression_type_t rpc_message_compression;
+    int32_t rpc_message_compression_threshold; // smaller bodies are never compressed
 
     int32_t rpc_timeout_milliseconds;
     int32_t rpc_request_resend_timeout_milliseconds;  // 0 for no auto-resend
     throttling_mode_t rpc_request_throttling_mode;    //
     std::vector<int> rpc_request_delays_milliseconds; // see exp_delay for delaying recving
     bool rpc_request_dropped_before_execution_when_timeout;
+    bool rpc_request_reply_when_dropped_for_timeout;  // reply ERR_TIMEOUT or stay silent
+    throttling_mode_t rpc_request_admission_mode;     // when rejected by admission controller
+    int32_t rpc_request_admission_delay_milliseconds; // for TM_DELAY of the above
 
     task_rejection_handler rejection_handler;
 
@@ -319,6 +338,19 @@ CONFIG_FLD(bool,
            rpc_message_crc_required,
            false,
            "whether to calculate the crc checksum when send request/response")
+CONFIG_FLD_ENUM(rpc_compression_type_t,
+                rpc_message_compression,
+                RPC_COMPRESSION_NONE,
+                RPC_COMPRESSION_INVALID,
+                false,
+                "how to compress the body when send request/response: RPC_COMPRESSION_NONE, "
+                "RPC_COMPRESSION_LZ4, RPC_COMPRESSION_ZSTD, only applied when rDSN is built with "
+                "ENABLE_RPC_COMPRESSION and the peer is able to decompress it")
+CONFIG_FLD(int32_t,
+           uint64,
+           rpc_message_compression_threshold,
+           4096,
+           "the body is compressed only when it is no smaller than this many bytes")
 CONFIG_FLD(int32_t,
            uint64,
            rpc_timeout_milliseconds,
@@ -350,6 +382,26 @@ CONFIG_FLD(bool,
            false,
            "whether to drop a request right before execution when its queueing time is already "
            "greater than its timeout value")
+CONFIG_FLD(bool,
+           bool,
+           rpc_request_reply_when_dropped_for_timeout,
+           false,
+           "whether to reply ERR_TIMEOUT to the client when a request is dropped due to "
+           "timeout, or stay silent")
+CONFIG_FLD_ENUM(throttling_mode_t,
+                rpc_request_admission_mode,
+                TM_REJECT,
+                TM_INVALID,
+                false,
+                "admission mode for rpc requests when they are not accepted by the admission "
+                "controller of the task queue: TM_NONE to accept them anyway, TM_REJECT to reply "
+                "ERR_BUSY, TM_DELAY to accept them but delay recving from their sessions")
+CONFIG_FLD(int32_t,
+           uint64,
+           rpc_request_admission_delay_milliseconds,
+           10,
+           "how many milliseconds to delay recving rpc session for when "
+           "rpc_request_admission_mode = TM_DELAY")
 CONFIG_END
 
 struct threadpool_spec
@@ -361,17 +413,32 @@ struct threadpool_spec
     bool worker_share_core;
     uint64_t worker_affinity_mask;
     int dequeue_batch_size;
-    bool partitioned; // false by default
+    bool partitioned;   // false by default
+    bool work_stealing; // false by default, only valid when partitioned == false
+    bool numa_aware;    // false by default
     std::string queue_factory_name;
     std::string worker_factory_name;
     std::list<std::string> queue_aspects;
     std::list<std::string> worker_aspects;
     int queue_length_throttling_threshold;
     bool enable_virtual_queue_throttling;
+    int idle_spin_count;  // how many times to poll the queue before yielding when idle
+    int idle_yield_count; // how many times to yield before parking when idle
+    int elastic_min_worker_count; // bounds of the auto-scaler, which is disabled when
+    int elastic_max_worker_count; // elastic_max_worker_count is 0
+    int elastic_check_interval_ms;
+    int elastic_scale_up_queueing_time_ms;
+    int elastic_scale_down_idle_checks;
     std::string admission_controller_factory_name;
     std::string admission_controller_arguments;
-
-    threadpool_spec(const dsn::threadpool_code &code) : name(code.to_string()), pool_code(code) {}
+    // no-op task of this pool to wake up its retired workers, registered by service_spec::init
+    // for the pools which may be elastic
+    dsn::task_code wake_up_task_code;
+
+    threadpool_spec(const dsn::threadpool_code &code)
+        : name(code.to_string()), pool_code(code), wake_up_task_code(TASK_CODE_INVALID)
+    {
+    }
     threadpool_spec(const threadpool_spec &source) = default;
     threadpool_spec &operator=(const threadpool_spec &source) = default;
 
@@ -406,6 +473,18 @@ CONFIG_FLD(bool,
            "whethe the threads share a single "
            "queue(partitioned=false) or not; the latter is usually "
            "for workload hash partitioning for avoiding locking")
+CONFIG_FLD(bool,
+           bool,
+           work_stealing,
+           false,
+           "whether each thread owns a private queue and steals tasks from "
+           "its peers when idle; only valid when partitioned = false")
+CONFIG_FLD(bool,
+           bool,
+           numa_aware,
+           false,
+           "whether to spread the threads across numa nodes by contiguous index ranges "
+           "and bind each of them to the cores and the memory of its node")
 CONFIG_FLD_STRING(queue_factory_name, "", "task queue provider name")
 CONFIG_FLD_STRING(worker_factory_name, "", "task worker provider name")
 CONFIG_FLD_STRING_LIST(queue_aspects, "task queue aspects names, usually for tooling purpose")
@@ -420,6 +499,46 @@ CONFIG_FLD(bool,
            enable_virtual_queue_throttling,
            false,
            "throttling: whether to enable throttling with virtual queues")
+CONFIG_FLD(int,
+           uint64,
+           idle_spin_count,
+           0,
+           "idle strategy: how many times an idle worker busy-polls its queue before "
+           "yielding, 0 for no spinning")
+CONFIG_FLD(int,
+           uint64,
+           idle_yield_count,
+           0,
+           "idle strategy: how many times an idle worker yields its cpu before parking, "
+           "0 for no yielding")
+CONFIG_FLD(int,
+           uint64,
+           elastic_min_worker_count,
+           1,
+           "elastic: min worker count the auto-scaler may shrink the pool to")
+CONFIG_FLD(int,
+           uint64,
+           elastic_max_worker_count,
+           0,
+           "elastic: max worker count the auto-scaler may grow the pool to, 0 to disable "
+           "auto-scaling; only valid when partitioned = false and work_stealing = false")
+CONFIG_FLD(int,
+           uint64,
+           elastic_check_interval_ms,
+           1000,
+           "elastic: interval (ms) of the auto-scaler checking the queue of the pool")
+CONFIG_FLD(int,
+           uint64,
+           elastic_scale_up_queueing_time_ms,
+           100,
+           "elastic: grow the pool by one worker when the estimated queueing time (ms) "
+           "exceeds this value")
+CONFIG_FLD(int,
+           uint64,
+           elastic_scale_down_idle_checks,
+           10,
+           "elastic: shrink the pool by one worker when the queue is found empty in so "
+           "many consecutive checks")
 CONFIG_FLD_STRING(admission_controller_factory_name,
                   "",
                   "customized admission controller for the task queues")
@@ -36,8 +36,9 @@
 
 #pragma once
 
-#include <dsn/utility/link.h>
+#include <dsn/utility/ports.h>
 #include <dsn/utility/synchronize.h>
+#include <dsn/utility/object_pool.h>
 #include <dsn/c/api_utilities.h>
 #include <atomic>
 
@@ -50,10 +51,32 @@ namespace dsn {
 //
 class task;
 class task_tracker;
+
+//
+// a tracked task is represented by a node in a lock-free list of its tracker; the node is
+// allocated from the per-thread object pools, and outlives the task when it is finished
+// before the tracker reclaims the node
+//
+struct tracked_task_node
+{
+    enum state_t
+    {
+        TASK_ALIVE = 0,
+        TASK_DETACHED = 1,  // the task is finished, the node is to be freed by the tracker
+        TRACKER_LOCKED = 2, // the tracker is cancelling or waiting for the task
+        TRACKER_DONE = 3,   // the tracker is done, the node is to be freed by the task
+        TASK_DETACHING = 4  // the task is counting itself finished to the tracker
+    };
+
+    std::atomic<int> state;
+    task *tsk;
+    tracked_task_node *next;
+};
+
 class trackable_task
 {
 public:
-    trackable_task() : _task(nullptr), _owner(nullptr), _dl_bucket_id(0) {}
+    trackable_task() : _owner(nullptr), _node(nullptr) {}
     virtual ~trackable_task() {}
 
     void set_tracker(task_tracker *owner, task *tsk);
@@ -61,26 +84,8 @@ public:
     task_tracker *tracker() const { return _owner; }
 
 private:
-    friend class task_tracker;
-
-    enum owner_delete_state
-    {
-        OWNER_DELETE_NOT_LOCKED = 0,
-        OWNER_DELETE_LOCKED = 1,
-        OWNER_DELETE_FINISHED = 2
-    };
-
-    task *_task;
     task_tracker *_owner;
-    std::atomic<owner_delete_state> _deleting_owner;
-
-    // double-linked list for put into _owner
-    dlink _dl;
-    int _dl_bucket_id;
-
-private:
-    owner_delete_state owner_delete_prepare();
-    void owner_delete_commit();
+    tracked_task_node *_node;
 };
 
 //
@@ -153,7 +158,9 @@ private:
 class task_tracker
 {
 public:
-    explicit task_tracker(int task_bucket_count = 1);
+    // task_bucket_count = 0 for one bucket per worker of the current node, which gives the
+    // threads tracking tasks concurrently their own buckets mostly
+    explicit task_tracker(int task_bucket_count = 0);
     virtual ~task_tracker();
 
     // wait all outstanding tasks to finish
@@ -166,11 +173,42 @@ public:
     // return not finished task count
     int cancel_but_not_wait_outstanding_tasks();
 
+    // tracked tasks not finished yet, summed from the counters of the shards
+    int outstanding_task_count();
+
 private:
     friend class trackable_task;
+
+    // tasks are tracked in the shard of the thread creating them: tracking pushes a node
+    // to the shard, and finishing marks the node detached, both without any lock and
+    // without touching the tracker for the latter. the detached nodes are swept from time
+    // to time by the threads tracking new tasks, and cancel/wait takes the nodes out of
+    // the shards to walk them.
+    //
+    // the outstanding tasks are counted as tracked_count - finished_count summed over the
+    // shards, where a task finishing counts itself to the shard of the finishing thread,
+    // and the tracker counts the ones it has cancelled or waited for.
+    struct alignas(CACHELINE_SIZE) shard
+    {
+        std::atomic<tracked_task_node *> head;
+        std::atomic<int> pushed_count; // since last sweep
+        std::atomic<int> kept_count;   // of last sweep
+        std::atomic<int> tracked_count;
+        std::atomic<int> finished_count;
+        ::dsn::utils::ex_lock_nr_spin sweep_lock;
+    };
+
+    shard &current_shard();
+    void track(tracked_task_node *node);
+    void on_finished();
+    void sweep(shard &s);
+    tracked_task_node *take_all(shard &s);
+    template <typename TOperation>
+    void walk_outstanding_tasks(TOperation op);
+
     const int _task_bucket_count;
-    ::dsn::utils::ex_lock_nr_spin *_outstanding_tasks_lock;
-    dlink *_outstanding_tasks;
+    shard *_shards;
+    char *_shards_memory; // not aligned to the cache lines as _shards
 };
 
 // ------- inlined implementation ----------
@@ -178,52 +216,40 @@ inline void trackable_task::set_tracker(task_tracker *owner, task *tsk)
 {
     dassert(_owner == nullptr, "task tracker is already set");
     _owner = owner;
-    _task = tsk;
-    _deleting_owner.store(OWNER_DELETE_NOT_LOCKED, std::memory_order_release);
 
     if (nullptr != _owner) {
-        _dl_bucket_id =
-            static_cast<int>(::dsn::utils::get_current_tid() % _owner->_task_bucket_count);
-        {
-            utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(
-                _owner->_outstanding_tasks_lock[_dl_bucket_id]);
-            _dl.insert_after(&_owner->_outstanding_tasks[_dl_bucket_id]);
-        }
+        _node = static_cast<tracked_task_node *>(tls_pool_malloc(sizeof(tracked_task_node)));
+        _node->state.store(tracked_task_node::TASK_ALIVE, std::memory_order_relaxed);
+        _node->tsk = tsk;
+        _owner->track(_node);
     }
 }
 
 inline void trackable_task::unset_tracker()
 {
-    if (nullptr != _owner) {
-        auto s = owner_delete_prepare();
-        switch (s) {
-        case OWNER_DELETE_NOT_LOCKED:
-            owner_delete_commit();
-            break;
-        case OWNER_DELETE_LOCKED:
-            while (OWNER_DELETE_LOCKED == _deleting_owner.load(std::memory_order_consume)) {
+    if (nullptr != _node) {
+        while (true) {
+            // the node is then freed by the tracker, which waits while TASK_DETACHING
+            int state = tracked_task_node::TASK_ALIVE;
+            if (_node->state.compare_exchange_strong(
+                    state, tracked_task_node::TASK_DETACHING, std::memory_order_acq_rel)) {
+                _owner->on_finished();
+                _node->state.store(tracked_task_node::TASK_DETACHED, std::memory_order_release);
+                break;
             }
-            break;
-        case OWNER_DELETE_FINISHED:
-            break;
-        }
-        _owner = nullptr;
-    }
-}
 
-inline trackable_task::owner_delete_state trackable_task::owner_delete_prepare()
-{
-    return _deleting_owner.exchange(OWNER_DELETE_LOCKED, std::memory_order_acquire);
-}
+            if (state == tracked_task_node::TRACKER_DONE) {
+                tls_pool_free(_node);
+                break;
+            }
 
-inline void trackable_task::owner_delete_commit()
-{
-    {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(
-            _owner->_outstanding_tasks_lock[_dl_bucket_id]);
-        _dl.remove();
+            // wait for the tracker which is cancelling or waiting for this task
+            while (tracked_task_node::TRACKER_LOCKED ==
+                   _node->state.load(std::memory_order_acquire)) {
+            }
+        }
+        _node = nullptr;
     }
-
-    _deleting_owner.store(OWNER_DELETE_FINISHED, std::memory_order_relaxed);
+    _owner = nullptr;
 }
 }
@@ -41,6 +41,7 @@
 #include <dsn/utility/dlib.h>
 #include <dsn/tool-api/perf_counter.h>
 #include <thread>
+#include <atomic>
 
 namespace dsn {
 
@@ -71,15 +72,24 @@ public:
     // service management
     DSN_API void start();
     DSN_API void stop();
+    // ask the worker to exit after its current batch without waiting for it,
+    // stop() is still needed to reclaim the thread once is_exited()
+    DSN_API void retire();
 
     DSN_API virtual void loop(); // run tasks from _input_queue
 
     // inquery
     const std::string &name() const { return _name; }
     int index() const { return _index; }
+    int numa_node() const { return _numa_node; } // -1 when the pool is not numa-aware
     int native_tid() const { return _native_tid; }
     task_worker_pool *pool() const { return _owner_pool; }
     task_queue *queue() const { return _input_queue; }
+    bool is_exited() const { return _is_exited; }
+    uint64_t processed_task_count() const
+    {
+        return _processed_task_count.load(std::memory_order_relaxed);
+    }
     DSN_API const threadpool_spec &pool_spec() const;
     DSN_API static task_worker *current();
 
@@ -87,12 +97,14 @@ private:
     task_worker_pool *_owner_pool;
     task_queue *_input_queue;
     int _index;
+    int _numa_node;
     int _native_tid;
     std::string _name;
     std::thread *_thread;
-    bool _is_running;
+    volatile bool _is_running;
+    volatile bool _is_exited;
     utils::notify_event _started;
-    int _processed_task_count;
+    std::atomic<uint64_t> _processed_task_count;
 
 public:
     DSN_API static void set_name(const char *name);
@@ -102,6 +114,11 @@ public:
 private:
     void run_internal();
 
+    // spin and then yield until the queue (or the peers it may steal from) is not empty,
+    // return false if it is still empty
+    // after idle_spin_count spins and idle_yield_count yields
+    bool idle_wait(task_queue *q);
+
 public:
     /*!
     @addtogroup tool-api-hooks
@@ -66,6 +66,10 @@ public:
     // after milliseconds, the provider should call task->enqueue()
     virtual void add_timer(task *task) = 0;
 
+    // called when a task added by add_timer is cancelled before it expires,
+    // so that the provider may drop it earlier
+    virtual void cancel_timer(task *task) {}
+
     // inquery
     service_node *node() const { return _node; }
 
@@ -27,6 +27,7 @@
 #pragma once
 
 #include <dsn/utility/transient_memory.h>
+#include <dsn/utility/object_pool.h>
 
 namespace dsn {
 
@@ -49,8 +50,13 @@ public:
 };
 
 /// transient_object uses tls_trans_malloc/tls_trans_free as custom memory allocate.
-/// in rdsn, serveral frequenctly allocated objects(task, rpc_message, etc.)
+/// in rdsn, serveral frequenctly allocated objects
 /// are derived from transient_objects,
 /// so that their memory can be mamanged by trans_memory_allocator
 typedef callocator_object<tls_trans_malloc, tls_trans_free> transient_object;
+
+/// pooled_object uses tls_pool_malloc/tls_pool_free as custom memory allocate.
+/// the hottest objects (task, message_ex) are derived from pooled_object, so that
+/// they are recycled through the per-thread free lists, see object_pool.h
+typedef callocator_object<tls_pool_malloc, tls_pool_free> pooled_object;
 }
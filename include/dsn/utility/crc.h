@@ -45,5 +45,29 @@ uint64_t crc64_concat(uint32_t xy_init,
                       uint64_t y_init,
                       uint64_t y_final,
                       size_t y_size);
+
+//
+// crc32_calc and crc64_calc are dispatched on first use to the fastest implementation
+// the cpu supports: the sse4.2 crc32 instruction for crc32 (which is CRC32C), pclmulqdq
+// folding for crc64, or slicing-by-8 otherwise. all of them compute the same checksums.
+// the implementations are also exposed for tests and benchmarks.
+//
+enum crc_impl_type
+{
+    CRC_IMPL_BYTEWISE,
+    CRC_IMPL_SLICING8,
+    CRC_IMPL_HARDWARE,
+    CRC_IMPL_COUNT
+};
+
+bool crc_impl_supported(crc_impl_type type);
+
+const char *crc32_impl_name(crc_impl_type type);
+
+const char *crc64_impl_name(crc_impl_type type);
+
+uint32_t crc32_calc_with(crc_impl_type type, const void *ptr, size_t size, uint32_t init_crc);
+
+uint64_t crc64_calc_with(crc_impl_type type, const void *ptr, size_t size, uint64_t init_crc);
 }
 }
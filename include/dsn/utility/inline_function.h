@@ -0,0 +1,255 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <dsn/utility/transient_memory.h>
+
+namespace dsn {
+
+/// inline_function is a drop-in replacement of std::function for the callbacks of tasks.
+///
+/// std::function only keeps very small callables (two pointers for libstdc++) in place, so most
+/// of the lambdas of rpc and aio callbacks go to the heap. inline_function keeps callables up
+/// to "Capacity" bytes inside itself, and the larger ones are allocated with tls_trans_malloc,
+/// so a task callback never touches the general purpose allocator.
+///
+/// the interfaces used by the tasks are the same with std::function: construct from any
+/// callable, compare/assign with nullptr, copy, move and invoke. an empty std::function
+/// or a null function pointer makes an empty inline_function.
+template <typename Signature, size_t Capacity = 64>
+class inline_function;
+
+template <typename R, typename... Args, size_t Capacity>
+class inline_function<R(Args...), Capacity>
+{
+    enum op_type
+    {
+        OP_COPY,
+        OP_MOVE,
+        OP_DESTROY
+    };
+
+    typedef R (*invoker_t)(void *storage, Args &&... args);
+    typedef void (*manager_t)(op_type op, void *dst, void *src);
+
+    template <typename F>
+    struct stored_inline
+    {
+        static constexpr bool value = sizeof(F) <= Capacity &&
+                                      alignof(F) <= alignof(std::max_align_t) &&
+                                      std::is_nothrow_move_constructible<F>::value;
+    };
+
+    template <typename F>
+    using enable_if_callable = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, inline_function>::value &&
+        (std::is_void<R>::value ||
+         std::is_convertible<decltype(std::declval<typename std::decay<F>::type &>()(
+                                 std::declval<Args>()...)),
+                             R>::value)>::type;
+
+public:
+    inline_function() noexcept : _invoker(nullptr), _manager(nullptr) {}
+    inline_function(std::nullptr_t) noexcept : inline_function() {}
+
+    template <typename F, typename = enable_if_callable<F>>
+    inline_function(F &&f) : inline_function()
+    {
+        typedef typename std::decay<F>::type functor;
+        if (is_empty(f))
+            return;
+        store<functor>(std::forward<F>(f),
+                       std::integral_constant<bool, stored_inline<functor>::value>());
+    }
+
+    inline_function(const inline_function &other) : inline_function()
+    {
+        if (other._manager != nullptr) {
+            other._manager(OP_COPY, &_storage, const_cast<void *>((const void *)&other._storage));
+            _invoker = other._invoker;
+            _manager = other._manager;
+        }
+    }
+
+    inline_function(inline_function &&other) noexcept : inline_function() { take(other); }
+
+    ~inline_function() { reset(); }
+
+    inline_function &operator=(const inline_function &other)
+    {
+        if (this != &other) {
+            inline_function tmp(other);
+            reset();
+            take(tmp);
+        }
+        return *this;
+    }
+
+    inline_function &operator=(inline_function &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            take(other);
+        }
+        return *this;
+    }
+
+    inline_function &operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    template <typename F, typename = enable_if_callable<F>>
+    inline_function &operator=(F &&f)
+    {
+        inline_function tmp(std::forward<F>(f));
+        reset();
+        take(tmp);
+        return *this;
+    }
+
+    R operator()(Args... args) const
+    {
+        if (_invoker == nullptr)
+            throw std::bad_function_call();
+        return _invoker(const_cast<void *>((const void *)&_storage), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return _invoker != nullptr; }
+
+    friend bool operator==(const inline_function &f, std::nullptr_t) noexcept { return !f; }
+    friend bool operator==(std::nullptr_t, const inline_function &f) noexcept { return !f; }
+    friend bool operator!=(const inline_function &f, std::nullptr_t) noexcept { return !!f; }
+    friend bool operator!=(std::nullptr_t, const inline_function &f) noexcept { return !!f; }
+
+private:
+    template <typename F>
+    static bool is_empty(const F &)
+    {
+        return false;
+    }
+    template <typename S>
+    static bool is_empty(const std::function<S> &f)
+    {
+        return !f;
+    }
+    template <typename S, size_t C>
+    static bool is_empty(const inline_function<S, C> &f)
+    {
+        return !f;
+    }
+    template <typename T>
+    static bool is_empty(T *f)
+    {
+        return f == nullptr;
+    }
+
+    // callable kept in _storage
+    template <typename F, typename T>
+    void store(T &&f, std::true_type)
+    {
+        new (&_storage) F(std::forward<T>(f));
+        _invoker = [](void *s, Args &&... args) -> R {
+            return (*static_cast<F *>(s))(std::forward<Args>(args)...);
+        };
+        _manager = [](op_type op, void *dst, void *src) {
+            switch (op) {
+            case OP_COPY:
+                new (dst) F(*static_cast<const F *>(src));
+                break;
+            case OP_MOVE:
+                new (dst) F(std::move(*static_cast<F *>(src)));
+                static_cast<F *>(src)->~F();
+                break;
+            case OP_DESTROY:
+                static_cast<F *>(dst)->~F();
+                break;
+            }
+        };
+    }
+
+    // callable too large, kept in transient memory and _storage holds the pointer
+    template <typename F, typename T>
+    void store(T &&f, std::false_type)
+    {
+        *reinterpret_cast<F **>(&_storage) =
+            new (tls_trans_malloc(sizeof(F))) F(std::forward<T>(f));
+        _invoker = [](void *s, Args &&... args) -> R {
+            return (**static_cast<F **>(s))(std::forward<Args>(args)...);
+        };
+        _manager = [](op_type op, void *dst, void *src) {
+            switch (op) {
+            case OP_COPY:
+                *static_cast<F **>(dst) =
+                    new (tls_trans_malloc(sizeof(F))) F(**static_cast<F *const *>(src));
+                break;
+            case OP_MOVE:
+                *static_cast<F **>(dst) = *static_cast<F **>(src);
+                break;
+            case OP_DESTROY: {
+                F *p = *static_cast<F **>(dst);
+                p->~F();
+                tls_trans_free(p);
+                break;
+            }
+            }
+        };
+    }
+
+    void take(inline_function &other) noexcept
+    {
+        if (other._manager != nullptr) {
+            other._manager(OP_MOVE, &_storage, &other._storage);
+            _invoker = other._invoker;
+            _manager = other._manager;
+            other._invoker = nullptr;
+            other._manager = nullptr;
+        }
+    }
+
+    void reset() noexcept
+    {
+        if (_manager != nullptr) {
+            manager_t m = _manager;
+            _invoker = nullptr;
+            _manager = nullptr;
+            m(OP_DESTROY, &_storage, nullptr);
+        }
+    }
+
+private:
+    typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type _storage;
+    invoker_t _invoker;
+    manager_t _manager;
+};
+}
@@ -0,0 +1,127 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+namespace utils {
+
+/// numa topology and node-local memory helpers
+///
+/// the topology is read from /sys/devices/system/node on linux, and on other platforms or
+/// when the information is not available, the machine is regarded as a single node which
+/// owns all the cpus.
+///
+/// cpu masks are limited to the first 64 cpus, the same as threadpool_spec.worker_affinity_mask.
+///
+/// the nodes with cpus are indexed densely from 0 in the order of their ids, and all the
+/// "node" arguments and return values below are such indexes.
+
+// count of numa nodes on this machine, at least 1
+int numa_node_count();
+
+// cpus of the given node, return 0 if the node doesn't exist
+uint64_t numa_node_cpu_mask(int node);
+
+// node of the given cpu, return -1 if unknown
+int numa_node_of_cpu(int cpu);
+
+// bind the memory allocated by numa_local_shared_array in current thread to the given node,
+// -1 to unbind
+void numa_set_thread_node(int node);
+
+// node current thread is bound to, -1 if not bound
+int numa_thread_node();
+
+// bind current io thread (e.g., io looper or asio thread) to the nodes in a round-robin
+// manner, both the cpus and the memory allocated by numa_local_shared_array, so that the
+// receive buffers are local to the node the thread runs on; no-op on single-node machines,
+// return the bound node or -1
+int numa_bind_io_thread();
+
+// node current thread is running on, return the bound node if there is, otherwise query the
+// node of the running cpu, return -1 if unknown
+int numa_current_node();
+
+// allocate memory on the given node, the memory is page-aligned and should be released by
+// numa_free with the same size
+void *numa_alloc_onnode(size_t sz, int node);
+void numa_free(void *ptr, size_t sz);
+
+// allocate an array on the node current thread is bound to, which is the same as
+// make_shared_array<char> when current thread is not bound or there is only one node;
+// the node-local arrays are reused through numa_chunk_cache
+std::shared_ptr<char> numa_local_shared_array(size_t sz);
+
+// the freed node-local chunks are kept in per-node free lists and reused, instead of being
+// mmap-ed, mbind-ed and munmap-ed for each allocation (e.g., each transient memory block
+// or large receive buffer); the chunk sizes are rounded up to powers of 2, and the chunks
+// larger than the largest class are not cached
+class numa_chunk_cache
+{
+public:
+    static const int MIN_CLASS_SHIFT = 12; // 4KB
+    static const int CLASS_COUNT = 16;     // up to 128MB
+
+    static numa_chunk_cache &instance();
+
+    numa_chunk_cache(int node_count, size_t max_cached_bytes_per_node);
+    ~numa_chunk_cache();
+
+    // allocate a chunk of at least "sz" bytes on the node, the chunk should be released
+    // by release() with the same node and the returned capacity
+    char *allocate(int node, size_t sz, /*out*/ size_t &capacity);
+    void release(int node, char *chunk, size_t capacity);
+
+    // bytes of the free chunks cached for the node
+    size_t cached_bytes(int node) const;
+
+private:
+    struct free_list
+    {
+        ex_lock_nr_spin lock;
+        std::vector<char *> chunks;
+    };
+
+    struct node_cache
+    {
+        free_list lists[CLASS_COUNT];
+        std::atomic<size_t> cached_bytes{0};
+    };
+
+    int _node_count;
+    size_t _max_cached_bytes_per_node;
+    std::unique_ptr<node_cache[]> _nodes;
+};
+}
+}
@@ -0,0 +1,107 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace dsn {
+
+/// per-thread size-classed object pool
+///
+/// the hot objects of the runtime (tasks, messages, message headers) are allocated and freed
+/// millions of times per second, and more often than not on different threads: a message is
+/// created on a network thread and freed on a worker thread, a response task the other way
+/// round. tls_pool_malloc serves them from free lists kept in thread local storage, one list
+/// for each 16-byte size class up to 1KB:
+///
+///   alloc: local free list -> a batch from the central list -> malloc
+///   free:  local free list -> a batch is handed to the central list when the local one
+///          grows beyond the high watermark -> free when the central list is full
+///
+/// so objects freed on a consumer thread flow back to the producer thread in batches, and the
+/// central lists are only touched once per batch. each central list keeps a bounded number of
+/// batches, so the memory of a burst is returned to the system once the burst is over.
+/// requests larger than 1KB go to tls_trans_malloc.
+///
+/// a hit is an allocation served by a previously freed object, and a miss is one served by
+/// fresh memory.
+
+void *tls_pool_malloc(size_t sz);
+
+// ptr shouldn't be null, and can be freed on any thread
+void tls_pool_free(void *ptr);
+
+struct object_pool_stats
+{
+    uint64_t hit_count;
+    uint64_t miss_count;
+    uint64_t batch_return_count; // batches handed to the central lists
+    // objects freed to the system as the central lists are full, which is counted globally
+    // at once, so it is always 0 in the deltas passed to the hook
+    uint64_t release_count;
+};
+
+// the per-thread stats are merged into the global ones every a few hundred allocations, so the
+// result lags behind a little
+object_pool_stats tls_pool_get_stats();
+
+// hook called with the delta every time a thread merges its stats, used by the service engine
+// to report the stats as perf counters
+typedef void (*object_pool_stats_hook)(const object_pool_stats &delta);
+void tls_pool_set_stats_hook(object_pool_stats_hook hook);
+
+/// stl compatible allocator on top of tls_pool_malloc, e.g., for the control blocks of
+/// std::shared_ptr
+template <typename T>
+class pool_allocator
+{
+public:
+    typedef T value_type;
+
+    pool_allocator() = default;
+    template <typename U>
+    pool_allocator(const pool_allocator<U> &)
+    {
+    }
+
+    T *allocate(size_t n) { return static_cast<T *>(tls_pool_malloc(n * sizeof(T))); }
+    void deallocate(T *p, size_t) { tls_pool_free(p); }
+
+    template <typename U>
+    bool operator==(const pool_allocator<U> &) const
+    {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const pool_allocator<U> &) const
+    {
+        return false;
+    }
+};
+}
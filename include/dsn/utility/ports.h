@@ -110,6 +110,11 @@ __pragma(warning(disable : 4127))
 #endif
 #endif
 
+// size of the cache lines, for keeping data written by different threads apart
+#ifndef CACHELINE_SIZE
+#define CACHELINE_SIZE 64
+#endif
+
 #ifdef _WIN32
 #define dsn_likely(pred) pred
 #define dsn_unlikely(pred) pred
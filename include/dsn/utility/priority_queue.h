@@ -63,6 +63,20 @@ public:
         }
     }
 
+    // enqueue "count" objects with one lock, "get_priority" returns the priority of an object
+    template <typename TGetPriority>
+    long enqueue_batch(const T *objs, int count, TGetPriority get_priority)
+    {
+        auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        for (int i = 0; i < count; i++) {
+            uint32_t priority = get_priority(objs[i]);
+            assert(priority >= 0 && priority < priority_count); // "wrong priority");
+            _items[priority].push(objs[i]);
+        }
+        _count += count;
+        return _count;
+    }
+
     virtual T dequeue()
     {
         auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
@@ -130,6 +144,15 @@ public:
         return r;
     }
 
+    template <typename TGetPriority>
+    long enqueue_batch(const T *objs, int count, TGetPriority get_priority)
+    {
+        auto r =
+            priority_queue<T, priority_count, TQueue>::enqueue_batch(objs, count, get_priority);
+        _sema.signal(count);
+        return r;
+    }
+
     T dequeue_with_timeout(/*out*/ long &ct, int milliseconds)
     {
         if (!_sema.wait(milliseconds)) {
@@ -141,6 +164,16 @@ public:
 
     virtual T dequeue(/*out*/ long &ct) override { return dequeue_with_timeout(ct, 0xffffffff); }
 
+    // return nullptr at once if the queue is empty
+    T try_dequeue(/*out*/ long &ct)
+    {
+        if (!_sema.try_wait()) {
+            ct = 0;
+            return nullptr;
+        }
+        return priority_queue<T, priority_count, TQueue>::dequeue(ct);
+    }
+
 private:
     semaphore _sema;
 };
@@ -115,6 +115,12 @@ public:
         return _store.erase(key) > 0;
     }
 
+    void clear()
+    {
+        auto_write_lock l(_lock);
+        _store.clear();
+    }
+
     void get_all_keys(/*out*/ std::vector<TKey> &keys)
     {
         auto_read_lock l(_lock);
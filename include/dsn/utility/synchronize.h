@@ -152,6 +152,11 @@ public:
 
     inline void wait() { _sema.wait(); }
 
+    inline bool try_wait() { return _sema.tryWait(); }
+
+    // take up to max_count without blocking, return how many are taken
+    inline int try_wait_many(int max_count) { return _sema.tryWaitMany(max_count); }
+
     inline bool wait(int milliseconds)
     {
         if (TIME_MS_MAX == static_cast<unsigned int>(milliseconds)) {
@@ -177,13 +177,14 @@ echo "##########################################################################
 ##############################################
 ## Supported test module:
 ##  - dsn.core.tests
+##  - dsn.core.coroutine.tests
 ##  - dsn.tests
 ##  - dsn.rep_tests.simple_kv
 ##  - dsn.replication.simple_kv
 ##############################################
 if [ -z "$TEST_MODULE" ]
 then
-    TEST_MODULE="dsn.core.tests,dsn.tests,dsn.replication.simple_kv,dsn.rep_tests.simple_kv,dsn.meta.test,dsn.replica.test"
+    TEST_MODULE="dsn.core.tests,dsn.core.coroutine.tests,dsn.tests,dsn.replication.simple_kv,dsn.rep_tests.simple_kv,dsn.meta.test,dsn.replica.test"
 fi
 
 echo "TEST_MODULE=$TEST_MODULE"
@@ -4,6 +4,10 @@
 
 namespace dsn {
 
+// see binary_reader_protocol in thrift_helper.h
+class binary_reader_protocol;
+__thread binary_reader_protocol *tls_binary_reader_protocol = nullptr;
+
 binary_reader::binary_reader(const blob &bb) { init(bb); }
 binary_reader::binary_reader(blob &&bb) { init(std::move(bb)); }
 
@@ -1,6 +1,15 @@
 #include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <mutex>
 #include <dsn/utility/crc.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#define DSN_CRC_X86_HARDWARE
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+
 namespace dsn {
 namespace utils {
 
@@ -12,6 +21,7 @@ struct crc_generator
     static const uintxx_t POLY = uPoly;
     static uintxx_t _crc_table[256];
     static uintxx_t _uX2N[64];
+    static uintxx_t _slicing_table[8][256];
 
     //
     // compute CRC
@@ -59,6 +69,37 @@ struct crc_generator
         return (uCrc);
     };
 
+    //
+    // compute CRC with slicing-by-8, which consumes 8 bytes per iteration;
+    // _slicing_table must be initialized by InitializeSlicingTables() first
+    //
+    static uintxx_t compute_slicing8(const void *pSrc, size_t uSize, uintxx_t uCrc)
+    {
+        const uint8_t *pData = (const uint8_t *)pSrc;
+
+        uCrc = ~uCrc;
+
+        for (; uSize > 0 && ((uintptr_t)pData & 7) != 0; uSize -= 1, pData += 1)
+            uCrc = _crc_table[(uint8_t)(uCrc ^ pData[0])] ^ (uCrc >> 8);
+
+        for (; uSize > 7; uSize -= 8, pData += 8) {
+            uint64_t v;
+            memcpy(&v, pData, sizeof(v));
+            v ^= (uint64_t)uCrc;
+            uCrc = _slicing_table[7][(uint8_t)v] ^ _slicing_table[6][(uint8_t)(v >> 8)] ^
+                   _slicing_table[5][(uint8_t)(v >> 16)] ^ _slicing_table[4][(uint8_t)(v >> 24)] ^
+                   _slicing_table[3][(uint8_t)(v >> 32)] ^ _slicing_table[2][(uint8_t)(v >> 40)] ^
+                   _slicing_table[1][(uint8_t)(v >> 48)] ^ _slicing_table[0][(uint8_t)(v >> 56)];
+        }
+
+        for (; uSize > 0; uSize -= 1, pData += 1)
+            uCrc = _crc_table[(uint8_t)(uCrc ^ pData[0])] ^ (uCrc >> 8);
+
+        uCrc = ~uCrc;
+
+        return (uCrc);
+    };
+
     //
     // Returns (a * b) mod POLY.
     // "a" and "b" are represented in "reversed" order -- LSB is x**(XX-1) coefficient, MSB is x^0
@@ -222,6 +263,29 @@ struct crc_generator
         }
     }
 
+    //
+    // _slicing_table[k][i] is the CRC of byte i followed by k zero bytes
+    //
+    static void InitializeSlicingTables(void)
+    {
+        size_t i, k;
+
+        for (i = 0; i < 256; ++i)
+            _slicing_table[0][i] = _crc_table[i];
+
+        for (k = 1; k < 8; ++k) {
+            for (i = 0; i < 256; ++i) {
+                uintxx_t c = _slicing_table[k - 1][i];
+                _slicing_table[k][i] = _crc_table[(uint8_t)c] ^ (c >> 8);
+            }
+        }
+    }
+
+    //
+    // Returns (x ** n) mod POLY, for any n (not only the multiples of 8)
+    //
+    static uintxx_t ComputeX_Bits(uint64_t n) { return MulPoly(ComputeX_N(n / 8), MSB >> (n % 8)); }
+
     static void PrintTables(char *pTypeName, char *pClassName)
     {
         size_t i, w;
@@ -260,6 +324,9 @@ struct crc_generator
     };
 };
 
+template <typename uintxx_t, uintxx_t uPoly>
+uintxx_t crc_generator<uintxx_t, uPoly>::_slicing_table[8][256];
+
 #define BIT64(n) (1ull << (63 - (n)))
 #define crc64_POLY                                                                                 \
     (BIT64(63) + BIT64(61) + BIT64(59) + BIT64(58) + BIT64(56) + BIT64(55) + BIT64(52) +           \
@@ -418,9 +485,264 @@ uint64_t crc64::_crc_table[sizeof(crc64::_crc_table) / sizeof(crc64::_crc_table[
 
 namespace dsn {
 namespace utils {
+
+#ifdef DSN_CRC_X86_HARDWARE
+
+//
+// crc32 above is CRC32C (Castagnoli), which is exactly what the sse4.2 crc32
+// instruction computes, so the checksums are the same as the table-driven ones.
+//
+// for long buffers, 3 independent streams are computed in parallel to hide the
+// latency of the crc32 instruction, and combined with pclmulqdq:
+//      crc(A##B) = crc(A) * x**(8 * |B|) + crc(B)  (mod POLY, raw crc registers)
+//
+// long streams for the bulk of big buffers, and short streams for the rest
+#define CRC32C_LONG_STREAM_BYTES 1024
+#define CRC32C_SHORT_STREAM_BYTES 128
+
+// (x ** (8 * n - 33)) mod POLY for shifting over 1 and 2 streams, see crc32c_shift
+static uint64_t s_crc32c_long_shift[2];
+static uint64_t s_crc32c_short_shift[2];
+
+__attribute__((target("sse4.2"))) static inline uint64_t
+crc32c_sse42_update(uint64_t c, const uint8_t *p, size_t size)
+{
+    for (; size > 7; size -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    for (; size > 0; size -= 1, p += 1)
+        c = _mm_crc32_u8((uint32_t)c, *p);
+    return c;
+}
+
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_sse42(const void *ptr, size_t size, uint32_t init_crc)
+{
+    return ~(uint32_t)crc32c_sse42_update((uint32_t)~init_crc, (const uint8_t *)ptr, size);
+}
+
+// c * x**(8 * n) mod POLY, with k = x**(8 * n - 33) mod POLY:
+// the carry-less product of the reflected c and k is the reflected c * k * x,
+// and crc32 instruction multiplies it by x**32 and reduces it.
+__attribute__((target("sse4.2,pclmul"))) static inline uint64_t crc32c_shift(uint64_t c,
+                                                                             uint64_t k)
+{
+    __m128i r = _mm_clmulepi64_si128(_mm_cvtsi64_si128(c), _mm_cvtsi64_si128(k), 0x00);
+    return _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(r));
+}
+
+__attribute__((target("sse4.2,pclmul"))) static inline uint64_t
+crc32c_3_streams(uint64_t c0, const uint8_t *p, size_t stream_bytes, const uint64_t *shift)
+{
+    uint64_t c1 = 0, c2 = 0;
+    const uint8_t *p1 = p + stream_bytes;
+    const uint8_t *p2 = p1 + stream_bytes;
+    for (size_t i = 0; i < stream_bytes; i += 8) {
+        uint64_t v0, v1, v2;
+        memcpy(&v0, p + i, sizeof(v0));
+        memcpy(&v1, p1 + i, sizeof(v1));
+        memcpy(&v2, p2 + i, sizeof(v2));
+        c0 = _mm_crc32_u64(c0, v0);
+        c1 = _mm_crc32_u64(c1, v1);
+        c2 = _mm_crc32_u64(c2, v2);
+    }
+    return crc32c_shift(c0, shift[1]) ^ crc32c_shift(c1, shift[0]) ^ c2;
+}
+
+__attribute__((target("sse4.2,pclmul"))) static uint32_t
+crc32c_sse42_pclmul(const void *ptr, size_t size, uint32_t init_crc)
+{
+    const uint8_t *p = (const uint8_t *)ptr;
+    uint64_t c = (uint32_t)~init_crc;
+
+    for (; size >= 3 * CRC32C_LONG_STREAM_BYTES;
+         size -= 3 * CRC32C_LONG_STREAM_BYTES, p += 3 * CRC32C_LONG_STREAM_BYTES)
+        c = crc32c_3_streams(c, p, CRC32C_LONG_STREAM_BYTES, s_crc32c_long_shift);
+
+    for (; size >= 3 * CRC32C_SHORT_STREAM_BYTES;
+         size -= 3 * CRC32C_SHORT_STREAM_BYTES, p += 3 * CRC32C_SHORT_STREAM_BYTES)
+        c = crc32c_3_streams(c, p, CRC32C_SHORT_STREAM_BYTES, s_crc32c_short_shift);
+
+    return ~(uint32_t)crc32c_sse42_update(c, p, size);
+}
+
+//
+// crc64 with pclmulqdq folding, see "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction" by Intel.
+//
+// the reflected 128-bit value X = H * x**64 + L (H is the low qword in memory order)
+// is folded over the next d bits B as X' = H * (x**(d + 64) mod POLY) + L * (x**d mod POLY) + B,
+// which keeps the crc unchanged. the carry-less product of two reflected values is
+// shifted by one bit, so the constants are x**(d + 63) and x**(d - 1) instead.
+// the final 128-bit value is reduced by the table-driven crc from a zero register.
+//
+static uint64_t s_crc64_fold_128[2];
+static uint64_t s_crc64_fold_512[2];
+
+__attribute__((target("pclmul,sse2"))) static inline __m128i crc64_fold(__m128i x,
+                                                                         __m128i k,
+                                                                         __m128i b)
+{
+    __m128i h = _mm_clmulepi64_si128(x, k, 0x00);
+    __m128i l = _mm_clmulepi64_si128(x, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(h, l), b);
+}
+
+__attribute__((target("pclmul,sse2"))) static uint64_t
+crc64_pclmul(const void *ptr, size_t size, uint64_t init_crc)
+{
+    if (size < 64)
+        return crc64::compute_slicing8(ptr, size, init_crc);
+
+    const uint8_t *p = (const uint8_t *)ptr;
+    __m128i x0 = _mm_loadu_si128((const __m128i *)(p + 0));
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(p + 16));
+    __m128i x2 = _mm_loadu_si128((const __m128i *)(p + 32));
+    __m128i x3 = _mm_loadu_si128((const __m128i *)(p + 48));
+
+    // feeding the initial crc register is the same as xoring it into the first 8 bytes
+    x0 = _mm_xor_si128(x0, _mm_cvtsi64_si128((long long)~init_crc));
+    p += 64;
+    size -= 64;
+
+    __m128i k = _mm_set_epi64x((long long)s_crc64_fold_512[1], (long long)s_crc64_fold_512[0]);
+    for (; size >= 64; size -= 64, p += 64) {
+        x0 = crc64_fold(x0, k, _mm_loadu_si128((const __m128i *)(p + 0)));
+        x1 = crc64_fold(x1, k, _mm_loadu_si128((const __m128i *)(p + 16)));
+        x2 = crc64_fold(x2, k, _mm_loadu_si128((const __m128i *)(p + 32)));
+        x3 = crc64_fold(x3, k, _mm_loadu_si128((const __m128i *)(p + 48)));
+    }
+
+    k = _mm_set_epi64x((long long)s_crc64_fold_128[1], (long long)s_crc64_fold_128[0]);
+    x0 = crc64_fold(x0, k, x1);
+    x0 = crc64_fold(x0, k, x2);
+    x0 = crc64_fold(x0, k, x3);
+    for (; size >= 16; size -= 16, p += 16)
+        x0 = crc64_fold(x0, k, _mm_loadu_si128((const __m128i *)p));
+
+    uint8_t buf[16];
+    _mm_storeu_si128((__m128i *)buf, x0);
+    uint64_t crc = crc64::compute_slicing8(buf, sizeof(buf), ~(uint64_t)0);
+    return crc64::compute_slicing8(p, size, crc);
+}
+
+#endif // DSN_CRC_X86_HARDWARE
+
+typedef uint32_t (*crc32_impl)(const void *ptr, size_t size, uint32_t init_crc);
+typedef uint64_t (*crc64_impl)(const void *ptr, size_t size, uint64_t init_crc);
+
+static crc32_impl s_crc32_impls[CRC_IMPL_COUNT];
+static crc64_impl s_crc64_impls[CRC_IMPL_COUNT];
+static const char *s_crc32_impl_names[CRC_IMPL_COUNT];
+static const char *s_crc64_impl_names[CRC_IMPL_COUNT];
+
+static uint32_t crc32_resolve(const void *ptr, size_t size, uint32_t init_crc);
+static uint64_t crc64_resolve(const void *ptr, size_t size, uint64_t init_crc);
+
+// start with the resolvers, which are replaced by the selected implementations on first use
+static std::atomic<crc32_impl> s_crc32_calc(crc32_resolve);
+static std::atomic<crc64_impl> s_crc64_calc(crc64_resolve);
+
+static void crc_init_impls()
+{
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+        crc32::InitializeSlicingTables();
+        crc64::InitializeSlicingTables();
+
+        s_crc32_impls[CRC_IMPL_BYTEWISE] = crc32::compute;
+        s_crc32_impl_names[CRC_IMPL_BYTEWISE] = "bytewise";
+        s_crc32_impls[CRC_IMPL_SLICING8] = crc32::compute_slicing8;
+        s_crc32_impl_names[CRC_IMPL_SLICING8] = "slicing-by-8";
+        s_crc64_impls[CRC_IMPL_BYTEWISE] = crc64::compute;
+        s_crc64_impl_names[CRC_IMPL_BYTEWISE] = "bytewise";
+        s_crc64_impls[CRC_IMPL_SLICING8] = crc64::compute_slicing8;
+        s_crc64_impl_names[CRC_IMPL_SLICING8] = "slicing-by-8";
+
+#ifdef DSN_CRC_X86_HARDWARE
+        __builtin_cpu_init();
+        bool has_sse42 = __builtin_cpu_supports("sse4.2");
+        bool has_pclmul = __builtin_cpu_supports("pclmul");
+
+        if (has_sse42 && has_pclmul) {
+            for (int i = 0; i < 2; i++) {
+                s_crc32c_long_shift[i] =
+                    crc32::ComputeX_Bits(8 * (i + 1) * CRC32C_LONG_STREAM_BYTES - 33);
+                s_crc32c_short_shift[i] =
+                    crc32::ComputeX_Bits(8 * (i + 1) * CRC32C_SHORT_STREAM_BYTES - 33);
+            }
+            s_crc32_impls[CRC_IMPL_HARDWARE] = crc32c_sse42_pclmul;
+            s_crc32_impl_names[CRC_IMPL_HARDWARE] = "sse4.2+pclmulqdq";
+        } else if (has_sse42) {
+            s_crc32_impls[CRC_IMPL_HARDWARE] = crc32c_sse42;
+            s_crc32_impl_names[CRC_IMPL_HARDWARE] = "sse4.2";
+        }
+
+        if (has_pclmul) {
+            s_crc64_fold_128[0] = crc64::ComputeX_Bits(128 + 63);
+            s_crc64_fold_128[1] = crc64::ComputeX_Bits(128 - 1);
+            s_crc64_fold_512[0] = crc64::ComputeX_Bits(512 + 63);
+            s_crc64_fold_512[1] = crc64::ComputeX_Bits(512 - 1);
+            s_crc64_impls[CRC_IMPL_HARDWARE] = crc64_pclmul;
+            s_crc64_impl_names[CRC_IMPL_HARDWARE] = "pclmulqdq";
+        }
+#endif
+    });
+}
+
+static uint32_t crc32_resolve(const void *ptr, size_t size, uint32_t init_crc)
+{
+    crc_init_impls();
+    crc32_impl impl = s_crc32_impls[CRC_IMPL_HARDWARE] ? s_crc32_impls[CRC_IMPL_HARDWARE]
+                                                        : s_crc32_impls[CRC_IMPL_SLICING8];
+    s_crc32_calc.store(impl, std::memory_order_release);
+    return impl(ptr, size, init_crc);
+}
+
+static uint64_t crc64_resolve(const void *ptr, size_t size, uint64_t init_crc)
+{
+    crc_init_impls();
+    crc64_impl impl = s_crc64_impls[CRC_IMPL_HARDWARE] ? s_crc64_impls[CRC_IMPL_HARDWARE]
+                                                        : s_crc64_impls[CRC_IMPL_SLICING8];
+    s_crc64_calc.store(impl, std::memory_order_release);
+    return impl(ptr, size, init_crc);
+}
+
+bool crc_impl_supported(crc_impl_type type)
+{
+    crc_init_impls();
+    return s_crc32_impls[type] != nullptr && s_crc64_impls[type] != nullptr;
+}
+
+const char *crc32_impl_name(crc_impl_type type)
+{
+    crc_init_impls();
+    return s_crc32_impl_names[type];
+}
+
+const char *crc64_impl_name(crc_impl_type type)
+{
+    crc_init_impls();
+    return s_crc64_impl_names[type];
+}
+
+uint32_t crc32_calc_with(crc_impl_type type, const void *ptr, size_t size, uint32_t init_crc)
+{
+    crc_init_impls();
+    return s_crc32_impls[type](ptr, size, init_crc);
+}
+
+uint64_t crc64_calc_with(crc_impl_type type, const void *ptr, size_t size, uint64_t init_crc)
+{
+    crc_init_impls();
+    return s_crc64_impls[type](ptr, size, init_crc);
+}
+
 uint32_t crc32_calc(const void *ptr, size_t size, uint32_t init_crc)
 {
-    return dsn::utils::crc32::compute(ptr, size, init_crc);
+    return s_crc32_calc.load(std::memory_order_acquire)(ptr, size, init_crc);
 }
 
 uint32_t crc32_concat(uint32_t xy_init,
@@ -437,7 +759,7 @@ uint32_t crc32_concat(uint32_t xy_init,
 
 uint64_t crc64_calc(const void *ptr, size_t size, uint64_t init_crc)
 {
-    return dsn::utils::crc64::compute(ptr, size, init_crc);
+    return s_crc64_calc.load(std::memory_order_acquire)(ptr, size, init_crc);
 }
 
 uint64_t crc64_concat(uint32_t xy_init,
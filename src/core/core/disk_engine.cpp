@@ -286,6 +286,34 @@ void disk_engine::write(aio_task *aio)
     }
 }
 
+void disk_engine::flush_async(aio_task *aio)
+{
+    if (!_is_running) {
+        aio->enqueue(ERR_SERVICE_NOT_FOUND, 0);
+        return;
+    }
+
+    if (!aio->spec().on_aio_call.execute(task::get_current_task(), aio, true)) {
+        aio->enqueue(ERR_FILE_OPERATION_FAILED, 0);
+        return;
+    }
+
+    // not ordered by the write queue, the pending writes are not necessarily covered
+    auto dio = aio->aio();
+    auto df = (disk_file *)dio->file;
+    dio->file = df->native_handle();
+    dio->file_object = df;
+    dio->engine = this;
+    dio->type = AIO_Sync;
+
+    if (_provider->support_async_sync()) {
+        aio->add_ref(); // released in complete_io
+        _provider->aio(aio);
+    } else {
+        aio->enqueue(_provider->flush(dio->file), 0);
+    }
+}
+
 void disk_engine::process_write(aio_task *aio, uint32_t sz)
 {
     // no batching
@@ -300,9 +328,11 @@ void disk_engine::process_write(aio_task *aio, uint32_t sz)
         auto bb = tls_trans_mem_alloc_blob((size_t)sz);
         char *ptr = (char *)bb.data();
         auto current_wk = aio;
+        bool sync_data = false;
         do {
             current_wk->copy_to(ptr);
             ptr += current_wk->aio()->buffer_size;
+            sync_data = sync_data || current_wk->aio()->sync_data;
             current_wk = (aio_task *)current_wk->next;
         } while (current_wk);
 
@@ -323,6 +353,7 @@ void disk_engine::process_write(aio_task *aio, uint32_t sz)
         dio->file_object = aio->aio()->file_object;
         dio->engine = aio->aio()->engine;
         dio->type = AIO_Write;
+        dio->sync_data = sync_data; // one sync for the whole batch
 
         new_task->add_ref(); // released in complete_io
         return _provider->aio(new_task);
@@ -338,8 +369,41 @@ void disk_engine::complete_io(aio_task *aio, error_code err, uint32_t bytes, int
               aio->id());
     }
 
+    // sync after the write for providers not linking them together, in a task rather than
+    // here, as flush() blocks and the other completions of the provider would wait for it.
+    // the task takes the code of the write, so the flush blocks the pool of the writer
+    // (e.g., the log pool) instead of THREAD_POOL_DEFAULT
+    if (err == ERR_OK && aio->aio()->type == AIO_Write && aio->aio()->sync_data &&
+        !_provider->support_async_sync()) {
+        aio_task *writer = aio;
+        if (aio->code() == LPC_AIO_BATCH_WRITE) {
+            writer = static_cast<batch_write_io_task *>(aio)->_tasks;
+        }
+
+        dsn::task_ptr sync_task(new raw_task(writer->code(),
+                                             [this, aio, bytes]() {
+                                                 error_code e = _provider->flush(aio->aio()->file);
+                                                 on_io_completed(aio, e, bytes);
+                                             },
+                                             writer->hash(),
+                                             _node));
+        sync_task->enqueue();
+        return;
+    }
+
+    on_io_completed(aio, err, bytes);
+}
+
+void disk_engine::on_io_completed(aio_task *aio, error_code err, uint32_t bytes)
+{
+    // flush_async
+    if (aio->aio()->type == AIO_Sync) {
+        aio->enqueue(err, (size_t)bytes);
+        aio->release_ref(); // added in flush_async
+    }
+
     // batching
-    if (aio->code() == LPC_AIO_BATCH_WRITE) {
+    else if (aio->code() == LPC_AIO_BATCH_WRITE) {
         aio->enqueue(err, (size_t)bytes);
         aio->release_ref(); // added in process_write
     }
@@ -90,6 +90,7 @@ public:
     error_code flush(dsn_handle_t fh);
     void read(aio_task *aio);
     void write(aio_task *aio);
+    void flush_async(aio_task *aio);
 
     void ctrl(dsn_handle_t fh, dsn_ctrl_code_t code, int param);
     disk_aio *prepare_aio_context(aio_task *tsk) { return _provider->prepare_aio_context(tsk); }
@@ -100,6 +101,7 @@ private:
     friend class batch_write_io_task;
     void process_write(aio_task *wk, uint32_t sz);
     void complete_io(aio_task *aio, error_code err, uint32_t bytes, int delay_milliseconds = 0);
+    void on_io_completed(aio_task *aio, error_code err, uint32_t bytes);
 
 private:
     volatile bool _is_running;
@@ -165,9 +165,10 @@ static bool build_server_network_confs(const char *section,
         if (rpc_channel::is_exist(k3.c_str())) {
             /*
             port = 0 for default setting in [apps..default]
-            port.channel = network_provider_name,buffer_block_size
+            port.channel = network_provider_name,buffer_block_size[,listener_count]
             network.server.port().RPC_CHANNEL_TCP = dsn::tools::asio_network_provider,65536
             network.server.port().RPC_CHANNEL_UDP = dsn::tools::asio_network_provider,65536
+            network.server.port().RPC_CHANNEL_TCP = dsn::tools::hpc_network_provider,65536,4
             */
 
             rpc_channel ch = rpc_channel::from_string(k3.c_str(), RPC_CHANNEL_TCP);
@@ -181,22 +182,31 @@ static bool build_server_network_confs(const char *section,
                 "network channel configuration, e.g., dsn::tools::asio_network_provider,65536");
             utils::split_args(v.c_str(), vs, ',');
 
-            if (vs.size() != 2) {
+            if (vs.size() != 2 && vs.size() != 3) {
                 printf("invalid server network specification '%s', should be "
-                       "'$network-factory,$msg-buffer-size'\n",
+                       "'$network-factory,$msg-buffer-size[,$listener-count]'\n",
                        v.c_str());
                 return false;
             }
 
+            auto vit = vs.begin();
             network_server_config ns(port, ch);
-            ns.factory_name = vs.begin()->c_str();
-            ns.message_buffer_block_size = atoi(vs.rbegin()->c_str());
+            ns.factory_name = (vit++)->c_str();
+            ns.message_buffer_block_size = atoi(vit->c_str());
 
             if (ns.message_buffer_block_size == 0) {
-                printf("invalid message buffer size specified: '%s'\n", vs.rbegin()->c_str());
+                printf("invalid message buffer size specified: '%s'\n", vit->c_str());
                 return false;
             }
 
+            if (++vit != vs.end()) {
+                ns.listener_count = atoi(vit->c_str());
+                if (ns.listener_count <= 0) {
+                    printf("invalid listener count specified: '%s'\n", vit->c_str());
+                    return false;
+                }
+            }
+
             nss[ns] = ns;
         } else {
             printf("invalid rpc channel type: %s\n", k3.c_str());
@@ -271,12 +281,14 @@ network_server_config::network_server_config() : port(0), channel(RPC_CHANNEL_TC
 {
     factory_name = "dsn::tools::asio_network_provider";
     message_buffer_block_size = 65536;
+    listener_count = 1;
 }
 
 network_server_config::network_server_config(int p, rpc_channel c) : port(p), channel(c)
 {
     factory_name = "dsn::tools::asio_network_provider";
     message_buffer_block_size = 65536;
+    listener_count = 1;
 }
 
 network_server_config::network_server_config(const network_server_config &r)
@@ -284,6 +296,7 @@ network_server_config::network_server_config(const network_server_config &r)
 {
     factory_name = r.factory_name;
     message_buffer_block_size = r.message_buffer_block_size;
+    listener_count = r.listener_count;
 }
 
 bool network_server_config::operator<(const network_server_config &r) const
@@ -301,6 +314,36 @@ bool service_spec::init()
     if (!threadpool_spec::init(threadpool_specs))
         return false;
 
+    // work stealing requires a private queue per worker, which does not work with
+    // hash partitioning or with io engines bound to the queues
+    for (auto &tspec : threadpool_specs) {
+        if (!tspec.work_stealing)
+            continue;
+
+        if (tspec.partitioned) {
+            printf("work_stealing is disabled for partitioned thread pool %s\n",
+                   tspec.name.c_str());
+            tspec.work_stealing = false;
+        } else if (disk_io_mode == IOE_PER_QUEUE || rpc_io_mode == IOE_PER_QUEUE ||
+                   nfs_io_mode == IOE_PER_QUEUE || timer_io_mode == IOE_PER_QUEUE) {
+            printf("work_stealing is disabled for thread pool %s as IOE_PER_QUEUE is used\n",
+                   tspec.name.c_str());
+            tspec.work_stealing = false;
+        }
+    }
+
+    // the retired workers of an elastic pool are woken up by no-op tasks, which have to
+    // belong to the pool as they go through its queue; registered before task_spec::init
+    // and the toollets, just like the statically defined task codes
+    for (auto &tspec : threadpool_specs) {
+        if (tspec.partitioned || tspec.work_stealing)
+            continue;
+
+        std::string name = "LPC_WAKE_UP_RETIRED_WORKER." + tspec.name;
+        tspec.wake_up_task_code =
+            task_code(name.c_str(), TASK_TYPE_COMPUTE, TASK_PRIORITY_HIGH, tspec.pool_code);
+    }
+
     // init task specs
     if (!task_spec::init())
         return false;
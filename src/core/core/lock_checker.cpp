@@ -91,11 +91,11 @@ void check_wait_task(task *waitee)
         // not much concurrency in the current pool
         &&
         (task::get_current_worker()->pool_spec().partitioned ||
-         task::get_current_worker()->pool_spec().worker_count == 1)) {
+         task::get_current_worker()->pool()->worker_count() == 1)) {
         if ((::dsn::tools::spec().rpc_io_mode == IOE_PER_QUEUE ||
              ::dsn::tools::spec().disk_io_mode == IOE_PER_QUEUE) &&
             (task::get_current_worker()->pool_spec().partitioned ||
-             task::get_current_worker()->pool_spec().worker_count == 1)) {
+             task::get_current_worker()->pool()->worker_count() == 1)) {
             dwarn("cannot call task wait in worker thread '%s' that also serves as io thread "
                   "(disk/rpc_io_mode == IOE_PER_QUEUE) "
                   "when the thread pool is partitioned or the worker thread number is 1",
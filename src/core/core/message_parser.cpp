@@ -34,6 +34,7 @@
  */
 
 #include "message_parser_manager.h"
+#include "recv_buffer_pool.h"
 #include <dsn/service_api_c.h>
 
 namespace dsn {
@@ -140,11 +141,13 @@ char *message_reader::read_buffer_ptr(unsigned int read_next)
         if (_buffer_occupied > 0)
             rb = _buffer.range(0, _buffer_occupied);
 
-        // switch to next
-        unsigned int sz =
-            (read_next + _buffer_occupied > _buffer_block_size ? read_next + _buffer_occupied
-                                                               : _buffer_block_size);
-        _buffer.assign(dsn::utils::make_shared_array<char>(sz), 0, sz);
+        // switch to next, which is taken from the pool of the reading thread and rounded up
+        // to its size class, so the spare capacity is used by the following messages
+        unsigned int need = read_next + _buffer_occupied;
+        size_t capacity;
+        std::shared_ptr<char> buffer = recv_buffer_pool::instance().allocate(
+            need > _buffer_block_size ? need : _buffer_block_size, capacity);
+        _buffer.assign(std::move(buffer), 0, (unsigned int)capacity);
         _buffer_occupied = 0;
 
         // copy
@@ -154,6 +157,15 @@ char *message_reader::read_buffer_ptr(unsigned int read_next)
             _buffer_occupied = rb.length();
         }
 
+        // when the parser knows the whole size of a message larger than a block, the rest
+        // of the message is read in place, instead of into a block first and then copied
+        // here once the block is filled up. the copy avoided is estimated as the room left
+        // in that block, as how much of it the next reads would fill is unknown
+        unsigned int avoided_estimated = 0;
+        if (need > _buffer_block_size && _buffer_occupied < _buffer_block_size)
+            avoided_estimated = _buffer_block_size - _buffer_occupied;
+        recv_buffer_pool::add_copy_stats(_buffer_occupied, avoided_estimated);
+
         dassert(read_next + _buffer_occupied <= _buffer.length(),
                 "%u(%u + %u) VS %u",
                 read_next + _buffer_occupied,
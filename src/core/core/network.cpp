@@ -40,6 +40,7 @@
 #include <dsn/utility/factory_store.h>
 #include "message_parser_manager.h"
 #include "rpc_engine.h"
+#include "service_engine.h"
 
 namespace dsn {
 /*static*/ join_point<void, rpc_session *>
@@ -121,6 +122,8 @@ void rpc_session::clear_send_queue(bool resend_msgs)
         utils::auto_lock<utils::ex_lock_nr> l(_lock);
         _sending_msgs.swap(swapped_sending_msgs);
         _sending_buffers.clear();
+        if (_parser)
+            _parser->on_buffers_sent();
     }
 
     // resend pending messages if need
@@ -323,6 +326,7 @@ void rpc_session::on_send_completed(uint64_t signature)
             }
             _sending_msgs.clear();
             _sending_buffers.clear();
+            _parser->on_buffers_sent();
         }
 
         if (!_is_sending_next) {
@@ -436,6 +440,7 @@ network::network(rpc_engine *srv, network *inner_provider)
     : _engine(srv), _client_hdr_format(NET_HDR_DSN), _unknown_msg_header_format(NET_HDR_INVALID)
 {
     _message_buffer_block_size = 1024 * 64;
+    _listener_count = 1;
     _max_buffer_block_count_per_send = 64; // TODO: windows, how about the other platforms?
     _send_queue_threshold =
         (int)dsn_config_get_value_uint64("network",
@@ -459,6 +464,8 @@ void network::reset_parser_attr(network_header_format client_hdr_format,
     _message_buffer_block_size = message_buffer_block_size;
 }
 
+void network::reset_listener_attr(int listener_count) { _listener_count = listener_count; }
+
 service_node *network::node() const { return _engine->node(); }
 
 void network::on_recv_request(message_ex *msg, int delay_ms)
@@ -527,21 +534,70 @@ uint32_t network::get_local_ipv4()
 connection_oriented_network::connection_oriented_network(rpc_engine *srv, network *inner_provider)
     : network(srv, inner_provider)
 {
+    _client_stripe_count = (int)dsn_config_get_value_uint64(
+        "network",
+        "client_stripe_count",
+        1,
+        "count of the client sessions (connections) to each remote address, the requests "
+        "are distributed among them by gpid or thread hash");
+    dassert(_client_stripe_count > 0, "client_stripe_count must be positive");
+}
+
+void connection_oriented_network::init_stripe_counters(::dsn::rpc_address to,
+                                                       client_stripes &stripes)
+{
+    const char *node_name = node()->full_name();
+    char name[128];
+    for (int i = 0; i < _client_stripe_count; i++) {
+        std::unique_ptr<stripe_counters> c(new stripe_counters());
+        snprintf(name, sizeof(name), "client.stripe.%s.%d.session.count", to.to_string(), i);
+        c->session_count.init_global_counter(
+            node_name, "network", name, COUNTER_TYPE_NUMBER, "client sessions of the stripe");
+        snprintf(name, sizeof(name), "client.stripe.%s.%d.connect.qps", to.to_string(), i);
+        c->connect_qps.init_global_counter(node_name,
+                                           "network",
+                                           name,
+                                           COUNTER_TYPE_RATE,
+                                           "client sessions (re)connected per second");
+        snprintf(name, sizeof(name), "client.stripe.%s.%d.send.qps", to.to_string(), i);
+        c->send_qps.init_global_counter(node_name,
+                                        "network",
+                                        name,
+                                        COUNTER_TYPE_RATE,
+                                        "requests sent through the stripe per second");
+        stripes.counters.push_back(std::move(c));
+    }
+}
+
+int connection_oriented_network::get_client_stripe(message_ex *request) const
+{
+    if (_client_stripe_count == 1)
+        return 0;
+
+    auto hdr = request->header;
+    uint32_t hash = hdr->gpid.value() != 0 ? (uint32_t)hdr->gpid.thread_hash()
+                                           : (uint32_t)hdr->client.thread_hash;
+    return (int)(hash % (uint32_t)_client_stripe_count);
 }
 
 void connection_oriented_network::inject_drop_message(message_ex *msg, bool is_send)
 {
     rpc_session_ptr s = msg->io_session;
     if (s == nullptr) {
-        // - if io_session == nulltr, there must be is_send == true;
+        // - if io_session == nulltr, there must be is_send == true, or the message is
+        //   delivered within the process, in which case there is no connection to close;
         // - but if is_send == true, there may be is_session != nullptr, when it is a
         //   normal (not forwarding) reply message from server to client, in which case
         //   the io_session has also been set.
-        dassert(is_send, "received message should always has io_session set");
+        if (!is_send) {
+            dassert(msg->local_peer != nullptr,
+                    "received message should always has io_session set");
+            return;
+        }
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(msg->to_address);
         if (it != _clients.end()) {
-            s = it->second;
+            s = it->second.sessions[get_client_stripe(msg)];
         }
     }
 
@@ -554,13 +610,18 @@ void connection_oriented_network::send_message(message_ex *request)
 {
     rpc_session_ptr client = nullptr;
     auto &to = request->to_address;
+    int stripe = get_client_stripe(request);
 
+    // the stripe counters go with the sessions of the remote address, so they are only
+    // touched under the lock
     // TODO: thread-local client ptr cache
     {
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(to);
         if (it != _clients.end()) {
-            client = it->second;
+            client = it->second.sessions[stripe];
+            if (client != nullptr && !it->second.counters.empty())
+                it->second.counters[stripe]->send_qps->increment();
         }
     }
 
@@ -568,21 +629,34 @@ void connection_oriented_network::send_message(message_ex *request)
     bool new_client = false;
     if (nullptr == client.get()) {
         utils::auto_write_lock l(_clients_lock);
-        auto it = _clients.find(to);
-        if (it != _clients.end()) {
-            client = it->second;
-        } else {
+        auto &stripes = _clients[to];
+        if (stripes.sessions.empty()) {
+            stripes.sessions.resize(_client_stripe_count);
+            if (_client_stripe_count > 1 && _engine != nullptr)
+                init_stripe_counters(to, stripes);
+        }
+        client = stripes.sessions[stripe];
+        if (nullptr == client.get()) {
             client = create_client_session(to);
-            _clients.insert(client_sessions::value_type(to, client));
+            stripes.sessions[stripe] = client;
             new_client = true;
         }
+        if (!stripes.counters.empty()) {
+            auto &c = stripes.counters[stripe];
+            if (new_client) {
+                c->session_count->increment();
+                c->connect_qps->increment();
+            }
+            c->send_qps->increment();
+        }
         scount = (int)_clients.size();
     }
 
     // init connection if necessary
     if (new_client) {
-        ddebug("client session created, remote_server = %s, current_count = %d",
+        ddebug("client session created, remote_server = %s, stripe = %d, current_count = %d",
                client->remote_address().to_string(),
+               stripe,
                scount);
         client->connect();
     }
@@ -640,11 +714,11 @@ void connection_oriented_network::on_server_session_disconnected(rpc_session_ptr
     }
 }
 
-rpc_session_ptr connection_oriented_network::get_client_session(::dsn::rpc_address ep)
+rpc_session_ptr connection_oriented_network::get_client_session(::dsn::rpc_address ep, int stripe)
 {
     utils::auto_read_lock l(_clients_lock);
     auto it = _clients.find(ep);
-    return it != _clients.end() ? it->second : nullptr;
+    return it != _clients.end() ? it->second.sessions[stripe] : nullptr;
 }
 
 void connection_oriented_network::on_client_session_connected(rpc_session_ptr &s)
@@ -654,8 +728,9 @@ void connection_oriented_network::on_client_session_connected(rpc_session_ptr &s
     {
         utils::auto_read_lock l(_clients_lock);
         auto it = _clients.find(s->remote_address());
-        if (it != _clients.end() && it->second.get() == s.get()) {
-            r = true;
+        if (it != _clients.end()) {
+            auto &sessions = it->second.sessions;
+            r = std::find(sessions.begin(), sessions.end(), s.get()) != sessions.end();
         }
         scount = (int)_clients.size();
     }
@@ -670,20 +745,34 @@ void connection_oriented_network::on_client_session_connected(rpc_session_ptr &s
 void connection_oriented_network::on_client_session_disconnected(rpc_session_ptr &s)
 {
     int scount = 0;
-    bool r = false;
+    int stripe = -1;
     {
         utils::auto_write_lock l(_clients_lock);
         auto it = _clients.find(s->remote_address());
-        if (it != _clients.end() && it->second.get() == s.get()) {
-            _clients.erase(it);
-            r = true;
+        if (it != _clients.end()) {
+            auto &sessions = it->second.sessions;
+            auto sit = std::find(sessions.begin(), sessions.end(), s.get());
+            if (sit != sessions.end()) {
+                // the stripe is reconnected by the next request to it
+                *sit = nullptr;
+                stripe = (int)(sit - sessions.begin());
+                if (!it->second.counters.empty()) {
+                    it->second.counters[stripe]->session_count->decrement();
+                }
+                if (std::all_of(sessions.begin(), sessions.end(), [](const rpc_session_ptr &c) {
+                        return c == nullptr;
+                    })) {
+                    _clients.erase(it);
+                }
+            }
         }
         scount = (int)_clients.size();
     }
 
-    if (r) {
-        ddebug("client session disconnected, remote_server = %s, current_count = %d",
+    if (stripe != -1) {
+        ddebug("client session disconnected, remote_server = %s, stripe = %d, current_count = %d",
                s->remote_address().to_string(),
+               stripe,
                scount);
     }
 }
@@ -0,0 +1,327 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include <cerrno>
+#include <atomic>
+#include <dsn/utility/numa.h>
+#include <dsn/utility/utils.h>
+#include <dsn/utility/strings.h>
+#include <dsn/c/api_utilities.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace dsn {
+namespace utils {
+
+namespace {
+
+// the nodes are indexed densely from 0 in the order of their ids, as the node ids
+// may be sparse (e.g., "0,2" when node 1 is offline, or some nodes have no cpu)
+struct numa_topology
+{
+    std::vector<int> node_ids;            // real node id of each index
+    std::vector<uint64_t> node_cpu_masks; // by index
+    std::vector<int> cpu_nodes;           // node index of each cpu
+
+    numa_topology()
+    {
+#ifdef __linux__
+        std::string online;
+        if (read_line("/sys/devices/system/node/online", online)) {
+            std::vector<int> nodes;
+            parse_list(online, nodes);
+            for (int node : nodes) {
+                std::string cpulist;
+                if (!read_line("/sys/devices/system/node/node" + std::to_string(node) +
+                                   "/cpulist",
+                               cpulist))
+                    continue;
+
+                // memory-only nodes are skipped, as no thread runs on them
+                std::vector<int> cpus;
+                parse_list(cpulist, cpus);
+                if (cpus.empty())
+                    continue;
+
+                int index = (int)node_ids.size();
+                node_ids.push_back(node);
+                node_cpu_masks.push_back(0);
+                for (int cpu : cpus) {
+                    if (cpu < 64)
+                        node_cpu_masks[index] |= ((uint64_t)1 << cpu);
+                    if ((int)cpu_nodes.size() <= cpu)
+                        cpu_nodes.resize(cpu + 1, -1);
+                    cpu_nodes[cpu] = index;
+                }
+            }
+        }
+#endif
+
+        // regard the machine as a single node
+        if (node_cpu_masks.empty()) {
+            int nr_cpu = (int)std::thread::hardware_concurrency();
+            node_ids.push_back(0);
+            node_cpu_masks.push_back(nr_cpu >= 64 ? ~((uint64_t)0)
+                                                  : (((uint64_t)1 << nr_cpu) - 1));
+            cpu_nodes.assign(nr_cpu, 0);
+        }
+    }
+
+    static bool read_line(const std::string &path, std::string &line)
+    {
+        std::ifstream in(path);
+        return in && std::getline(in, line) && !line.empty();
+    }
+
+    // parse list like "0-7,16-23"
+    static void parse_list(const std::string &str, std::vector<int> &items)
+    {
+        std::vector<std::string> ranges;
+        split_args(str.c_str(), ranges, ',');
+        for (auto &r : ranges) {
+            int first = 0, last = 0;
+            auto pos = r.find('-');
+            if (pos == std::string::npos) {
+                first = last = atoi(r.c_str());
+            } else {
+                first = atoi(r.substr(0, pos).c_str());
+                last = atoi(r.substr(pos + 1).c_str());
+            }
+            for (int i = first; i <= last; i++)
+                items.push_back(i);
+        }
+    }
+};
+
+const numa_topology &topology()
+{
+    static numa_topology s_topology;
+    return s_topology;
+}
+
+__thread int tls_numa_node = -1;
+}
+
+int numa_node_count() { return (int)topology().node_cpu_masks.size(); }
+
+uint64_t numa_node_cpu_mask(int node)
+{
+    auto &masks = topology().node_cpu_masks;
+    return (node >= 0 && node < (int)masks.size()) ? masks[node] : 0;
+}
+
+int numa_node_of_cpu(int cpu)
+{
+    auto &nodes = topology().cpu_nodes;
+    return (cpu >= 0 && cpu < (int)nodes.size()) ? nodes[cpu] : -1;
+}
+
+void numa_set_thread_node(int node) { tls_numa_node = node; }
+
+int numa_thread_node() { return tls_numa_node; }
+
+int numa_bind_io_thread()
+{
+    int count = numa_node_count();
+    if (count <= 1)
+        return -1;
+
+    static std::atomic<unsigned int> s_next_node(0);
+    int node = (int)(s_next_node.fetch_add(1, std::memory_order_relaxed) % count);
+    numa_set_thread_node(node);
+
+#ifdef __linux__
+    uint64_t mask = numa_node_cpu_mask(node);
+    if (mask != 0) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        for (int cpu = 0; cpu < 64; cpu++) {
+            if ((mask & ((uint64_t)1 << cpu)) != 0)
+                CPU_SET(cpu, &cpuset);
+        }
+        // the thread is still tagged with the node even if it fails
+        if (::sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0) {
+            dwarn("bind io thread to numa node %d failed, err = %d", node, errno);
+        }
+    }
+#endif
+    return node;
+}
+
+int numa_current_node()
+{
+    if (tls_numa_node >= 0)
+        return tls_numa_node;
+#ifdef __linux__
+    return numa_node_of_cpu(sched_getcpu());
+#else
+    return numa_node_count() == 1 ? 0 : -1;
+#endif
+}
+
+void *numa_alloc_onnode(size_t sz, int node)
+{
+#ifdef __linux__
+    void *ptr = ::mmap(nullptr, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        return nullptr;
+
+    // MPOL_PREFERRED, so that the pages still can be allocated from the other nodes
+    // when the given node is out of memory.
+    // it is fine if mbind fails, as the memory is still usable
+    auto &ids = topology().node_ids;
+    int id = (node >= 0 && node < (int)ids.size()) ? ids[node] : -1;
+    if (id >= 0 && id < 64) {
+        const int mpol_preferred = 1;
+        unsigned long node_mask = (1UL << id);
+        ::syscall(SYS_mbind, ptr, sz, mpol_preferred, &node_mask, sizeof(node_mask) * 8, 0);
+    }
+    return ptr;
+#else
+    return ::malloc(sz);
+#endif
+}
+
+void numa_free(void *ptr, size_t sz)
+{
+#ifdef __linux__
+    ::munmap(ptr, sz);
+#else
+    ::free(ptr);
+#endif
+}
+
+std::shared_ptr<char> numa_local_shared_array(size_t sz)
+{
+    int node = tls_numa_node;
+    if (node >= 0 && numa_node_count() > 1) {
+        size_t capacity;
+        char *ptr = numa_chunk_cache::instance().allocate(node, sz, capacity);
+        if (ptr != nullptr) {
+            return std::shared_ptr<char>(ptr, [node, capacity](char *p) {
+                numa_chunk_cache::instance().release(node, p, capacity);
+            });
+        }
+    }
+    return make_shared_array<char>(sz);
+}
+
+namespace {
+// -1 if the size is larger than the largest class
+int chunk_class_of(size_t sz)
+{
+    for (int c = 0; c < numa_chunk_cache::CLASS_COUNT; c++) {
+        if (sz <= ((size_t)1 << (numa_chunk_cache::MIN_CLASS_SHIFT + c)))
+            return c;
+    }
+    return -1;
+}
+}
+
+/*static*/ numa_chunk_cache &numa_chunk_cache::instance()
+{
+    // never destroyed, as the chunks may be released by the static objects after exit
+    static numa_chunk_cache *s_cache = new numa_chunk_cache(numa_node_count(), 256 * 1024 * 1024);
+    return *s_cache;
+}
+
+numa_chunk_cache::numa_chunk_cache(int node_count, size_t max_cached_bytes_per_node)
+    : _node_count(node_count),
+      _max_cached_bytes_per_node(max_cached_bytes_per_node),
+      _nodes(new node_cache[node_count])
+{
+}
+
+numa_chunk_cache::~numa_chunk_cache()
+{
+    for (int node = 0; node < _node_count; node++) {
+        for (int c = 0; c < CLASS_COUNT; c++) {
+            for (char *chunk : _nodes[node].lists[c].chunks) {
+                numa_free(chunk, (size_t)1 << (MIN_CLASS_SHIFT + c));
+            }
+        }
+    }
+}
+
+char *numa_chunk_cache::allocate(int node, size_t sz, /*out*/ size_t &capacity)
+{
+    int c = (node >= 0 && node < _node_count) ? chunk_class_of(sz) : -1;
+    if (c < 0) {
+        capacity = sz;
+        return static_cast<char *>(numa_alloc_onnode(sz, node));
+    }
+
+    capacity = (size_t)1 << (MIN_CLASS_SHIFT + c);
+    node_cache &nc = _nodes[node];
+    {
+        free_list &list = nc.lists[c];
+        auto_lock<ex_lock_nr_spin> l(list.lock);
+        if (!list.chunks.empty()) {
+            char *chunk = list.chunks.back();
+            list.chunks.pop_back();
+            nc.cached_bytes -= capacity;
+            return chunk;
+        }
+    }
+    return static_cast<char *>(numa_alloc_onnode(capacity, node));
+}
+
+void numa_chunk_cache::release(int node, char *chunk, size_t capacity)
+{
+    int c = (node >= 0 && node < _node_count) ? chunk_class_of(capacity) : -1;
+    if (c >= 0) {
+        dassert(capacity == ((size_t)1 << (MIN_CLASS_SHIFT + c)),
+                "invalid chunk capacity %" PRIu64,
+                (uint64_t)capacity);
+        node_cache &nc = _nodes[node];
+        free_list &list = nc.lists[c];
+        auto_lock<ex_lock_nr_spin> l(list.lock);
+        if (nc.cached_bytes.load(std::memory_order_relaxed) + capacity <=
+            _max_cached_bytes_per_node) {
+            list.chunks.push_back(chunk);
+            nc.cached_bytes += capacity;
+            return;
+        }
+    }
+    numa_free(chunk, capacity);
+}
+
+size_t numa_chunk_cache::cached_bytes(int node) const
+{
+    return (node >= 0 && node < _node_count) ? _nodes[node].cached_bytes.load() : 0;
+}
+}
+}
@@ -0,0 +1,290 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <vector>
+#include <dsn/utility/ports.h>
+#include <dsn/utility/object_pool.h>
+#include <dsn/utility/synchronize.h>
+#include <dsn/utility/transient_memory.h>
+
+namespace dsn {
+
+namespace {
+
+const size_t POOL_CLASS_GRANULARITY = 16;
+const size_t POOL_MAX_OBJECT_SIZE = 1024;
+const int POOL_CLASS_COUNT = POOL_MAX_OBJECT_SIZE / POOL_CLASS_GRANULARITY;
+const uint32_t POOL_BATCH_SIZE = 32;
+const uint32_t POOL_HIGH_WATERMARK = POOL_BATCH_SIZE * 4;
+const size_t POOL_CENTRAL_MAX_BATCHES = 64; // for each size class
+const uint32_t POOL_STATS_MERGE_INTERVAL = 256;
+
+const uint32_t POOL_MAGIC = 0xdeadbeef;
+const uint32_t POOL_CLASS_NONE = 0xffffffff; // allocated by tls_trans_malloc
+
+// put before each object, 16 bytes to keep the alignment of the object
+struct pool_header
+{
+    uint32_t magic;
+    uint32_t size_class;
+    uint64_t reserved;
+};
+static_assert(sizeof(pool_header) == 16, "pool header must keep the 16-byte alignment");
+
+// a freed object, overlaying the header
+struct pool_block
+{
+    pool_block *next;
+};
+
+struct pool_batch
+{
+    pool_block *head;
+    uint32_t count;
+};
+
+struct central_list
+{
+    utils::ex_lock_nr_spin lock;
+    std::vector<pool_batch> batches;
+};
+
+central_list *central_lists()
+{
+    static central_list s_lists[POOL_CLASS_COUNT];
+    return s_lists;
+}
+
+struct tls_pool_t
+{
+    uint32_t magic;
+    bool exiting;
+    pool_block *heads[POOL_CLASS_COUNT];
+    uint32_t counts[POOL_CLASS_COUNT];
+    uint32_t ops;
+    object_pool_stats stats;
+};
+
+__thread tls_pool_t tls_pool;
+
+std::atomic<uint64_t> s_hit_count(0);
+std::atomic<uint64_t> s_miss_count(0);
+std::atomic<uint64_t> s_batch_return_count(0);
+std::atomic<uint64_t> s_release_count(0);
+std::atomic<object_pool_stats_hook> s_stats_hook(nullptr);
+
+inline size_t block_size(int size_class)
+{
+    return sizeof(pool_header) + (size_class + 1) * POOL_CLASS_GRANULARITY;
+}
+
+void merge_stats()
+{
+    // reset before reporting, as the hook may allocate and merge again
+    object_pool_stats s = tls_pool.stats;
+    tls_pool.stats = object_pool_stats{0, 0, 0, 0};
+    tls_pool.ops = 0;
+
+    s_hit_count.fetch_add(s.hit_count, std::memory_order_relaxed);
+    s_miss_count.fetch_add(s.miss_count, std::memory_order_relaxed);
+    s_batch_return_count.fetch_add(s.batch_return_count, std::memory_order_relaxed);
+
+    object_pool_stats_hook hook = s_stats_hook.load(std::memory_order_acquire);
+    if (hook != nullptr)
+        hook(s);
+}
+
+void push_central(int size_class, pool_block *head, uint32_t count)
+{
+    central_list &l = central_lists()[size_class];
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> _(l.lock);
+        if (l.batches.size() < POOL_CENTRAL_MAX_BATCHES) {
+            l.batches.push_back(pool_batch{head, count});
+            return;
+        }
+    }
+
+    // the central list is full, free the batch to the system
+    while (head != nullptr) {
+        pool_block *next = head->next;
+        ::free(head);
+        head = next;
+    }
+    s_release_count.fetch_add(count, std::memory_order_relaxed);
+}
+
+bool pop_central(int size_class, /*out*/ pool_batch &batch)
+{
+    central_list &l = central_lists()[size_class];
+    utils::auto_lock<utils::ex_lock_nr_spin> _(l.lock);
+    if (l.batches.empty())
+        return false;
+    batch = l.batches.back();
+    l.batches.pop_back();
+    return true;
+}
+
+// hand all the cached objects to the central lists when the thread exits, so that they can
+// be reused by the other threads
+struct tls_pool_exit_guard
+{
+    ~tls_pool_exit_guard()
+    {
+        for (int i = 0; i < POOL_CLASS_COUNT; i++) {
+            if (tls_pool.heads[i] != nullptr) {
+                push_central(i, tls_pool.heads[i], tls_pool.counts[i]);
+                tls_pool.heads[i] = nullptr;
+                tls_pool.counts[i] = 0;
+            }
+        }
+        merge_stats();
+        tls_pool.exiting = true;
+    }
+};
+
+void tls_pool_init()
+{
+    static thread_local tls_pool_exit_guard s_guard;
+    (void)s_guard;
+    tls_pool.magic = POOL_MAGIC;
+}
+
+// local free list is empty
+pool_block *refill(int size_class)
+{
+    if (tls_pool.magic != POOL_MAGIC)
+        tls_pool_init();
+
+    pool_batch batch;
+    if (pop_central(size_class, batch)) {
+        tls_pool.stats.hit_count++;
+        tls_pool.heads[size_class] = batch.head->next;
+        tls_pool.counts[size_class] = batch.count - 1;
+        return batch.head;
+    }
+
+    // each block is malloc-ed on its own, so that it can be freed alone when the central
+    // list is full
+    tls_pool.stats.miss_count++;
+    pool_block *b = static_cast<pool_block *>(::malloc(block_size(size_class)));
+    assert(b != nullptr);
+    return b;
+}
+
+// local free list is above the high watermark
+void flush(int size_class)
+{
+    pool_block *head = tls_pool.heads[size_class];
+    pool_block *tail = head;
+    for (uint32_t i = 1; i < POOL_BATCH_SIZE; i++)
+        tail = tail->next;
+
+    tls_pool.heads[size_class] = tail->next;
+    tls_pool.counts[size_class] -= POOL_BATCH_SIZE;
+    tail->next = nullptr;
+
+    push_central(size_class, head, POOL_BATCH_SIZE);
+    tls_pool.stats.batch_return_count++;
+}
+}
+
+void *tls_pool_malloc(size_t sz)
+{
+    if (sz > POOL_MAX_OBJECT_SIZE || sz == 0) {
+        pool_header *h = static_cast<pool_header *>(tls_trans_malloc(sz + sizeof(pool_header)));
+        h->magic = POOL_MAGIC;
+        h->size_class = POOL_CLASS_NONE;
+        tls_pool.stats.miss_count++;
+        return h + 1;
+    }
+
+    int size_class = static_cast<int>((sz - 1) / POOL_CLASS_GRANULARITY);
+    pool_block *b = tls_pool.heads[size_class];
+    if (b != nullptr) {
+        tls_pool.heads[size_class] = b->next;
+        tls_pool.counts[size_class]--;
+        tls_pool.stats.hit_count++;
+    } else {
+        b = refill(size_class);
+    }
+
+    if (++tls_pool.ops >= POOL_STATS_MERGE_INTERVAL)
+        merge_stats();
+
+    pool_header *h = reinterpret_cast<pool_header *>(b);
+    h->magic = POOL_MAGIC;
+    h->size_class = static_cast<uint32_t>(size_class);
+    return h + 1;
+}
+
+void tls_pool_free(void *ptr)
+{
+    pool_header *h = static_cast<pool_header *>(ptr) - 1;
+    // invalid pooled object
+    assert(h->magic == POOL_MAGIC);
+
+    if (h->size_class == POOL_CLASS_NONE) {
+        tls_trans_free(h);
+        return;
+    }
+
+    int size_class = static_cast<int>(h->size_class);
+    pool_block *b = reinterpret_cast<pool_block *>(h);
+
+    // the thread local lists are gone, e.g., objects freed by the destructors of other
+    // thread local variables
+    if (dsn_unlikely(tls_pool.exiting)) {
+        b->next = nullptr;
+        push_central(size_class, b, 1);
+        return;
+    }
+
+    if (dsn_unlikely(tls_pool.magic != POOL_MAGIC))
+        tls_pool_init();
+
+    b->next = tls_pool.heads[size_class];
+    tls_pool.heads[size_class] = b;
+    if (++tls_pool.counts[size_class] > POOL_HIGH_WATERMARK)
+        flush(size_class);
+}
+
+object_pool_stats tls_pool_get_stats()
+{
+    return object_pool_stats{s_hit_count.load(std::memory_order_relaxed),
+                             s_miss_count.load(std::memory_order_relaxed),
+                             s_batch_return_count.load(std::memory_order_relaxed),
+                             s_release_count.load(std::memory_order_relaxed)};
+}
+
+void tls_pool_set_stats_hook(object_pool_stats_hook hook)
+{
+    s_stats_hook.store(hook, std::memory_order_release);
+}
+}
@@ -39,11 +39,15 @@
 #include <dsn/tool-api/command_manager.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/cpp/json_helper.h>
+#include <dsn/cpp/rpc_stream.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
 #include "service_engine.h"
 
 namespace dsn {
 
-perf_counters::perf_counters(void)
+perf_counters::perf_counters(void) : _version(0)
 {
     ::dsn::command_manager::instance().register_command(
         {"counter.list"},
@@ -87,12 +91,16 @@ perf_counter_ptr perf_counters::get_global_counter(const char *app,
     std::string full_name;
     perf_counter::build_full_name(app, section, name, full_name);
 
+    // released out of the lock
+    std::shared_ptr<const metrics_snapshot> old_snapshot;
     utils::auto_write_lock l(_lock);
     if (create_if_not_exist) {
         auto it = _counters.find(full_name);
         if (it == _counters.end()) {
             perf_counter_ptr counter = _factory(app, section, name, flags, dsptr);
             _counters.emplace(full_name, counter_object{counter, 1});
+            ++_version;
+            old_snapshot.swap(_metrics_snapshot);
             return counter;
         } else {
             dassert(it->second.counter->type() == flags,
@@ -117,6 +125,7 @@ perf_counter_ptr perf_counters::get_global_counter(const char *app,
 bool perf_counters::remove_counter(const char *full_name)
 {
     int remain_ref;
+    std::shared_ptr<const metrics_snapshot> old_snapshot;
     {
         utils::auto_write_lock l(_lock);
         auto it = _counters.find(full_name);
@@ -127,6 +136,8 @@ bool perf_counters::remove_counter(const char *full_name)
             remain_ref = (--c.user_reference);
             if (remain_ref == 0) {
                 _counters.erase(it);
+                ++_version;
+                old_snapshot.swap(_metrics_snapshot);
             }
         }
     }
@@ -260,6 +271,246 @@ std::string perf_counters::get_counter_sample(const std::vector<std::string> &ar
     return ss.str();
 }
 
+void perf_counters::start_http_metrics()
+{
+    ::dsn::service_engine::fast_instance().register_system_rpc_handler(
+        RPC_HTTP_METRICS, "dsn.metrics", &perf_counters::on_http_metrics);
+}
+
+/*static*/ void perf_counters::on_http_metrics(dsn_message_t req)
+{
+    dsn_message_t resp = dsn_msg_create_response(req);
+    {
+        // write into the buffers of the response directly
+        rpc_write_stream writer(resp);
+        perf_counters::instance().write_metrics(writer);
+    }
+    dsn_rpc_reply(resp);
+}
+
+namespace {
+
+// [a-zA-Z_:][a-zA-Z0-9_:]*
+std::string metric_family_name(const char *section, const char *name)
+{
+    std::string family;
+    if (!isalpha(section[0]) && section[0] != '_' && section[0] != ':')
+        family.push_back('_');
+    family.append(section).append("_").append(name);
+    for (char &c : family) {
+        if (!isalnum(c) && c != '_' && c != ':')
+            c = '_';
+    }
+    return family;
+}
+
+std::string escape_metric_text(const char *text)
+{
+    std::string escaped;
+    for (const char *p = text; *p != '\0'; p++) {
+        switch (*p) {
+        case '\\':
+            escaped.append("\\\\");
+            break;
+        case '"':
+            escaped.append("\\\"");
+            break;
+        case '\n':
+            escaped.append("\\n");
+            break;
+        default:
+            escaped.push_back(*p);
+        }
+    }
+    return escaped;
+}
+
+const char *metric_type_name(dsn_perf_counter_type_t type)
+{
+    switch (type) {
+    case COUNTER_TYPE_NUMBER:
+        return "gauge";
+    case COUNTER_TYPE_RATE:
+        return "counter";
+    case COUNTER_TYPE_NUMBER_PERCENTILES:
+        return "summary";
+    default:
+        return nullptr;
+    }
+}
+
+const struct
+{
+    dsn_perf_counter_percentile_type_t type;
+    const char *label;
+} s_quantiles[] = {{COUNTER_PERCENTILE_50, ",quantile=\"0.5\"} "},
+                   {COUNTER_PERCENTILE_90, ",quantile=\"0.9\"} "},
+                   {COUNTER_PERCENTILE_95, ",quantile=\"0.95\"} "},
+                   {COUNTER_PERCENTILE_99, ",quantile=\"0.99\"} "},
+                   {COUNTER_PERCENTILE_999, ",quantile=\"0.999\"} "}};
+
+inline void write_text(binary_writer &writer, const char *text, size_t len)
+{
+    writer.write(text, static_cast<int>(len));
+}
+
+inline void write_text(binary_writer &writer, const std::string &text)
+{
+    writer.write(text.data(), static_cast<int>(text.length()));
+}
+
+// format 'value' ending at 'end', return where it begins
+inline char *format_uint64(char *end, uint64_t value)
+{
+    do {
+        *--end = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    return end;
+}
+
+inline void write_value(binary_writer &writer, uint64_t value)
+{
+    char buf[32];
+    buf[31] = '\n';
+    char *begin = format_uint64(buf + 31, value);
+    write_text(writer, begin, buf + 32 - begin);
+}
+
+inline void write_value(binary_writer &writer, double value)
+{
+    // most values are integers, which are much cheaper to format by hand than by snprintf
+    if (value == std::floor(value) && std::fabs(value) < 1e18) {
+        if (value >= 0) {
+            write_value(writer, static_cast<uint64_t>(value));
+        } else {
+            char buf[32];
+            buf[31] = '\n';
+            char *begin = format_uint64(buf + 31, static_cast<uint64_t>(-value));
+            *--begin = '-';
+            write_text(writer, begin, buf + 32 - begin);
+        }
+        return;
+    }
+
+    char buf[32];
+    int len;
+    if (std::isnan(value)) {
+        len = snprintf(buf, sizeof(buf), "NaN\n");
+    } else if (std::isinf(value)) {
+        len = snprintf(buf, sizeof(buf), "%cInf\n", value > 0 ? '+' : '-');
+    } else {
+        len = snprintf(buf, sizeof(buf), "%.17g\n", value);
+    }
+    write_text(writer, buf, len);
+}
+}
+
+std::shared_ptr<const perf_counters::metrics_snapshot> perf_counters::get_metrics_snapshot()
+{
+    uint64_t version;
+    std::vector<perf_counter_ptr> counters;
+    {
+        utils::auto_read_lock l(_lock);
+        if (_metrics_snapshot != nullptr)
+            return _metrics_snapshot;
+
+        version = _version;
+        counters.reserve(_counters.size());
+        for (auto &cp : _counters) {
+            counters.push_back(cp.second.counter);
+        }
+    }
+
+    struct sort_entry
+    {
+        std::string family;
+        std::string app;
+        perf_counter_ptr counter;
+    };
+    std::vector<sort_entry> entries;
+    entries.reserve(counters.size());
+    for (auto &c : counters) {
+        if (metric_type_name(c->type()) == nullptr)
+            continue;
+        std::string family = metric_family_name(c->section(), c->name());
+        // counter families are named without the "_total" suffix of their samples
+        if (c->type() == COUNTER_TYPE_RATE && family.size() > 6 &&
+            family.compare(family.size() - 6, 6, "_total") == 0) {
+            family.resize(family.size() - 6);
+        }
+        entries.push_back(sort_entry{std::move(family), escape_metric_text(c->app()), c});
+    }
+    std::sort(entries.begin(), entries.end(), [](const sort_entry &l, const sort_entry &r) {
+        return l.family != r.family ? l.family < r.family : l.app < r.app;
+    });
+
+    auto snapshot = std::make_shared<metrics_snapshot>();
+    snapshot->reserve(entries.size());
+    const sort_entry *last = nullptr;
+    for (auto &e : entries) {
+        bool family_begin = (last == nullptr || last->family != e.family);
+        if (!family_begin && (last->counter->type() != e.counter->type() || last->app == e.app)) {
+            // the names of different counters may be the same after escaped
+            dwarn("skip perf counter %s in metrics as it conflicts with %s",
+                  e.counter->full_name(),
+                  last->counter->full_name());
+            continue;
+        }
+
+        metric m;
+        m.counter = e.counter;
+        if (family_begin) {
+            m.family_header = "# TYPE " + e.family + " " + metric_type_name(e.counter->type()) +
+                              "\n# HELP " + e.family + " " +
+                              escape_metric_text(e.counter->dsptr()) + "\n";
+        }
+        m.sample_prefix = e.family + (e.counter->type() == COUNTER_TYPE_RATE ? "_total" : "") +
+                          "{app=\"" + e.app + "\"";
+        snapshot->push_back(std::move(m));
+        last = &e;
+    }
+
+    {
+        utils::auto_write_lock l(_lock);
+        if (_version == version)
+            _metrics_snapshot = snapshot;
+    }
+    return snapshot;
+}
+
+void perf_counters::write_metrics(binary_writer &writer)
+{
+    std::shared_ptr<const metrics_snapshot> snapshot = get_metrics_snapshot();
+    for (const metric &m : *snapshot) {
+        write_text(writer, m.family_header);
+
+        perf_counter *c = m.counter.get();
+        switch (c->type()) {
+        case COUNTER_TYPE_NUMBER:
+            write_text(writer, m.sample_prefix);
+            write_text(writer, "} ", 2);
+            write_value(writer, c->get_value());
+            break;
+        case COUNTER_TYPE_RATE:
+            write_text(writer, m.sample_prefix);
+            write_text(writer, "} ", 2);
+            write_value(writer, c->get_total());
+            break;
+        case COUNTER_TYPE_NUMBER_PERCENTILES:
+            for (auto &q : s_quantiles) {
+                write_text(writer, m.sample_prefix);
+                write_text(writer, q.label, strlen(q.label));
+                write_value(writer, c->get_percentile(q.type));
+            }
+            break;
+        default:
+            dassert(false, "invalid metric type %d", c->type());
+        }
+    }
+    write_text(writer, "# EOF\n", 6);
+}
+
 perf_counter_ptr perf_counters::get_counter(const char *full_name)
 {
     utils::auto_read_lock l(_lock);
@@ -0,0 +1,377 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "recv_buffer_pool.h"
+#include <dsn/c/api_layer1.h>
+#include <dsn/c/api_utilities.h>
+#include <dsn/cpp/perf_counter_wrapper.h>
+#include <dsn/utility/config_api.h>
+#include <dsn/utility/numa.h>
+#include <dsn/utility/object_pool.h>
+#include <dsn/utility/ports.h>
+#include <algorithm>
+#include <cstdlib>
+
+namespace dsn {
+
+namespace {
+
+const size_t MIN_CLASS_SHIFT = 12; // 4KB
+
+inline size_t class_capacity(int size_class) { return (size_t)1 << (MIN_CLASS_SHIFT + size_class); }
+
+// -1 if the size is larger than the largest class
+inline int size_class_of(size_t size)
+{
+    for (int c = 0; c < recv_buffer_pool::CLASS_COUNT; c++) {
+        if (size <= class_capacity(c))
+            return c;
+    }
+    return -1;
+}
+
+struct recv_buffer_counters
+{
+    recv_buffer_counters()
+    {
+        used_bytes.init_global_counter("core",
+                                       "network",
+                                       "recv.buffer.used.bytes",
+                                       COUNTER_TYPE_NUMBER,
+                                       "bytes of the receive buffers referred by the readers "
+                                       "or the messages parsed from them");
+        cached_bytes.init_global_counter("core",
+                                         "network",
+                                         "recv.buffer.cached.bytes",
+                                         COUNTER_TYPE_NUMBER,
+                                         "bytes of the free receive buffers cached in the pools");
+        copied_bytes.init_global_counter("core",
+                                         "network",
+                                         "recv.buffer.copied.bytes",
+                                         COUNTER_TYPE_RATE,
+                                         "bytes copied per second as messages straddle buffers");
+        copy_avoided_bytes.init_global_counter(
+            "core",
+            "network",
+            "recv.buffer.copy.avoided.estimated.bytes",
+            COUNTER_TYPE_RATE,
+            "estimated bytes per second received in place into buffers sized for the whole "
+            "messages, taken as the room left in the block they would otherwise be received "
+            "into and copied from, which is an upper bound as a read may not fill the block");
+    }
+
+    perf_counter_wrapper used_bytes;
+    perf_counter_wrapper cached_bytes;
+    perf_counter_wrapper copied_bytes;
+    perf_counter_wrapper copy_avoided_bytes;
+};
+
+recv_buffer_counters &get_counters()
+{
+    static recv_buffer_counters counters;
+    return counters;
+}
+
+inline void add_bytes(perf_counter_wrapper &counter, size_t sz) { counter->add((uint64_t)sz); }
+
+inline void sub_bytes(perf_counter_wrapper &counter, size_t sz)
+{
+    counter->add((uint64_t)(-(int64_t)sz));
+}
+}
+
+namespace {
+
+// free buffers cached by all the pools
+std::atomic<int64_t> s_total_cached_bytes(0);
+
+// all the pools, for trim_all()
+utils::ex_lock_nr s_pools_lock;
+std::vector<recv_buffer_pool *> s_pools;
+std::atomic<uint64_t> s_next_trim_ms(0);
+
+// allocate() checks the clock for trimming once per so many calls
+const int TRIM_CHECK_ALLOCATE_COUNT = 64;
+
+uint64_t get_total_max_cached_bytes()
+{
+    static uint64_t max_bytes =
+        dsn_config_get_value_uint64(
+            "network",
+            "recv_buffer_pool_total_max_cached_mb",
+            256,
+            "max MB of free receive buffers cached by all the io threads together") *
+        1024 * 1024;
+    return max_bytes;
+}
+
+uint64_t get_trim_interval_ms()
+{
+    static uint64_t interval_ms =
+        dsn_config_get_value_uint64("network",
+                                    "recv_buffer_pool_trim_interval_seconds",
+                                    10,
+                                    "free receive buffers cached but not used over such an "
+                                    "interval are returned to the system") *
+        1000;
+    return interval_ms;
+}
+
+// the buffer is freed when the budget is used up
+bool reserve_cached_bytes(size_t sz)
+{
+    int64_t total = s_total_cached_bytes.fetch_add((int64_t)sz, std::memory_order_relaxed) + sz;
+    if (total > (int64_t)get_total_max_cached_bytes()) {
+        s_total_cached_bytes.fetch_sub((int64_t)sz, std::memory_order_relaxed);
+        return false;
+    }
+    add_bytes(get_counters().cached_bytes, sz);
+    return true;
+}
+
+void unreserve_cached_bytes(size_t sz)
+{
+    s_total_cached_bytes.fetch_sub((int64_t)sz, std::memory_order_relaxed);
+    sub_bytes(get_counters().cached_bytes, sz);
+}
+}
+
+static __thread recv_buffer_pool *tls_recv_buffer_pool = nullptr;
+static __thread bool tls_recv_buffer_pool_exited = false;
+
+/*static*/ recv_buffer_pool &recv_buffer_pool::instance()
+{
+    if (dsn_unlikely(tls_recv_buffer_pool == nullptr)) {
+        tls_recv_buffer_pool = new recv_buffer_pool();
+
+        // the guard is not constructed again once destroyed, so a pool created during the
+        // thread exit is never freed, which is rare and small
+        if (!tls_recv_buffer_pool_exited) {
+            static thread_local thread_exit_guard s_guard;
+            s_guard.pool = tls_recv_buffer_pool;
+        }
+    }
+    return *tls_recv_buffer_pool;
+}
+
+recv_buffer_pool::thread_exit_guard::~thread_exit_guard()
+{
+    tls_recv_buffer_pool_exited = true;
+    tls_recv_buffer_pool = nullptr;
+    if (pool != nullptr) {
+        pool->on_thread_exit();
+    }
+}
+
+recv_buffer_pool::recv_buffer_pool() : _exited(false), _allocate_count(0), _ref_count(1)
+{
+    static uint64_t max_cached_bytes =
+        dsn_config_get_value_uint64("network",
+                                    "recv_buffer_pool_max_cached_mb",
+                                    64,
+                                    "max MB of free receive buffers cached by each io thread") *
+        1024 * 1024;
+
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        _free_lists[c].max_count = max_cached_bytes / CLASS_COUNT / class_capacity(c);
+        _free_lists[c].low_water = 0;
+    }
+
+    utils::auto_lock<utils::ex_lock_nr> l(s_pools_lock);
+    s_pools.push_back(this);
+}
+
+/*static*/ size_t recv_buffer_pool::capacity_of(size_t size)
+{
+    int c = size_class_of(size);
+    return c >= 0 ? class_capacity(c) : size;
+}
+
+std::shared_ptr<char> recv_buffer_pool::allocate(size_t size, /*out*/ size_t &capacity)
+{
+    auto &counters = get_counters();
+
+    int c = size_class_of(size);
+    if (c < 0) {
+        capacity = size;
+        add_bytes(counters.used_bytes, size);
+        std::shared_ptr<char> buffer = utils::numa_local_shared_array(size);
+        return std::shared_ptr<char>(buffer.get(),
+                                     [buffer, size](char *) mutable {
+                                         sub_bytes(get_counters().used_bytes, size);
+                                         buffer.reset();
+                                     },
+                                     pool_allocator<char>());
+    }
+
+    if (++_allocate_count >= TRIM_CHECK_ALLOCATE_COUNT) {
+        _allocate_count = 0;
+        uint64_t now_ms = dsn_now_ms();
+        uint64_t next_ms = s_next_trim_ms.load(std::memory_order_relaxed);
+        if (now_ms >= next_ms &&
+            s_next_trim_ms.compare_exchange_strong(next_ms, now_ms + get_trim_interval_ms())) {
+            // the first check only sets the time of the first trim
+            if (next_ms != 0)
+                trim_all();
+        }
+    }
+
+    capacity = class_capacity(c);
+    char *buffer = nullptr;
+    {
+        free_list &list = _free_lists[c];
+        utils::auto_lock<utils::ex_lock_nr_spin> l(list.lock);
+        if (!list.buffers.empty()) {
+            buffer = list.buffers.back();
+            list.buffers.pop_back();
+            if (list.buffers.size() < list.low_water)
+                list.low_water = list.buffers.size();
+        }
+    }
+
+    if (buffer != nullptr) {
+        unreserve_cached_bytes(capacity);
+    } else {
+        // first touched by the reading thread, so it is local to the node of the thread
+        buffer = static_cast<char *>(malloc(capacity));
+        dassert(buffer != nullptr, "allocate receive buffer of %" PRIu64 " bytes failed",
+                (uint64_t)capacity);
+    }
+    add_bytes(counters.used_bytes, capacity);
+
+    _ref_count.fetch_add(1, std::memory_order_relaxed); // released in recycle
+    return std::shared_ptr<char>(
+        buffer, [this, c](char *p) { recycle(p, c); }, pool_allocator<char>());
+}
+
+void recv_buffer_pool::recycle(char *buffer, int size_class)
+{
+    auto &counters = get_counters();
+    size_t capacity = class_capacity(size_class);
+    sub_bytes(counters.used_bytes, capacity);
+
+    bool cached = false;
+    {
+        free_list &list = _free_lists[size_class];
+        utils::auto_lock<utils::ex_lock_nr_spin> l(list.lock);
+        if (!_exited && list.buffers.size() < list.max_count && reserve_cached_bytes(capacity)) {
+            list.buffers.push_back(buffer);
+            cached = true;
+        }
+    }
+
+    if (!cached)
+        free(buffer);
+
+    release_ref(); // added in allocate
+}
+
+void recv_buffer_pool::trim()
+{
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        std::vector<char *> idle_buffers;
+        {
+            free_list &list = _free_lists[c];
+            utils::auto_lock<utils::ex_lock_nr_spin> l(list.lock);
+
+            // the ones at the bottom of the stack are not taken out since the last trim
+            size_t idle_count = std::min(list.low_water, list.buffers.size());
+            idle_buffers.assign(list.buffers.begin(), list.buffers.begin() + idle_count);
+            list.buffers.erase(list.buffers.begin(), list.buffers.begin() + idle_count);
+            list.low_water = list.buffers.size();
+        }
+
+        if (!idle_buffers.empty()) {
+            unreserve_cached_bytes(idle_buffers.size() * class_capacity(c));
+            for (char *buffer : idle_buffers) {
+                free(buffer);
+            }
+        }
+    }
+}
+
+/*static*/ void recv_buffer_pool::trim_all()
+{
+    utils::auto_lock<utils::ex_lock_nr> l(s_pools_lock);
+    for (recv_buffer_pool *pool : s_pools) {
+        pool->trim();
+    }
+}
+
+size_t recv_buffer_pool::cached_bytes()
+{
+    size_t bytes = 0;
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        free_list &list = _free_lists[c];
+        utils::auto_lock<utils::ex_lock_nr_spin> l(list.lock);
+        bytes += list.buffers.size() * class_capacity(c);
+    }
+    return bytes;
+}
+
+void recv_buffer_pool::on_thread_exit()
+{
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(s_pools_lock);
+        s_pools.erase(std::find(s_pools.begin(), s_pools.end(), this));
+    }
+
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        std::vector<char *> buffers;
+        {
+            free_list &list = _free_lists[c];
+            utils::auto_lock<utils::ex_lock_nr_spin> l(list.lock);
+            _exited = true;
+            buffers.swap(list.buffers);
+        }
+
+        if (!buffers.empty()) {
+            unreserve_cached_bytes(buffers.size() * class_capacity(c));
+            for (char *buffer : buffers) {
+                free(buffer);
+            }
+        }
+    }
+
+    release_ref(); // the one of the thread
+}
+
+void recv_buffer_pool::release_ref()
+{
+    if (_ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+}
+
+/*static*/ void recv_buffer_pool::add_copy_stats(uint64_t copied_bytes,
+                                                 uint64_t avoided_estimated_bytes)
+{
+    auto &counters = get_counters();
+    if (copied_bytes > 0)
+        counters.copied_bytes->add(copied_bytes);
+    if (avoided_estimated_bytes > 0)
+        counters.copy_avoided_bytes->add(avoided_estimated_bytes);
+}
+}
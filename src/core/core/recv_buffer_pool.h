@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     per-looper pool of the receive buffers of message_reader
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include <dsn/utility/synchronize.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace dsn {
+
+/// the messages parsed by message_reader refer to the buffers they are read into until the
+/// messages are freed, usually on a worker thread. so the buffers are pooled by the reading
+/// thread (an io looper) in power of two size classes from 4KB up to 8MB, and a buffer goes
+/// back to the pool it is taken from once the last blob referring to it is released, from
+/// whichever thread. larger buffers are allocated and freed directly.
+///
+/// the free buffers cached are bounded by:
+///  - [network] recv_buffer_pool_max_cached_mb for each pool, evenly shared by the size
+///    classes, and [network] recv_buffer_pool_total_max_cached_mb for all the pools;
+///  - [network] recv_buffer_pool_trim_interval_seconds: a buffer not taken out of its pool
+///    over such an interval is freed, so the memory of a traffic peak is returned;
+///  - the thread exit: the cache of the pool is freed, and the buffers released later
+///    are freed directly.
+class recv_buffer_pool
+{
+public:
+    static const int CLASS_COUNT = 12;
+
+    // pool of the current thread
+    static recv_buffer_pool &instance();
+
+    // a buffer of no less than 'size' bytes, whose real size is returned in 'capacity'
+    std::shared_ptr<char> allocate(size_t size, /*out*/ size_t &capacity);
+
+    // size of the buffer allocate(size) returns
+    static size_t capacity_of(size_t size);
+
+    // bytes copied by message_reader as a message straddles two buffers, and the bytes
+    // such copies are estimated to be avoided for, see message_reader::read_buffer_ptr
+    static void add_copy_stats(uint64_t copied_bytes, uint64_t avoided_estimated_bytes);
+
+    // frees the buffers of all the pools that are not taken out since the last call, which
+    // is done every trim interval by allocate()
+    static void trim_all();
+
+    // bytes of the free buffers cached by this pool
+    size_t cached_bytes();
+
+private:
+    recv_buffer_pool();
+    ~recv_buffer_pool() = default;
+
+    void recycle(char *buffer, int size_class);
+    void trim();
+    void on_thread_exit();
+    void release_ref();
+
+    // the pool is freed when the thread has exited and all its buffers are released
+    struct thread_exit_guard
+    {
+        recv_buffer_pool *pool = nullptr;
+        ~thread_exit_guard();
+    };
+
+    struct free_list
+    {
+        utils::ex_lock_nr_spin lock;
+        std::vector<char *> buffers;
+        size_t max_count;
+        size_t low_water; // fewest buffers since the last trim, never taken out since then
+    };
+    free_list _free_lists[CLASS_COUNT];
+    bool _exited; // protected by the locks of the free lists
+    int _allocate_count;
+
+    // one for the thread, and one for each buffer allocated and not recycled yet
+    std::atomic<int64_t> _ref_count;
+};
+}
@@ -46,6 +46,8 @@
 #include "rpc_engine.h"
 #include "service_engine.h"
 #include <dsn/utility/factory_store.h>
+#include <dsn/utility/singleton_store.h>
+#include <dsn/tool/node_scoper.h>
 #include <dsn/tool-api/perf_counter.h>
 #include <dsn/tool-api/group_address.h>
 #include <dsn/tool-api/uri_address.h>
@@ -53,51 +55,275 @@
 #include <dsn/cpp/serialization.h>
 #include <dsn/cpp/clientlet.h>
 #include <set>
+#include <mutex>
 
 namespace dsn {
 
 DEFINE_TASK_CODE(LPC_RPC_TIMEOUT, TASK_PRIORITY_COMMON, THREAD_POOL_DEFAULT)
 
+// the sweeper of a bucket of rpc_client_matcher
 class rpc_timeout_task : public task
 {
 public:
-    rpc_timeout_task(rpc_client_matcher *matcher, uint64_t id, service_node *node)
+    rpc_timeout_task(rpc_client_matcher *matcher,
+                     int bucket_index,
+                     uint64_t ts_ms,
+                     service_node *node)
         : task(LPC_RPC_TIMEOUT, 0, node)
     {
         _matcher = matcher;
-        _id = id;
+        _bucket_index = bucket_index;
+        _ts_ms = ts_ms;
     }
 
-    virtual void exec() { _matcher->on_rpc_timeout(_id); }
+    virtual void exec() { _matcher->on_sweep(_bucket_index, _ts_ms); }
 private:
     // use the following if the matcher is per rpc session
     // rpc_client_matcher_ptr _matcher;
 
     rpc_client_matcher *_matcher;
-    uint64_t _id;
+    int _bucket_index;
+    uint64_t _ts_ms;
 };
 
+//----------------------------------------------------------------------------------------------
+const uint32_t rpc_request_bucket::NPOS;
+
+rpc_request_bucket::rpc_request_bucket() : _free_head(NPOS), _size(0), _slots(64), _shift(64 - 6)
+{
+    for (auto &s : _slots)
+        s.index = NPOS;
+}
+
+size_t rpc_request_bucket::find_slot(uint64_t id) const
+{
+    size_t mask = _slots.size() - 1;
+    size_t i = home(id);
+    while (_slots[i].index != NPOS && _slots[i].id != id)
+        i = (i + 1) & mask;
+    return i;
+}
+
+void rpc_request_bucket::grow()
+{
+    std::vector<slot> old(_slots.size() * 2);
+    old.swap(_slots);
+    _shift--;
+    for (auto &s : _slots)
+        s.index = NPOS;
+
+    for (auto &s : old) {
+        if (s.index != NPOS)
+            _slots[find_slot(s.id)] = s;
+    }
+}
+
+rpc_request_bucket::entry *rpc_request_bucket::insert(uint64_t id)
+{
+    if ((_size + 1) * 2 > _slots.size())
+        grow();
+
+    size_t i = find_slot(id);
+    if (_slots[i].index != NPOS)
+        return nullptr;
+
+    uint32_t index;
+    if (_free_head != NPOS) {
+        index = _free_head;
+        _free_head = _entries[index].next_free;
+    } else {
+        index = (uint32_t)_entries.size();
+        _entries.emplace_back();
+        _entries.back().index = index;
+    }
+
+    entry &e = _entries[index];
+    e.id = id;
+    e.deadline_ms = 0;
+    e.timeout_ts_ms = 0;
+    e.heap_pos = NPOS;
+    e.next_free = NPOS;
+
+    _slots[i].id = id;
+    _slots[i].index = index;
+    _size++;
+    return &e;
+}
+
+rpc_request_bucket::entry *rpc_request_bucket::find(uint64_t id) const
+{
+    const slot &s = _slots[find_slot(id)];
+    return s.index != NPOS ? &_entries[s.index] : nullptr;
+}
+
+void rpc_request_bucket::erase(entry *e)
+{
+    if (e->heap_pos != NPOS)
+        unschedule(e);
+
+    size_t mask = _slots.size() - 1;
+    size_t i = find_slot(e->id);
+    dassert(_slots[i].index == e->index, "entry %" PRIu64 " is not in the table", e->id);
+
+    // backward shift deletion, so no tombstone is left: move back the following
+    // slots of the cluster unless they are at or after their home position
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (_slots[j].index == NPOS)
+            break;
+
+        size_t k = home(_slots[j].id);
+        if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+
+        _slots[i] = _slots[j];
+        i = j;
+    }
+    _slots[i].index = NPOS;
+
+    e->resp_task = nullptr;
+    e->next_free = _free_head;
+    _free_head = e->index;
+    _size--;
+}
+
+void rpc_request_bucket::schedule(entry *e, uint64_t deadline_ms)
+{
+    dassert(e->heap_pos == NPOS, "entry %" PRIu64 " is already scheduled", e->id);
+    e->deadline_ms = deadline_ms;
+    e->heap_pos = (uint32_t)_heap.size();
+    _heap.push_back(e->index);
+    sift_up(e->heap_pos);
+}
+
+void rpc_request_bucket::unschedule(entry *e)
+{
+    uint32_t pos = e->heap_pos;
+    dassert(pos != NPOS && pos < _heap.size(), "entry %" PRIu64 " is not scheduled", e->id);
+
+    uint32_t last = (uint32_t)_heap.size() - 1;
+    if (pos != last) {
+        heap_swap(pos, last);
+        _heap.pop_back();
+        sift_down(pos);
+        sift_up(pos);
+    } else {
+        _heap.pop_back();
+    }
+    e->heap_pos = NPOS;
+}
+
+void rpc_request_bucket::heap_swap(uint32_t a, uint32_t b)
+{
+    std::swap(_heap[a], _heap[b]);
+    _entries[_heap[a]].heap_pos = a;
+    _entries[_heap[b]].heap_pos = b;
+}
+
+void rpc_request_bucket::sift_up(uint32_t pos)
+{
+    while (pos > 0) {
+        uint32_t parent = (pos - 1) / 2;
+        if (!earlier(pos, parent))
+            break;
+        heap_swap(pos, parent);
+        pos = parent;
+    }
+}
+
+void rpc_request_bucket::sift_down(uint32_t pos)
+{
+    uint32_t n = (uint32_t)_heap.size();
+    while (true) {
+        uint32_t child = pos * 2 + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && earlier(child + 1, child))
+            child++;
+        if (!earlier(child, pos))
+            break;
+        heap_swap(pos, child);
+        pos = child;
+    }
+}
+
+//----------------------------------------------------------------------------------------------
+rpc_client_matcher::rpc_client_matcher(rpc_engine *engine) : _engine(engine)
+{
+    for (auto &b : _buckets)
+        b.sweep_ts_ms = 0;
+}
+
 rpc_client_matcher::~rpc_client_matcher()
 {
     for (int i = 0; i < MATCHER_BUCKET_NR; i++) {
-        dassert(_requests[i].size() == 0,
+        dassert(_buckets[i].requests.size() == 0,
                 "all rpc entries must be removed before the matcher ends");
     }
 }
 
+task_ptr rpc_client_matcher::arm_sweeper(int bucket_index, uint64_t deadline_ms, uint64_t now_ms)
+{
+    // the sweeper armed fires no later than it
+    bucket &b = _buckets[bucket_index];
+    if (b.sweep_ts_ms != 0 && b.sweep_ts_ms <= deadline_ms)
+        return nullptr;
+
+    // the later sweeper, if any, finds itself superseded when it fires
+    b.sweep_ts_ms = deadline_ms;
+    task_ptr sweeper(new rpc_timeout_task(this, bucket_index, deadline_ms, _engine->node()));
+    sweeper->set_delay(deadline_ms > now_ms ? static_cast<int>(deadline_ms - now_ms) : 0);
+    return sweeper;
+}
+
+void rpc_client_matcher::on_sweep(int bucket_index, uint64_t ts_ms)
+{
+    std::vector<uint64_t> expired_keys;
+    task_ptr sweeper;
+
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
+        bucket &b = _buckets[bucket_index];
+        if (ts_ms != b.sweep_ts_ms)
+            return;
+
+        uint64_t now_ms = dsn_now_ms();
+        rpc_request_bucket::entry *e;
+        while ((e = b.requests.earliest()) != nullptr && e->deadline_ms <= now_ms) {
+            // left in the table till on_rpc_timeout, unless the response comes before
+            b.requests.unschedule(e);
+            expired_keys.push_back(e->id);
+        }
+
+        b.sweep_ts_ms = 0;
+        if (e != nullptr) {
+            sweeper = arm_sweeper(bucket_index, e->deadline_ms, now_ms);
+        }
+    }
+
+    if (sweeper != nullptr) {
+        sweeper->enqueue();
+    }
+
+    for (uint64_t key : expired_keys) {
+        on_rpc_timeout(key);
+    }
+}
+
 bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *reply, int delay_ms)
 {
     rpc_response_task_ptr call;
-    task_ptr timeout_task;
     int bucket_index = key % MATCHER_BUCKET_NR;
 
     {
         utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
-            call = std::move(it->second.resp_task);
-            timeout_task = std::move(it->second.timeout_task);
-            _requests[bucket_index].erase(it);
+        rpc_request_bucket &requests = _buckets[bucket_index].requests;
+        auto e = requests.find(key);
+        if (e != nullptr) {
+            // the sweeper armed for it, if any, is left to find nothing due
+            call = std::move(e->resp_task);
+            requests.erase(e);
         } else {
             if (reply) {
                 dassert(reply->get_count() == 0,
@@ -109,11 +335,6 @@ bool rpc_client_matcher::on_recv_reply(network *net, uint64_t key, message_ex *r
     }
 
     dbg_dassert(call != nullptr, "rpc response task cannot be empty");
-    dbg_dassert(timeout_task != nullptr, "rpc timeout task cannot be empty");
-
-    if (timeout_task != task::get_current_task()) {
-        timeout_task->cancel(false); // no need to wait
-    }
 
     auto req = call->get_request();
     auto spec = task_spec::get(req->local_rpc_code);
@@ -217,12 +438,13 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
 
     {
         utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
-            timeout_ts_ms = it->second.timeout_ts_ms;
-            call = it->second.resp_task;
+        rpc_request_bucket &requests = _buckets[bucket_index].requests;
+        auto e = requests.find(key);
+        if (e != nullptr) {
+            timeout_ts_ms = e->timeout_ts_ms;
+            call = e->resp_task;
             if (timeout_ts_ms == 0) {
-                _requests[bucket_index].erase(it);
+                requests.erase(e);
             }
 
             // resend is enabled
@@ -251,25 +473,22 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
     // TODO: time overflow
     resend = (now_ts_ms < timeout_ts_ms && call->state() == TASK_STATE_READY);
 
-    // TODO: memory pool for this task
-    task_ptr new_timeout_task;
-    if (resend) {
-        new_timeout_task = new rpc_timeout_task(this, key, call->node());
-    }
-
+    task_ptr sweeper;
     {
         utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto it = _requests[bucket_index].find(key);
-        if (it != _requests[bucket_index].end()) {
+        rpc_request_bucket &requests = _buckets[bucket_index].requests;
+        auto e = requests.find(key);
+        if (e != nullptr) {
             // timeout
             if (!resend) {
-                _requests[bucket_index].erase(it);
+                requests.erase(e);
             }
 
             // resend
             else {
-                // reset timeout task
-                it->second.timeout_task = new_timeout_task;
+                // use rest of the timeout to resend once only
+                requests.schedule(e, timeout_ts_ms);
+                sweeper = arm_sweeper(bucket_index, timeout_ts_ms, now_ts_ms);
             }
         }
 
@@ -287,10 +506,10 @@ void rpc_client_matcher::on_rpc_timeout(uint64_t key)
 
         // resend without handling rpc_matcher, use the same request_id
         _engine->call_ip(req->to_address, req, nullptr);
+    }
 
-        // use rest of the timeout to resend once only
-        new_timeout_task->set_delay(static_cast<int>(timeout_ts_ms - now_ts_ms));
-        new_timeout_task->enqueue();
+    if (sweeper != nullptr) {
+        sweeper->enqueue();
     }
 }
 
@@ -300,27 +519,36 @@ void rpc_client_matcher::on_call(message_ex *request, const rpc_response_task_pt
     int bucket_index = hdr.id % MATCHER_BUCKET_NR;
     auto sp = task_spec::get(request->local_rpc_code);
     int timeout_ms = hdr.client.timeout_ms;
+    uint64_t now_ms = dsn_now_ms();
     uint64_t timeout_ts_ms = 0;
 
     // reset timeout when resend is enabled
     if (sp->rpc_request_resend_timeout_milliseconds > 0 &&
         timeout_ms > sp->rpc_request_resend_timeout_milliseconds) {
-        timeout_ts_ms = dsn_now_ms() + timeout_ms; // non-zero for resend
+        timeout_ts_ms = now_ms + timeout_ms; // non-zero for resend
         timeout_ms = sp->rpc_request_resend_timeout_milliseconds;
     }
 
     dbg_dassert(call != nullptr, "rpc response task cannot be empty");
-    task *timeout_task(new rpc_timeout_task(this, hdr.id, call->node()));
+    uint64_t deadline_ms = now_ms + (timeout_ms > 0 ? timeout_ms : 0);
+    task_ptr sweeper;
 
     {
         utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_requests_lock[bucket_index]);
-        auto pr =
-            _requests[bucket_index].emplace(hdr.id, match_entry{call, timeout_task, timeout_ts_ms});
-        dassert(pr.second, "the message is already on the fly!!!");
+        rpc_request_bucket &requests = _buckets[bucket_index].requests;
+        auto e = requests.insert(hdr.id);
+        dassert(e != nullptr, "the message is already on the fly!!!");
+        e->resp_task = call;
+        e->timeout_ts_ms = timeout_ts_ms;
+        requests.schedule(e, deadline_ms);
+
+        // only when it is due before the sweeper armed
+        sweeper = arm_sweeper(bucket_index, deadline_ms, now_ms);
     }
 
-    timeout_task->set_delay(timeout_ms);
-    timeout_task->enqueue();
+    if (sweeper != nullptr) {
+        sweeper->enqueue();
+    }
 }
 
 //----------------------------------------------------------------------------------------------
@@ -417,11 +645,26 @@ rpc_request_task *rpc_server_dispatcher::on_request(message_ex *msg, service_nod
 }
 
 //----------------------------------------------------------------------------------------------
+// server networks in this process for the in-process fast path, by channel
+// 10 should be >= than rpc_channel::max_value() + 1
+static utils::safe_singleton_store<::dsn::rpc_address, network *> s_local_server_nets[10];
+static std::once_flag s_local_server_nets_exit_once;
+
+// the networks are not destroyed with the process, but the calls made during exit
+// should not be delivered to them anymore
+static void clear_local_server_nets(sys_exit_type)
+{
+    for (auto &nets : s_local_server_nets) {
+        nets.clear();
+    }
+}
+
 rpc_engine::rpc_engine(service_node *node) : _node(node), _rpc_matcher(this)
 {
     dassert(_node != nullptr, "");
     _is_running = false;
     _is_serving = false;
+    _local_fast_path = false;
 }
 
 //
@@ -436,6 +679,7 @@ network *rpc_engine::create_network(const network_server_config &netcs,
     network *net = utils::factory_store<network>::create(
         netcs.factory_name.c_str(), ::dsn::PROVIDER_TYPE_MAIN, this, nullptr);
     net->reset_parser_attr(client_hdr_format, netcs.message_buffer_block_size);
+    net->reset_listener_attr(netcs.listener_count);
 
     for (auto it = spec.network_aspects.begin(); it != spec.network_aspects.end(); it++) {
         net = utils::factory_store<network>::create(
@@ -536,6 +780,10 @@ error_code rpc_engine::start(const service_app_spec &aspec, io_modifer &ctx)
         }
 
         (*pnets)[sp.second.channel] = net;
+        s_local_server_nets[sp.second.channel].put(net->address(), net);
+        std::call_once(s_local_server_nets_exit_once, [] {
+            ::dsn::tools::sys_exit.put_back(clear_local_server_nets, "rpc.local_server_nets");
+        });
 
         if (ctx.queue) {
             dwarn("[%s.%s] network server started at port %u, channel = %s, ...",
@@ -553,6 +801,15 @@ error_code rpc_engine::start(const service_app_spec &aspec, io_modifer &ctx)
 
     _uri_resolver_mgr.reset(new uri_resolver_manager());
 
+    // the simulator has its own in-process network with simulated delays
+    _local_fast_path =
+        dsn_config_get_value_bool("network",
+                                  "local_fast_path",
+                                  false,
+                                  "whether to deliver rpc calls to the nodes in the same process "
+                                  "directly without network") &&
+        service_engine::fast_instance().spec().tool != "simulator";
+
     _local_primary_address = _client_nets[NET_HDR_DSN][0]->address();
     _local_primary_address.set_port(aspec.ports.size() > 0 ? *aspec.ports.begin()
                                                            : aspec.id + ctx.port_shift_value);
@@ -863,9 +1120,49 @@ void rpc_engine::call_ip(rpc_address addr,
         _rpc_matcher.on_call(request, call);
     }
 
+    if (_local_fast_path) {
+        network *server_net = nullptr;
+        if (s_local_server_nets[sp->rpc_call_channel].get(addr, server_net)) {
+            deliver_local_request(server_net, request);
+            return;
+        }
+    }
+
     net->send_message(request);
 }
 
+void rpc_engine::deliver_local_request(network *server_net, message_ex *request)
+{
+    message_ex *msg = request->copy_for_local_receive();
+    msg->local_peer = this;
+
+    // as ref_count for request may be zero when it is a one-way call,
+    // otherwise it is held by the response task
+    request->add_ref();
+    request->release_ref();
+
+    rpc_engine *target = server_net->engine();
+    ::dsn::tools::node_scoper ns(target->node());
+    target->on_recv_request(server_net, msg, 0);
+}
+
+void rpc_engine::deliver_local_reply(message_ex *response)
+{
+    rpc_engine *target = response->local_peer;
+    message_ex *msg = response->copy_for_local_receive();
+    msg->local_peer = this;
+
+    auto sp = task_spec::get(response->local_rpc_code);
+    network *net = target->_client_nets[response->hdr_format][sp->rpc_call_channel];
+
+    // as ref_count for response may be zero
+    response->add_ref();
+    response->release_ref();
+
+    ::dsn::tools::node_scoper ns(target->node());
+    target->matcher()->on_recv_reply(net, msg->header->id, msg, 0);
+}
+
 void rpc_engine::reply(message_ex *response, error_code err)
 {
     // when a message doesn't need to reply, we don't do the on_rpc_reply hooks to avoid mistakes
@@ -889,6 +1186,19 @@ void rpc_engine::reply(message_ex *response, error_code err)
 
     bool no_fail = sp->on_rpc_reply.execute(task::get_current_task(), response, true);
 
+    // request delivered within the process, deliver the response back in the same way
+    if (response->local_peer != nullptr && !response->header->context.u.is_forwarded) {
+        if (no_fail) {
+            deliver_local_reply(response);
+        } else {
+            // because (1) initially, the ref count is zero
+            //         (2) upper apps may call add_ref already
+            response->add_ref();
+            response->release_ref();
+        }
+        return;
+    }
+
     // connection oriented network, we have bound session
     if (s != nullptr) {
         // not forwarded, we can use the original rpc session
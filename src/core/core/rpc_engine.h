@@ -39,6 +39,8 @@
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/network.h>
 #include <dsn/tool-api/global_config.h>
+#include <deque>
+#include <vector>
 
 namespace dsn {
 
@@ -61,16 +63,89 @@ class uri_resolver_manager;
 // less std::shared_ptr<rpc_client_matcher> operations in rpc_timeout_task
 //
 #define MATCHER_BUCKET_NR 13
+//
+// the requests on the fly in a bucket of rpc_client_matcher, not thread safe:
+// - the entries are kept in a deque and reused by a free list, so they never move
+// - an open-addressing (linear probing) table maps the request id to its entry
+// - the entries waiting for timeout are in a min-heap ordered by deadline, each
+//   knowing its position in the heap, so it is removed in O(log n) upon the reply
+//
+class rpc_request_bucket
+{
+public:
+    struct entry
+    {
+        uint64_t id;
+        rpc_response_task_ptr resp_task;
+        uint64_t deadline_ms;   // when the sweeper times out the request
+        uint64_t timeout_ts_ms; // > 0 for auto-resent msgs
+        uint32_t heap_pos;      // NPOS when not waiting for timeout
+        uint32_t index;         // in the deque
+        uint32_t next_free;
+    };
+
+    static const uint32_t NPOS = 0xffffffff;
+
+    rpc_request_bucket();
+
+    size_t size() const { return _size; }
+
+    // return nullptr if the id is already on the fly
+    entry *insert(uint64_t id);
+    entry *find(uint64_t id) const;
+    void erase(entry *e);
+
+    // wait for timeout at deadline_ms, or not any more
+    void schedule(entry *e, uint64_t deadline_ms);
+    void unschedule(entry *e);
+
+    // the entry waiting for timeout with the earliest deadline, or nullptr
+    entry *earliest() const { return _heap.empty() ? nullptr : &_entries[_heap[0]]; }
+
+private:
+    struct slot
+    {
+        uint64_t id;
+        uint32_t index; // of the entry, NPOS for an empty slot
+    };
+
+    size_t home(uint64_t id) const
+    {
+        // the ids in a bucket are strided by MATCHER_BUCKET_NR, so they are mixed
+        return (size_t)((id * 0x9E3779B97F4A7C15ULL) >> _shift);
+    }
+    size_t find_slot(uint64_t id) const;
+    void grow();
+
+    bool earlier(uint32_t a, uint32_t b) const
+    {
+        return _entries[_heap[a]].deadline_ms < _entries[_heap[b]].deadline_ms;
+    }
+    void heap_swap(uint32_t a, uint32_t b);
+    void sift_up(uint32_t pos);
+    void sift_down(uint32_t pos);
+
+private:
+    mutable std::deque<entry> _entries;
+    uint32_t _free_head;
+    size_t _size;
+
+    std::vector<slot> _slots; // power of 2, at most half full
+    int _shift;
+
+    std::vector<uint32_t> _heap;
+};
+
 class rpc_client_matcher : public ref_counter
 {
 public:
-    rpc_client_matcher(rpc_engine *engine) : _engine(engine) {}
+    rpc_client_matcher(rpc_engine *engine);
 
     ~rpc_client_matcher();
 
     //
-    // when a two-way RPC call is made, register the requst id and the callback
-    // which also registers a timer for timeout tracking
+    // when a two-way RPC call is made, register the requst id and the callback,
+    // and the request is timed out by the sweeper of its bucket
     //
     void on_call(message_ex *request, const rpc_response_task_ptr &call);
 
@@ -88,16 +163,21 @@ private:
     friend class rpc_timeout_task;
     void on_rpc_timeout(uint64_t key);
 
+    // time out the requests due in the bucket, the sweeper is then re-armed
+    // for the earliest deadline left; ts_ms identifies the sweeper
+    void on_sweep(int bucket_index, uint64_t ts_ms);
+
+    // should be called in the lock of the bucket, the sweeper is enqueued by the caller
+    task_ptr arm_sweeper(int bucket_index, uint64_t deadline_ms, uint64_t now_ms);
+
 private:
     rpc_engine *_engine;
-    struct match_entry
+    struct bucket
     {
-        rpc_response_task_ptr resp_task;
-        task_ptr timeout_task;
-        uint64_t timeout_ts_ms; // > 0 for auto-resent msgs
+        rpc_request_bucket requests;
+        uint64_t sweep_ts_ms; // when the latest sweeper fires, 0 for none
     };
-    typedef std::unordered_map<uint64_t, match_entry> rpc_requests;
-    rpc_requests _requests[MATCHER_BUCKET_NR];
+    bucket _buckets[MATCHER_BUCKET_NR];
     ::dsn::utils::ex_lock_nr_spin _requests_lock[MATCHER_BUCKET_NR];
 };
 
@@ -193,6 +273,11 @@ private:
                             network_header_format client_hdr_format,
                             io_modifer &ctx);
 
+    // in-process fast path: the request/response is handed to the target engine in the
+    // same process directly, sharing the body buffers, without going through the network
+    void deliver_local_request(network *server_net, message_ex *request);
+    void deliver_local_reply(message_ex *response);
+
 private:
     service_node *_node;
     std::vector<std::vector<network *>> _client_nets;             // <format, <CHANNEL, network*>>
@@ -205,6 +290,7 @@ private:
 
     volatile bool _is_running;
     volatile bool _is_serving;
+    bool _local_fast_path;
 };
 
 // ------------------------ inline implementations --------------------
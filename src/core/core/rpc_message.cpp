@@ -36,10 +36,12 @@
 #include <dsn/utility/ports.h>
 #include <dsn/utility/crc.h>
 #include <dsn/utility/transient_memory.h>
+#include <dsn/utility/object_pool.h>
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/tool-api/network.h>
 #include <dsn/tool-api/message_parser.h>
 #include <cctype>
+#include <type_traits>
 
 #include "task_engine.h"
 
@@ -205,6 +207,7 @@ message_ex::message_ex()
       local_rpc_code(::dsn::TASK_CODE_INVALID),
       hdr_format(NET_HDR_INVALID),
       send_retry_count(0),
+      local_peer(nullptr),
       _rw_index(-1),
       _rw_offset(0),
       _rw_committed(true),
@@ -286,12 +289,18 @@ message_ex *message_ex::create_receive_message(const blob &data)
 message_ex *message_ex::create_receive_message_with_standalone_header(const blob &data)
 {
     message_ex *msg = new message_ex();
-    std::shared_ptr<char> header_holder(
-        static_cast<char *>(dsn::tls_trans_malloc(sizeof(message_header))),
-        [](char *c) { dsn::tls_trans_free(c); });
-    msg->header = reinterpret_cast<message_header *>(header_holder.get());
-    memset(msg->header, 0, sizeof(message_header));
-    msg->buffers.emplace_back(blob(std::move(header_holder), sizeof(message_header)));
+
+    // the header and the control block are taken from the object pools at once. the header
+    // is raw storage as the ones in the receive buffers, so no destructor runs on it
+    typedef std::aligned_storage<sizeof(message_header), alignof(message_header)>::type
+        header_storage;
+    std::shared_ptr<header_storage> storage =
+        std::allocate_shared<header_storage>(dsn::pool_allocator<header_storage>());
+    char *header = reinterpret_cast<char *>(storage.get());
+    memset(header, 0, sizeof(message_header));
+    msg->header = reinterpret_cast<message_header *>(header);
+    msg->buffers.emplace_back(
+        blob(std::shared_ptr<char>(std::move(storage), header), sizeof(message_header)));
     msg->buffers.push_back(data);
 
     msg->header->body_length = data.length();
@@ -391,6 +400,39 @@ message_ex *message_ex::copy_and_prepare_send(bool clone_content)
     return copy;
 }
 
+message_ex *message_ex::copy_for_local_receive()
+{
+    dassert(!_is_read && _rw_committed, "only committed sent messages can be copied");
+
+    message_ex *msg = new message_ex();
+
+    // the header is copied as the sender may still modify it, e.g., when resending,
+    // while the body buffers are shared
+    std::shared_ptr<char> header_holder(
+        static_cast<char *>(dsn::tls_pool_malloc(sizeof(message_header))),
+        [](char *c) { dsn::tls_pool_free(c); },
+        dsn::pool_allocator<char>());
+    msg->header = new (header_holder.get()) message_header(*header);
+    msg->buffers.emplace_back(blob(std::move(header_holder), sizeof(message_header)));
+
+    dassert((const char *)header == buffers[0].data(), "header must be in the first buffer");
+    for (size_t i = 0; i < buffers.size(); i++) {
+        blob bb = (i == 0 ? buffers[0].range((int)sizeof(message_header)) : buffers[i]);
+        if (bb.length() > 0)
+            msg->buffers.push_back(bb);
+    }
+
+    msg->to_address = to_address;
+    msg->local_rpc_code = local_rpc_code;
+    msg->hdr_format = hdr_format;
+    msg->_is_read = true;
+    // we skip the message header
+    msg->_rw_index = 1;
+
+    copy_to(*msg); // extensible object state move
+    return msg;
+}
+
 message_ex *message_ex::create_request(dsn::task_code rpc_code,
                                        int timeout_milliseconds,
                                        int thread_hash,
@@ -461,6 +503,7 @@ message_ex *message_ex::create_response()
     msg->header->from_address = to_address;
     msg->to_address = header->from_address;
     msg->io_session = io_session;
+    msg->local_peer = local_peer;
     msg->hdr_format = hdr_format;
 
     // join point
@@ -51,6 +51,7 @@
 #include <dsn/utility/filesystem.h>
 #include <dsn/utility/transient_memory.h>
 #include <dsn/tool-api/command_manager.h>
+#include <dsn/tool-api/perf_counters.h>
 #include "service_engine.h"
 #include "rpc_engine.h"
 #include "disk_engine.h"
@@ -361,6 +362,18 @@ DSN_API dsn::error_code dsn_file_flush(dsn_handle_t file)
     return ::dsn::task::get_current_disk()->flush(file);
 }
 
+DSN_API void dsn_file_flush_async(dsn_handle_t file, dsn::aio_task *cb)
+{
+    cb->aio()->buffer = nullptr;
+    cb->aio()->buffer_size = 0;
+    cb->aio()->engine = nullptr;
+    cb->aio()->file = file;
+    cb->aio()->file_offset = 0;
+    cb->aio()->type = ::dsn::AIO_Sync;
+
+    ::dsn::task::get_current_disk()->flush_async(cb);
+}
+
 // native HANDLE: HANDLE for windows, int for non-windows
 DSN_API void *dsn_file_native_handle(dsn_handle_t file)
 {
@@ -844,6 +857,13 @@ bool run(const char *config_file,
         ::dsn::command_manager::instance().start_remote_cli();
     }
 
+    if (dsn_config_get_value_bool("core",
+                                  "http_metrics",
+                                  true,
+                                  "whether to serve the perf counters at http GET /metrics")) {
+        ::dsn::perf_counters::instance().start_http_metrics();
+    }
+
     dsn::command_manager::instance().register_command({"config-dump"},
                                                       "config-dump - dump configuration",
                                                       "config-dump [to-this-config-file]",
@@ -408,6 +408,11 @@ service_engine::service_engine(void)
         "system.queue - get queue internal information",
         "system.queue",
         &service_engine::get_queue_info);
+    ::dsn::command_manager::instance().register_command(
+        {"system.resize-pool"},
+        "system.resize-pool - resize an elastic thread pool on all nodes",
+        "system.resize-pool <pool-name> <worker-count>",
+        &service_engine::resize_pool);
 }
 
 void service_engine::init_before_toollets(const service_spec &spec)
@@ -443,6 +448,50 @@ void service_engine::init_after_toollets()
         _env = factory_store<env_provider>::create(it->c_str(), PROVIDER_TYPE_ASPECT, _env);
     }
     tls_dsn.env = _env;
+
+    _object_pool_hit.init_global_counter("core",
+                                         "object_pool",
+                                         "object_pool.hit",
+                                         COUNTER_TYPE_RATE,
+                                         "allocations per second served by recycled objects");
+    _object_pool_miss.init_global_counter("core",
+                                          "object_pool",
+                                          "object_pool.miss",
+                                          COUNTER_TYPE_RATE,
+                                          "allocations per second served by fresh memory");
+    _object_pool_batch_return.init_global_counter(
+        "core",
+        "object_pool",
+        "object_pool.batch.return",
+        COUNTER_TYPE_RATE,
+        "batches of freed objects per second handed back to the central lists");
+    _object_pool_released.init_global_counter("core",
+                                              "object_pool",
+                                              "object_pool.released",
+                                              COUNTER_TYPE_NUMBER,
+                                              "objects freed to the system since the process "
+                                              "started, as the central lists are full");
+    _object_pool_hit_ratio.init_global_counter("core",
+                                               "object_pool",
+                                               "object_pool.hit.ratio(%)",
+                                               COUNTER_TYPE_NUMBER,
+                                               "percentage of the allocations served by "
+                                               "recycled objects since the process started");
+    tls_pool_set_stats_hook(&service_engine::on_object_pool_stats);
+}
+
+void service_engine::on_object_pool_stats(const object_pool_stats &delta)
+{
+    service_engine &engine = service_engine::fast_instance();
+    engine._object_pool_hit->add(delta.hit_count);
+    engine._object_pool_miss->add(delta.miss_count);
+    engine._object_pool_batch_return->add(delta.batch_return_count);
+
+    object_pool_stats total = tls_pool_get_stats();
+    engine._object_pool_released->set(total.release_count);
+    uint64_t count = total.hit_count + total.miss_count;
+    if (count > 0)
+        engine._object_pool_hit_ratio->set(total.hit_count * 100 / count);
 }
 
 // port == -1 for all node
@@ -544,4 +593,31 @@ std::string service_engine::get_queue_info(const std::vector<std::string> &args)
     return ss.str();
 }
 
+std::string service_engine::resize_pool(const std::vector<std::string> &args)
+{
+    if (args.size() != 2)
+        return "invalid arguments, usage: system.resize-pool <pool-name> <worker-count>";
+    if (!threadpool_code::is_exist(args[0].c_str()))
+        return "cannot find thread pool " + args[0];
+
+    threadpool_code code(args[0].c_str());
+    int worker_count = atoi(args[1].c_str());
+
+    std::stringstream ss;
+    for (auto &kv : service_engine::fast_instance()._nodes_by_app_id) {
+        task_engine *engine = kv.second->computation();
+        if (engine == nullptr || static_cast<size_t>(code) >= engine->pools().size())
+            continue;
+        task_worker_pool *pool = engine->get_pool(code);
+        if (pool == nullptr)
+            continue;
+
+        std::string err = pool->resize(worker_count);
+        ss << kv.second->full_name() << ": " << (err.empty() ? "OK" : err) << std::endl;
+    }
+
+    std::string result = ss.str();
+    return result.empty() ? "thread pool " + args[0] + " is not used by any node" : result;
+}
+
 } // end namespace
@@ -44,6 +44,8 @@
 #include <dsn/tool-api/auto_codes.h>
 #include <dsn/cpp/service_app.h>
 #include <dsn/utility/synchronize.h>
+#include <dsn/utility/object_pool.h>
+#include <dsn/cpp/perf_counter_wrapper.h>
 
 namespace dsn {
 
@@ -147,6 +149,8 @@ public:
     logging_provider *logging() const { return _logging; }
     static std::string get_runtime_info(const std::vector<std::string> &args);
     static std::string get_queue_info(const std::vector<std::string> &args);
+    static std::string resize_pool(const std::vector<std::string> &args);
+    static void on_object_pool_stats(const object_pool_stats &delta);
 
     void init_before_toollets(const service_spec &spec);
     void init_after_toollets();
@@ -170,6 +174,12 @@ private:
         node_engines_by_port; // multiple ports may share the same node
     service_nodes_by_app_id _nodes_by_app_id;
     node_engines_by_port _nodes_by_app_port;
+
+    perf_counter_wrapper _object_pool_hit;
+    perf_counter_wrapper _object_pool_miss;
+    perf_counter_wrapper _object_pool_batch_return;
+    perf_counter_wrapper _object_pool_released;
+    perf_counter_wrapper _object_pool_hit_ratio;
 };
 
 // ------------ inline impl ---------------------
@@ -131,6 +131,10 @@ task::task(dsn::task_code code, int hash, service_node *node)
     _wait_for_cancel = false;
     _is_null = false;
     next = nullptr;
+    timer.owner = nullptr;
+    timer.slot = nullptr;
+    timer.prev = nullptr;
+    timer.expire_tick = 0;
 
     if (node != nullptr) {
         _node = node;
@@ -337,6 +341,10 @@ bool task::cancel(bool wait_until_finished, /*out*/ bool *finished /*= nullptr*/
     }
 
     if (succ) {
+        // let the timer service drop the task now instead of on its expiry
+        if (timer.owner != nullptr)
+            timer.owner->cancel_timer(this);
+
         spec().on_task_cancelled.execute(this);
         signal_waiters();
 
@@ -369,6 +377,15 @@ void task::enqueue()
     enqueue(pool);
 }
 
+void task::enqueue_batch(const std::vector<task_ptr> &tasks)
+{
+    // the tasks are collected by the scope, and enqueued to their pools when it's destroyed
+    task_batch_scope batch;
+    for (auto &t : tasks) {
+        t->enqueue();
+    }
+}
+
 void task::enqueue(task_worker_pool *pool)
 {
     this->add_ref(); // released in exec_internal (even when cancelled)
@@ -467,6 +484,7 @@ rpc_request_task::rpc_request_task(message_ex *request, rpc_request_handler &&h,
     : task(request->rpc_code(), request->header->client.thread_hash, node),
       _request(request),
       _handler(std::move(h)),
+      _deadline_ns(0),
       _enqueue_ts_ns(0)
 {
     dbg_dassert(
@@ -483,10 +501,46 @@ rpc_request_task::~rpc_request_task()
 
 void rpc_request_task::enqueue()
 {
-    if (spec().rpc_request_dropped_before_execution_when_timeout) {
+    auto pool = node()->computation()->get_pool(spec().pool_code);
+
+    // the clock is read only when the deadline or the admission controller needs it
+    int timeout_ms = _request->header->client.timeout_ms;
+    if (timeout_ms > 0 || (pool != nullptr && pool->has_admission_controller())) {
         _enqueue_ts_ns = dsn_now_ns();
+        if (timeout_ms > 0) {
+            _deadline_ns = _enqueue_ts_ns + static_cast<uint64_t>(timeout_ms) * 1000000ULL;
+        }
+    }
+    task::enqueue(pool);
+}
+
+bool rpc_request_task::drop_if_expired(uint64_t now_ns)
+{
+    if (!need_drop_check() || now_ns < _deadline_ns)
+        return false;
+
+    // the following exec_internal() is then a no-op except for releasing the task
+    if (!cancel(false))
+        return false;
+
+    on_dropped();
+    return true;
+}
+
+void rpc_request_task::on_dropped()
+{
+    auto pool = node()->computation()->get_pool(spec().pool_code);
+    pool->rpc_request_timeout_drop_counter()->increment();
+
+    dinfo("rpc_request_task(%s) from(%s) is dropped due to timeout_ms(%d) exceed",
+          spec().name.c_str(),
+          _request->header->from_address.to_string(),
+          _request->header->client.timeout_ms);
+
+    if (spec().rpc_request_reply_when_dropped_for_timeout) {
+        auto resp = _request->create_response();
+        task::get_current_rpc()->reply(resp, ERR_TIMEOUT);
     }
-    task::enqueue(node()->computation()->get_pool(spec().pool_code));
 }
 
 rpc_response_task::rpc_response_task(message_ex *request,
@@ -34,8 +34,12 @@
  */
 
 #include "task_engine.h"
+#include <dsn/tool_api.h>
 #include <dsn/tool-api/perf_counter.h>
 #include <dsn/utility/factory_store.h>
+#include <dsn/utility/numa.h>
+#include <algorithm>
+#include <mutex>
 
 using namespace dsn::utils;
 
@@ -46,6 +50,14 @@ task_worker_pool::task_worker_pool(const threadpool_spec &opts, task_engine *own
 {
     _is_running = false;
     _per_node_timer_svc = nullptr;
+    _next_queue = 0;
+    _elastic = false;
+    _has_admission_controller = false;
+    _worker_count = _spec.worker_count;
+    _reaped_task_count = 0;
+    _last_check_ns = 0;
+    _last_processed_task_count = 0;
+    _idle_check_count = 0;
 }
 
 void task_worker_pool::create()
@@ -53,7 +65,9 @@ void task_worker_pool::create()
     if (_is_running)
         return;
 
-    int qCount = _spec.partitioned ? _spec.worker_count : 1;
+    // each worker owns a queue when the pool is partitioned or work-stealing
+    bool private_queue = _spec.partitioned || _spec.work_stealing;
+    int qCount = private_queue ? _spec.worker_count : 1;
     for (int i = 0; i < qCount; i++) {
         auto q = factory_store<task_queue>::create(
             _spec.queue_factory_name.c_str(), PROVIDER_TYPE_MAIN, this, i, nullptr);
@@ -72,6 +86,7 @@ void task_worker_pool::create()
             if (controller) {
                 _controllers.push_back(controller);
                 q->set_controller(controller);
+                _has_admission_controller = true;
             } else {
                 _controllers.push_back(nullptr);
             }
@@ -80,19 +95,127 @@ void task_worker_pool::create()
         }
     }
 
+    _rpc_request_timeout_drop.init_global_counter(
+        _node->full_name(),
+        "engine",
+        (_spec.name + ".rpc.request.timeout.drop").c_str(),
+        COUNTER_TYPE_RATE,
+        "rpc requests per second dropped before execution as their deadlines have passed");
+
+    if (_spec.idle_spin_count > 0 || _spec.idle_yield_count > 0) {
+        _idle_spin_time.init_global_counter(
+            _node->full_name(),
+            "engine",
+            (_spec.name + ".idle.spin.time(ns)").c_str(),
+            COUNTER_TYPE_RATE,
+            "time (ns) per second the idle workers spend on spinning");
+        _idle_yield_time.init_global_counter(
+            _node->full_name(),
+            "engine",
+            (_spec.name + ".idle.yield.time(ns)").c_str(),
+            COUNTER_TYPE_RATE,
+            "time (ns) per second the idle workers spend on yielding");
+        _idle_park_time.init_global_counter(
+            _node->full_name(),
+            "engine",
+            (_spec.name + ".idle.park.time(ns)").c_str(),
+            COUNTER_TYPE_RATE,
+            "time (ns) per second the idle workers spend on parking");
+        for (auto q : _queues) {
+            q->set_park_time_counter(_idle_park_time.get());
+        }
+    }
+
+    if (_spec.numa_aware) {
+        int node_count = utils::numa_node_count();
+        for (int n = 0; n < node_count; n++) {
+            std::string prefix = _spec.name + ".numa.node" + std::to_string(n);
+            _numa_queue_length.emplace_back(new perf_counter_wrapper());
+            _numa_queue_length.back()->init_global_counter(
+                _node->full_name(),
+                "engine",
+                (prefix + ".queue.length").c_str(),
+                COUNTER_TYPE_NUMBER,
+                "length of the task queues on the numa node");
+            _numa_remote_enqueue.emplace_back(new perf_counter_wrapper());
+            _numa_remote_enqueue.back()->init_global_counter(
+                _node->full_name(),
+                "engine",
+                (prefix + ".remote.enqueue").c_str(),
+                COUNTER_TYPE_RATE,
+                "tasks per second enqueued to the numa node from the other nodes");
+        }
+
+        // a shared queue is served by the workers on all the nodes
+        if (private_queue) {
+            for (int i = 0; i < qCount; i++) {
+                int node = worker_numa_node(i);
+                _queues[i]->set_numa_node(node,
+                                          _numa_queue_length[node]->get(),
+                                          _numa_remote_enqueue[node]->get());
+            }
+        }
+    }
+
     for (int i = 0; i < _spec.worker_count; i++) {
         auto q = _queues[qCount == 1 ? 0 : i];
-        task_worker *worker = factory_store<task_worker>::create(
-            _spec.worker_factory_name.c_str(), PROVIDER_TYPE_MAIN, this, q, i, nullptr);
-        for (auto it = _spec.worker_aspects.begin(); it != _spec.worker_aspects.end(); ++it) {
-            worker = factory_store<task_worker>::create(
-                it->c_str(), PROVIDER_TYPE_ASPECT, this, q, i, worker);
-        }
-        task_worker::on_create.execute(worker);
-        q->set_owner_worker(spec().partitioned ? worker : nullptr);
+        task_worker *worker = create_worker(i, q);
+        q->set_owner_worker(private_queue ? worker : nullptr);
 
         _workers.push_back(worker);
     }
+
+    // the simulator schedules the workers by itself, so they are never resized
+    _elastic = !private_queue && _queues[0]->is_shared() &&
+               service_engine::fast_instance().spec().tool != "simulator";
+    if (_elastic) {
+        _worker_count_counter.init_global_counter(_node->full_name(),
+                                                  "engine",
+                                                  (_spec.name + ".worker.count").c_str(),
+                                                  COUNTER_TYPE_NUMBER,
+                                                  "worker count of the elastic pool");
+        _worker_count_counter->set(_spec.worker_count);
+
+        if (_spec.elastic_max_worker_count > 0) {
+            dassert(_spec.elastic_min_worker_count >= 1 &&
+                        _spec.elastic_min_worker_count <= _spec.elastic_max_worker_count,
+                    "invalid elastic worker count range [%d, %d] of thread pool %s",
+                    _spec.elastic_min_worker_count,
+                    _spec.elastic_max_worker_count,
+                    _spec.name.c_str());
+            _queueing_time_estimate.init_global_counter(
+                _node->full_name(),
+                "engine",
+                (_spec.name + ".queueing.time.estimate(ms)").c_str(),
+                COUNTER_TYPE_NUMBER,
+                "queueing time (ms) of the elastic pool estimated by the auto-scaler");
+        }
+    } else if (_spec.elastic_max_worker_count > 0) {
+        dwarn("elastic_max_worker_count of thread pool %s is ignored, as the pool is "
+              "partitioned, work-stealing or served by only one worker",
+              _spec.name.c_str());
+    }
+}
+
+task_worker *task_worker_pool::create_worker(int index, task_queue *q)
+{
+    task_worker *worker = factory_store<task_worker>::create(
+        _spec.worker_factory_name.c_str(), PROVIDER_TYPE_MAIN, this, q, index, nullptr);
+    for (auto it = _spec.worker_aspects.begin(); it != _spec.worker_aspects.end(); ++it) {
+        worker = factory_store<task_worker>::create(
+            it->c_str(), PROVIDER_TYPE_ASPECT, this, q, index, worker);
+    }
+    task_worker::on_create.execute(worker);
+    return worker;
+}
+
+int task_worker_pool::worker_numa_node(int index) const
+{
+    if (!_spec.numa_aware)
+        return -1;
+
+    return static_cast<int>(static_cast<int64_t>(index) * utils::numa_node_count() /
+                            worker_count());
 }
 
 void task_worker_pool::start()
@@ -104,13 +227,15 @@ void task_worker_pool::start()
         wk->start();
 
     ddebug("[%s] thread pool [%s] started, pool_code = %s, worker_count = %d, worker_share_core = "
-           "%s, partitioned = %s, ...",
+           "%s, partitioned = %s, work_stealing = %s, numa_aware = %s, ...",
            _node->full_name(),
            _spec.name.c_str(),
            _spec.pool_code.to_string(),
            _spec.worker_count,
            _spec.worker_share_core ? "true" : "false",
-           _spec.partitioned ? "true" : "false");
+           _spec.partitioned ? "true" : "false",
+           _spec.work_stealing ? "true" : "false",
+           _spec.numa_aware ? "true" : "false");
 
     // setup cached ptrs for fast timer service access
     if (service_engine::fast_instance().spec().timer_io_mode == IOE_PER_QUEUE) {
@@ -150,10 +275,16 @@ void task_worker_pool::enqueue(task *t)
             "task delayed should be dispatched to timer service first");
 
     if (_is_running) {
+        task_batch_scope *batch = task_batch_scope::current();
+        if (batch != nullptr) {
+            batch->add(this, t);
+            return;
+        }
+
         unsigned int idx =
             (_spec.partitioned
                  ? static_cast<unsigned int>(t->hash()) % static_cast<unsigned int>(_queues.size())
-                 : 0);
+                 : (_spec.work_stealing ? select_work_stealing_queue() : 0));
         return _queues[idx]->enqueue_internal(t);
     } else {
         dassert(false,
@@ -163,16 +294,225 @@ void task_worker_pool::enqueue(task *t)
     }
 }
 
+void task_worker_pool::enqueue_batch(task **tasks, int count)
+{
+    dassert(_is_running,
+            "worker pool %s must be started before enqueue tasks",
+            spec().name.c_str());
+
+    for (int i = 0; i < count; i++) {
+        dassert(tasks[i]->spec().pool_code == spec().pool_code ||
+                    tasks[i]->spec().type == TASK_TYPE_RPC_RESPONSE,
+                "Invalid thread pool used");
+        dassert(tasks[i]->delay_milliseconds() == 0,
+                "task delayed should be dispatched to timer service first");
+    }
+
+    if (!_spec.partitioned) {
+        // a batch goes to one queue, and with work stealing the idle peers will take
+        // their shares from it
+        unsigned int idx = _spec.work_stealing ? select_work_stealing_queue() : 0;
+        _queues[idx]->enqueue_internal_batch(tasks, count);
+        return;
+    }
+
+    // group by target queue, keeping the order of the tasks of each queue
+    unsigned int queue_count = static_cast<unsigned int>(_queues.size());
+    std::vector<int> offsets(queue_count + 1, 0);
+    for (int i = 0; i < count; i++) {
+        offsets[static_cast<unsigned int>(tasks[i]->hash()) % queue_count + 1]++;
+    }
+    for (unsigned int q = 0; q < queue_count; q++) {
+        offsets[q + 1] += offsets[q];
+    }
+
+    std::vector<task *> grouped(count);
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < count; i++) {
+        grouped[next[static_cast<unsigned int>(tasks[i]->hash()) % queue_count]++] = tasks[i];
+    }
+
+    for (unsigned int q = 0; q < queue_count; q++) {
+        int n = offsets[q + 1] - offsets[q];
+        if (n > 0) {
+            _queues[q]->enqueue_internal_batch(&grouped[offsets[q]], n);
+        }
+    }
+}
+
+unsigned int task_worker_pool::select_work_stealing_queue()
+{
+    // tasks enqueued by a worker of this pool stay in its own queue,
+    // others are spread among the workers in a round-robin way
+    task_worker *current = task::get_current_worker2();
+    if (current != nullptr && current->pool() == this)
+        return static_cast<unsigned int>(current->index());
+
+    return _next_queue.fetch_add(1, std::memory_order_relaxed) %
+           static_cast<unsigned int>(_queues.size());
+}
+
+std::string task_worker_pool::resize(int worker_count)
+{
+    if (!_elastic)
+        return "thread pool " + _spec.name +
+               " is not elastic, as it is partitioned, work-stealing or served by only one "
+               "worker";
+    if (worker_count < 1)
+        return "worker count must be positive";
+    if (_spec.elastic_max_worker_count > 0 && worker_count > _spec.elastic_max_worker_count)
+        return "worker count exceeds elastic_max_worker_count " +
+               std::to_string(_spec.elastic_max_worker_count);
+
+    std::vector<task *> wake_ups;
+    int old_count;
+    {
+        auto_lock<ex_lock_nr> l(_resize_lock);
+        reap_retired_workers();
+
+        old_count = static_cast<int>(_workers.size());
+        if (worker_count > old_count) {
+            // set first as the new workers look up their numa nodes with it
+            _worker_count.store(worker_count, std::memory_order_release);
+            for (int i = old_count; i < worker_count; i++) {
+                task_worker *worker = create_worker(i, _queues[0]);
+                _workers.push_back(worker);
+                if (_is_running)
+                    worker->start();
+            }
+        } else if (worker_count < old_count) {
+            for (int i = worker_count; i < old_count; i++) {
+                _workers[i]->retire();
+                _retired_workers.push_back(_workers[i]);
+                if (_is_running)
+                    wake_ups.push_back(
+                        new raw_task(_spec.wake_up_task_code, task_handler(), 0, _node));
+            }
+            _workers.resize(worker_count);
+            _worker_count.store(worker_count, std::memory_order_release);
+        }
+        update_queue_worker_count();
+        _worker_count_counter->set(worker_count);
+    }
+
+    // the retired workers parked on the queue exit after they are woken up by
+    // whatever tasks, these are to make it sooner
+    for (auto t : wake_ups) {
+        t->add_ref(); // released in exec_internal
+        t->spec().on_task_enqueue.execute(task::get_current_task(), t);
+        _queues[0]->enqueue_internal(t);
+    }
+
+    if (old_count != worker_count) {
+        ddebug("[%s] thread pool [%s] resized from %d to %d workers",
+               _node->full_name(),
+               _spec.name.c_str(),
+               old_count,
+               worker_count);
+    }
+    return std::string();
+}
+
+void task_worker_pool::reap_retired_workers()
+{
+    size_t retired_count = _retired_workers.size();
+    for (auto it = _retired_workers.begin(); it != _retired_workers.end();) {
+        task_worker *worker = *it;
+        if (worker->is_exited()) {
+            worker->stop();
+            _reaped_task_count += worker->processed_task_count();
+            delete worker;
+            it = _retired_workers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (retired_count != _retired_workers.size())
+        update_queue_worker_count();
+}
+
+void task_worker_pool::update_queue_worker_count()
+{
+    // the retired workers not yet exited are still waiting on the shared queue
+    _queues[0]->set_worker_count(static_cast<int>(_workers.size() + _retired_workers.size()));
+}
+
+std::vector<task_worker *> task_worker_pool::workers()
+{
+    auto_lock<ex_lock_nr> l(_resize_lock);
+    return _workers;
+}
+
+void task_worker_pool::auto_scale()
+{
+    uint64_t now_ns = dsn_now_ns();
+    if (_last_check_ns != 0 &&
+        now_ns - _last_check_ns < static_cast<uint64_t>(_spec.elastic_check_interval_ms) * 1000000)
+        return;
+
+    int target_count = 0;
+    {
+        auto_lock<ex_lock_nr> l(_resize_lock);
+        reap_retired_workers();
+
+        int queue_length = _queues[0]->count();
+        uint64_t processed_count = _reaped_task_count;
+        for (auto wk : _workers)
+            processed_count += wk->processed_task_count();
+        for (auto wk : _retired_workers)
+            processed_count += wk->processed_task_count();
+
+        uint64_t elapsed_ms = (now_ns - _last_check_ns) / 1000000;
+        uint64_t done_count = processed_count - _last_processed_task_count;
+        bool is_first_check = (_last_check_ns == 0);
+        _last_check_ns = now_ns;
+        _last_processed_task_count = processed_count;
+        if (is_first_check)
+            return;
+
+        // by little's law, the queueing time is the queue length over the throughput
+        uint64_t queueing_ms =
+            static_cast<uint64_t>(queue_length) * elapsed_ms / std::max(done_count, (uint64_t)1);
+        _queueing_time_estimate->set(queueing_ms);
+
+        int worker_count = static_cast<int>(_workers.size());
+        if (queueing_ms > static_cast<uint64_t>(_spec.elastic_scale_up_queueing_time_ms)) {
+            _idle_check_count = 0;
+            if (worker_count < _spec.elastic_max_worker_count)
+                target_count = worker_count + 1;
+        } else if (queue_length == 0) {
+            if (++_idle_check_count >= _spec.elastic_scale_down_idle_checks &&
+                worker_count > _spec.elastic_min_worker_count) {
+                _idle_check_count = 0;
+                target_count = worker_count - 1;
+            }
+        } else {
+            _idle_check_count = 0;
+        }
+    }
+
+    if (target_count != 0) {
+        std::string err = resize(target_count);
+        if (!err.empty()) {
+            dwarn("[%s] auto-scale thread pool [%s] failed: %s",
+                  _node->full_name(),
+                  _spec.name.c_str(),
+                  err.c_str());
+        }
+    }
+}
+
 bool task_worker_pool::shared_same_worker_with_current_task(task *tsk) const
 {
     task *current = task::get_current_task();
     if (nullptr != current) {
         if (current->spec().pool_code != tsk->code())
             return false;
-        else if (_workers.size() == 1)
+        else if (worker_count() == 1)
             return true;
         else if (_spec.partitioned) {
-            unsigned int sz = static_cast<unsigned int>(_workers.size());
+            unsigned int sz = static_cast<unsigned int>(worker_count());
             return static_cast<unsigned int>(current->hash()) % sz ==
                    static_cast<unsigned int>(tsk->hash()) % sz;
         } else {
@@ -187,6 +527,8 @@ void task_worker_pool::get_runtime_info(const std::string &indent,
                                         const std::vector<std::string> &args,
                                         /*out*/ std::stringstream &ss)
 {
+    auto_lock<ex_lock_nr> l(_resize_lock);
+
     std::string indent2 = indent + "\t";
     ss << indent << "contains " << _workers.size() << " threads with " << _queues.size()
        << " queues" << std::endl;
@@ -204,9 +546,16 @@ void task_worker_pool::get_runtime_info(const std::string &indent,
                << ") attached with queue " << wk->queue()->get_name() << std::endl;
         }
     }
+
+    for (auto &wk : _retired_workers) {
+        ss << indent2 << wk->index() << " (TID = " << wk->native_tid() << ") "
+           << (wk->is_exited() ? "exited" : "retiring") << std::endl;
+    }
 }
 void task_worker_pool::get_queue_info(/*out*/ std::stringstream &ss)
 {
+    auto_lock<ex_lock_nr> l(_resize_lock);
+
     ss << "[";
     bool first_flag = 0;
     for (auto &q : _queues) {
@@ -221,10 +570,57 @@ void task_worker_pool::get_queue_info(/*out*/ std::stringstream &ss)
     ss << "]\n";
 }
 
+__thread task_batch_scope *task_batch_scope::s_current = nullptr;
+
+task_batch_scope::task_batch_scope() : _is_outermost(s_current == nullptr)
+{
+    if (_is_outermost) {
+        s_current = this;
+    }
+}
+
+task_batch_scope::~task_batch_scope()
+{
+    if (!_is_outermost) {
+        return;
+    }
+    s_current = nullptr;
+
+    // tasks of a batch mostly go to the same pool, and the order among different
+    // pools doesn't matter
+    std::stable_sort(_tasks.begin(),
+                     _tasks.end(),
+                     [](const std::pair<task_worker_pool *, task *> &l,
+                        const std::pair<task_worker_pool *, task *> &r) {
+                         return l.first < r.first;
+                     });
+
+    std::vector<task *> tasks;
+    tasks.reserve(_tasks.size());
+    for (size_t i = 0; i < _tasks.size(); i++) {
+        tasks.push_back(_tasks[i].second);
+        if (i + 1 == _tasks.size() || _tasks[i + 1].first != _tasks[i].first) {
+            _tasks[i].first->enqueue_batch(tasks.data(), static_cast<int>(tasks.size()));
+            tasks.clear();
+        }
+    }
+}
+
 task_engine::task_engine(service_node *node)
 {
     _is_running = false;
     _node = node;
+    _elastic_thread = nullptr;
+}
+
+task_engine::~task_engine() { stop_auto_scaler(); }
+
+static void stop_auto_scalers_on_exit(sys_exit_type)
+{
+    for (auto &kv : service_engine::fast_instance().get_all_nodes()) {
+        if (kv.second->computation() != nullptr)
+            kv.second->computation()->stop_auto_scaler();
+    }
 }
 
 void task_engine::create(const std::list<threadpool_code> &pools)
@@ -247,12 +643,55 @@ void task_engine::start()
     if (_is_running)
         return;
 
+    int elastic_interval_ms = 0;
     for (auto &pl : _pools) {
-        if (pl)
+        if (pl) {
             pl->start();
+
+            if (pl->is_elastic() && pl->spec().elastic_max_worker_count > 0) {
+                int interval_ms = std::max(pl->spec().elastic_check_interval_ms, 1);
+                elastic_interval_ms = (elastic_interval_ms == 0
+                                           ? interval_ms
+                                           : std::min(elastic_interval_ms, interval_ms));
+            }
+        }
     }
 
     _is_running = true;
+
+    if (elastic_interval_ms > 0) {
+        static std::once_flag exit_once;
+        std::call_once(exit_once, [] {
+            ::dsn::tools::sys_exit.put_back(stop_auto_scalers_on_exit, "task.auto_scaler");
+        });
+
+        _elastic_thread =
+            new std::thread(std::bind(&task_engine::elastic_loop, this, elastic_interval_ms));
+    }
+}
+
+void task_engine::stop_auto_scaler()
+{
+    if (_elastic_thread == nullptr)
+        return;
+
+    _elastic_stop.notify();
+    _elastic_thread->join();
+    delete _elastic_thread;
+    _elastic_thread = nullptr;
+}
+
+void task_engine::elastic_loop(int interval_ms)
+{
+    task_worker::set_name((std::string(_node->full_name()) + ".elastic").c_str());
+
+    // until stop_auto_scaler() is called
+    while (!_elastic_stop.wait_for(interval_ms)) {
+        for (auto &pl : _pools) {
+            if (pl && pl->is_elastic() && pl->spec().elastic_max_worker_count > 0)
+                pl->auto_scale();
+        }
+    }
 }
 
 volatile int *task_engine::get_task_queue_virtual_length_ptr(dsn::task_code code, int hash)
@@ -39,6 +39,7 @@
 #include <dsn/tool-api/task_queue.h>
 #include <dsn/tool-api/admission_controller.h>
 #include <dsn/tool-api/perf_counter.h>
+#include <dsn/cpp/perf_counter_wrapper.h>
 #include <dsn/tool-api/task_worker.h>
 #include <dsn/tool-api/timer_service.h>
 
@@ -50,7 +51,9 @@ class task_worker;
 
 //
 // a task_worker_pool is a set of TaskWorkers share the same configs;
-// they may even share the same task_queue when partitioned == false
+// they may even share the same task_queue when partitioned == false,
+// unless work_stealing == true, in which case each worker owns a queue
+// and steals tasks from the others when idle
 //
 class task_worker_pool
 {
@@ -63,13 +66,28 @@ public:
 
     // task procecessing
     void enqueue(task *task);
+    // enqueue the tasks of this pool in one go: tasks are grouped by their target queues,
+    // and each group is appended to its queue at once, waking up at most as many workers
+    // as the tasks in the group
+    void enqueue_batch(task **tasks, int count);
     void on_dequeue(int count);
 
+    // elastic pools (partitioned == false && work_stealing == false, with a shared queue)
+    // can be resized at runtime; the retired workers exit after their current batch.
+    // return empty string on success, or the reason of failure
+    std::string resize(int worker_count);
+    bool is_elastic() const { return _elastic; }
+    // grow or shrink the pool by one worker according to the estimated queueing time,
+    // called by the task engine every elastic_check_interval_ms
+    void auto_scale();
+
     // cached timer service access
     void add_timer(task *task);
 
     // inquery
     const threadpool_spec &spec() const { return _spec; }
+    // the current number of workers, while spec().worker_count is the configured one
+    int worker_count() const { return _worker_count.load(std::memory_order_acquire); }
     bool shared_same_worker_with_current_task(task *task) const;
     task_engine *engine() const { return _owner; }
     service_node *node() const { return _node; }
@@ -78,8 +96,33 @@ public:
                           /*out*/ std::stringstream &ss);
     void get_queue_info(/*out*/ std::stringstream &ss);
     std::vector<task_queue *> &queues() { return _queues; }
-    std::vector<task_worker *> &workers() { return _workers; }
+    // a snapshot, as the workers of an elastic pool may be changed by resize()
+    std::vector<task_worker *> workers();
     std::vector<admission_controller *> &controllers() { return _controllers; }
+    bool has_admission_controller() const { return _has_admission_controller; }
+
+    // time (ns) spent by the idle workers in each phase of the idle strategy,
+    // only valid when idle_spin_count or idle_yield_count is set
+    perf_counter *idle_spin_time_counter() const { return _idle_spin_time.get(); }
+    perf_counter *idle_yield_time_counter() const { return _idle_yield_time.get(); }
+    perf_counter *idle_park_time_counter() const { return _idle_park_time.get(); }
+
+    // requests dropped before execution as their deadlines have passed
+    perf_counter *rpc_request_timeout_drop_counter() const
+    {
+        return _rpc_request_timeout_drop.get();
+    }
+
+    // numa node of the worker with the given index, -1 when the pool is not numa-aware;
+    // workers are spread across the nodes by contiguous index ranges, so that with
+    // partitioned == true each node serves a contiguous range of the hash partitions
+    int worker_numa_node(int index) const;
+
+private:
+    unsigned int select_work_stealing_queue();
+    task_worker *create_worker(int index, task_queue *q);
+    void reap_retired_workers();
+    void update_queue_worker_count();
 
 private:
     threadpool_spec _spec;
@@ -87,26 +130,78 @@ private:
     service_node *_node;
 
     std::vector<task_worker *> _workers;
+    std::atomic<int> _worker_count;
     std::vector<task_queue *> _queues;
     std::vector<admission_controller *> _controllers;
+    bool _has_admission_controller;
+
+    perf_counter_wrapper _idle_spin_time;
+    perf_counter_wrapper _idle_yield_time;
+    perf_counter_wrapper _idle_park_time;
+    perf_counter_wrapper _rpc_request_timeout_drop;
+
+    // per numa node counters, only valid when numa_aware == true
+    std::vector<std::unique_ptr<perf_counter_wrapper>> _numa_queue_length;
+    std::vector<std::unique_ptr<perf_counter_wrapper>> _numa_remote_enqueue;
 
     // cached ptrs for fast access
     timer_service *_per_node_timer_svc;
     std::vector<timer_service *> _per_queue_timer_svcs;
 
     bool _is_running;
+    std::atomic<unsigned int> _next_queue; // for work stealing
+
+    // for elastic pools
+    bool _elastic;
+    ::dsn::utils::ex_lock_nr _resize_lock;
+    std::vector<task_worker *> _retired_workers;
+    uint64_t _reaped_task_count; // processed by the reaped workers
+    uint64_t _last_check_ns;
+    uint64_t _last_processed_task_count;
+    int _idle_check_count;
+    perf_counter_wrapper _worker_count_counter;
+    perf_counter_wrapper _queueing_time_estimate;
+};
+
+//
+// while a task_batch_scope is alive on the current thread, the tasks enqueued to the pools
+// are collected instead, and they are enqueued with task_worker_pool::enqueue_batch when
+// the scope is destroyed. nested scopes are merged into the outermost one.
+//
+// tasks run inline (e.g., allow_inline) during the scope must not wait for the tasks
+// enqueued before them in the same scope, as they are not queued yet.
+//
+class task_batch_scope
+{
+public:
+    task_batch_scope();
+    ~task_batch_scope();
+
+    // return the scope collecting the tasks of current thread, nullptr if there is none
+    static task_batch_scope *current() { return s_current; }
+
+    void add(task_worker_pool *pool, task *t) { _tasks.emplace_back(pool, t); }
+
+private:
+    std::vector<std::pair<task_worker_pool *, task *>> _tasks;
+    bool _is_outermost;
+
+    static __thread task_batch_scope *s_current;
 };
 
 class task_engine
 {
 public:
     task_engine(service_node *node);
+    ~task_engine();
 
     //
     // service management routines
     //
     void create(const std::list<dsn::threadpool_code> &pools);
     void start();
+    // stop the auto-scaler of the elastic pools, which is also done on system exit
+    void stop_auto_scaler();
 
     //
     // task management routines
@@ -124,10 +219,15 @@ public:
                           /*out*/ std::stringstream &ss);
     void get_queue_info(/*out*/ std::stringstream &ss);
 
+private:
+    void elastic_loop(int interval_ms);
+
 private:
     std::vector<task_worker_pool *> _pools;
     volatile bool _is_running;
     service_node *_node;
+    std::thread *_elastic_thread; // auto-scaler of the elastic pools
+    ::dsn::utils::notify_event _elastic_stop;
 };
 
 // -------------------- inline implementation ----------------------------
@@ -37,7 +37,9 @@
 #include "task_engine.h"
 #include <dsn/tool-api/perf_counters.h>
 #include <dsn/tool-api/network.h>
+#include <dsn/utility/numa.h>
 #include <cstdio>
+#include <algorithm>
 #include "rpc_engine.h"
 
 namespace dsn {
@@ -51,7 +53,20 @@ task_queue::task_queue(task_worker_pool *pool, int index, task_queue *inner_prov
     _name = pool->spec().name + '.';
     _name.append(num);
     _owner_worker = nullptr;
-    _worker_count = _pool->spec().partitioned ? 1 : _pool->spec().worker_count;
+    _numa_node = -1;
+    _node_queue_length_counter = nullptr;
+    _node_remote_enqueue_counter = nullptr;
+    _park_time_counter = nullptr;
+    // a shared queue of an elastic pool may be served by up to elastic_max_worker_count
+    // workers at runtime
+    const threadpool_spec &pool_spec = _pool->spec();
+    if (pool_spec.partitioned)
+        _worker_count = 1;
+    else if (pool_spec.work_stealing)
+        _worker_count = pool_spec.worker_count;
+    else
+        _worker_count = std::max(pool_spec.worker_count, pool_spec.elastic_max_worker_count);
+    _is_shared = (_worker_count > 1);
     _queue_length_counter.init_global_counter(_pool->node()->full_name(),
                                               "engine",
                                               (_name + ".queue.length").c_str(),
@@ -66,9 +81,48 @@ task_queue::~task_queue()
     perf_counters::instance().remove_counter(_queue_length_counter->full_name());
 }
 
+service_node *task_queue::node() const { return _pool->node(); }
+
+bool task_queue::admit(task *task)
+{
+    auto &sp = task->spec();
+    if (sp.rpc_request_admission_mode == TM_NONE || _controller->is_task_accepted(task))
+        return true;
+
+    auto rtask = static_cast<rpc_request_task *>(task);
+    if (sp.rpc_request_admission_mode == TM_DELAY) {
+        // requests from the local node have no session to delay
+        auto &session = rtask->get_request()->io_session;
+        if (session != nullptr)
+            session->delay_recv(sp.rpc_request_admission_delay_milliseconds);
+        return true;
+    }
+
+    dbg_dassert(TM_REJECT == sp.rpc_request_admission_mode,
+                "unknow mode %d",
+                (int)sp.rpc_request_admission_mode);
+    if (sp.rejection_handler != nullptr) {
+        sp.rejection_handler(task, _controller);
+    } else {
+        auto resp = rtask->get_request()->create_response();
+        task::get_current_rpc()->reply(resp, ERR_BUSY);
+    }
+
+    dinfo("admission controller of %s rejects message from %s with trace_id = %016" PRIx64,
+          _name.c_str(),
+          rtask->get_request()->header->from_address.to_string(),
+          rtask->get_request()->header->trace_id);
+
+    task->release_ref(); // added in task::enqueue(pool)
+    return false;
+}
+
 void task_queue::enqueue_internal(task *task)
 {
     auto &sp = task->spec();
+    if (_controller != nullptr && sp.type == TASK_TYPE_RPC_REQUEST && !admit(task))
+        return;
+
     auto throttle_mode = sp.rpc_request_throttling_mode;
     if (throttle_mode != TM_NONE) {
         int ac_value = 0;
@@ -83,7 +137,10 @@ void task_queue::enqueue_internal(task *task)
                 sp.rpc_request_delayer.delay(ac_value, _spec->queue_length_throttling_threshold);
             if (delay_ms > 0) {
                 auto rtask = static_cast<rpc_request_task *>(task);
-                rtask->get_request()->io_session->delay_recv(delay_ms);
+                // requests delivered within the process have no session to delay
+                auto &session = rtask->get_request()->io_session;
+                if (session != nullptr)
+                    session->delay_recv(delay_ms);
 
                 dwarn("too many pending tasks (%d), delay traffic from %s for %d milliseconds",
                       ac_value,
@@ -110,7 +167,43 @@ void task_queue::enqueue_internal(task *task)
         }
     }
 
+    if (_node_remote_enqueue_counter) {
+        int node = utils::numa_current_node();
+        if (node >= 0 && node != _numa_node)
+            _node_remote_enqueue_counter->increment();
+    }
+
     tls_dsn.last_worker_queue_size = increase_count();
     enqueue(task);
 }
+
+void task_queue::enqueue_internal_batch(task **tasks, int count)
+{
+    // throttling and admission control work on each single task
+    for (int i = 0; i < count; i++) {
+        if (tasks[i]->spec().rpc_request_throttling_mode != TM_NONE ||
+            (_controller != nullptr && tasks[i]->spec().type == TASK_TYPE_RPC_REQUEST)) {
+            for (int j = 0; j < count; j++) {
+                enqueue_internal(tasks[j]);
+            }
+            return;
+        }
+    }
+
+    if (_node_remote_enqueue_counter) {
+        int node = utils::numa_current_node();
+        if (node >= 0 && node != _numa_node)
+            _node_remote_enqueue_counter->add(count);
+    }
+
+    tls_dsn.last_worker_queue_size = increase_count(count);
+    enqueue_batch(tasks, count);
+}
+
+void task_queue::enqueue_batch(task **tasks, int count)
+{
+    for (int i = 0; i < count; i++) {
+        enqueue(tasks[i]);
+    }
+}
 }
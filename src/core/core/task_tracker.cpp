@@ -36,21 +36,140 @@
 #include <dsn/tool-api/task_tracker.h>
 #include <dsn/tool-api/task.h>
 #include <dsn/tool_api.h>
+#include "task_engine.h"
+#include <thread>
 
 namespace dsn {
 
-task_tracker::task_tracker(int task_bucket_count) : _task_bucket_count(task_bucket_count)
+// one bucket per worker of the current node, or per cpu when it is unknown
+static int default_task_bucket_count()
 {
-    _outstanding_tasks_lock = new ::dsn::utils::ex_lock_nr_spin[_task_bucket_count];
-    _outstanding_tasks = new dlink[_task_bucket_count];
+    int count = 0;
+    service_node *node = task::get_current_node2();
+    if (node != nullptr && node->computation() != nullptr) {
+        for (task_worker_pool *pool : node->computation()->pools()) {
+            if (pool != nullptr)
+                count += pool->worker_count();
+        }
+    }
+    if (count == 0)
+        count = static_cast<int>(std::thread::hardware_concurrency());
+
+    // a tracker is usually owned by an object with many peers, e.g., a replica
+    return std::max(1, std::min(count, 64));
+}
+
+task_tracker::task_tracker(int task_bucket_count)
+    : _task_bucket_count(task_bucket_count > 0 ? task_bucket_count : default_task_bucket_count())
+{
+    // new does not align to the cache lines before c++17
+    _shards_memory = new char[sizeof(shard) * _task_bucket_count + CACHELINE_SIZE];
+    _shards = reinterpret_cast<shard *>(
+        (reinterpret_cast<uintptr_t>(_shards_memory) + CACHELINE_SIZE - 1) &
+        ~static_cast<uintptr_t>(CACHELINE_SIZE - 1));
+    for (int i = 0; i < _task_bucket_count; i++) {
+        new (&_shards[i]) shard();
+        _shards[i].head.store(nullptr, std::memory_order_relaxed);
+        _shards[i].pushed_count.store(0, std::memory_order_relaxed);
+        _shards[i].kept_count.store(0, std::memory_order_relaxed);
+        _shards[i].tracked_count.store(0, std::memory_order_relaxed);
+        _shards[i].finished_count.store(0, std::memory_order_relaxed);
+    }
 }
 
 task_tracker::~task_tracker()
 {
     cancel_outstanding_tasks();
 
-    delete[] _outstanding_tasks;
-    delete[] _outstanding_tasks_lock;
+    for (int i = 0; i < _task_bucket_count; i++) {
+        _shards[i].~shard();
+    }
+    delete[] _shards_memory;
+}
+
+task_tracker::shard &task_tracker::current_shard()
+{
+    return _shards[::dsn::utils::get_current_tid() % _task_bucket_count];
+}
+
+void task_tracker::on_finished()
+{
+    current_shard().finished_count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void task_tracker::track(tracked_task_node *node)
+{
+    shard &s = current_shard();
+    s.tracked_count.fetch_add(1, std::memory_order_relaxed);
+
+    node->next = s.head.load(std::memory_order_relaxed);
+    while (!s.head.compare_exchange_weak(
+        node->next, node, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+
+    // the detached nodes are swept once there are more new ones than the ones kept
+    // by last sweep, so that each tracking pays O(1) for sweeping in average; the count
+    // is not exact with concurrent tracking, which is fine for that
+    int pushed_count = s.pushed_count.load(std::memory_order_relaxed) + 1;
+    s.pushed_count.store(pushed_count, std::memory_order_relaxed);
+    if (pushed_count > s.kept_count.load(std::memory_order_relaxed) + 64 &&
+        s.sweep_lock.try_lock()) {
+        sweep(s);
+        s.sweep_lock.unlock();
+    }
+}
+
+// under sweep_lock
+void task_tracker::sweep(shard &s)
+{
+    tracked_task_node *n = s.head.exchange(nullptr, std::memory_order_acquire);
+    tracked_task_node *kept_head = nullptr;
+    tracked_task_node *kept_tail = nullptr;
+    int kept_count = 0;
+    while (n != nullptr) {
+        tracked_task_node *next = n->next;
+        if (n->state.load(std::memory_order_acquire) == tracked_task_node::TASK_DETACHED) {
+            tls_pool_free(n);
+        } else {
+            if (kept_tail == nullptr)
+                kept_head = n;
+            else
+                kept_tail->next = n;
+            kept_tail = n;
+            kept_count++;
+        }
+        n = next;
+    }
+
+    s.pushed_count.store(0, std::memory_order_relaxed);
+    s.kept_count.store(kept_count, std::memory_order_relaxed);
+
+    // put back the kept ones, after the ones tracked during the sweep
+    if (kept_head != nullptr) {
+        kept_tail->next = s.head.load(std::memory_order_relaxed);
+        while (!s.head.compare_exchange_weak(
+            kept_tail->next, kept_head, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+}
+
+tracked_task_node *task_tracker::take_all(shard &s)
+{
+    // wait for the ongoing sweep, which may put some nodes back
+    utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(s.sweep_lock);
+    s.pushed_count.store(0, std::memory_order_relaxed);
+    s.kept_count.store(0, std::memory_order_relaxed);
+    return s.head.exchange(nullptr, std::memory_order_acquire);
+}
+
+int task_tracker::outstanding_task_count()
+{
+    int count = 0;
+    for (int i = 0; i < _task_bucket_count; i++) {
+        count += _shards[i].tracked_count.load(std::memory_order_relaxed);
+        count -= _shards[i].finished_count.load(std::memory_order_relaxed);
+    }
+    return count;
 }
 
 // TODO:
@@ -72,101 +191,82 @@ struct tls_tracker_hack
 
 static __thread tls_tracker_hack s_hack;
 
-void task_tracker::wait_outstanding_tasks()
+template <typename TOperation>
+void task_tracker::walk_outstanding_tasks(TOperation op)
 {
     for (int i = 0; i < _task_bucket_count; i++) {
-        while (true) {
-            trackable_task::owner_delete_state prepare_state;
-            trackable_task *tcm;
-
-            {
-                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_outstanding_tasks_lock[i]);
-                auto n = _outstanding_tasks[i].next();
-                if (n != &_outstanding_tasks[i]) {
-                    tcm = CONTAINING_RECORD(n, trackable_task, _dl);
-
-                    // try to get the lock
-                    prepare_state = tcm->owner_delete_prepare();
-                } else
-                    break; // assuming nobody is putting tasks into it anymore
-            }
+        shard &s = _shards[i];
 
-            switch (prepare_state) {
-            // tracker get the lock
-            case trackable_task::OWNER_DELETE_NOT_LOCKED:
-                if (s_hack.under_simulation()) {
-                    task *tsk = tcm->_task;
-                    tsk->add_ref(); // released after delete commit
-                    tcm->owner_delete_commit();
+        // assuming nobody is putting tasks into it anymore
+        tracked_task_node *n;
+        while ((n = take_all(s)) != nullptr) {
+            while (n != nullptr) {
+                tracked_task_node *next = n->next;
 
-                    tsk->wait();        // wait outside the delete spin lock
-                    tsk->release_ref(); // added before delete commit
+                int state = tracked_task_node::TASK_ALIVE;
+                if (n->state.compare_exchange_strong(
+                        state, tracked_task_node::TRACKER_LOCKED, std::memory_order_acquire)) {
+                    // the task can not finish until TRACKER_DONE, and then frees the node
+                    task *tsk = n->tsk;
+                    if (s_hack.under_simulation()) {
+                        tsk->add_ref(); // released after TRACKER_DONE
+                        n->state.store(tracked_task_node::TRACKER_DONE,
+                                       std::memory_order_release);
+
+                        op(tsk); // outside the spinning of the task
+                        tsk->release_ref();
+                    } else {
+                        op(tsk);
+                        n->state.store(tracked_task_node::TRACKER_DONE,
+                                       std::memory_order_release);
+                    }
+
+                    // the task no longer counts itself when it finishes
+                    on_finished();
                 } else {
-                    tcm->_task->wait();
-                    tcm->owner_delete_commit();
+                    // the task is finished, wait for it to finish counting
+                    while (n->state.load(std::memory_order_acquire) ==
+                           tracked_task_node::TASK_DETACHING) {
+                    }
+                    tls_pool_free(n);
                 }
-                break;
-            case trackable_task::OWNER_DELETE_LOCKED:
-            case trackable_task::OWNER_DELETE_FINISHED:
-                break;
+                n = next;
             }
         }
     }
 }
 
-void task_tracker::cancel_outstanding_tasks()
+void task_tracker::wait_outstanding_tasks()
 {
-    for (int i = 0; i < _task_bucket_count; i++) {
-        while (true) {
-            trackable_task::owner_delete_state prepare_state;
-            trackable_task *tcm;
-
-            {
-                utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_outstanding_tasks_lock[i]);
-                auto n = _outstanding_tasks[i].next();
-                if (n != &_outstanding_tasks[i]) {
-                    tcm = CONTAINING_RECORD(n, trackable_task, _dl);
-                    prepare_state = tcm->owner_delete_prepare();
-                } else
-                    break; // assuming nobody is putting tasks into it anymore
-            }
-
-            switch (prepare_state) {
-            case trackable_task::OWNER_DELETE_NOT_LOCKED:
-                if (s_hack.under_simulation()) {
-                    task *tsk = tcm->_task;
-                    tsk->add_ref(); // released after delete commit
-                    tcm->owner_delete_commit();
+    walk_outstanding_tasks([](task *tsk) { tsk->wait(); });
+}
 
-                    tsk->cancel(true);  // cancel outside the delete spin lock
-                    tsk->release_ref(); // added before delete commit
-                } else {
-                    tcm->_task->cancel(true);
-                    tcm->owner_delete_commit();
-                }
-                break;
-            case trackable_task::OWNER_DELETE_LOCKED:
-            case trackable_task::OWNER_DELETE_FINISHED:
-                break;
-            }
-        }
-    }
+void task_tracker::cancel_outstanding_tasks()
+{
+    walk_outstanding_tasks([](task *tsk) { tsk->cancel(true); });
 }
 
 int task_tracker::cancel_but_not_wait_outstanding_tasks()
 {
     int not_finished = 0;
     for (int i = 0; i < _task_bucket_count; i++) {
-        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_outstanding_tasks_lock[i]);
-        auto n = _outstanding_tasks[i].next();
-        if (n != &_outstanding_tasks[i]) {
-            trackable_task *tcm = CONTAINING_RECORD(n, trackable_task, _dl);
-            if (tcm->_task != task::get_current_task()) {
+        shard &s = _shards[i];
+
+        // the nodes are neither swept nor taken meanwhile
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(s.sweep_lock);
+        for (auto n = s.head.load(std::memory_order_acquire); n != nullptr; n = n->next) {
+            int state = tracked_task_node::TASK_ALIVE;
+            if (!n->state.compare_exchange_strong(
+                    state, tracked_task_node::TRACKER_LOCKED, std::memory_order_acquire))
+                continue;
+
+            if (n->tsk != task::get_current_task()) {
                 bool finished;
-                tcm->_task->cancel(false, &finished);
+                n->tsk->cancel(false, &finished);
                 if (!finished)
                     not_finished++;
             }
+            n->state.store(tracked_task_node::TASK_ALIVE, std::memory_order_release);
         }
     }
     return not_finished;
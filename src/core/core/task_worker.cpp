@@ -35,6 +35,7 @@
 
 #include <dsn/tool-api/task_worker.h>
 #include "task_engine.h"
+#include <dsn/utility/numa.h>
 #include <sstream>
 #include <errno.h>
 
@@ -66,12 +67,14 @@ task_worker::task_worker(task_worker_pool *pool,
     _owner_pool = pool;
     _input_queue = q;
     _index = index;
+    _numa_node = pool->worker_numa_node(index);
     _native_tid = ::dsn::utils::get_invalid_tid();
 
     char name[256];
     sprintf(name, "%5s.%s.%u", pool->node()->full_name(), pool->spec().name.c_str(), index);
     _name = std::string(name);
     _is_running = false;
+    _is_exited = false;
 
     _thread = nullptr;
     _processed_task_count = 0;
@@ -81,7 +84,7 @@ task_worker::~task_worker() { stop(); }
 
 void task_worker::start()
 {
-    if (_is_running)
+    if (_is_running || _thread != nullptr)
         return;
 
     _is_running = true;
@@ -93,7 +96,8 @@ void task_worker::start()
 
 void task_worker::stop()
 {
-    if (!_is_running)
+    // a retired worker is no longer running but its thread is still to be joined
+    if (_thread == nullptr)
         return;
 
     _is_running = false;
@@ -101,10 +105,10 @@ void task_worker::stop()
     _thread->join();
     delete _thread;
     _thread = nullptr;
-
-    _is_running = false;
 }
 
+void task_worker::retire() { _is_running = false; }
+
 void task_worker::set_name(const char *name)
 {
 #ifdef _WIN32
@@ -272,22 +276,47 @@ void task_worker::run_internal()
     set_name(name().c_str());
     set_priority(pool_spec().worker_priority);
 
+    // a numa-aware worker only runs on the cores of its node, and is
+    // ordered by its index among the workers on the same node
+    uint64_t affinity_mask = pool_spec().worker_affinity_mask;
+    int affinity_index = _index;
+    if (_numa_node >= 0) {
+        utils::numa_set_thread_node(_numa_node);
+
+        uint64_t node_mask = utils::numa_node_cpu_mask(_numa_node);
+        if ((affinity_mask & node_mask) != 0 || affinity_mask == 0) {
+            affinity_mask = (affinity_mask == 0 ? node_mask : (affinity_mask & node_mask));
+        } else {
+            dwarn("worker_affinity_mask of %s has no core on numa node %d, use all cores of "
+                  "the node instead",
+                  pool_spec().name.c_str(),
+                  _numa_node);
+            affinity_mask = node_mask;
+        }
+
+        affinity_index = 0;
+        for (int i = 0; i < _index; ++i) {
+            if (_owner_pool->worker_numa_node(i) == _numa_node)
+                ++affinity_index;
+        }
+    }
+
     if (true == pool_spec().worker_share_core) {
-        if (pool_spec().worker_affinity_mask > 0) {
-            set_affinity(pool_spec().worker_affinity_mask);
+        if (affinity_mask > 0) {
+            set_affinity(affinity_mask);
         }
     } else {
-        uint64_t current_mask = pool_spec().worker_affinity_mask;
+        uint64_t current_mask = affinity_mask;
         if (0 == current_mask) {
             derror("mask for %s is set to 0x0, mostly due to that #core > 64, set to 64 now",
                    pool_spec().name.c_str());
 
             current_mask = ~((uint64_t)0);
         }
-        for (int i = 0; i < _index; ++i) {
+        for (int i = 0; i < affinity_index; ++i) {
             current_mask &= (current_mask - 1);
             if (0 == current_mask) {
-                current_mask = pool_spec().worker_affinity_mask;
+                current_mask = affinity_mask;
             }
         }
         current_mask -= (current_mask & (current_mask - 1));
@@ -300,15 +329,56 @@ void task_worker::run_internal()
     on_start.execute(this);
 
     loop();
+
+    _is_exited = true;
+}
+
+static inline void cpu_relax()
+{
+#if defined(_WIN32)
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+bool task_worker::idle_wait(task_queue *q)
+{
+    const threadpool_spec &spec = pool_spec();
+
+    uint64_t start_ns = dsn_now_ns();
+    int i = 0;
+    for (; i < spec.idle_spin_count && q->is_empty(); i++) {
+        cpu_relax();
+    }
+    uint64_t spin_end_ns = dsn_now_ns();
+    _owner_pool->idle_spin_time_counter()->add(spin_end_ns - start_ns);
+    if (i < spec.idle_spin_count)
+        return true;
+
+    for (i = 0; i < spec.idle_yield_count && q->is_empty(); i++) {
+        std::this_thread::yield();
+    }
+    _owner_pool->idle_yield_time_counter()->add(dsn_now_ns() - spin_end_ns);
+    return i < spec.idle_yield_count;
 }
 
 void task_worker::loop()
 {
     task_queue *q = queue();
+    admission_controller *controller = q->controller();
     int best_batch_size = pool_spec().dequeue_batch_size;
+    bool adaptive_idle = (pool_spec().idle_spin_count > 0 || pool_spec().idle_yield_count > 0);
 
     // try {
     while (_is_running) {
+        // when the queue is empty, spin and yield for a while before
+        // parking in dequeue, to save the wake-up cost under moderate load;
+        // the parked time is accounted by the queue around its blocking wait
+        if (adaptive_idle && q->is_empty()) {
+            idle_wait(q);
+        }
+
         int batch_size = best_batch_size;
         task *task = q->dequeue(batch_size), *next;
 
@@ -317,9 +387,28 @@ void task_worker::loop()
 #ifndef NDEBUG
         int count = 0;
 #endif
+        uint64_t now_ns = 0;
         while (task != nullptr) {
             next = task->next;
             task->next = nullptr;
+
+            // drop the expired requests cheaply before running them,
+            // with the clock read at most once per batch
+            if (task->spec().type == TASK_TYPE_RPC_REQUEST) {
+                auto rtask = static_cast<rpc_request_task *>(task);
+                bool drop_check = rtask->need_drop_check();
+                if (drop_check || controller != nullptr) {
+                    if (now_ns == 0)
+                        now_ns = dsn_now_ns();
+                    if (controller != nullptr && rtask->enqueue_ts_ns() != 0) {
+                        controller->on_task_dequeued(
+                            rtask, now_ns - std::min(now_ns, rtask->enqueue_ts_ns()), now_ns);
+                    }
+                    if (drop_check)
+                        rtask->drop_if_expired(now_ns);
+                }
+            }
+
             task->exec_internal();
             task = next;
 #ifndef NDEBUG
@@ -334,7 +423,10 @@ void task_worker::loop()
                 batch_size);
 #endif
 
-        _processed_task_count += batch_size;
+        // only written by this worker, so no need for an atomic add
+        _processed_task_count.store(
+            _processed_task_count.load(std::memory_order_relaxed) + batch_size,
+            std::memory_order_relaxed);
     }
     /*}
     catch (std::exception& ex)
@@ -36,6 +36,7 @@
 #include <cassert>
 #include <memory>
 #include <dsn/utility/utils.h>
+#include <dsn/utility/numa.h>
 #include <dsn/utility/transient_memory.h>
 
 namespace dsn {
@@ -59,7 +60,8 @@ void tls_trans_mem_alloc(size_t min_size)
     tls_trans_memory.remain_bytes =
         (min_size > tls_trans_mem_default_block_bytes ? min_size
                                                       : tls_trans_mem_default_block_bytes);
-    *tls_trans_memory.block = ::dsn::utils::make_shared_array<char>(tls_trans_memory.remain_bytes);
+    // node-local when current thread is bound to a numa node
+    *tls_trans_memory.block = ::dsn::utils::numa_local_shared_array(tls_trans_memory.remain_bytes);
     tls_trans_memory.next = tls_trans_memory.block->get();
 }
 
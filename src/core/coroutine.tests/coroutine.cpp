@@ -0,0 +1,197 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Unit-test for the c++20 coroutine awaitables.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <dsn/cpp/coroutine.h>
+#include <dsn/tool-api/task_worker.h>
+#include <dsn/utility/synchronize.h>
+#include <gtest/gtest.h>
+#include <cstring>
+#include <iostream>
+#include "test_utils.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+DEFINE_TASK_CODE(LPC_TEST_CORO, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+DEFINE_TASK_CODE_AIO(LPC_TEST_CORO_AIO, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+
+static coro::async enqueue_and_sleep(task_tracker *tracker,
+                                     std::vector<task_worker *> *workers,
+                                     utils::notify_event *done)
+{
+    co_await coro::enqueue(LPC_TEST_CORO, tracker, 1);
+    workers->push_back(task::get_current_worker());
+
+    co_await coro::sleep_for(LPC_TEST_CORO, tracker, std::chrono::milliseconds(100), 1);
+    workers->push_back(task::get_current_worker());
+
+    done->notify();
+}
+
+TEST(coroutine, enqueue)
+{
+    task_tracker tracker;
+    std::vector<task_worker *> workers;
+    utils::notify_event done;
+
+    uint64_t start_ms = dsn_now_ms();
+    enqueue_and_sleep(&tracker, &workers, &done);
+    done.wait();
+    ASSERT_LE(start_ms + 100, dsn_now_ms());
+    tracker.wait_outstanding_tasks();
+
+    // resumed on the worker of the partitioned pool selected by the hash both times
+    ASSERT_EQ(2u, workers.size());
+    ASSERT_NE(nullptr, workers[0]);
+    ASSERT_EQ(workers[0], workers[1]);
+    ASSERT_EQ(THREAD_POOL_TEST_SERVER, workers[0]->pool_spec().pool_code);
+}
+
+static coro::async echo(rpc_address server,
+                        std::string request,
+                        task_tracker *tracker,
+                        std::pair<error_code, std::string> *result,
+                        utils::notify_event *done)
+{
+    *result = co_await coro::call<std::string>(
+        server, RPC_TEST_CORO_ECHO, request, tracker, std::chrono::milliseconds(1000));
+    done->notify();
+}
+
+TEST(coroutine, rpc_call)
+{
+    task_tracker tracker;
+
+    {
+        std::pair<error_code, std::string> result;
+        utils::notify_event done;
+        echo(rpc_address("localhost", 20311), "hello coroutine", &tracker, &result, &done);
+        done.wait();
+        ASSERT_EQ(ERR_OK, result.first);
+        ASSERT_EQ("hello coroutine", result.second);
+    }
+
+    // nobody listens on the port
+    {
+        std::pair<error_code, std::string> result;
+        utils::notify_event done;
+        echo(rpc_address("localhost", 20312), "hello coroutine", &tracker, &result, &done);
+        done.wait();
+        ASSERT_NE(ERR_OK, result.first);
+        ASSERT_TRUE(result.second.empty());
+    }
+
+    tracker.wait_outstanding_tasks();
+}
+
+static coro::async write_and_read(dsn_handle_t fh,
+                                  const char *data,
+                                  char *buffer,
+                                  int len,
+                                  task_tracker *tracker,
+                                  std::pair<error_code, size_t> *write_result,
+                                  std::pair<error_code, size_t> *read_result,
+                                  utils::notify_event *done)
+{
+    *write_result = co_await coro::write(fh, data, len, 0, LPC_TEST_CORO_AIO, tracker, 1);
+    if (write_result->first == ERR_OK) {
+        *read_result = co_await coro::read(fh, buffer, len, 0, LPC_TEST_CORO_AIO, tracker, 1);
+    }
+    done->notify();
+}
+
+TEST(coroutine, file_read)
+{
+    if (task::get_current_disk() == nullptr)
+        return;
+
+    const char *data = "hello, coroutine";
+    int len = (int)strlen(data);
+    char buffer[64] = {0};
+
+    dsn_handle_t fh = dsn_file_open("coroutine.test.file", O_RDWR | O_CREAT | O_BINARY, 0666);
+    ASSERT_NE(nullptr, fh);
+
+    task_tracker tracker;
+    std::pair<error_code, size_t> write_result(ERR_UNKNOWN, 0), read_result(ERR_UNKNOWN, 0);
+    utils::notify_event done;
+    write_and_read(fh, data, buffer, len, &tracker, &write_result, &read_result, &done);
+    done.wait();
+    tracker.wait_outstanding_tasks();
+
+    ASSERT_EQ(ERR_OK, write_result.first);
+    ASSERT_EQ((size_t)len, write_result.second);
+    ASSERT_EQ(ERR_OK, read_result.first);
+    ASSERT_EQ((size_t)len, read_result.second);
+    ASSERT_EQ(0, memcmp(data, buffer, len));
+
+    ASSERT_EQ(ERR_OK, dsn_file_close(fh));
+}
+
+struct destroy_flag
+{
+    bool *destroyed;
+    ~destroy_flag() { *destroyed = true; }
+};
+
+static coro::async sleep_long(task_tracker *tracker, bool *resumed, bool *destroyed)
+{
+    destroy_flag flag{destroyed};
+    co_await coro::sleep_for(LPC_TEST_CORO, tracker, std::chrono::milliseconds(10000), 1);
+    *resumed = true;
+}
+
+TEST(coroutine, cancel)
+{
+    bool resumed = false;
+    bool destroyed = false;
+    task_tracker tracker;
+
+    sleep_long(&tracker, &resumed, &destroyed);
+    ASSERT_FALSE(destroyed);
+
+    // the frame is destroyed with the released callback, and never resumed
+    tracker.cancel_outstanding_tasks();
+    ASSERT_TRUE(destroyed);
+    ASSERT_FALSE(resumed);
+}
+
+#else
+
+TEST(coroutine, not_supported)
+{
+    std::cout << "c++20 coroutines are not supported by the compiler, skipped" << std::endl;
+}
+
+#endif
@@ -0,0 +1,16 @@
+#!/bin/bash
+
+if [ -z "${REPORT_DIR}" ]; then
+    REPORT_DIR="."
+fi
+
+rm -rf core* log.* data coroutine.test.file
+GTEST_OUTPUT="xml:${REPORT_DIR}/dsn.core.coroutine.tests.xml" ./dsn.core.coroutine.tests config-test.ini
+if [ $? -ne 0 ]; then
+    echo "run dsn.core.coroutine.tests failed"
+    if find . -name log.1.txt; then
+        echo "---- tail -n 100 log.1.txt ----"
+        tail -n 100 `find . -name log.1.txt`
+    fi
+    exit 1
+fi
@@ -0,0 +1,80 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     test app of the coroutine tests
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include <dsn/service_api_cpp.h>
+#include <gtest/gtest.h>
+
+using namespace ::dsn;
+
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_TEST_SERVER)
+DEFINE_TASK_CODE_RPC(RPC_TEST_CORO_ECHO, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+
+extern int g_test_count;
+extern int g_test_ret;
+
+class test_client : public ::dsn::serverlet<test_client>, public ::dsn::service_app
+{
+public:
+    test_client(const service_app_info *info)
+        : ::dsn::serverlet<test_client>("test-server"), ::dsn::service_app(info)
+    {
+    }
+
+    void on_echo(const std::string &request, ::dsn::rpc_replier<std::string> &replier)
+    {
+        replier(request);
+    }
+
+    ::dsn::error_code start(const std::vector<std::string> &args)
+    {
+        // server
+        if (args.size() == 1) {
+            register_async_rpc_handler(
+                RPC_TEST_CORO_ECHO, "rpc.test.coro.echo", &test_client::on_echo);
+        }
+
+        // client
+        else {
+            g_test_ret = RUN_ALL_TESTS();
+            g_test_count++;
+        }
+
+        return ::dsn::ERR_OK;
+    }
+
+    ::dsn::error_code stop(bool cleanup = false) { return ERR_OK; }
+};
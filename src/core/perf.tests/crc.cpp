@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Performance test of the crc implementations across buffer sizes
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <dsn/utility/crc.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace ::dsn::utils;
+
+template <typename T>
+static double crc_perf_test(T (*calc)(crc_impl_type, const void *, size_t, T),
+                            crc_impl_type type,
+                            const std::vector<char> &buffer,
+                            size_t size)
+{
+    // 256MB for each case
+    size_t total_bytes = 256 * 1024 * 1024;
+    T crc = 0;
+    std::chrono::steady_clock clock;
+    auto tic = clock.now();
+    for (size_t bytes = 0; bytes < total_bytes; bytes += size) {
+        crc = calc(type, buffer.data(), size, crc);
+    }
+    auto toc = clock.now();
+    auto time_us = std::chrono::duration_cast<std::chrono::microseconds>(toc - tic).count();
+    return time_us == 0 ? 0.0 : (double)total_bytes / time_us;
+}
+
+TEST(core, crc_perf_test)
+{
+    std::vector<char> buffer(1024 * 1024);
+    for (size_t i = 0; i < buffer.size(); i++) {
+        buffer[i] = (char)(i * 7919);
+    }
+
+    for (size_t size : {16, 64, 256, 1024, 4096, 65536, 1024 * 1024}) {
+        for (int t = 0; t < CRC_IMPL_COUNT; t++) {
+            auto type = (crc_impl_type)t;
+            if (!crc_impl_supported(type))
+                continue;
+            std::cout << "crc perf test: size = " << size << ", crc32 (" << crc32_impl_name(type)
+                      << ") = " << crc_perf_test<uint32_t>(crc32_calc_with, type, buffer, size)
+                      << "MB/sec, crc64 (" << crc64_impl_name(type)
+                      << ") = " << crc_perf_test<uint64_t>(crc64_calc_with, type, buffer, size)
+                      << "MB/sec" << std::endl;
+        }
+    }
+}
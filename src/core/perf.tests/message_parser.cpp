@@ -0,0 +1,130 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Performance test of the message headers, v1 VS compact
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <dsn/tool-api/rpc_message.h>
+#include <gtest/gtest.h>
+#include "dsn_message_parser.h"
+#include "test_utils.h"
+#include <chrono>
+#include <iostream>
+
+// send 'msg' through 'from' and receive it with 'to' in memory, return the bytes on the wire
+static size_t transfer(message_parser &from,
+                       message_parser &to,
+                       message_ex *msg,
+                       message_reader &reader,
+                       std::vector<message_parser::send_buf> &buffers,
+                       /*out*/ message_ex *&received)
+{
+    from.prepare_on_send(msg);
+    buffers.resize(from.get_buffer_count_on_send(msg));
+    int count = from.get_buffers_on_send(msg, buffers.data());
+
+    size_t bytes = 0;
+    for (int i = 0; i < count; i++) {
+        char *ptr = reader.read_buffer_ptr((unsigned int)buffers[i].sz);
+        memcpy(ptr, buffers[i].buf, buffers[i].sz);
+        reader.mark_read((unsigned int)buffers[i].sz);
+        bytes += buffers[i].sz;
+    }
+    from.on_buffers_sent();
+
+    int read_next;
+    received = to.get_message_on_receive(&reader, read_next);
+    return bytes;
+}
+
+static void message_header_perf_test(const char *name, bool compact_header, bool crc)
+{
+    task_spec::get(RPC_TEST_HASH)->rpc_message_crc_required = crc;
+    task_spec::get(RPC_TEST_HASH_ACK)->rpc_message_crc_required = crc;
+
+    dsn_message_parser client(compact_header), server(compact_header);
+    message_reader client_reader(65536), server_reader(65536);
+    std::vector<message_parser::send_buf> buffers;
+    const char body[] = "0123456789abcdef";
+
+    size_t total_rpc_count = 1000000;
+    size_t total_bytes = 0;
+    std::chrono::steady_clock clock;
+    auto tic = clock.now();
+    for (size_t i = 0; i < total_rpc_count; i++) {
+        message_ex *request = message_ex::create_request(RPC_TEST_HASH, 0, 0, i);
+        request->header->trace_id = i + 1;
+        request->write_append(blob(body, 0, sizeof(body)));
+        request->add_ref();
+
+        message_ex *received;
+        total_bytes += transfer(client, server, request, server_reader, buffers, received);
+        ASSERT_NE(nullptr, received);
+        received->add_ref();
+        received->rpc_code(); // resolved by rpc_engine on receive
+
+        message_ex *response = received->create_response();
+        response->header->server.error_code.local_code = ERR_OK;
+        response->header->server.error_code.local_hash = message_ex::s_local_hash;
+        strncpy(response->header->server.error_name,
+                ERR_OK.to_string(),
+                sizeof(response->header->server.error_name));
+        response->write_append(blob(body, 0, sizeof(body)));
+        response->add_ref();
+
+        message_ex *reply;
+        total_bytes += transfer(server, client, response, client_reader, buffers, reply);
+        ASSERT_NE(nullptr, reply);
+        reply->add_ref();
+
+        reply->release_ref();
+        response->release_ref();
+        received->release_ref();
+        request->release_ref();
+    }
+    auto toc = clock.now();
+    auto time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(toc - tic).count();
+    std::cout << "message header perf test (" << name << (crc ? ", crc" : "")
+              << "): bytes per rpc = " << total_bytes / total_rpc_count
+              << ", cpu per rpc = " << time_ns / total_rpc_count << "ns" << std::endl;
+}
+
+TEST(core, message_header_perf_test)
+{
+    message_header_perf_test("v1", false, false);
+    message_header_perf_test("compact", true, false);
+    message_header_perf_test("v1", false, true);
+    message_header_perf_test("compact", true, true);
+
+    task_spec::get(RPC_TEST_HASH)->rpc_message_crc_required = false;
+    task_spec::get(RPC_TEST_HASH_ACK)->rpc_message_crc_required = false;
+}
@@ -38,10 +38,8 @@
 #include "test_utils.h"
 #include <boost/lexical_cast.hpp>
 
-TEST(core, rpc_perf_test)
+static void rpc_perf_test(const char *provider, rpc_address localhost)
 {
-    rpc_address localhost("localhost", 20101);
-
     rpc_read_stream response;
     std::mutex lock;
     for (auto concurrency : {10, 100, 1000, 10000}) {
@@ -71,12 +69,37 @@ TEST(core, rpc_perf_test)
         }
         auto toc = clock.now();
         auto time_us = std::chrono::duration_cast<std::chrono::microseconds>(toc - tic).count();
-        std::cout << "rpc perf test: concurrency = " << concurrency
+        std::cout << "rpc perf test (" << provider << "): concurrency = " << concurrency
                   << " throughput = " << total_query_count * 1000000llu / time_us << "call/sec"
                   << std::endl;
     }
 }
 
+TEST(core, rpc_perf_test)
+{
+    rpc_perf_test("hpc_network_provider", rpc_address("localhost", 20101));
+}
+
+// server_io_uring in config-test.ini serves with io_uring_network_provider, which
+// falls back to hpc_network_provider when io_uring is not usable
+TEST(core, rpc_perf_test_io_uring)
+{
+    rpc_perf_test("io_uring_network_provider", rpc_address("localhost", 20102));
+}
+
+// server_reuseport in config-test.ini accepts on 4 listeners sharing the port
+TEST(core, rpc_perf_test_reuseport)
+{
+    rpc_perf_test("hpc_network_provider (4 listeners)", rpc_address("localhost", 20103));
+}
+
+// server_shm in config-test.ini serves with shm_network_provider, and so does the
+// client connect, so the calls go through the shared memory rings
+TEST(core, rpc_perf_test_shm)
+{
+    rpc_perf_test("shm_network_provider", rpc_address("localhost", 20104));
+}
+
 TEST(core, rpc_perf_test_sync)
 {
     rpc_address localhost("localhost", 20101);
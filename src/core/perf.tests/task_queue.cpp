@@ -50,6 +50,18 @@ DEFINE_THREAD_POOL_CODE(THREAD_POOL_TEST_TASK_QUEUE_2)
 DEFINE_TASK_CODE(LPC_TEST_TASK_QUEUE_1, TASK_PRIORITY_HIGH, THREAD_POOL_TEST_TASK_QUEUE_1)
 DEFINE_TASK_CODE(LPC_TEST_TASK_QUEUE_2, TASK_PRIORITY_HIGH, THREAD_POOL_TEST_TASK_QUEUE_2)
 
+// worker = 1, for comparing the queue providers
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_TEST_HPC_TASK_QUEUE)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_TEST_HPC_TASK_PRIORITY_QUEUE)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_TEST_HPC_MPSC_TASK_QUEUE)
+DEFINE_TASK_CODE(LPC_TEST_HPC_TASK_QUEUE, TASK_PRIORITY_HIGH, THREAD_POOL_TEST_HPC_TASK_QUEUE)
+DEFINE_TASK_CODE(LPC_TEST_HPC_TASK_PRIORITY_QUEUE,
+                 TASK_PRIORITY_HIGH,
+                 THREAD_POOL_TEST_HPC_TASK_PRIORITY_QUEUE)
+DEFINE_TASK_CODE(LPC_TEST_HPC_MPSC_TASK_QUEUE,
+                 TASK_PRIORITY_HIGH,
+                 THREAD_POOL_TEST_HPC_MPSC_TASK_QUEUE)
+
 struct auto_timer
 {
     std::string prefix;
@@ -102,15 +114,15 @@ void iterate_over_preallocated_tasks(void *ctx)
     }
 }
 
-void external_flooding(const int enqueue_time)
+void external_flooding(const int enqueue_time, task_code code = LPC_TEST_TASK_QUEUE_1)
 {
     std::vector<raw_task *> tsks;
     for (int i = 0; i < enqueue_time; i++) {
-        auto tsk = new raw_task(LPC_TEST_TASK_QUEUE_1, empty_cb);
+        auto tsk = new raw_task(code, empty_cb);
         tsks.push_back(tsk);
     }
     {
-        auto_timer t("inter-thread flooding test:", enqueue_time);
+        auto_timer t(std::string(code.to_string()) + " inter-thread flooding test:", enqueue_time);
         for (auto tsk : tsks) {
             if (tsk == tsks.back()) {
                 tsk->add_ref();
@@ -122,16 +134,16 @@ void external_flooding(const int enqueue_time)
     }
 }
 
-void self_flooding(const int enqueue_time)
+void self_flooding(const int enqueue_time, task_code code = LPC_TEST_TASK_QUEUE_1)
 {
     std::vector<raw_task *> tsks;
     for (int i = 0; i < enqueue_time; i++) {
-        auto tsk = new raw_task(LPC_TEST_TASK_QUEUE_1, empty_cb);
+        auto tsk = new raw_task(code, empty_cb);
         tsks.push_back(tsk);
     }
     {
-        auto_timer t("self-flooding test:", enqueue_time);
-        tasking::enqueue(LPC_TEST_TASK_QUEUE_1, nullptr, [&]() {
+        auto_timer t(std::string(code.to_string()) + " self-flooding test:", enqueue_time);
+        tasking::enqueue(code, nullptr, [&]() {
             for (auto tsk : tsks) {
                 if (tsk == tsks.back()) {
                     tsk->add_ref();
@@ -144,15 +156,15 @@ void self_flooding(const int enqueue_time)
         tsks.back()->release_ref();
     }
 }
-void external_blocking(const int enqueue_time)
+void external_blocking(const int enqueue_time, task_code code = LPC_TEST_TASK_QUEUE_1)
 {
     std::vector<raw_task *> tsks;
     for (int i = 0; i < enqueue_time; i++) {
-        auto tsk = new raw_task(LPC_TEST_TASK_QUEUE_1, empty_cb);
+        auto tsk = new raw_task(code, empty_cb);
         tsks.push_back(tsk);
     }
     {
-        auto_timer t("inter-thread blocking test:", enqueue_time);
+        auto_timer t(std::string(code.to_string()) + " inter-thread blocking test:", enqueue_time);
         for (auto tsk : tsks) {
             tsk->add_ref();
             tsk->enqueue();
@@ -161,17 +173,16 @@ void external_blocking(const int enqueue_time)
         }
     }
 }
-void self_iterating(const int enqueue_time)
+void self_iterating(const int enqueue_time, task_code code = LPC_TEST_TASK_QUEUE_1)
 {
     self_iterate_context ctx;
     for (int i = 0; i < enqueue_time; i++) {
-        auto tsk = new raw_task(LPC_TEST_TASK_QUEUE_1,
-                                [&ctx]() { iterate_over_preallocated_tasks(&ctx); });
+        auto tsk = new raw_task(code, [&ctx]() { iterate_over_preallocated_tasks(&ctx); });
         ctx.tsks.push_back(tsk);
     }
     ctx.it = ctx.tsks.begin();
     {
-        auto_timer t("self-iterating test:", enqueue_time);
+        auto_timer t(std::string(code.to_string()) + " self-iterating test:", enqueue_time);
         iterate_over_preallocated_tasks(&ctx);
         std::unique_lock<std::mutex> _lk(ctx.mut);
         ctx.cv.wait(_lk, [&] { return ctx.done; });
@@ -202,3 +213,17 @@ TEST(core, task_queue_perf_test)
     self_iterating(enqueue_time);
     tic_tock_iterating(enqueue_time / 10);
 }
+
+TEST(core, task_queue_provider_perf_test)
+{
+    // compare the queue providers usable by partitioned pools (one consumer per queue),
+    // see [threadpool.THREAD_POOL_TEST_HPC_*] in config-test.ini
+    const int enqueue_time = 1000000;
+    for (auto code :
+         {LPC_TEST_HPC_TASK_QUEUE, LPC_TEST_HPC_TASK_PRIORITY_QUEUE, LPC_TEST_HPC_MPSC_TASK_QUEUE}) {
+        external_flooding(enqueue_time, code);
+        self_flooding(enqueue_time, code);
+        external_blocking(enqueue_time / 10, code);
+        self_iterating(enqueue_time, code);
+    }
+}
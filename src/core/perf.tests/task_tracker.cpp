@@ -0,0 +1,150 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     task tracker performance test
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <dsn/tool-api/task_tracker.h>
+#include <dsn/utility/link.h>
+#include <dsn/utility/utils.h>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+
+using namespace ::dsn;
+
+// the previous tracker, which links the tasks into the buckets guarded by spin locks
+class locked_task_tracker
+{
+public:
+    struct tracked
+    {
+        dlink dl;
+        int bucket_id;
+    };
+
+    explicit locked_task_tracker(int bucket_count)
+        : _bucket_count(bucket_count),
+          _locks(new utils::ex_lock_nr_spin[bucket_count]),
+          _tasks(new dlink[bucket_count])
+    {
+    }
+    ~locked_task_tracker()
+    {
+        delete[] _tasks;
+        delete[] _locks;
+    }
+
+    void track(tracked *t)
+    {
+        t->bucket_id = static_cast<int>(utils::get_current_tid() % _bucket_count);
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_locks[t->bucket_id]);
+        t->dl.insert_after(&_tasks[t->bucket_id]);
+    }
+
+    void untrack(tracked *t)
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_locks[t->bucket_id]);
+        t->dl.remove();
+    }
+
+private:
+    int _bucket_count;
+    utils::ex_lock_nr_spin *_locks;
+    dlink *_tasks;
+};
+
+// each thread tracks a window of tasks, and finishes the oldest one when tracking a new one,
+// as the tasks created by the replicas are usually short-lived
+template <typename TTracked, typename TTrack, typename TUntrack>
+void run_tracker_perf_test(const std::string &name,
+                           int thread_count,
+                           TTrack track,
+                           TUntrack untrack)
+{
+    const int task_count_per_thread = 1000000;
+    const int window = 64;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; t++) {
+        threads.emplace_back([&]() {
+            std::vector<TTracked> tasks(window);
+            for (int i = 0; i < task_count_per_thread; i++) {
+                TTracked &tsk = tasks[i % window];
+                if (i >= window)
+                    untrack(tsk);
+                track(tsk);
+            }
+            for (int i = 0; i < window; i++) {
+                untrack(tasks[i]);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+    std::cout << name << " with " << thread_count << " threads: throughput = "
+              << static_cast<uint64_t>(task_count_per_thread) * thread_count * 1000000 /
+                     std::max(us, (decltype(us))1)
+              << " tasks/s" << std::endl;
+}
+
+TEST(core, task_tracker_perf_test)
+{
+    for (int bucket_count : {1, 13}) {
+        for (int thread_count : {1, 4, 8}) {
+            std::string suffix = " (" + std::to_string(bucket_count) + " buckets)";
+
+            locked_task_tracker locked(bucket_count);
+            run_tracker_perf_test<locked_task_tracker::tracked>(
+                "locked_task_tracker" + suffix,
+                thread_count,
+                [&](locked_task_tracker::tracked &t) { locked.track(&t); },
+                [&](locked_task_tracker::tracked &t) { locked.untrack(&t); });
+
+            task_tracker tracker(bucket_count);
+            run_tracker_perf_test<trackable_task>(
+                "task_tracker" + suffix,
+                thread_count,
+                [&](trackable_task &t) { t.set_tracker(&tracker, nullptr); },
+                [&](trackable_task &t) { t.unset_tracker(); });
+            ASSERT_EQ(0, tracker.outstanding_task_count());
+        }
+    }
+}
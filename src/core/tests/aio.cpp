@@ -157,6 +157,51 @@ TEST(core, aio_share)
     utils::filesystem::remove_path("tmp");
 }
 
+TEST(core, aio_sync)
+{
+    // if in dsn_mimic_app() and disk_io_mode == IOE_PER_QUEUE
+    if (task::get_current_disk() == nullptr)
+        return;
+
+    const char *buffer = "hello, world";
+    int len = (int)strlen(buffer);
+
+    auto fp = dsn_file_open("tmp", O_RDWR | O_CREAT | O_BINARY, 0666);
+    EXPECT_TRUE(fp != nullptr);
+
+    // writes synced before completion, possibly batched with the plain ones
+    std::list<aio_task_ptr> tasks;
+    uint64_t offset = 0;
+    for (int i = 0; i < 100; i++) {
+        auto t = ::dsn::file::write(
+            fp, buffer, len, offset, LPC_AIO_TEST, nullptr, nullptr, 0, i % 10 == 9);
+        tasks.push_back(t);
+        offset += len;
+    }
+
+    for (auto &t : tasks) {
+        t->wait();
+        EXPECT_TRUE(t->error() == ERR_OK);
+        EXPECT_TRUE(t->get_transferred_size() == (size_t)len);
+    }
+
+    // standalone sync
+    auto t = ::dsn::file::flush(fp, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    EXPECT_TRUE(t->error() == ERR_OK);
+
+    char *buffer2 = (char *)alloca((size_t)len);
+    t = ::dsn::file::read(fp, buffer2, len, offset - len, LPC_AIO_TEST, nullptr, nullptr);
+    t->wait();
+    EXPECT_TRUE(t->get_transferred_size() == (size_t)len);
+    EXPECT_TRUE(memcmp(buffer, buffer2, len) == 0);
+
+    auto err = dsn_file_close(fp);
+    EXPECT_TRUE(err == ERR_OK);
+
+    utils::filesystem::remove_path("tmp");
+}
+
 TEST(core, operation_failed)
 {
     // if in dsn_mimic_app() and disk_io_mode == IOE_PER_QUEUE
@@ -0,0 +1,86 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ */
+
+/*
+ * Description:
+ *     Unit-test for codel_admission_controller.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <gtest/gtest.h>
+#include <dsn/service_api_cpp.h>
+#include "../core/task_engine.h"
+#include "../tools/common/codel_admission_controller.h"
+#include "test_utils.h"
+
+using namespace ::dsn;
+
+TEST(core, codel_admission_controller)
+{
+    task_queue *q =
+        task::get_current_node2()->computation()->get_pool(THREAD_POOL_DEFAULT)->queues()[0];
+    std::vector<std::string> args = {"5", "100"};
+    tools::codel_admission_controller controller(q, args);
+
+    const uint64_t ms = 1000000;
+    uint64_t start = 1000 * ms;
+
+    ASSERT_TRUE(controller.is_accepted(start));
+
+    // a burst drained within the interval is not an overload
+    controller.on_task_dequeued(nullptr, 50 * ms, start + 10 * ms);
+    controller.on_task_dequeued(nullptr, 1 * ms, start + 20 * ms);
+    controller.on_task_dequeued(nullptr, 50 * ms, start + 100 * ms);
+    ASSERT_FALSE(controller.is_dropping());
+    ASSERT_TRUE(controller.is_accepted(start + 100 * ms));
+
+    // a standing queue is, once it has stayed above the target for the interval
+    controller.on_task_dequeued(nullptr, 20 * ms, start + 120 * ms);
+    controller.on_task_dequeued(nullptr, 20 * ms, start + 199 * ms);
+    ASSERT_FALSE(controller.is_dropping());
+    controller.on_task_dequeued(nullptr, 20 * ms, start + 200 * ms);
+    ASSERT_TRUE(controller.is_dropping());
+
+    // one request is dropped at once, then the next ones are spaced at interval / sqrt(count)
+    uint64_t now = start + 201 * ms;
+    ASSERT_FALSE(controller.is_accepted(now));
+    ASSERT_TRUE(controller.is_accepted(now + 99 * ms));
+    ASSERT_FALSE(controller.is_accepted(now + 100 * ms));
+    now += 100 * ms;
+    ASSERT_TRUE(controller.is_accepted(now + 70 * ms));  // 100 / sqrt(2) = 70.7
+    ASSERT_FALSE(controller.is_accepted(now + 71 * ms));
+    now += 71 * ms;
+    ASSERT_TRUE(controller.is_accepted(now + 57 * ms));  // 100 / sqrt(3) = 57.7
+    ASSERT_FALSE(controller.is_accepted(now + 58 * ms));
+    now += 58 * ms;
+
+    // still above the target, keep dropping
+    controller.on_task_dequeued(nullptr, 10 * ms, now);
+    ASSERT_TRUE(controller.is_dropping());
+
+    // below the target, leave the dropping state at once
+    controller.on_task_dequeued(nullptr, 1 * ms, now + 1 * ms);
+    ASSERT_FALSE(controller.is_dropping());
+    ASSERT_TRUE(controller.is_accepted(now + 200 * ms));
+
+    // re-entering soon resumes from about the drop rate reached (count = 3 - 1), so the
+    // first drop at once and the next one after 100 / sqrt(2)
+    now += 10 * ms;
+    controller.on_task_dequeued(nullptr, 10 * ms, now);
+    controller.on_task_dequeued(nullptr, 10 * ms, now + 100 * ms);
+    ASSERT_TRUE(controller.is_dropping());
+    now += 100 * ms;
+    ASSERT_FALSE(controller.is_accepted(now));
+    ASSERT_TRUE(controller.is_accepted(now + 70 * ms));
+    ASSERT_FALSE(controller.is_accepted(now + 71 * ms));
+
+    controller.on_task_dequeued(nullptr, 1 * ms, now + 60 * ms);
+    ASSERT_FALSE(controller.is_dropping());
+}
@@ -0,0 +1,600 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Unit-test for the compact message header of dsn_message_parser.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <dsn/utility/crc.h>
+#include <dsn/tool-api/rpc_message.h>
+#include <gtest/gtest.h>
+#include "dsn_message_parser.h"
+#include "recv_buffer_pool.h"
+#include <thread>
+
+using namespace ::dsn;
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_COMPACT_HEADER, TASK_PRIORITY_COMMON, ::dsn::THREAD_POOL_DEFAULT)
+
+// send 'msg' with 'from' into 'reader' byte by byte, and receive it with 'to'
+static message_ex *transfer(message_parser &from,
+                            message_parser &to,
+                            message_ex *msg,
+                            message_reader &reader,
+                            /*out*/ size_t &wire_size)
+{
+    from.prepare_on_send(msg);
+    std::vector<message_parser::send_buf> buffers(from.get_buffer_count_on_send(msg));
+    int count = from.get_buffers_on_send(msg, buffers.data());
+
+    message_ex *received = nullptr;
+    int read_next;
+    wire_size = 0;
+    for (int i = 0; i < count; i++) {
+        for (size_t j = 0; j < buffers[i].sz; j++) {
+            EXPECT_EQ(nullptr, received);
+            char *ptr = reader.read_buffer_ptr(1);
+            *ptr = static_cast<char *>(buffers[i].buf)[j];
+            reader.mark_read(1);
+            received = to.get_message_on_receive(&reader, read_next);
+            EXPECT_NE(-1, read_next);
+        }
+        wire_size += buffers[i].sz;
+    }
+    from.on_buffers_sent();
+
+    EXPECT_NE(nullptr, received);
+    if (received != nullptr) {
+        received->add_ref();
+        received->rpc_code();
+    }
+    return received;
+}
+
+static message_ex *create_request(const char *body)
+{
+    message_ex *request = message_ex::create_request(RPC_TEST_COMPACT_HEADER, 100, 1, 2);
+    request->header->trace_id = 123456;
+    request->header->gpid = gpid(2, 3);
+    request->header->from_address = rpc_address("127.0.0.1", 8080);
+    request->write_append(blob(body, 0, (unsigned int)strlen(body)));
+    request->add_ref();
+    return request;
+}
+
+static message_ex *create_request(const std::string &body1, const std::string &body2)
+{
+    message_ex *request = message_ex::create_request(RPC_TEST_COMPACT_HEADER, 100, 1, 2);
+    request->write_append(blob(body1.data(), 0, (unsigned int)body1.length()));
+    request->write_append(blob(body2.data(), 0, (unsigned int)body2.length()));
+    request->add_ref();
+    return request;
+}
+
+static message_ex *create_response(message_ex *request, error_code err, const char *body)
+{
+    message_ex *response = request->create_response();
+    strncpy(response->header->server.error_name,
+            err.to_string(),
+            sizeof(response->header->server.error_name));
+    response->header->server.error_code.local_code = err;
+    response->header->server.error_code.local_hash = message_ex::s_local_hash;
+    response->write_append(blob(body, 0, (unsigned int)strlen(body)));
+    response->add_ref();
+    return response;
+}
+
+static void check_body(message_ex *msg, const char *body)
+{
+    blob bb;
+    ASSERT_TRUE(msg->read_next(bb));
+    ASSERT_EQ(std::string(body), std::string(bb.data(), bb.length()));
+}
+
+static std::string make_body(size_t size)
+{
+    std::string body;
+    while (body.size() < size)
+        body += "mutation " + std::to_string(body.size() % 97) + "; ";
+    body.resize(size);
+    return body;
+}
+
+TEST(core, dsn_message_parser_compact_header)
+{
+    dsn_message_parser client(true), server(true);
+    message_reader client_reader(4096), server_reader(4096);
+    size_t request_size = 0, response_size = 0, last_request_size, last_response_size;
+
+    for (int round = 0; round < 4; round++) {
+        last_request_size = request_size;
+        last_response_size = response_size;
+
+        message_ex *request = create_request("hello");
+        message_ex *received = transfer(client, server, request, server_reader, request_size);
+        ASSERT_NE(nullptr, received);
+        if (round == 0) {
+            // the peer is unknown yet, so v1 is sent to announce we can receive compact headers
+            ASSERT_EQ(sizeof(message_header) + 5, request_size);
+            ASSERT_EQ(DSN_MSG_HDR_VERSION_V1_COMPACT_READY,
+                      request->header->hdr_version & DSN_MSG_HDR_VERSION_MASK);
+        } else {
+            ASSERT_LT(request_size, sizeof(message_header) / 2);
+        }
+        // the names are announced only once on a session
+        if (round >= 3) {
+            ASSERT_EQ(last_request_size, request_size);
+        }
+
+        ASSERT_TRUE(server.is_peer_compact_ready());
+        ASSERT_EQ(RPC_TEST_COMPACT_HEADER, received->rpc_code());
+        ASSERT_STREQ(request->header->rpc_name, received->header->rpc_name);
+        ASSERT_EQ(request->header->id, received->header->id);
+        ASSERT_EQ(123456u, received->header->trace_id);
+        ASSERT_EQ(gpid(2, 3), received->header->gpid);
+        ASSERT_EQ(request->header->context.context, received->header->context.context);
+        ASSERT_EQ(rpc_address("127.0.0.1", 8080), received->header->from_address);
+        ASSERT_EQ(100, received->header->client.timeout_ms);
+        ASSERT_EQ(1, received->header->client.thread_hash);
+        ASSERT_EQ(2u, received->header->client.partition_hash);
+        check_body(received, "hello");
+
+        message_ex *response = create_response(received, ERR_TIMEOUT, "world!");
+        message_ex *reply = transfer(server, client, response, client_reader, response_size);
+        ASSERT_NE(nullptr, reply);
+        ASSERT_LT(response_size, sizeof(message_header) / 2);
+        if (round >= 2) {
+            ASSERT_EQ(last_response_size, response_size);
+        }
+
+        ASSERT_TRUE(client.is_peer_compact_ready());
+        ASSERT_EQ(RPC_TEST_COMPACT_HEADER_ACK, reply->rpc_code());
+        ASSERT_EQ(request->header->id, reply->header->id);
+        ASSERT_EQ(ERR_TIMEOUT, reply->error());
+        ASSERT_STREQ(ERR_TIMEOUT.to_string(), reply->header->server.error_name);
+        check_body(reply, "world!");
+
+        reply->release_ref();
+        response->release_ref();
+        received->release_ref();
+        request->release_ref();
+    }
+}
+
+TEST(core, dsn_message_parser_v1_peer)
+{
+    dsn_message_parser client(false), server(true);
+    message_reader client_reader(4096), server_reader(4096);
+    size_t wire_size;
+
+    for (int round = 0; round < 2; round++) {
+        message_ex *request = create_request("hello");
+        message_ex *received = transfer(client, server, request, server_reader, wire_size);
+        ASSERT_NE(nullptr, received);
+        ASSERT_EQ(DSN_MSG_HDR_VERSION_V1, received->header->hdr_version & DSN_MSG_HDR_VERSION_MASK);
+        ASSERT_FALSE(server.is_peer_compact_ready());
+
+        // v1 is always sent to the peer not able to receive compact headers
+        message_ex *response = create_response(received, ERR_OK, "world!");
+        message_ex *reply = transfer(server, client, response, client_reader, wire_size);
+        ASSERT_NE(nullptr, reply);
+        ASSERT_EQ(sizeof(message_header) + 6, wire_size);
+        ASSERT_EQ(ERR_OK, reply->error());
+        check_body(reply, "world!");
+
+        reply->release_ref();
+        response->release_ref();
+        received->release_ref();
+        request->release_ref();
+    }
+}
+
+TEST(core, dsn_message_parser_corrupted_compact_header)
+{
+    dsn_message_parser client(true), server(true);
+    message_reader client_reader(4096), server_reader(4096);
+
+    task_spec::get(RPC_TEST_COMPACT_HEADER)->rpc_message_crc_required = true;
+
+    size_t wire_size;
+    message_ex *request = create_request("hello");
+    message_ex *received = transfer(client, server, request, server_reader, wire_size);
+    ASSERT_NE(nullptr, received);
+    message_ex *response = create_response(received, ERR_OK, "world!");
+    message_ex *reply = transfer(server, client, response, client_reader, wire_size);
+    ASSERT_NE(nullptr, reply);
+    ASSERT_TRUE(client.is_peer_compact_ready());
+
+    // a compact header with a bit flipped
+    message_ex *request2 = create_request("hello");
+    client.prepare_on_send(request2);
+    std::vector<message_parser::send_buf> buffers(client.get_buffer_count_on_send(request2));
+    int count = client.get_buffers_on_send(request2, buffers.data());
+    for (int i = 0; i < count; i++) {
+        char *ptr = server_reader.read_buffer_ptr((unsigned int)buffers[i].sz);
+        memcpy(ptr, buffers[i].buf, buffers[i].sz);
+        server_reader.mark_read((unsigned int)buffers[i].sz);
+    }
+    client.on_buffers_sent();
+    ASSERT_LT(buffers[0].sz, sizeof(message_header));
+    const_cast<char *>(server_reader._buffer.data())[buffers[0].sz - 1] ^= 0x1;
+
+    int read_next;
+    ASSERT_EQ(nullptr, server.get_message_on_receive(&server_reader, read_next));
+    ASSERT_EQ(-1, read_next);
+
+    task_spec::get(RPC_TEST_COMPACT_HEADER)->rpc_message_crc_required = false;
+
+    request2->release_ref();
+    reply->release_ref();
+    response->release_ref();
+    received->release_ref();
+    request->release_ref();
+}
+
+TEST(core, dsn_message_parser_deferred_header_crc)
+{
+    dsn_message_parser client(true), server(true), v1_client(false), v1_server(false);
+    message_reader client_reader(4096), server_reader(4096), v1_server_reader(4096);
+
+    task_spec::get(RPC_TEST_COMPACT_HEADER)->rpc_message_crc_required = true;
+
+    size_t wire_size;
+    message_ex *request = create_request("hello");
+    message_ex *received = transfer(client, server, request, server_reader, wire_size);
+    ASSERT_NE(nullptr, received);
+    message_ex *response = create_response(received, ERR_OK, "world!");
+    message_ex *reply = transfer(server, client, response, client_reader, wire_size);
+    ASSERT_NE(nullptr, reply);
+    ASSERT_TRUE(client.is_peer_compact_ready());
+
+    // the v1 header crc is left to the compact header for a compact-ready peer, and is
+    // still computed when the v1 header is sent after all, e.g., as the message is resent
+    // to another peer without being prepared again
+    message_ex *request2 = create_request("hello");
+    client.prepare_on_send(request2);
+    std::vector<message_parser::send_buf> buffers(v1_client.get_buffer_count_on_send(request2));
+    int count = v1_client.get_buffers_on_send(request2, buffers.data());
+    ASSERT_EQ(sizeof(message_header), buffers[0].sz);
+    for (int i = 0; i < count; i++) {
+        char *ptr = v1_server_reader.read_buffer_ptr((unsigned int)buffers[i].sz);
+        memcpy(ptr, buffers[i].buf, buffers[i].sz);
+        v1_server_reader.mark_read((unsigned int)buffers[i].sz);
+    }
+    v1_client.on_buffers_sent();
+
+    int read_next;
+    message_ex *received2 = v1_server.get_message_on_receive(&v1_server_reader, read_next);
+    ASSERT_NE(nullptr, received2);
+    received2->add_ref();
+    check_body(received2, "hello");
+
+    task_spec::get(RPC_TEST_COMPACT_HEADER)->rpc_message_crc_required = false;
+
+    received2->release_ref();
+    request2->release_ref();
+    reply->release_ref();
+    response->release_ref();
+    received->release_ref();
+    request->release_ref();
+}
+
+#ifdef DSN_ENABLE_RPC_COMPRESSION
+TEST(core, dsn_message_parser_compression)
+{
+    task_spec *spec = task_spec::get(RPC_TEST_COMPACT_HEADER);
+    task_spec *ack_spec = task_spec::get(RPC_TEST_COMPACT_HEADER_ACK);
+    spec->rpc_message_compression = RPC_COMPRESSION_LZ4;
+    spec->rpc_message_compression_threshold = 1024;
+    ack_spec->rpc_message_compression = RPC_COMPRESSION_ZSTD;
+    ack_spec->rpc_message_compression_threshold = 1024;
+
+    std::string body1 = make_body(3000), body2 = make_body(5000);
+    for (bool compact : {false, true}) {
+        for (bool crc : {false, true}) {
+            dsn_message_parser client(compact), server(compact);
+            message_reader client_reader(4096), server_reader(4096);
+            spec->rpc_message_crc_required = crc;
+            ack_spec->rpc_message_crc_required = crc;
+
+            for (int round = 0; round < 3; round++) {
+                size_t wire_size;
+                message_ex *request = create_request(body1, body2);
+                message_ex *received = transfer(client, server, request, server_reader, wire_size);
+                ASSERT_NE(nullptr, received);
+                ASSERT_TRUE(server.is_peer_compression_ready());
+                if (round == 0) {
+                    // the peer is unknown yet, so the body is sent as it is
+                    ASSERT_EQ(sizeof(message_header) + 8000, wire_size);
+                } else {
+                    ASSERT_LT(wire_size, 2000u);
+                }
+                ASSERT_EQ(8000u, received->header->body_length);
+                ASSERT_EQ(0u, received->header->hdr_version & DSN_MSG_HDR_COMPRESSION_MASK);
+                ASSERT_EQ(request->header->id, received->header->id);
+                check_body(received, (body1 + body2).c_str());
+
+                // bodies smaller than the threshold are never compressed
+                message_ex *response = create_response(received, ERR_OK, "small");
+                message_ex *reply = transfer(server, client, response, client_reader, wire_size);
+                ASSERT_NE(nullptr, reply);
+                ASSERT_TRUE(client.is_peer_compression_ready());
+                ASSERT_EQ(ERR_OK, reply->error());
+                check_body(reply, "small");
+
+                message_ex *response2 = create_response(received, ERR_OK, body2.c_str());
+                message_ex *reply2 = transfer(server, client, response2, client_reader, wire_size);
+                ASSERT_NE(nullptr, reply2);
+                ASSERT_LT(wire_size, 1000u);
+                ASSERT_EQ(ERR_OK, reply2->error());
+                check_body(reply2, body2.c_str());
+
+                // the compressed body is reused when resending
+                message_ex *reply3 = transfer(server, client, response2, client_reader, wire_size);
+                ASSERT_NE(nullptr, reply3);
+                ASSERT_LT(wire_size, 1000u);
+                check_body(reply3, body2.c_str());
+
+                reply3->release_ref();
+                reply2->release_ref();
+                response2->release_ref();
+                reply->release_ref();
+                response->release_ref();
+                received->release_ref();
+                request->release_ref();
+            }
+        }
+    }
+
+    spec->rpc_message_compression = RPC_COMPRESSION_NONE;
+    spec->rpc_message_crc_required = false;
+    ack_spec->rpc_message_compression = RPC_COMPRESSION_NONE;
+    ack_spec->rpc_message_crc_required = false;
+}
+
+TEST(core, dsn_message_parser_corrupted_compressed_body)
+{
+    task_spec *spec = task_spec::get(RPC_TEST_COMPACT_HEADER);
+    spec->rpc_message_compression = RPC_COMPRESSION_LZ4;
+    spec->rpc_message_compression_threshold = 1024;
+
+    // the blobs of the requests refer to the strings
+    std::string body1 = make_body(1000), body2 = make_body(3000);
+    for (bool compact : {false, true}) {
+        dsn_message_parser client(compact), server(compact);
+        message_reader client_reader(4096), server_reader(4096);
+
+        size_t wire_size;
+        message_ex *request = create_request(body1, body2);
+        message_ex *received = transfer(client, server, request, server_reader, wire_size);
+        ASSERT_NE(nullptr, received);
+        message_ex *response = create_response(received, ERR_OK, "world!");
+        message_ex *reply = transfer(server, client, response, client_reader, wire_size);
+        ASSERT_NE(nullptr, reply);
+        ASSERT_TRUE(client.is_peer_compression_ready());
+
+        // a compressed body claiming a wrong raw length
+        message_ex *request2 = create_request(body1, body2);
+        client.prepare_on_send(request2);
+        std::vector<message_parser::send_buf> buffers(client.get_buffer_count_on_send(request2));
+        int count = client.get_buffers_on_send(request2, buffers.data());
+        ASSERT_EQ(2, count);
+        for (int i = 0; i < count; i++) {
+            char *ptr = server_reader.read_buffer_ptr((unsigned int)buffers[i].sz);
+            memcpy(ptr, buffers[i].buf, buffers[i].sz);
+            server_reader.mark_read((unsigned int)buffers[i].sz);
+        }
+        client.on_buffers_sent();
+        const_cast<char *>(server_reader._buffer.data())[buffers[0].sz] ^= 0x1;
+
+        int read_next;
+        ASSERT_EQ(nullptr, server.get_message_on_receive(&server_reader, read_next));
+        ASSERT_EQ(-1, read_next);
+
+        request2->release_ref();
+        reply->release_ref();
+        response->release_ref();
+        received->release_ref();
+        request->release_ref();
+    }
+
+    spec->rpc_message_compression = RPC_COMPRESSION_NONE;
+}
+#else
+TEST(core, dsn_message_parser_compression_disabled)
+{
+    task_spec *spec = task_spec::get(RPC_TEST_COMPACT_HEADER);
+    spec->rpc_message_compression = RPC_COMPRESSION_LZ4;
+    spec->rpc_message_compression_threshold = 1024;
+
+    // without ENABLE_RPC_COMPRESSION, the parser never announces it is able to decompress,
+    // so the bodies are always sent as they are
+    std::string body1 = make_body(3000), body2 = make_body(5000);
+    dsn_message_parser client, server;
+    message_reader server_reader(4096);
+    for (int round = 0; round < 2; round++) {
+        size_t wire_size;
+        message_ex *request = create_request(body1, body2);
+        message_ex *received = transfer(client, server, request, server_reader, wire_size);
+        ASSERT_NE(nullptr, received);
+        ASSERT_FALSE(server.is_peer_compression_ready());
+        ASSERT_EQ(sizeof(message_header) + 8000, wire_size);
+        check_body(received, (body1 + body2).c_str());
+        received->release_ref();
+        request->release_ref();
+    }
+
+    spec->rpc_message_compression = RPC_COMPRESSION_NONE;
+}
+#endif
+
+TEST(core, message_reader_pooled_buffers)
+{
+    ASSERT_EQ(4096u, recv_buffer_pool::capacity_of(1));
+    ASSERT_EQ(8192u, recv_buffer_pool::capacity_of(4097));
+    ASSERT_EQ(64u << 20, recv_buffer_pool::capacity_of(64u << 20));
+
+    // a released buffer is reused for the same size class
+    size_t capacity;
+    std::shared_ptr<char> buffer = recv_buffer_pool::instance().allocate(5000, capacity);
+    ASSERT_EQ(8192u, capacity);
+    char *released = buffer.get();
+    buffer.reset();
+    buffer = recv_buffer_pool::instance().allocate(6000, capacity);
+    ASSERT_EQ(released, buffer.get());
+    buffer.reset();
+
+    // a large message followed by a small one, received as a socket does
+    dsn_message_parser client, server;
+    message_reader reader(4096);
+    std::string body1 = make_body(100000);
+    message_ex *requests[] = {create_request(body1.c_str()), create_request("hello")};
+    std::string wire;
+    size_t first_size = 0;
+    for (message_ex *request : requests) {
+        client.prepare_on_send(request);
+        std::vector<message_parser::send_buf> buffers(client.get_buffer_count_on_send(request));
+        int count = client.get_buffers_on_send(request, buffers.data());
+        for (int i = 0; i < count; i++)
+            wire.append(static_cast<char *>(buffers[i].buf), buffers[i].sz);
+        client.on_buffers_sent();
+        if (first_size == 0)
+            first_size = wire.size();
+    }
+
+    std::vector<message_ex *> received;
+    size_t offset = 0;
+    int read_next = 20;
+    while (offset < wire.size()) {
+        char *ptr = reader.read_buffer_ptr((unsigned int)read_next);
+        size_t length = std::min((size_t)reader.read_buffer_capacity(), wire.size() - offset);
+        // the first read returns only the beginning of the header
+        if (offset == 0) {
+            length = 20;
+        }
+        memcpy(ptr, wire.data() + offset, length);
+        reader.mark_read((unsigned int)length);
+        offset += length;
+
+        message_ex *msg;
+        while ((msg = server.get_message_on_receive(&reader, read_next)) != nullptr) {
+            msg->add_ref();
+            received.push_back(msg);
+        }
+        ASSERT_NE(-1, read_next);
+
+        // the whole message is asked for once its body length is known
+        if (offset == 20) {
+            ASSERT_EQ(first_size - 20, (size_t)read_next);
+        }
+    }
+
+    ASSERT_EQ(2u, received.size());
+    check_body(received[0], body1.c_str());
+    check_body(received[1], "hello");
+
+    // both messages are read into the same buffer rounded up to its size class, without
+    // copying the bytes read before
+    ASSERT_EQ(received[0]->buffers[0].buffer(), received[1]->buffers[0].buffer());
+    ASSERT_EQ(received[0]->buffers[0].buffer(), reader._buffer.buffer());
+    const char *end = reader._buffer.data() + reader._buffer.length();
+    ASSERT_EQ(recv_buffer_pool::capacity_of(first_size),
+              (size_t)(end - reader._buffer.buffer().get()));
+
+    for (message_ex *msg : received)
+        msg->release_ref();
+    for (message_ex *request : requests)
+        request->release_ref();
+}
+
+TEST(core, recv_buffer_pool_trim_and_thread_exit)
+{
+    // the cached buffers are freed once not taken out over a whole trim interval
+    size_t capacity;
+    std::shared_ptr<char> buffer1 = recv_buffer_pool::instance().allocate(5000, capacity);
+    std::shared_ptr<char> buffer2 = recv_buffer_pool::instance().allocate(5000, capacity);
+    buffer1.reset();
+    buffer2.reset();
+    ASSERT_LE(2 * capacity, recv_buffer_pool::instance().cached_bytes());
+    recv_buffer_pool::trim_all();
+    recv_buffer_pool::trim_all();
+    ASSERT_EQ(0u, recv_buffer_pool::instance().cached_bytes());
+
+    // a buffer outlives the thread whose pool it is taken from
+    std::shared_ptr<char> buffer;
+    std::thread t([&buffer]() {
+        size_t capacity;
+        buffer = recv_buffer_pool::instance().allocate(5000, capacity);
+        std::shared_ptr<char> cached = recv_buffer_pool::instance().allocate(5000, capacity);
+        cached.reset();
+        ASSERT_EQ(capacity, recv_buffer_pool::instance().cached_bytes());
+    });
+    t.join();
+    memset(buffer.get(), 0, 5000);
+    buffer.reset();
+}
+
+TEST(core, dsn_message_parser_untrusted_body_length)
+{
+    dsn_message_parser client, server;
+    message_ex *request = create_request("hello");
+    client.prepare_on_send(request);
+    std::vector<message_parser::send_buf> buffers(client.get_buffer_count_on_send(request));
+    int count = client.get_buffers_on_send(request, buffers.data());
+    std::string wire;
+    for (int i = 0; i < count; i++)
+        wire.append(static_cast<char *>(buffers[i].buf), buffers[i].sz);
+    client.on_buffers_sent();
+
+    // a header checked by its crc, whose body length is then corrupted
+    message_header *header = reinterpret_cast<message_header *>(&wire[0]);
+    header->hdr_crc32 = CRC_INVALID;
+    header->hdr_crc32 = dsn::utils::crc32_calc(header, sizeof(message_header), 0);
+    uint32_t body_length = 0xfffffff0;
+    memcpy(&wire[FIELD_OFFSET(message_header, body_length)], &body_length, sizeof(uint32_t));
+
+    message_reader reader(4096);
+    int read_next;
+    char *ptr = reader.read_buffer_ptr(20);
+    memcpy(ptr, wire.data(), 20);
+    reader.mark_read(20);
+    ASSERT_EQ(nullptr, server.get_message_on_receive(&reader, read_next));
+    ASSERT_EQ(sizeof(message_header) - 20, (size_t)read_next);
+
+    // then the header check fails
+    ptr = reader.read_buffer_ptr((unsigned int)read_next);
+    memcpy(ptr, wire.data() + 20, read_next);
+    reader.mark_read((unsigned int)read_next);
+    ASSERT_EQ(nullptr, server.get_message_on_receive(&reader, read_next));
+    ASSERT_EQ(-1, read_next);
+
+    request->release_ref();
+}
@@ -0,0 +1,188 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Unit-test for the listeners of hpc network provider.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <gtest/gtest.h>
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/task.h>
+#include <dsn/tool-api/perf_counters.h>
+#include "../core/service_engine.h"
+#include "../core/rpc_engine.h"
+#include "../tools/hpc/hpc_network_provider.h"
+#include "test_utils.h"
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace ::dsn;
+using namespace ::dsn::tools;
+
+namespace {
+// listener_count is set by rpc_engine from the server network config
+class listener_network_provider : public hpc_network_provider
+{
+public:
+    listener_network_provider(int listener_count)
+        : hpc_network_provider(task::get_current_rpc(), nullptr)
+    {
+        _listener_count = listener_count;
+    }
+};
+
+int connect_to(int port)
+{
+    struct sockaddr_in addr;
+    memset((void *)&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s != -1 && connect(s, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(s);
+        s = -1;
+    }
+    return s;
+}
+
+int64_t total_sessions(const std::vector<perf_counter_ptr> &counters)
+{
+    int64_t total = 0;
+    for (auto &c : counters)
+        total += c->get_integer_value();
+    return total;
+}
+}
+
+TEST(tools_hpc, hpc_network_provider_listeners)
+{
+    if (dsn::service_engine::fast_instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    io_modifer modifier;
+    modifier.mode = IOE_PER_NODE;
+    modifier.queue = nullptr;
+
+    const int port = 20431;
+    const int listener_count = 4;
+    const int connection_count = 32;
+
+    auto server = new listener_network_provider(listener_count);
+    ASSERT_EQ(ERR_OK, server->start(RPC_CHANNEL_TCP, port, false, modifier));
+
+    std::vector<perf_counter_ptr> counters;
+    for (int i = 0; i < listener_count; i++) {
+        char name[128];
+        snprintf(name, sizeof(name), "%d.listener.%d.session.count", port, i);
+        counters.push_back(perf_counters::instance().get_global_counter(
+            server->node()->full_name(), "network", name, COUNTER_TYPE_NUMBER, "", false));
+        ASSERT_NE(nullptr, counters.back().get());
+        ASSERT_EQ(0, counters.back()->get_integer_value());
+    }
+
+    std::vector<int> clients;
+    for (int i = 0; i < connection_count; i++) {
+        int s = connect_to(port);
+        ASSERT_NE(-1, s);
+        clients.push_back(s);
+    }
+
+    for (int i = 0; i < 100 && total_sessions(counters) < connection_count; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(connection_count, total_sessions(counters));
+
+    // the kernel hashes the connections over the listeners, so they cannot all land on one
+    int busy_listeners = 0;
+    for (auto &c : counters) {
+        if (c->get_integer_value() > 0)
+            busy_listeners++;
+    }
+    ASSERT_LT(1, busy_listeners);
+
+    for (int s : clients)
+        close(s);
+    for (int i = 0; i < 100 && total_sessions(counters) > 0; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(0, total_sessions(counters));
+
+    // the port is released with the listeners
+    delete server;
+    server = new listener_network_provider(listener_count);
+    ASSERT_EQ(ERR_OK, server->start(RPC_CHANNEL_TCP, port, false, modifier));
+    int s = connect_to(port);
+    ASSERT_NE(-1, s);
+    close(s);
+    delete server;
+}
+
+TEST(tools_hpc, hpc_network_provider_listeners_failed)
+{
+    if (dsn::service_engine::fast_instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    io_modifer modifier;
+    modifier.mode = IOE_PER_NODE;
+    modifier.queue = nullptr;
+
+    // the port is taken by a socket not sharing it
+    const int port = 20432;
+    struct sockaddr_in addr;
+    memset((void *)&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    int blocker = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(-1, blocker);
+    ASSERT_EQ(0, bind(blocker, (struct sockaddr *)&addr, sizeof(addr)));
+    ASSERT_EQ(0, listen(blocker, 16));
+
+    auto server = new listener_network_provider(4);
+    ASSERT_EQ(ERR_NETWORK_START_FAILED, server->start(RPC_CHANNEL_TCP, port, false, modifier));
+    delete server;
+
+    // nothing is left bound to the port once the blocker is gone
+    close(blocker);
+    server = new listener_network_provider(4);
+    ASSERT_EQ(ERR_OK, server->start(RPC_CHANNEL_TCP, port, false, modifier));
+    delete server;
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Unit-test for http_message_parser.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <dsn/tool-api/rpc_message.h>
+#include <dsn/tool-api/perf_counters.h>
+#include <gtest/gtest.h>
+#include "http_message_parser.h"
+
+using namespace ::dsn;
+
+// feed 'data' into 'reader' and receive all the messages composed from it with 'parser'
+static std::vector<message_ex *>
+receive(http_message_parser &parser, message_reader &reader, const std::string &data)
+{
+    std::vector<message_ex *> received;
+    char *ptr = reader.read_buffer_ptr((unsigned int)data.size());
+    memcpy(ptr, data.data(), data.size());
+    reader.mark_read((unsigned int)data.size());
+
+    int read_next;
+    message_ex *msg;
+    while ((msg = parser.get_message_on_receive(&reader, read_next)) != nullptr) {
+        msg->add_ref();
+        received.push_back(msg);
+    }
+    EXPECT_NE(-1, read_next);
+    return received;
+}
+
+TEST(core, http_message_parser_get_metrics)
+{
+    http_message_parser parser;
+    message_reader reader(4096);
+
+    auto received = receive(parser, reader, "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ASSERT_EQ(1u, received.size());
+    ASSERT_STREQ(RPC_HTTP_METRICS.to_string(), received[0]->header->rpc_name);
+    ASSERT_EQ(0u, received[0]->header->body_length);
+    received[0]->release_ref();
+
+    received =
+        receive(parser, reader, "GET /metrics?name[]=xxx HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ASSERT_EQ(1u, received.size());
+    ASSERT_STREQ(RPC_HTTP_METRICS.to_string(), received[0]->header->rpc_name);
+    received[0]->release_ref();
+}
+
+TEST(core, http_message_parser_bodyless_rpc_request)
+{
+    http_message_parser parser;
+    message_reader reader(4096);
+
+    // the handler of a rpc url expects a request body, so bodyless requests are dropped
+    auto received = receive(
+        parser, reader, "GET /DSF_THRIFT_JSON/0/RPC_CLI_CLI_CALL HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    ASSERT_TRUE(received.empty());
+    received = receive(parser,
+                       reader,
+                       "OPTIONS /DSF_THRIFT_JSON/0/RPC_CLI_CLI_CALL HTTP/1.1\r\n"
+                       "Host: localhost\r\n"
+                       "Access-Control-Request-Method: POST\r\n\r\n");
+    ASSERT_TRUE(received.empty());
+
+    // while a request with body is still received on the same connection
+    received = receive(parser,
+                       reader,
+                       "POST /DSF_THRIFT_JSON/0/RPC_CLI_CLI_CALL HTTP/1.1\r\n"
+                       "Host: localhost\r\n"
+                       "Content-Length: 5\r\n\r\n"
+                       "hello");
+    ASSERT_EQ(1u, received.size());
+    ASSERT_STREQ("RPC_CLI_CLI_CALL", received[0]->header->rpc_name);
+    ASSERT_EQ(5u, received[0]->header->body_length);
+    received[0]->release_ref();
+}
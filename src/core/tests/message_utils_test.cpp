@@ -72,3 +72,109 @@ TEST(message_utils, complex_convertion)
     t_rpc rpc(msg);
     ASSERT_EQ(rpc.request().app_name, "haha");
 }
+
+// a thrift struct with a blob field, written as the thrift compiler generates it
+struct thrift_blob_holder
+{
+    int32_t code;
+    blob data;
+
+    uint32_t read(::apache::thrift::protocol::TProtocol *iprot)
+    {
+        uint32_t xfer = 0;
+        std::string fname;
+        ::apache::thrift::protocol::TType ftype;
+        int16_t fid;
+
+        xfer += iprot->readStructBegin(fname);
+        while (true) {
+            xfer += iprot->readFieldBegin(fname, ftype, fid);
+            if (ftype == ::apache::thrift::protocol::T_STOP)
+                break;
+            if (fid == 1 && ftype == ::apache::thrift::protocol::T_I32)
+                xfer += iprot->readI32(code);
+            else if (fid == 2 && ftype == ::apache::thrift::protocol::T_STRUCT)
+                xfer += data.read(iprot);
+            else
+                xfer += iprot->skip(ftype);
+            xfer += iprot->readFieldEnd();
+        }
+        xfer += iprot->readStructEnd();
+        return xfer;
+    }
+
+    uint32_t write(::apache::thrift::protocol::TProtocol *oprot) const
+    {
+        uint32_t xfer = 0;
+        xfer += oprot->writeStructBegin("thrift_blob_holder");
+        xfer += oprot->writeFieldBegin("code", ::apache::thrift::protocol::T_I32, 1);
+        xfer += oprot->writeI32(code);
+        xfer += oprot->writeFieldEnd();
+        xfer += oprot->writeFieldBegin("data", ::apache::thrift::protocol::T_STRUCT, 2);
+        xfer += data.write(oprot);
+        xfer += oprot->writeFieldEnd();
+        xfer += oprot->writeFieldStop();
+        xfer += oprot->writeStructEnd();
+        return xfer;
+    }
+};
+
+static blob marshall_blob_holder(const std::string &data)
+{
+    thrift_blob_holder holder;
+    holder.code = 1;
+    holder.data = blob(data.data(), 0, (unsigned int)data.size());
+
+    binary_writer writer;
+    marshall_thrift_binary(writer, holder);
+    return writer.get_buffer();
+}
+
+TEST(message_utils, thrift_blob_zero_copy)
+{
+    // a large blob field refers to the buffer being unmarshalled
+    std::string data(binary_reader_transport::BLOB_SLICE_MIN_SIZE, 'x');
+    blob buffer = marshall_blob_holder(data);
+    thrift_blob_holder received;
+    from_blob_to_thrift(buffer, received);
+    ASSERT_EQ(1, received.code);
+    ASSERT_EQ(data, received.data.to_string());
+    ASSERT_EQ(buffer.buffer(), received.data.buffer());
+    ASSERT_GE(received.data.data(), buffer.data());
+    ASSERT_LE(received.data.data() + received.data.length(), buffer.data() + buffer.length());
+
+    // a small one is copied, so that it does not keep the whole buffer
+    std::string small_data(binary_reader_transport::BLOB_SLICE_MIN_SIZE - 1, 'y');
+    blob small_buffer = marshall_blob_holder(small_data);
+    thrift_blob_holder small_received;
+    from_blob_to_thrift(small_buffer, small_received);
+    ASSERT_EQ(small_data, small_received.data.to_string());
+    ASSERT_NE(small_buffer.buffer(), small_received.data.buffer());
+
+    // a large one is also copied when it is a small part of the buffer, so that it does not
+    // keep the rest, while the field covering most of the buffer is still sliced
+    std::string part_data(binary_reader_transport::BLOB_SLICE_MIN_SIZE, 'p');
+    std::string most_data(binary_reader_transport::BLOB_SLICE_MIN_SIZE * 4, 'm');
+    thrift_blob_holder part_holder, most_holder;
+    part_holder.data = blob(part_data.data(), 0, (unsigned int)part_data.size());
+    most_holder.data = blob(most_data.data(), 0, (unsigned int)most_data.size());
+    binary_writer writer;
+    marshall_thrift_binary(writer, part_holder);
+    marshall_thrift_binary(writer, most_holder);
+    blob both_buffer = writer.get_buffer();
+    binary_reader reader(both_buffer);
+    thrift_blob_holder part_received, most_received;
+    unmarshall_thrift_binary(reader, part_received);
+    unmarshall_thrift_binary(reader, most_received);
+    ASSERT_EQ(part_data, part_received.data.to_string());
+    ASSERT_NE(both_buffer.buffer(), part_received.data.buffer());
+    ASSERT_EQ(most_data, most_received.data.to_string());
+    ASSERT_EQ(both_buffer.buffer(), most_received.data.buffer());
+
+    // a truncated blob field
+    thrift_blob_holder truncated;
+    ASSERT_THROW(from_blob_to_thrift(buffer.range(0, buffer.length() - 100), truncated),
+                 apache::thrift::transport::TTransportException);
+    ASSERT_THROW(from_blob_to_thrift(small_buffer.range(0, small_buffer.length() - 100), truncated),
+                 apache::thrift::transport::TTransportException);
+}
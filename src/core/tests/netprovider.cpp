@@ -43,6 +43,7 @@
 
 #include <dsn/tool-api/task.h>
 #include <dsn/tool-api/task_spec.h>
+#include <dsn/tool-api/perf_counters.h>
 
 #include "../tools/common/asio_net_provider.h"
 #include "../tools/common/network.sim.h"
@@ -234,3 +235,167 @@ TEST(tools_common, sim_net_provider)
 
     TEST_PORT++;
 }
+
+static message_ex *create_stripe_request(rpc_address addr, gpid pid, int thread_hash)
+{
+    message_ex *msg = message_ex::create_request(RPC_TEST_NETPROVIDER, 0, thread_hash);
+    msg->header->gpid = pid;
+    msg->to_address = addr;
+    ::dsn::marshall(msg, std::string("hello world"));
+    return msg;
+}
+
+static void stripe_send(connection_oriented_network *net, message_ex *msg)
+{
+    static char request_str[] = "hello world";
+    wait_flag = 0;
+    rpc_response_task *t = new rpc_response_task(msg,
+                                                 std::bind(&response_handler,
+                                                           std::placeholders::_1,
+                                                           std::placeholders::_2,
+                                                           std::placeholders::_3,
+                                                           request_str),
+                                                 0);
+    net->engine()->matcher()->on_call(msg, t);
+    net->send_message(msg);
+    wait_response();
+}
+
+static perf_counter_ptr get_stripe_counter(
+    network *net, rpc_address addr, int stripe, const char *name, dsn_perf_counter_type_t type)
+{
+    char full_name[128];
+    snprintf(
+        full_name, sizeof(full_name), "client.stripe.%s.%d.%s", addr.to_string(), stripe, name);
+    return perf_counters::instance().get_global_counter(
+        net->node()->full_name(), "network", full_name, type, "", false);
+}
+
+TEST(tools_common, asio_net_provider_stripe)
+{
+    if (dsn::service_engine::fast_instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    // client_stripe_count is set to 2 in config-test-stripe.ini
+    if (dsn_config_get_value_uint64("network", "client_stripe_count", 1, "") != 2)
+        return;
+
+    ASSERT_TRUE(dsn_rpc_register_handler(
+        RPC_TEST_NETPROVIDER, "rpc.test.netprovider", rpc_server_response));
+
+    io_modifer modifier;
+    modifier.mode = IOE_PER_NODE;
+    modifier.queue = nullptr;
+
+    asio_network_provider *server = new asio_network_provider(task::get_current_rpc(), nullptr);
+    ASSERT_EQ(ERR_OK, server->start(RPC_CHANNEL_TCP, TEST_PORT, false, modifier));
+    asio_network_provider *client = new asio_network_provider(task::get_current_rpc(), nullptr);
+    ASSERT_EQ(ERR_OK, client->start(RPC_CHANNEL_TCP, 0, true, modifier));
+    rpc_address addr("localhost", TEST_PORT);
+
+    // gpid takes precedence over the thread hash, and the same gpid or thread hash
+    // always goes to the same stripe
+    message_ex *msg = create_stripe_request(addr, gpid(1, 0), 2);
+    ASSERT_EQ(1, client->get_client_stripe(msg));
+    msg->header->gpid = gpid(1, 1);
+    ASSERT_EQ(0, client->get_client_stripe(msg));
+    msg->header->gpid = gpid();
+    ASSERT_EQ(0, client->get_client_stripe(msg));
+    msg->header->client.thread_hash = 3;
+    ASSERT_EQ(1, client->get_client_stripe(msg));
+    msg->add_ref();
+    msg->release_ref();
+
+    // each stripe gets its own session on its first request
+    ASSERT_EQ(nullptr, client->get_client_session(addr, 0).get());
+    ASSERT_EQ(nullptr,
+              get_stripe_counter(client, addr, 0, "session.count", COUNTER_TYPE_NUMBER).get());
+    stripe_send(client, create_stripe_request(addr, gpid(1, 1), 0));
+    rpc_session_ptr s0 = client->get_client_session(addr, 0);
+    ASSERT_NE(nullptr, s0.get());
+    ASSERT_EQ(nullptr, client->get_client_session(addr, 1).get());
+
+    // the counters of all the stripes to the remote address come with its first session
+    perf_counter_ptr session_count[2], send_qps[2];
+    for (int i = 0; i < 2; i++) {
+        session_count[i] =
+            get_stripe_counter(client, addr, i, "session.count", COUNTER_TYPE_NUMBER);
+        send_qps[i] = get_stripe_counter(client, addr, i, "send.qps", COUNTER_TYPE_RATE);
+        ASSERT_NE(nullptr, session_count[i].get());
+        ASSERT_NE(nullptr, send_qps[i].get());
+    }
+    ASSERT_EQ(1, session_count[0]->get_integer_value());
+    ASSERT_EQ(0, session_count[1]->get_integer_value());
+    ASSERT_EQ(1, send_qps[0]->get_total());
+    ASSERT_EQ(0, send_qps[1]->get_total());
+
+    // and are not shared with other remote addresses
+    rpc_address other_addr("localhost", TEST_PORT + 1);
+    ASSERT_EQ(
+        nullptr,
+        get_stripe_counter(client, other_addr, 0, "session.count", COUNTER_TYPE_NUMBER).get());
+
+    stripe_send(client, create_stripe_request(addr, gpid(1, 0), 0));
+    stripe_send(client, create_stripe_request(addr, gpid(), 3));
+    rpc_session_ptr s1 = client->get_client_session(addr, 1);
+    ASSERT_NE(nullptr, s1.get());
+    ASSERT_NE(s0.get(), s1.get());
+    ASSERT_EQ(s0.get(), client->get_client_session(addr, 0).get());
+
+    ASSERT_EQ(1, session_count[0]->get_integer_value());
+    ASSERT_EQ(1, session_count[1]->get_integer_value());
+    ASSERT_EQ(1, send_qps[0]->get_total());
+    ASSERT_EQ(2, send_qps[1]->get_total());
+
+    // a broken stripe is dropped alone, and reconnected by the next request to it
+    s0->close_on_fault_injection();
+    for (int i = 0; i < 100 && client->get_client_session(addr, 0) != nullptr; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    ASSERT_EQ(nullptr, client->get_client_session(addr, 0).get());
+    ASSERT_EQ(s1.get(), client->get_client_session(addr, 1).get());
+    ASSERT_EQ(0, session_count[0]->get_integer_value());
+    ASSERT_EQ(1, session_count[1]->get_integer_value());
+
+    stripe_send(client, create_stripe_request(addr, gpid(), 2));
+    rpc_session_ptr s0_new = client->get_client_session(addr, 0);
+    ASSERT_NE(nullptr, s0_new.get());
+    ASSERT_NE(s0.get(), s0_new.get());
+    ASSERT_EQ(s1.get(), client->get_client_session(addr, 1).get());
+    ASSERT_EQ(1, session_count[0]->get_integer_value());
+    ASSERT_EQ(2, send_qps[0]->get_total());
+    ASSERT_EQ(2, send_qps[1]->get_total());
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_NETPROVIDER));
+
+    TEST_PORT++;
+}
+
+TEST(tools_common, network_server_listener_count)
+{
+    // the sections are only in config-test.ini
+    std::vector<const char *> keys;
+    dsn_config_get_all_keys("core.test.listener", keys);
+    if (keys.empty())
+        return;
+
+    service_app_spec spec;
+    ASSERT_TRUE(spec.init("core.test.listener", "listener", nullptr, nullptr, nullptr));
+    ASSERT_EQ(2, spec.network_server_confs.size());
+
+    auto it = spec.network_server_confs.find(network_server_config(0, RPC_CHANNEL_TCP));
+    ASSERT_NE(spec.network_server_confs.end(), it);
+    ASSERT_EQ("dsn::tools::hpc_network_provider", it->second.factory_name);
+    ASSERT_EQ(65536, it->second.message_buffer_block_size);
+    ASSERT_EQ(4, it->second.listener_count);
+
+    // defaults to a single listener when omitted
+    it = spec.network_server_confs.find(network_server_config(0, RPC_CHANNEL_UDP));
+    ASSERT_NE(spec.network_server_confs.end(), it);
+    ASSERT_EQ(1, it->second.listener_count);
+
+    service_app_spec bad_spec;
+    ASSERT_FALSE(bad_spec.init("core.test.listener.zero", "listener", nullptr, nullptr, nullptr));
+    ASSERT_FALSE(bad_spec.init("core.test.listener.extra", "listener", nullptr, nullptr, nullptr));
+}
@@ -0,0 +1,137 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <dsn/utility/numa.h>
+#include <gtest/gtest.h>
+#include <cstring>
+#include <thread>
+
+using namespace ::dsn::utils;
+
+TEST(core, numa_topology)
+{
+    int node_count = numa_node_count();
+    ASSERT_GE(node_count, 1);
+
+    uint64_t all_mask = 0;
+    for (int node = 0; node < node_count; ++node) {
+        uint64_t mask = numa_node_cpu_mask(node);
+        // the nodes are indexed densely, so none of them is empty even if the ids are sparse
+        if (std::thread::hardware_concurrency() <= 64) {
+            ASSERT_NE(0u, mask);
+        }
+        // nodes don't share cpus
+        ASSERT_EQ(0u, all_mask & mask);
+        all_mask |= mask;
+
+        for (int cpu = 0; cpu < 64; ++cpu) {
+            if ((mask & ((uint64_t)1 << cpu)) != 0) {
+                ASSERT_EQ(node, numa_node_of_cpu(cpu));
+            }
+        }
+    }
+    ASSERT_NE(0u, all_mask);
+    ASSERT_EQ(0u, numa_node_cpu_mask(node_count));
+    ASSERT_EQ(-1, numa_node_of_cpu(-1));
+
+    int node = numa_current_node();
+    ASSERT_TRUE(node >= -1 && node < node_count);
+}
+
+TEST(core, numa_memory)
+{
+    void *ptr = numa_alloc_onnode(4096, 0);
+    ASSERT_NE(nullptr, ptr);
+    memset(ptr, 0xff, 4096);
+    numa_free(ptr, 4096);
+
+    ASSERT_EQ(-1, numa_thread_node());
+    numa_set_thread_node(0);
+    ASSERT_EQ(0, numa_thread_node());
+    ASSERT_EQ(0, numa_current_node());
+    {
+        std::shared_ptr<char> buffer = numa_local_shared_array(1024);
+        ASSERT_NE(nullptr, buffer.get());
+        memset(buffer.get(), 0xff, 1024);
+    }
+    numa_set_thread_node(-1);
+    ASSERT_EQ(-1, numa_thread_node());
+}
+
+TEST(core, numa_bind_io_thread)
+{
+    std::thread io_thread([]() {
+        int node = numa_bind_io_thread();
+        if (numa_node_count() == 1) {
+            EXPECT_EQ(-1, node);
+        } else {
+            EXPECT_TRUE(node >= 0 && node < numa_node_count());
+        }
+        EXPECT_EQ(node, numa_thread_node());
+    });
+    io_thread.join();
+}
+
+TEST(core, numa_chunk_cache)
+{
+    // a private cache which caches at most 2 chunks of 8KB on node 0
+    numa_chunk_cache cache(1, 16 * 1024);
+    ASSERT_EQ(0u, cache.cached_bytes(0));
+
+    size_t capacity1, capacity2, capacity3;
+    char *chunk1 = cache.allocate(0, 5000, capacity1);
+    ASSERT_NE(nullptr, chunk1);
+    ASSERT_EQ(8192u, capacity1);
+    memset(chunk1, 0xff, capacity1);
+
+    // freed chunks are reused
+    cache.release(0, chunk1, capacity1);
+    ASSERT_EQ(8192u, cache.cached_bytes(0));
+    char *chunk = cache.allocate(0, 8192, capacity2);
+    ASSERT_EQ(chunk1, chunk);
+    ASSERT_EQ(8192u, capacity2);
+    ASSERT_EQ(0u, cache.cached_bytes(0));
+
+    // chunks beyond the limit are freed
+    chunk = cache.allocate(0, 4097, capacity1);
+    char *chunk3 = cache.allocate(0, 6000, capacity3);
+    ASSERT_NE(nullptr, chunk3);
+    cache.release(0, chunk, capacity1);
+    cache.release(0, chunk1, capacity2);
+    ASSERT_EQ(16384u, cache.cached_bytes(0));
+    cache.release(0, chunk3, capacity3);
+    ASSERT_EQ(16384u, cache.cached_bytes(0));
+
+    // chunks larger than the largest class are not cached
+    size_t large = ((size_t)1 << (numa_chunk_cache::MIN_CLASS_SHIFT +
+                                  numa_chunk_cache::CLASS_COUNT - 1)) +
+                   1;
+    chunk = cache.allocate(0, large, capacity1);
+    ASSERT_NE(nullptr, chunk);
+    ASSERT_EQ(large, capacity1);
+    cache.release(0, chunk, capacity1);
+    ASSERT_EQ(16384u, cache.cached_bytes(0));
+}
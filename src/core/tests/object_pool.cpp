@@ -0,0 +1,122 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <dsn/utility/object_pool.h>
+#include <dsn/utility/inline_function.h>
+#include <gtest/gtest.h>
+
+using namespace ::dsn;
+
+TEST(core, object_pool)
+{
+    object_pool_stats before = tls_pool_get_stats();
+
+    // the objects freed on the other thread come back in batches
+    std::vector<void *> objects;
+    for (int i = 0; i < 1000; i++) {
+        objects.push_back(tls_pool_malloc(200));
+        memset(objects.back(), 0xff, 200);
+    }
+    std::thread t([&objects]() {
+        for (void *p : objects)
+            tls_pool_free(p);
+    });
+    t.join();
+
+    // recycled in the same thread, and the stats are merged on the way
+    for (int i = 0; i < 1000; i++)
+        tls_pool_free(tls_pool_malloc(190));
+
+    object_pool_stats after = tls_pool_get_stats();
+    ASSERT_LT(before.hit_count, after.hit_count);
+    ASSERT_LT(before.batch_return_count, after.batch_return_count);
+
+    // large objects go to the transient memory
+    void *large = tls_pool_malloc(4096);
+    memset(large, 0xff, 4096);
+    tls_pool_free(large);
+
+    // a burst freed on another thread overflows the central list, and is freed to the system
+    objects.clear();
+    for (int i = 0; i < 10000; i++)
+        objects.push_back(tls_pool_malloc(500));
+    before = tls_pool_get_stats();
+    std::thread t2([&objects]() {
+        for (void *p : objects)
+            tls_pool_free(p);
+    });
+    t2.join();
+    after = tls_pool_get_stats();
+    ASSERT_LT(before.release_count, after.release_count);
+
+    std::shared_ptr<char> holder(static_cast<char *>(tls_pool_malloc(64)),
+                                 [](char *c) { tls_pool_free(c); },
+                                 pool_allocator<char>());
+    ASSERT_NE(nullptr, holder.get());
+}
+
+TEST(core, inline_function)
+{
+    int calls = 0;
+    inline_function<void()> f = [&calls]() { calls++; };
+    ASSERT_TRUE(f != nullptr);
+    f();
+    ASSERT_EQ(1, calls);
+
+    inline_function<void()> copied = f;
+    copied();
+    ASSERT_EQ(2, calls);
+
+    inline_function<void()> moved(std::move(copied));
+    ASSERT_TRUE(copied == nullptr);
+    moved();
+    ASSERT_EQ(3, calls);
+
+    // empty std::function makes an empty inline_function
+    std::function<void()> empty;
+    inline_function<void()> from_empty(empty);
+    ASSERT_TRUE(from_empty == nullptr);
+
+    // callables larger than the inline capacity
+    auto ref = std::make_shared<int>(1);
+    char padding[200] = {2};
+    inline_function<int(int)> large = [ref, padding](int x) { return x + *ref + padding[0]; };
+    ASSERT_EQ(2, ref.use_count());
+    inline_function<int(int)> large_copied = large;
+    ASSERT_EQ(3, ref.use_count());
+    ASSERT_EQ(13, large_copied(10));
+
+    large = nullptr;
+    ASSERT_EQ(2, ref.use_count());
+    large_copied = [](int x) { return x; };
+    ASSERT_EQ(1, ref.use_count());
+
+    std::function<int(int)> to_std = large_copied;
+    ASSERT_EQ(4, to_std(4));
+}
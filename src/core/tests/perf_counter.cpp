@@ -110,7 +110,10 @@ static void test_perf_counter(perf_counter::factory f)
     counter = f("", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_RATE, "");
     perf_counter_inc_dec(counter);
     perf_counter_add(counter, vec);
+    ASSERT_EQ((uint64_t)ans, counter->get_total());
     ddebug("%lf", counter->get_value());
+    // the total is not reset by getting the rate
+    ASSERT_EQ((uint64_t)ans, counter->get_total());
 
     counter = f("", "", "", dsn_perf_counter_type_t::COUNTER_TYPE_NUMBER_PERCENTILES, "");
     std::this_thread::sleep_for(std::chrono::seconds(sleep_interval));
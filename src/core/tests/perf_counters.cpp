@@ -101,3 +101,65 @@ TEST(core, perf_counters)
     ASSERT_EQ(nullptr, p);
     ASSERT_FALSE(perf_counters::instance().remove_counter("app*test*unexist_counter"));
 }
+
+TEST(core, perf_counters_metrics)
+{
+    perf_counter_ptr rate = perf_counters::instance().get_global_counter(
+        "metrics_app", "test_metrics", "rate.counter", COUNTER_TYPE_RATE, "a \"rate\"", true);
+    perf_counter_ptr number = perf_counters::instance().get_global_counter(
+        "metrics_app", "test_metrics", "number.counter", COUNTER_TYPE_NUMBER, "a number", true);
+    perf_counter_ptr volatile_number =
+        perf_counters::instance().get_global_counter("metrics_app",
+                                                     "test_metrics",
+                                                     "volatile.counter",
+                                                     COUNTER_TYPE_VOLATILE_NUMBER,
+                                                     "",
+                                                     true);
+    perf_counter_ptr percentile =
+        perf_counters::instance().get_global_counter("metrics_app",
+                                                     "test_metrics",
+                                                     "latency(ns)",
+                                                     COUNTER_TYPE_NUMBER_PERCENTILES,
+                                                     "",
+                                                     true);
+    rate->add(3);
+    number->set(7);
+
+    binary_writer writer;
+    perf_counters::instance().write_metrics(writer);
+    std::string metrics = writer.get_buffer().to_string();
+
+    ASSERT_NE(std::string::npos,
+              metrics.find("# TYPE test_metrics_rate_counter counter\n"
+                           "# HELP test_metrics_rate_counter a \\\"rate\\\"\n"
+                           "test_metrics_rate_counter_total{app=\"metrics_app\"} 3\n"));
+    ASSERT_NE(std::string::npos,
+              metrics.find("# TYPE test_metrics_number_counter gauge\n"
+                           "# HELP test_metrics_number_counter a number\n"
+                           "test_metrics_number_counter{app=\"metrics_app\"} 7\n"));
+    ASSERT_NE(std::string::npos, metrics.find("# TYPE test_metrics_latency_ns_ summary\n"));
+    ASSERT_NE(std::string::npos,
+              metrics.find("test_metrics_latency_ns_{app=\"metrics_app\",quantile=\"0.99\"} "));
+    ASSERT_EQ(std::string::npos, metrics.find("test_metrics_volatile_counter"));
+    ASSERT_EQ("# EOF\n", metrics.substr(metrics.size() - 6));
+
+    // the rate is exposed as its total, which is not reset by scraping
+    rate->add(2);
+    binary_writer writer2;
+    perf_counters::instance().write_metrics(writer2);
+    ASSERT_NE(std::string::npos,
+              writer2.get_buffer().to_string().find(
+                  "test_metrics_rate_counter_total{app=\"metrics_app\"} 5\n"));
+
+    // removed counters are no longer exposed
+    ASSERT_TRUE(perf_counters::instance().remove_counter("metrics_app*test_metrics*rate.counter"));
+    binary_writer writer3;
+    perf_counters::instance().write_metrics(writer3);
+    ASSERT_EQ(std::string::npos, writer3.get_buffer().to_string().find("test_metrics_rate"));
+
+    ASSERT_TRUE(
+        perf_counters::instance().remove_counter("metrics_app*test_metrics*number.counter"));
+    ASSERT_TRUE(
+        perf_counters::instance().remove_counter("metrics_app*test_metrics*volatile.counter"));
+    ASSERT_TRUE(perf_counters::instance().remove_counter("metrics_app*test_metrics*latency(ns)"));
+}
@@ -45,7 +45,10 @@
 #include <dsn/utility/priority_queue.h>
 #include <dsn/tool-api/group_address.h>
 #include <dsn/tool-api/aio_provider.h>
+#include "../core/service_engine.h"
+#include "../core/task_engine.h"
 #include "test_utils.h"
+#include <mutex>
 
 typedef std::function<void(error_code, dsn_message_t, dsn_message_t)> rpc_reply_handler;
 
@@ -88,6 +91,73 @@ TEST(core, rpc)
                 "server.THREAD_POOL_TEST_SERVER");
 }
 
+static std::atomic<bool> s_drop_local_test_requests(false);
+static std::atomic<bool> s_drop_local_test_responses(false);
+static bool on_local_test_request_enqueue(rpc_request_task *)
+{
+    return !s_drop_local_test_requests;
+}
+static bool on_local_test_response_enqueue(rpc_response_task *)
+{
+    return !s_drop_local_test_responses;
+}
+
+TEST(core, rpc_local_fast_path)
+{
+    if (!dsn_config_get_value_bool("network",
+                                   "local_fast_path",
+                                   false,
+                                   "whether to deliver rpc calls to the nodes in the same process "
+                                   "directly without network") ||
+        dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    // the tests are run twice, in rDSN threads and in non-rDSN threads
+    static std::once_flag hooks_once;
+    std::call_once(hooks_once, []() {
+        task_spec *spec = task_spec::get(RPC_TEST_HASH);
+        spec->on_rpc_request_enqueue.put_native(on_local_test_request_enqueue);
+        spec->on_rpc_response_enqueue.put_native(on_local_test_response_enqueue);
+    });
+
+    int req = 0;
+    ::dsn::rpc_address server("localhost", 20101);
+    auto call = [&]() {
+        return ::dsn::rpc::call_wait<std::string>(
+                   server, RPC_TEST_HASH, req, std::chrono::milliseconds(200), 1)
+            .first;
+    };
+    EXPECT_EQ(ERR_OK, call());
+
+    // requests dropped by fault injection at the server side, which has no session to close
+    s_drop_local_test_requests = true;
+    EXPECT_EQ(ERR_TIMEOUT, call());
+    s_drop_local_test_requests = false;
+
+    // responses dropped by fault injection at the client side
+    s_drop_local_test_responses = true;
+    EXPECT_EQ(ERR_NETWORK_FAILURE, call());
+    s_drop_local_test_responses = false;
+    EXPECT_EQ(ERR_OK, call());
+
+    // throttled with TM_DELAY, while there is no session to delay recving from
+    service_node *server_node = nullptr;
+    for (auto &kv : dsn::service_engine::fast_instance().get_all_nodes()) {
+        if (strcmp(kv.second->full_name(), "server") == 0)
+            server_node = kv.second;
+    }
+    ASSERT_NE(nullptr, server_node);
+    auto &pool_spec = const_cast<threadpool_spec &>(
+        server_node->computation()->get_pool(THREAD_POOL_TEST_SERVER)->spec());
+    task_spec *spec = task_spec::get(RPC_TEST_HASH);
+    int threshold = pool_spec.queue_length_throttling_threshold;
+    pool_spec.queue_length_throttling_threshold = 0; // every request is over it
+    spec->rpc_request_throttling_mode = TM_DELAY;
+    EXPECT_EQ(ERR_OK, call());
+    spec->rpc_request_throttling_mode = TM_NONE;
+    pool_spec.queue_length_throttling_threshold = threshold;
+}
+
 TEST(core, group_address_talk_to_others)
 {
     ::dsn::rpc_address addr = build_group();
@@ -0,0 +1,138 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Unit-test for rpc_request_bucket of rpc_client_matcher.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <gtest/gtest.h>
+#include "../core/rpc_engine.h"
+#include <map>
+#include <random>
+#include <set>
+
+using namespace ::dsn;
+
+TEST(core, rpc_request_bucket_basic)
+{
+    rpc_request_bucket b;
+    ASSERT_EQ(nullptr, b.earliest());
+
+    // ids of a bucket are strided by MATCHER_BUCKET_NR
+    for (uint64_t i = 0; i < 1000; i++) {
+        auto e = b.insert(i * MATCHER_BUCKET_NR + 3);
+        ASSERT_NE(nullptr, e);
+        b.schedule(e, 10000 - i);
+    }
+    ASSERT_EQ(1000u, b.size());
+    ASSERT_EQ(nullptr, b.insert(3));
+    ASSERT_EQ(nullptr, b.find(4));
+
+    auto e = b.earliest();
+    ASSERT_EQ(999 * MATCHER_BUCKET_NR + 3, e->id);
+    ASSERT_EQ(9001u, e->deadline_ms);
+
+    // not scheduled any more, but still in the table
+    b.unschedule(e);
+    ASSERT_EQ(e, b.find(999 * MATCHER_BUCKET_NR + 3));
+    ASSERT_EQ(998 * MATCHER_BUCKET_NR + 3, b.earliest()->id);
+    b.erase(e);
+    ASSERT_EQ(nullptr, b.find(999 * MATCHER_BUCKET_NR + 3));
+
+    // erasing a scheduled entry takes it out of the heap
+    b.erase(b.find(998 * MATCHER_BUCKET_NR + 3));
+    ASSERT_EQ(997 * MATCHER_BUCKET_NR + 3, b.earliest()->id);
+    ASSERT_EQ(998u, b.size());
+
+    // the entries are reused
+    e = b.insert(1);
+    ASSERT_NE(nullptr, e);
+    ASSERT_EQ(rpc_request_bucket::NPOS, e->heap_pos);
+    ASSERT_EQ(nullptr, e->resp_task);
+}
+
+TEST(core, rpc_request_bucket_random)
+{
+    rpc_request_bucket b;
+    std::map<uint64_t, uint64_t> expect;        // id => deadline, or 0 if not scheduled
+    std::set<std::pair<uint64_t, uint64_t>> by_deadline;
+    std::mt19937_64 rng(0x5eed);
+    uint64_t next_id = 7;
+
+    for (int round = 0; round < 200000; round++) {
+        int op = (int)(rng() % 10);
+        if (op < 4 || expect.empty()) {
+            uint64_t id = next_id;
+            next_id += MATCHER_BUCKET_NR;
+            uint64_t deadline = 1 + rng() % 1000;
+            auto e = b.insert(id);
+            ASSERT_NE(nullptr, e);
+            b.schedule(e, deadline);
+            expect[id] = deadline;
+            by_deadline.insert(std::make_pair(deadline, id));
+        } else if (op < 8) {
+            // reply, of a random one
+            auto it = expect.lower_bound(rng() % next_id);
+            if (it == expect.end())
+                it = expect.begin();
+            auto e = b.find(it->first);
+            ASSERT_NE(nullptr, e);
+            ASSERT_EQ(it->first, e->id);
+            if (it->second != 0)
+                by_deadline.erase(std::make_pair(it->second, it->first));
+            b.erase(e);
+            expect.erase(it);
+        } else {
+            // sweep
+            auto e = b.earliest();
+            if (by_deadline.empty()) {
+                ASSERT_EQ(nullptr, e);
+                continue;
+            }
+            ASSERT_NE(nullptr, e);
+            ASSERT_EQ(by_deadline.begin()->first, e->deadline_ms);
+            uint64_t id = e->id;
+            ASSERT_EQ(expect[id], e->deadline_ms);
+            by_deadline.erase(std::make_pair(e->deadline_ms, id));
+            b.unschedule(e);
+            expect[id] = 0;
+        }
+        ASSERT_EQ(expect.size(), b.size());
+    }
+
+    for (auto &kv : expect) {
+        auto e = b.find(kv.first);
+        ASSERT_NE(nullptr, e);
+        b.erase(e);
+    }
+    ASSERT_EQ(0u, b.size());
+    ASSERT_EQ(nullptr, b.earliest());
+}
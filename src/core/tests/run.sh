@@ -7,10 +7,18 @@ fi
 while read -r -a line; do
     test_case=${line[0]}
     gtest_filter=${line[1]}
-    output_xml="${REPORT_DIR}/dsn.core.tests_${test_case/.ini/.xml}"
-    echo "============ run dsn.core.tests ${test_case} with gtest_filter ${gtest_filter} ============"
+    # optional arguments for the %key% placeholders in the config file
+    config_args=${line[2]}
+    if [ -n "${config_args}" ]; then
+        output_xml="${REPORT_DIR}/dsn.core.tests_${test_case/.ini/_${config_args//[=;,]/_}.xml}"
+        cargs="-cargs ${config_args}"
+    else
+        output_xml="${REPORT_DIR}/dsn.core.tests_${test_case/.ini/.xml}"
+        cargs=""
+    fi
+    echo "============ run dsn.core.tests ${test_case} ${cargs} with gtest_filter ${gtest_filter} ============"
     ./clear.sh
-    GTEST_OUTPUT="xml:${output_xml}" GTEST_FILTER=${gtest_filter} ./dsn.core.tests ${test_case} < command.txt
+    GTEST_OUTPUT="xml:${output_xml}" GTEST_FILTER=${gtest_filter} ./dsn.core.tests ${test_case} ${cargs} < command.txt
 
     if [ $? -ne 0 ]; then
         echo "run dsn.core.tests $test_case failed"
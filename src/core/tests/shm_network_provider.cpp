@@ -0,0 +1,177 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Unit-test for shm network provider.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <gtest/gtest.h>
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/task.h>
+#include "../core/service_engine.h"
+#include "../core/rpc_engine.h"
+#include "../tools/hpc/shm_network_provider.h"
+#include "test_utils.h"
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+
+#include <sys/un.h>
+
+using namespace ::dsn;
+using namespace ::dsn::tools;
+
+DEFINE_TASK_CODE_RPC(RPC_TEST_SHM_NETPROVIDER, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+
+namespace {
+void shm_echo(dsn_message_t request)
+{
+    std::string str;
+    ::dsn::unmarshall(request, str);
+    dsn_message_t response = dsn_msg_create_response(request);
+    ::dsn::marshall(response, str);
+    dsn_rpc_reply(response);
+}
+
+// call RPC_TEST_SHM_NETPROVIDER over 'session' and wait for its response
+error_code echo_over(rpc_session_ptr session, int timeout_ms = 0)
+{
+    message_ex *msg = message_ex::create_request(RPC_TEST_SHM_NETPROVIDER, timeout_ms, 0);
+    ::dsn::marshall(msg, std::string("hello shm"));
+
+    std::atomic<bool> done(false);
+    error_code result = ERR_UNKNOWN;
+    rpc_response_task *t = new rpc_response_task(
+        msg,
+        [&](error_code err, dsn_message_t req, dsn_message_t resp) {
+            if (err == ERR_OK) {
+                std::string str;
+                ::dsn::unmarshall(resp, str);
+                if (str != "hello shm")
+                    err = ERR_INVALID_DATA;
+            }
+            result = err;
+            done.store(true);
+        },
+        0);
+
+    session->net().engine()->matcher()->on_call(msg, t);
+    session->send_message(msg);
+    while (!done.load())
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return result;
+}
+}
+
+TEST(tools_hpc, shm_network_provider)
+{
+    if (dsn::service_engine::fast_instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    ASSERT_TRUE(
+        dsn_rpc_register_handler(RPC_TEST_SHM_NETPROVIDER, "rpc.test.shm.netprovider", shm_echo));
+
+    io_modifer modifier;
+    modifier.mode = IOE_PER_NODE;
+    modifier.queue = nullptr;
+
+    const int port = 20421;
+    auto server = new shm_network_provider(task::get_current_rpc(), nullptr);
+    ASSERT_EQ(ERR_OK, server->start(RPC_CHANNEL_TCP, port, false, modifier));
+    auto client = new shm_network_provider(task::get_current_rpc(), nullptr);
+    ASSERT_EQ(ERR_OK, client->start(RPC_CHANNEL_TCP, 0, true, modifier));
+
+    rpc_session_ptr session = client->create_client_session(rpc_address("localhost", port));
+    ASSERT_NE(nullptr, dynamic_cast<shm_rpc_session *>(session.get()));
+    session->connect();
+
+    // sent once the server acks the handshake
+    ASSERT_EQ(ERR_OK, echo_over(session));
+
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_SHM_NETPROVIDER));
+}
+
+TEST(tools_hpc, shm_network_provider_rejected)
+{
+    if (dsn::service_engine::fast_instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    ASSERT_TRUE(
+        dsn_rpc_register_handler(RPC_TEST_SHM_NETPROVIDER, "rpc.test.shm.netprovider", shm_echo));
+
+    io_modifer modifier;
+    modifier.mode = IOE_PER_NODE;
+    modifier.queue = nullptr;
+
+    // the unix socket of the server is taken by a peer rejecting all the shm sessions, as
+    // a server run by another user or failing to map the shared memory does, so the
+    // server only serves by tcp
+    const int port = 20422;
+    struct sockaddr_un addr;
+    memset((void *)&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    int n = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "rdsn-shm-%d", port);
+    socklen_t addr_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + n);
+    int rejecter = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ASSERT_NE(-1, rejecter);
+    ASSERT_EQ(0, bind(rejecter, (struct sockaddr *)&addr, addr_len));
+    ASSERT_EQ(0, listen(rejecter, 16));
+
+    auto server = new shm_network_provider(task::get_current_rpc(), nullptr);
+    ASSERT_EQ(ERR_OK, server->start(RPC_CHANNEL_TCP, port, false, modifier));
+    auto client = new shm_network_provider(task::get_current_rpc(), nullptr);
+    ASSERT_EQ(ERR_OK, client->start(RPC_CHANNEL_TCP, 0, true, modifier));
+
+    rpc_session_ptr session = client->create_client_session(rpc_address("localhost", port));
+    ASSERT_NE(nullptr, dynamic_cast<shm_rpc_session *>(session.get()));
+    session->connect();
+
+    int s = accept(rejecter, nullptr, nullptr);
+    ASSERT_NE(-1, s);
+    close(s);
+
+    // the request on the rejected session is never sent
+    ASSERT_EQ(ERR_TIMEOUT, echo_over(session, 1000));
+
+    // then the server is connected by tcp
+    session = client->create_client_session(rpc_address("localhost", port));
+    ASSERT_EQ(nullptr, dynamic_cast<shm_rpc_session *>(session.get()));
+    session->connect();
+    ASSERT_EQ(ERR_OK, echo_over(session));
+
+    close(rejecter);
+    ASSERT_TRUE(dsn_rpc_unregiser_handler(RPC_TEST_SHM_NETPROVIDER));
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Unit-test for shm_ring.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <gtest/gtest.h>
+#include <dsn/c/api_utilities.h>
+#include "../tools/hpc/shm_ring.h"
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ::dsn::tools;
+
+namespace {
+// the memory of a direction, zeroed as a new memfd
+struct ring_memory
+{
+    std::vector<uint64_t> words;
+    shm_ring producer;
+    shm_ring consumer;
+
+    ring_memory(uint32_t capacity, uint32_t slot_size, uint32_t slot_count)
+        : words(shm_ring::region_size(capacity, slot_size, slot_count) / sizeof(uint64_t), 0)
+    {
+        producer.attach((char *)words.data(), capacity, slot_size, slot_count);
+        consumer.attach((char *)words.data(), capacity, slot_size, slot_count);
+        producer.init_waiting();
+    }
+};
+}
+
+TEST(core, shm_ring_records)
+{
+    ring_memory m(shm_ring::MIN_CAPACITY, 4096, 2);
+    shm_ring &p = m.producer;
+    shm_ring &c = m.consumer;
+
+    const shm_ring::record *r;
+    ASSERT_TRUE(c.peek(r));
+    ASSERT_EQ(nullptr, r);
+
+    // a record is at most a quarter of the ring
+    uint32_t length = shm_ring::MIN_CAPACITY;
+    char *ptr = p.reserve(1, length);
+    ASSERT_NE(nullptr, ptr);
+    ASSERT_EQ(shm_ring::MIN_CAPACITY / 4, length);
+
+    length = 5;
+    ptr = p.reserve(1, length);
+    ASSERT_EQ(5u, length);
+    memcpy(ptr, "hello", 5);
+    p.commit(shm_ring::REC_DATA, 5);
+
+    // not seen before publish, and the consumer waiting initially is notified
+    ASSERT_TRUE(c.peek(r));
+    ASSERT_EQ(nullptr, r);
+    ASSERT_TRUE(p.publish());
+    ASSERT_FALSE(p.publish());
+
+    ASSERT_TRUE(c.peek(r));
+    ASSERT_NE(nullptr, r);
+    ASSERT_EQ((uint32_t)shm_ring::REC_DATA, r->type);
+    ASSERT_EQ(std::string("hello"), std::string(c.payload(r), r->length));
+    ASSERT_FALSE(c.release(r));
+
+    ASSERT_TRUE(c.peek(r));
+    ASSERT_EQ(nullptr, r);
+    ASSERT_TRUE(c.wait_for_data());
+
+    // pass a slot
+    int index = p.acquire_slot();
+    ASSERT_EQ(0, index);
+    ASSERT_EQ(1, p.acquire_slot());
+    ASSERT_EQ(-1, p.acquire_slot());
+    memcpy(p.slot_data(index), "world", 5);
+    length = sizeof(shm_ring::slot_ref);
+    auto ref = (shm_ring::slot_ref *)p.reserve(length, length);
+    ref->index = (uint32_t)index;
+    ref->length = 5;
+    p.commit(shm_ring::REC_SLOT, length);
+    ASSERT_TRUE(p.publish());
+
+    ASSERT_TRUE(c.peek(r));
+    ASSERT_EQ((uint32_t)shm_ring::REC_SLOT, r->type);
+    ref = (shm_ring::slot_ref *)c.payload(r);
+    ASSERT_EQ(std::string("world"), std::string(c.slot_data(ref->index), ref->length));
+    c.release(r);
+    c.free_slot(ref->index);
+    ASSERT_EQ(0, p.acquire_slot());
+}
+
+TEST(core, shm_ring_wrap_and_wait)
+{
+    const uint32_t capacity = shm_ring::MIN_CAPACITY;
+    ring_memory m(capacity, 4096, 0);
+    shm_ring &p = m.producer;
+    shm_ring &c = m.consumer;
+
+    // fill the ring with records of 1000 bytes
+    int written = 0;
+    while (true) {
+        uint32_t length = 1000;
+        char *ptr = p.reserve(1000, length);
+        if (ptr == nullptr)
+            break;
+        ASSERT_EQ(1000u, length);
+        memset(ptr, written, length);
+        p.commit(shm_ring::REC_DATA, length);
+        written++;
+    }
+    ASSERT_EQ((int)(capacity / 1008), written);
+    p.publish();
+    ASSERT_TRUE(p.wait_for_space(1000));
+
+    // releasing the first record is just enough for the padding of the 16 bytes
+    // left at the end, and the next record at the beginning
+    const shm_ring::record *r;
+    ASSERT_TRUE(c.peek(r));
+    ASSERT_TRUE(c.release(r));
+    ASSERT_FALSE(p.wait_for_space(1000));
+    ASSERT_TRUE(p.wait_for_space(1001));
+
+    uint32_t length = 1000;
+    char *ptr = p.reserve(1000, length);
+    ASSERT_NE(nullptr, ptr);
+    memset(ptr, 0xff, length);
+    p.commit(shm_ring::REC_DATA, length);
+    p.publish();
+
+    // the padding is skipped
+    int read = 1;
+    while (c.peek(r), r != nullptr) {
+        ASSERT_EQ(1000u, r->length);
+        ASSERT_EQ(read < written ? (char)read : (char)0xff, c.payload(r)[999]);
+        c.release(r);
+        read++;
+    }
+    ASSERT_EQ(written + 1, read);
+}
+
+TEST(core, shm_ring_malformed)
+{
+    ring_memory m(shm_ring::MIN_CAPACITY, 4096, 1);
+    shm_ring &p = m.producer;
+    shm_ring &c = m.consumer;
+
+    // a slot out of range
+    uint32_t length = sizeof(shm_ring::slot_ref);
+    auto ref = (shm_ring::slot_ref *)p.reserve(length, length);
+    ref->index = 1;
+    ref->length = 10;
+    p.commit(shm_ring::REC_SLOT, length);
+    p.publish();
+
+    const shm_ring::record *r;
+    ASSERT_FALSE(c.peek(r));
+}
+
+TEST(core, shm_ring_stream)
+{
+    ring_memory m(shm_ring::MIN_CAPACITY, 4096, 0);
+    shm_ring &p = m.producer;
+    shm_ring &c = m.consumer;
+    const uint64_t total = 64 * 1024 * 1024;
+
+    // the waiting flags are polled here instead of the eventfds
+    std::thread producer([&]() {
+        uint64_t pos = 0;
+        while (pos < total) {
+            uint32_t length = (uint32_t)std::min(total - pos, (uint64_t)(pos % 7000 + 1));
+            char *ptr = p.reserve(1, length);
+            if (ptr == nullptr) {
+                p.publish();
+                while (p.wait_for_space(1))
+                    std::this_thread::yield();
+                continue;
+            }
+            for (uint32_t i = 0; i < length; i++)
+                ptr[i] = (char)(pos + i);
+            p.commit(shm_ring::REC_DATA, length);
+            pos += length;
+            if (pos % 3 == 0)
+                p.publish();
+        }
+        p.publish();
+    });
+
+    uint64_t pos = 0;
+    bool ok = true;
+    while (pos < total && ok) {
+        const shm_ring::record *r;
+        ASSERT_TRUE(c.peek(r));
+        if (r == nullptr) {
+            while (c.wait_for_data())
+                std::this_thread::yield();
+            continue;
+        }
+        const char *data = c.payload(r);
+        for (uint32_t i = 0; i < r->length; i++)
+            ok = ok && data[i] == (char)(pos + i);
+        pos += r->length;
+        c.release(r);
+    }
+    producer.join();
+    ASSERT_TRUE(ok);
+    ASSERT_EQ(total, pos);
+}
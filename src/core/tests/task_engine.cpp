@@ -34,13 +34,19 @@
  */
 
 #include "../core/task_engine.h"
+#include "../tools/common/deadline_task_queue.h"
 #include "test_utils.h"
 #include <dsn/tool_api.h>
 #include <gtest/gtest.h>
 #include <sstream>
+#include <set>
+#include <mutex>
 
 using namespace ::dsn;
 
+// when set, no rpc request is accepted by admission_controller_for_test
+static std::atomic<bool> s_reject_all_requests(false);
+
 class admission_controller_for_test : public admission_controller
 {
 public:
@@ -51,7 +57,7 @@ public:
 
     virtual ~admission_controller_for_test() {}
 
-    virtual bool is_task_accepted(task *task) { return true; }
+    virtual bool is_task_accepted(task *task) { return !s_reject_all_requests; }
 
     const std::vector<std::string> &arguments() const { return _args; }
 
@@ -67,6 +73,14 @@ void task_engine_module_init()
 
 DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_1)
 DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_2)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_3)
+DEFINE_THREAD_POOL_CODE(THREAD_POOL_FOR_TEST_4)
+DEFINE_TASK_CODE(LPC_WORK_STEALING_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_3)
+DEFINE_TASK_CODE(LPC_ENQUEUE_BATCH_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_2)
+DEFINE_TASK_CODE(LPC_ELASTIC_POOL_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_1)
+DEFINE_TASK_CODE(LPC_AUTO_SCALE_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_4)
+DEFINE_TASK_CODE(LPC_DEADLINE_HIGH_TEST, TASK_PRIORITY_HIGH, THREAD_POOL_FOR_TEST_2)
+DEFINE_TASK_CODE_RPC(RPC_DEADLINE_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_FOR_TEST_2)
 
 TEST(core, task_engine)
 {
@@ -132,6 +146,145 @@ TEST(core, task_engine)
     ASSERT_EQ(nullptr, controllers2[1]);
 }
 
+TEST(core, work_stealing_pool)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    task_engine *engine = task::get_current_node2()->computation();
+    task_worker_pool *pool = engine->get_pool(THREAD_POOL_FOR_TEST_3);
+    ASSERT_NE(nullptr, pool);
+    ASSERT_TRUE(pool->spec().work_stealing);
+
+    // each worker owns a queue
+    std::vector<task_queue *> &queues = pool->queues();
+    std::vector<task_worker *> workers = pool->workers();
+    ASSERT_EQ(3u, queues.size());
+    ASSERT_EQ(3u, workers.size());
+    for (size_t i = 0; i < workers.size(); ++i) {
+        ASSERT_EQ(queues[i], workers[i]->queue());
+        ASSERT_EQ(workers[i], queues[i]->owner_worker());
+    }
+
+    // all tasks are enqueued into the queue of a single worker,
+    // and the idle workers are expected to steal some of them
+    const int total = 3000;
+    std::atomic<int> count(0);
+    std::mutex lock;
+    std::set<int> tids;
+    utils::notify_event done;
+    tasking::enqueue(LPC_WORK_STEALING_TEST, nullptr, [&]() {
+        for (int i = 0; i < total; ++i) {
+            tasking::enqueue(LPC_WORK_STEALING_TEST, nullptr, [&]() {
+                {
+                    std::lock_guard<std::mutex> l(lock);
+                    tids.insert(task::get_current_worker()->native_tid());
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                if (++count == total)
+                    done.notify();
+            });
+        }
+    });
+    done.wait();
+
+    ASSERT_EQ(total, count.load());
+    ASSERT_LT(1u, tids.size());
+}
+
+TEST(core, idle_spin_and_yield)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    task_engine *engine = task::get_current_node2()->computation();
+    task_worker_pool *pool = engine->get_pool(THREAD_POOL_FOR_TEST_3);
+    if (pool->spec().idle_spin_count == 0)
+        return;
+    ASSERT_EQ(1000, pool->spec().idle_spin_count);
+    ASSERT_EQ(100, pool->spec().idle_yield_count);
+
+    // the counters are only there when idle spinning or yielding is configured
+    ASSERT_EQ(nullptr, engine->get_pool(THREAD_POOL_FOR_TEST_2)->idle_spin_time_counter());
+    perf_counter *spin = pool->idle_spin_time_counter();
+    perf_counter *yield = pool->idle_yield_time_counter();
+    perf_counter *park = pool->idle_park_time_counter();
+    ASSERT_NE(nullptr, spin);
+    ASSERT_NE(nullptr, yield);
+    ASSERT_NE(nullptr, park);
+    uint64_t spin0 = spin->get_total(), yield0 = yield->get_total(), park0 = park->get_total();
+
+    // the workers go through spinning, yielding and then parking while idle,
+    // and the parked ones account the parked time when they are woken up
+    for (int round = 0; round < 3; round++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::vector<task_ptr> tasks;
+        for (int i = 0; i < 3; i++) {
+            tasks.push_back(tasking::enqueue(LPC_WORK_STEALING_TEST, nullptr, []() {}));
+        }
+        for (auto &t : tasks) {
+            t->wait();
+        }
+    }
+
+    ASSERT_LT(spin0, spin->get_total());
+    ASSERT_LT(yield0, yield->get_total());
+    ASSERT_LT(park0, park->get_total());
+}
+
+TEST(core, enqueue_batch)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    // tasks of a partitioned pool, and of a work-stealing pool, plus a delayed one
+    const int total = 200;
+    std::atomic<int> count(0);
+    std::mutex lock;
+    std::vector<int> sequences[2];
+    utils::notify_event done;
+
+    std::vector<task_ptr> tasks;
+    for (int i = 0; i < total; ++i) {
+        if (i % 4 == 3) {
+            tasks.push_back(tasking::create_task(LPC_WORK_STEALING_TEST, nullptr, [&]() {
+                if (++count == total + 1)
+                    done.notify();
+            }));
+            continue;
+        }
+        tasks.push_back(tasking::create_task(LPC_ENQUEUE_BATCH_TEST,
+                                             nullptr,
+                                             [&, i]() {
+                                                 {
+                                                     std::lock_guard<std::mutex> l(lock);
+                                                     sequences[i % 2].push_back(i);
+                                                 }
+                                                 if (++count == total + 1)
+                                                     done.notify();
+                                             },
+                                             i));
+    }
+    tasks.push_back(tasking::create_task(LPC_ENQUEUE_BATCH_TEST, nullptr, [&]() {
+        if (++count == total + 1)
+            done.notify();
+    }));
+    tasks.back()->set_delay(10);
+
+    tasking::enqueue_batch(tasks);
+    done.wait();
+    ASSERT_EQ(total + 1, count.load());
+
+    // each queue of the partitioned pool is served by one worker, in which the tasks
+    // run in the order they are in the batch
+    for (auto &seq : sequences) {
+        ASSERT_FALSE(seq.empty());
+        for (size_t i = 1; i < seq.size(); ++i) {
+            ASSERT_LT(seq[i - 1], seq[i]);
+        }
+    }
+}
+
 /*
 TEST(core, task_engine)
 {
@@ -204,3 +357,320 @@ dynamic_cast<admission_controller_for_test*>(controllers1[0]);
     ASSERT_EQ(nullptr, controllers2[1]);
 }
 */
+
+TEST(core, elastic_pool)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    task_engine *engine = task::get_current_node2()->computation();
+
+    // partitioned and work-stealing pools are not elastic, and are left as they are
+    for (auto code : {THREAD_POOL_FOR_TEST_2, THREAD_POOL_FOR_TEST_3}) {
+        task_worker_pool *fixed = engine->get_pool(code);
+        int count = fixed->spec().worker_count;
+        ASSERT_FALSE(fixed->is_elastic());
+        ASSERT_EQ(count, fixed->worker_count());
+        ASSERT_EQ(count, (int)fixed->workers().size());
+        ASSERT_FALSE(fixed->resize(count + 2).empty());
+        ASSERT_EQ(count, fixed->worker_count());
+        ASSERT_EQ(count, (int)fixed->workers().size());
+        ASSERT_EQ(TASK_CODE_INVALID.code(), fixed->spec().wake_up_task_code.code());
+    }
+
+    task_worker_pool *pool = engine->get_pool(THREAD_POOL_FOR_TEST_1);
+    ASSERT_TRUE(pool->is_elastic());
+    ASSERT_EQ(2u, pool->workers().size());
+    ASSERT_FALSE(pool->resize(0).empty());
+    ASSERT_EQ(2, pool->worker_count());
+
+    // the retired workers are woken up by the tasks of the pool itself
+    task_spec *wake_up_spec = task_spec::get(pool->spec().wake_up_task_code);
+    ASSERT_NE(nullptr, wake_up_spec);
+    ASSERT_EQ((int)THREAD_POOL_FOR_TEST_1, (int)wake_up_spec->pool_code);
+
+    auto run_tasks = [](int total) {
+        std::atomic<int> count(0);
+        std::mutex lock;
+        std::set<int> tids;
+        utils::notify_event done;
+        for (int i = 0; i < total; ++i) {
+            tasking::enqueue(LPC_ELASTIC_POOL_TEST, nullptr, [&]() {
+                {
+                    std::lock_guard<std::mutex> l(lock);
+                    tids.insert(task::get_current_worker()->native_tid());
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                if (++count == total)
+                    done.notify();
+            });
+        }
+        done.wait();
+        return tids.size();
+    };
+
+    // the configured worker count is kept in the spec
+    ASSERT_EQ(2, pool->spec().worker_count);
+    ASSERT_EQ(2, pool->worker_count());
+    task_queue *queue = pool->queues()[0];
+
+    // grow
+    ASSERT_TRUE(pool->resize(4).empty());
+    ASSERT_EQ(2, pool->spec().worker_count);
+    ASSERT_EQ(4, pool->worker_count());
+    ASSERT_EQ(4u, pool->workers().size());
+    ASSERT_EQ(4, queue->worker_count());
+    ASSERT_LE(run_tasks(1000), 4u);
+
+    // shrink, and the retired workers exit once they are woken up
+    ASSERT_TRUE(pool->resize(1).empty());
+    ASSERT_EQ(1, pool->worker_count());
+    ASSERT_EQ(1u, pool->workers().size());
+    ASSERT_TRUE(queue->is_shared());
+    run_tasks(100);
+
+    bool all_exited = false;
+    for (int i = 0; i < 500 && !all_exited; ++i) {
+        std::stringstream ss;
+        pool->get_runtime_info("", std::vector<std::string>(), ss);
+        ASSERT_NE(std::string::npos, ss.str().find("contains 1 threads"));
+        all_exited = (ss.str().find("retiring") == std::string::npos);
+        if (!all_exited)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_TRUE(all_exited);
+    ASSERT_EQ(1u, run_tasks(100));
+    // the exited workers are reaped by the next resize
+    ASSERT_TRUE(pool->resize(1).empty());
+    ASSERT_EQ(1, queue->worker_count());
+
+    // back to the configured size for the other tests
+    ASSERT_TRUE(pool->resize(2).empty());
+    ASSERT_EQ(2u, pool->workers().size());
+    ASSERT_EQ(2, pool->worker_count());
+    ASSERT_EQ(2, queue->worker_count());
+}
+
+TEST(core, elastic_pool_auto_scale)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    task_engine *engine = task::get_current_node2()->computation();
+    task_worker_pool *pool = engine->get_pool(THREAD_POOL_FOR_TEST_4);
+    if (pool == nullptr)
+        return;
+    ASSERT_TRUE(pool->is_elastic());
+    ASSERT_EQ(2, pool->worker_count());
+
+    // the slow tasks pile up in the queue, so the auto-scaler adds workers
+    // one per check, up to elastic_max_worker_count
+    const int total = 400;
+    std::atomic<int> count(0);
+    utils::notify_event done;
+    int max_count = pool->worker_count();
+    for (int i = 0; i < total; ++i) {
+        tasking::enqueue(LPC_AUTO_SCALE_TEST, nullptr, [&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            if (++count == total)
+                done.notify();
+        });
+    }
+    while (!done.wait_for(5)) {
+        max_count = std::max(max_count, pool->worker_count());
+    }
+    ASSERT_LT(2, max_count);
+    ASSERT_GE(4, max_count);
+
+    // and removes them after idle checks, down to elastic_min_worker_count
+    for (int i = 0; i < 500 && pool->worker_count() > 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(2, pool->worker_count());
+    ASSERT_EQ(2u, pool->workers().size());
+}
+
+static std::atomic<int> s_deadline_timeout_replies(0);
+static bool on_deadline_test_reply(task *caller, message_ex *response)
+{
+    if (strcmp(response->header->server.error_name, "ERR_TIMEOUT") == 0)
+        ++s_deadline_timeout_replies;
+    return false; // nowhere to send
+}
+
+TEST(core, rpc_request_deadline_drop)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    service_node *node = task::get_current_node2();
+    task_worker_pool *pool = node->computation()->get_pool(THREAD_POOL_FOR_TEST_2);
+    perf_counter *drop_counter = pool->rpc_request_timeout_drop_counter();
+
+    task_spec *spec = task_spec::get(RPC_DEADLINE_TEST);
+    spec->rpc_request_dropped_before_execution_when_timeout = true;
+    // the tests are run twice, in rDSN threads and in non-rDSN threads
+    static std::once_flag hook_once;
+    std::call_once(hook_once, [spec]() { spec->on_rpc_reply.put_native(on_deadline_test_reply); });
+
+    // the requests are queued after a blocking task on the same worker of the
+    // partitioned pool, and the one with a short timeout expires before dequeue
+    auto run_requests = [&](std::atomic<int> &executed) {
+        utils::notify_event unblock, done;
+        task_ptr blocker(new raw_task(LPC_ENQUEUE_BATCH_TEST, [&]() { unblock.wait(); }, 1));
+        blocker->enqueue();
+
+        auto create_request = [&](int timeout_ms, bool last) {
+            message_ex *msg = message_ex::create_request(RPC_DEADLINE_TEST, 0, 1);
+            msg->header->client.timeout_ms = timeout_ms; // no deadline if 0
+            msg->header->from_address = rpc_address("localhost", 20501);
+            msg->local_peer = task::get_current_rpc();
+            return new rpc_request_task(msg,
+                                        [&executed, &done, last](dsn_message_t) {
+                                            ++executed;
+                                            if (last)
+                                                done.notify();
+                                        },
+                                        node);
+        };
+        task_ptr expired(create_request(20, false));
+        task_ptr no_timeout(create_request(0, false));
+        task_ptr long_timeout(create_request(60000, true));
+        expired->enqueue();
+        no_timeout->enqueue();
+        long_timeout->enqueue();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        unblock.notify();
+        done.wait();
+    };
+
+    // dropped and replied with ERR_TIMEOUT
+    spec->rpc_request_reply_when_dropped_for_timeout = true;
+    uint64_t drop_base = drop_counter->get_total();
+    int reply_base = s_deadline_timeout_replies.load();
+    std::atomic<int> executed(0);
+    run_requests(executed);
+    ASSERT_EQ(2, executed.load());
+    ASSERT_EQ(reply_base + 1, s_deadline_timeout_replies.load());
+    ASSERT_EQ(drop_base + 1, drop_counter->get_total());
+
+    // dropped silently
+    spec->rpc_request_reply_when_dropped_for_timeout = false;
+    executed = 0;
+    run_requests(executed);
+    ASSERT_EQ(2, executed.load());
+    ASSERT_EQ(reply_base + 1, s_deadline_timeout_replies.load());
+    ASSERT_EQ(drop_base + 2, drop_counter->get_total());
+
+    // not dropped when the option is off
+    spec->rpc_request_dropped_before_execution_when_timeout = false;
+    executed = 0;
+    run_requests(executed);
+    ASSERT_EQ(3, executed.load());
+    ASSERT_EQ(drop_base + 2, drop_counter->get_total());
+}
+
+class deadline_test_request_task : public rpc_request_task
+{
+public:
+    deadline_test_request_task(uint64_t deadline_ns)
+        : rpc_request_task(message_ex::create_request(RPC_DEADLINE_TEST, 0, 0),
+                           rpc_request_handler(),
+                           task::get_current_node2())
+    {
+        _deadline_ns = deadline_ns;
+    }
+};
+
+TEST(core, deadline_task_queue)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    task_worker_pool *pool =
+        task::get_current_node2()->computation()->get_pool(THREAD_POOL_FOR_TEST_2);
+    tools::deadline_task_queue q(pool, 100, nullptr);
+
+    uint64_t now = dsn_now_ns();
+    uint64_t ms = 1000000;
+    std::vector<task_ptr> tasks;
+    tasks.emplace_back(new deadline_test_request_task(now + 300 * ms)); // 0
+    tasks.emplace_back(new deadline_test_request_task(now + 100 * ms)); // 1
+    tasks.emplace_back(new raw_task(LPC_DEADLINE_HIGH_TEST, []() {}));  // 2
+    tasks.emplace_back(new raw_task(LPC_ENQUEUE_BATCH_TEST, []() {}));  // 3
+    tasks.emplace_back(new deadline_test_request_task(now + 100 * ms)); // 4
+    tasks.emplace_back(new deadline_test_request_task(0));              // 5
+
+    q.enqueue(tasks[0].get());
+    q.enqueue(tasks[1].get());
+    q.enqueue(tasks[2].get());
+    task *batch[] = {tasks[3].get(), tasks[4].get(), tasks[5].get()};
+    q.enqueue_batch(batch, 3);
+
+    // higher priority first, then the earliest deadline, then fifo; the tasks without
+    // deadlines are due when they are enqueued
+    int expected[] = {2, 3, 5, 1, 4, 0};
+    for (int i : expected) {
+        int batch_size = 0;
+        ASSERT_EQ(tasks[i].get(), q.dequeue(batch_size));
+        ASSERT_EQ(1, batch_size);
+    }
+
+    // a batch is taken in the same order, and no larger than the tasks queued
+    for (auto &t : tasks)
+        q.enqueue(t.get());
+    int batch_size = 4;
+    task *t = q.dequeue(batch_size);
+    ASSERT_EQ(4, batch_size);
+    for (int i = 0; i < 6; i++) {
+        if (i == 4) {
+            ASSERT_EQ(nullptr, t);
+            batch_size = 10;
+            t = q.dequeue(batch_size);
+            ASSERT_EQ(2, batch_size);
+        }
+        ASSERT_EQ(tasks[expected[i]].get(), t);
+        task *next = t->next;
+        t->next = nullptr;
+        t = next;
+    }
+    ASSERT_EQ(nullptr, t);
+}
+
+TEST(core, rpc_request_admission)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    // the requests are admitted by admission_controller_for_test of THREAD_POOL_TEST_SERVER
+    task_spec *spec = task_spec::get(RPC_TEST_HASH);
+    ::dsn::rpc_address server("localhost", 20101);
+    int req = 0;
+    auto call = [&]() {
+        return ::dsn::rpc::call_wait<std::string>(
+                   server, RPC_TEST_HASH, req, std::chrono::milliseconds(0), 1)
+            .first;
+    };
+
+    // rejected with ERR_BUSY
+    ASSERT_EQ(TM_REJECT, spec->rpc_request_admission_mode);
+    s_reject_all_requests = true;
+    EXPECT_EQ(ERR_BUSY, call());
+    s_reject_all_requests = false;
+    EXPECT_EQ(ERR_OK, call());
+
+    // accepted, while recving the following requests from the session is delayed
+    int delay_ms = spec->rpc_request_admission_delay_milliseconds;
+    spec->rpc_request_admission_mode = TM_DELAY;
+    spec->rpc_request_admission_delay_milliseconds = 200;
+    s_reject_all_requests = true;
+    EXPECT_EQ(ERR_OK, call());
+    s_reject_all_requests = false;
+    uint64_t start_ms = dsn_now_ms();
+    EXPECT_EQ(ERR_OK, call());
+    EXPECT_GE(dsn_now_ms() - start_ms, 100u);
+
+    spec->rpc_request_admission_mode = TM_REJECT;
+    spec->rpc_request_admission_delay_milliseconds = delay_ms;
+}
@@ -0,0 +1,78 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ */
+
+/*
+ * Description:
+ *     Unit-test for task_tracker.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <gtest/gtest.h>
+#include <dsn/service_api_cpp.h>
+#include <dsn/tool-api/task_tracker.h>
+#include "../core/service_engine.h"
+#include "test_utils.h"
+#include <thread>
+
+DEFINE_TASK_CODE(LPC_TASK_TRACKER_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+
+TEST(core, task_tracker)
+{
+    if (dsn::service_engine::fast_instance().spec().tool == "simulator")
+        return;
+
+    std::atomic<int> count(0);
+    dsn::task_tracker tracker(3);
+
+    // more than enough to trigger sweeping the finished ones
+    const int total = 1000;
+    std::vector<dsn::task_ptr> tasks;
+    for (int i = 0; i < total; ++i) {
+        tasks.push_back(
+            dsn::tasking::enqueue(LPC_TASK_TRACKER_TEST, &tracker, [&]() { ++count; }));
+    }
+    tracker.wait_outstanding_tasks();
+    ASSERT_EQ(total, count.load());
+    tasks.clear();
+    ASSERT_EQ(0, tracker.outstanding_task_count());
+
+    // the delayed ones are cancelled before they run
+    for (int i = 0; i < 10; ++i) {
+        tasks.push_back(dsn::tasking::enqueue(LPC_TASK_TRACKER_TEST,
+                                              &tracker,
+                                              [&]() { ++count; },
+                                              0,
+                                              std::chrono::seconds(10)));
+    }
+    ASSERT_EQ(10, tracker.outstanding_task_count());
+    tracker.cancel_outstanding_tasks();
+    ASSERT_EQ(0, tracker.outstanding_task_count());
+    for (auto &t : tasks) {
+        ASSERT_EQ(dsn::TASK_STATE_CANCELLED, t->state());
+    }
+    ASSERT_EQ(total, count.load());
+    tasks.clear();
+
+    // the tasks count themselves finished once released, without the tracker walking them
+    dsn::task_tracker default_tracker;
+    for (int i = 0; i < 100; ++i) {
+        tasks.push_back(
+            dsn::tasking::enqueue(LPC_TASK_TRACKER_TEST, &default_tracker, [&]() { ++count; }));
+    }
+    for (auto &t : tasks) {
+        t->wait();
+    }
+    tasks.clear();
+    for (int i = 0; i < 100 && default_tracker.outstanding_task_count() != 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(0, default_tracker.outstanding_task_count());
+    ASSERT_EQ(total + 100, count.load());
+}
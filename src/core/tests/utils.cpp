@@ -69,6 +69,41 @@ TEST(core, crc)
     EXPECT_TRUE(c3 == c4);
 }
 
+TEST(core, crc_impls)
+{
+    // check values of CRC32C and the crc64 polynomial
+    const char *check = "123456789";
+    EXPECT_EQ(0xe3069283u, dsn::utils::crc32_calc(check, 9, 0));
+    EXPECT_EQ(0xae8b14860a799888ull, dsn::utils::crc64_calc(check, 9, 0));
+
+    std::vector<char> buffer(4096 + 8);
+    for (auto &c : buffer) {
+        c = (char)dsn_random32(0, 255);
+    }
+
+    // all the implementations must agree on every length and alignment
+    for (size_t len = 0; len <= 4096; len += (len < 256 ? 1 : 61)) {
+        for (size_t offset = 0; offset < 8; offset++) {
+            const char *ptr = buffer.data() + offset;
+            uint32_t init32 = dsn_random32(0, 0xffffffff);
+            uint64_t init64 = dsn_random64(0, 0xffffffffffffffffull);
+            uint32_t c32 = dsn::utils::crc32_calc_with(CRC_IMPL_BYTEWISE, ptr, len, init32);
+            uint64_t c64 = dsn::utils::crc64_calc_with(CRC_IMPL_BYTEWISE, ptr, len, init64);
+            for (int t = CRC_IMPL_SLICING8; t < CRC_IMPL_COUNT; t++) {
+                auto type = (crc_impl_type)t;
+                if (!dsn::utils::crc_impl_supported(type))
+                    continue;
+                ASSERT_EQ(c32, dsn::utils::crc32_calc_with(type, ptr, len, init32))
+                    << dsn::utils::crc32_impl_name(type) << ", len = " << len;
+                ASSERT_EQ(c64, dsn::utils::crc64_calc_with(type, ptr, len, init64))
+                    << dsn::utils::crc64_impl_name(type) << ", len = " << len;
+            }
+            ASSERT_EQ(c32, dsn::utils::crc32_calc(ptr, len, init32));
+            ASSERT_EQ(c64, dsn::utils::crc64_calc(ptr, len, init64));
+        }
+    }
+}
+
 TEST(core, binary_io)
 {
     int value = 0xdeadbeef;
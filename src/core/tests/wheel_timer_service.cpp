@@ -0,0 +1,105 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     Unit-test for wheel_timer_service.
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include <gtest/gtest.h>
+#include <dsn/service_api_cpp.h>
+#include "../core/service_engine.h"
+#include "../tools/common/wheel_timer_service.h"
+#include "test_utils.h"
+
+DEFINE_TASK_CODE(LPC_WHEEL_TIMER_TEST, TASK_PRIORITY_COMMON, THREAD_POOL_TEST_SERVER)
+
+TEST(core, wheel_timer_service)
+{
+    if (dsn::service_engine::fast_instance().spec().semaphore_factory_name ==
+        "dsn::tools::sim_semaphore_provider")
+        return;
+
+    // the ticking thread never exits, so the service is never deleted
+    auto svc = new dsn::tools::wheel_timer_service(::dsn::task::get_current_node2(), nullptr);
+    dsn::io_modifer ctx;
+    ctx.queue = nullptr;
+    ctx.port_shift_value = 0;
+    ctx.mode = dsn::IOE_PER_NODE;
+    svc->start(ctx);
+
+    // delays covering the root level and the first upper level
+    std::vector<int> delays = {0, 1, 10, 255, 256, 300, 3000};
+    std::vector<dsn::task_ptr> timers;
+    std::vector<uint64_t> fired_ms(delays.size(), 0);
+    uint64_t start_ms = dsn_now_ms();
+    for (size_t i = 0; i < delays.size(); i++) {
+        dsn::task_ptr t(new dsn::raw_task(LPC_WHEEL_TIMER_TEST,
+                                          [&fired_ms, i]() { fired_ms[i] = dsn_now_ms(); }));
+        t->set_delay(delays[i]);
+        t->add_ref(); // released by the timer service
+        svc->add_timer(t.get());
+        timers.push_back(t);
+    }
+
+    // cancelled timers are dropped on expiry
+    bool cancelled_fired = false;
+    dsn::task_ptr cancelled(
+        new dsn::raw_task(LPC_WHEEL_TIMER_TEST, [&cancelled_fired]() { cancelled_fired = true; }));
+    cancelled->set_delay(100);
+    cancelled->add_ref();
+    svc->add_timer(cancelled.get());
+    ASSERT_TRUE(cancelled->cancel(false));
+
+    for (size_t i = 0; i < delays.size(); i++) {
+        timers[i]->wait();
+        ASSERT_GE(fired_ms[i], start_ms + delays[i]);
+    }
+
+    // the cancelled timer has expired long ago
+    ASSERT_FALSE(cancelled_fired);
+    ASSERT_EQ(dsn::TASK_STATE_CANCELLED, cancelled->state());
+    ASSERT_EQ(1, cancelled->get_count());
+
+    // a cancelled timer is unlinked from the wheel at once instead of on its expiry
+    dsn::task_ptr long_timer(new dsn::raw_task(LPC_WHEEL_TIMER_TEST, []() {}));
+    long_timer->set_delay(3600 * 1000);
+    long_timer->add_ref();
+    svc->add_timer(long_timer.get());
+    for (int i = 0; i < 1000 && svc->timer_count() == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ASSERT_EQ(1u, svc->timer_count());
+    ASSERT_EQ(2, long_timer->get_count());
+
+    ASSERT_TRUE(long_timer->cancel(false));
+    ASSERT_EQ(0u, svc->timer_count());
+    ASSERT_EQ(1, long_timer->get_count());
+}
@@ -35,6 +35,7 @@
 
 #include "asio_net_provider.h"
 #include "asio_rpc_session.h"
+#include <dsn/utility/numa.h>
 
 namespace dsn {
 namespace tools {
@@ -64,6 +65,7 @@ asio_network_provider::start(rpc_channel channel, int port, bool client_only, io
             char buffer[128];
             sprintf(buffer, "%s.asio.%d", name, i);
             task_worker::set_name(buffer);
+            utils::numa_bind_io_thread();
 
             boost::asio::io_service::work work(_io_service);
             _io_service.run();
@@ -345,6 +347,7 @@ asio_udp_provider::start(rpc_channel channel, int port, bool client_only, io_mod
             char buffer[128];
             sprintf(buffer, "%s.asio.udp.%d.%d", name, (int)(this->address().port()), i);
             task_worker::set_name(buffer);
+            utils::numa_bind_io_thread();
 
             boost::asio::io_service::work work(_io_service);
             _io_service.run();
@@ -0,0 +1,195 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     admission controller shedding rpc requests by the queueing delay (CoDel)
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include "codel_admission_controller.h"
+#include <cmath>
+
+namespace dsn {
+namespace tools {
+
+codel_admission_controller::codel_admission_controller(task_queue *q,
+                                                       std::vector<std::string> &sargs)
+    : admission_controller(q, sargs), _target_ns(5000000), _interval_ns(100000000)
+{
+    if (sargs.size() > 0) {
+        int target_ms = atoi(sargs[0].c_str());
+        dassert(target_ms > 0,
+                "invalid arguments for codel_admission_controller: target_ms = '%s'",
+                sargs[0].c_str());
+        _target_ns = static_cast<uint64_t>(target_ms) * 1000000;
+    }
+    if (sargs.size() > 1) {
+        int interval_ms = atoi(sargs[1].c_str());
+        dassert(interval_ms > 0,
+                "invalid arguments for codel_admission_controller: interval_ms = '%s'",
+                sargs[1].c_str());
+        _interval_ns = static_cast<uint64_t>(interval_ms) * 1000000;
+    }
+
+    _first_above_ns = 0;
+    _dropping = false;
+    _drop_next_ns = 0;
+    _count = 0;
+    _last_count = 0;
+
+    const char *node_name = ::dsn::tools::get_service_node_name(q->node());
+    _sojourn_counter.init_global_counter(
+        node_name,
+        "engine",
+        (q->get_name() + ".admission.sojourn(us)").c_str(),
+        COUNTER_TYPE_NUMBER_PERCENTILES,
+        "queueing time (us) of the rpc requests checked by the admission controller");
+    _dropping_counter.init_global_counter(
+        node_name,
+        "engine",
+        (q->get_name() + ".admission.overloaded").c_str(),
+        COUNTER_TYPE_NUMBER,
+        "whether the queue is in the dropping state (1) or not (0)");
+    _not_accepted_counter.init_global_counter(
+        node_name,
+        "engine",
+        (q->get_name() + ".admission.not.accepted").c_str(),
+        COUNTER_TYPE_RATE,
+        "rpc requests per second not accepted, then rejected or delayed according to "
+        "their rpc_request_admission_mode");
+}
+
+bool codel_admission_controller::is_task_accepted(task *task)
+{
+    if (!_dropping.load(std::memory_order_relaxed))
+        return true;
+
+    // the request is just stamped in rpc_request_task::enqueue
+    uint64_t now_ns = 0;
+    if (task->spec().type == TASK_TYPE_RPC_REQUEST)
+        now_ns = static_cast<rpc_request_task *>(task)->enqueue_ts_ns();
+    if (now_ns == 0)
+        now_ns = dsn_now_ns();
+
+    return is_accepted(now_ns);
+}
+
+bool codel_admission_controller::is_accepted(uint64_t now_ns)
+{
+    if (!_dropping.load(std::memory_order_relaxed) ||
+        now_ns < _drop_next_ns.load(std::memory_order_relaxed))
+        return true;
+
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+        if (!_dropping.load(std::memory_order_relaxed) ||
+            now_ns < _drop_next_ns.load(std::memory_order_relaxed))
+            return true;
+
+        // the next drop is scheduled from now rather than from the last one, so that
+        // a quiet period in the dropping state is not followed by a burst of drops
+        ++_count;
+        _drop_next_ns.store(control_law(now_ns), std::memory_order_relaxed);
+    }
+
+    _not_accepted_counter->increment();
+    return false;
+}
+
+void codel_admission_controller::on_task_dequeued(task *task,
+                                                  uint64_t sojourn_ns,
+                                                  uint64_t now_ns)
+{
+    _sojourn_counter->set(sojourn_ns / 1000);
+
+    // nothing changes in the steady states
+    bool above = (sojourn_ns >= _target_ns);
+    if (above) {
+        if (_dropping.load(std::memory_order_relaxed))
+            return;
+        uint64_t first_above_ns = _first_above_ns.load(std::memory_order_relaxed);
+        if (first_above_ns != 0 && now_ns < first_above_ns)
+            return;
+    } else {
+        if (!_dropping.load(std::memory_order_relaxed) &&
+            _first_above_ns.load(std::memory_order_relaxed) == 0)
+            return;
+    }
+
+    utils::auto_lock<utils::ex_lock_nr_spin> l(_lock);
+    if (!above) {
+        _first_above_ns.store(0, std::memory_order_relaxed);
+        if (_dropping.load(std::memory_order_relaxed)) {
+            _dropping.store(false, std::memory_order_relaxed);
+            _dropping_counter->set(0);
+            dwarn("%s leaves overload after %u requests not accepted, queueing time = %" PRIu64
+                  " us",
+                  bound_queue()->get_name().c_str(),
+                  _count,
+                  sojourn_ns / 1000);
+        }
+        return;
+    }
+
+    if (_dropping.load(std::memory_order_relaxed))
+        return;
+
+    uint64_t first_above_ns = _first_above_ns.load(std::memory_order_relaxed);
+    if (first_above_ns == 0) {
+        _first_above_ns.store(now_ns + _interval_ns, std::memory_order_relaxed);
+        return;
+    }
+    if (now_ns < first_above_ns)
+        return;
+
+    // above the target for a whole interval. when the last dropping state is recent, the
+    // drop rate it reached is likely still needed, so start from about there
+    uint32_t delta = _count - _last_count;
+    uint32_t count = 1;
+    if (delta > 1 && now_ns < _drop_next_ns.load(std::memory_order_relaxed) + 16 * _interval_ns)
+        count = delta;
+    _last_count = count;
+
+    // the next request is not accepted, which brings _count to count
+    _count = count - 1;
+    _drop_next_ns.store(now_ns, std::memory_order_relaxed);
+    _dropping.store(true, std::memory_order_relaxed);
+    _dropping_counter->set(1);
+    dwarn("%s enters overload, queueing time over the last interval >= %" PRIu64 " us",
+          bound_queue()->get_name().c_str(),
+          sojourn_ns / 1000);
+}
+
+uint64_t codel_admission_controller::control_law(uint64_t now_ns) const
+{
+    return now_ns + static_cast<uint64_t>(_interval_ns / std::sqrt(static_cast<double>(_count)));
+}
+}
+}
@@ -0,0 +1,92 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     admission controller shedding rpc requests by the queueing delay (CoDel)
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include <dsn/tool_api.h>
+#include <dsn/cpp/perf_counter_wrapper.h>
+#include <atomic>
+
+namespace dsn {
+namespace tools {
+
+//
+// CoDel (controlled delay) applied at the admission of the rpc requests:
+//  - the queue enters the dropping state when the queueing time of the rpc requests
+//    dequeued has stayed above the target for a whole interval. the bursts that the
+//    workers can drain within an interval do not matter, while a standing queue does.
+//  - in the dropping state, the next request is not accepted at once, and the later
+//    ones are spaced at interval / sqrt(count), where count is the number of requests
+//    not accepted in this dropping state, so the pressure grows until the queueing time
+//    goes down. not accepted requests are rejected or delayed according to
+//    rpc_request_admission_mode of their task codes.
+//  - the queue leaves the dropping state as soon as a request dequeued has waited less
+//    than the target. re-entering it soon after resumes with about the previous count.
+//
+// arguments: [target_ms = 5] [interval_ms = 100]
+//
+class codel_admission_controller : public admission_controller
+{
+public:
+    codel_admission_controller(task_queue *q, std::vector<std::string> &sargs);
+
+    bool is_task_accepted(task *task) override;
+    void on_task_dequeued(task *task, uint64_t sojourn_ns, uint64_t now_ns) override;
+
+    // whether a request arriving at now_ns is accepted, counted as dropped if not
+    bool is_accepted(uint64_t now_ns);
+    bool is_dropping() const { return _dropping.load(std::memory_order_relaxed); }
+
+private:
+    // time of the next drop after the one at now_ns
+    uint64_t control_law(uint64_t now_ns) const;
+
+private:
+    uint64_t _target_ns;
+    uint64_t _interval_ns;
+
+    ::dsn::utils::ex_lock_nr_spin _lock;
+    std::atomic<uint64_t> _first_above_ns; // when staying above target ends the interval, or 0
+    std::atomic<bool> _dropping;
+    std::atomic<uint64_t> _drop_next_ns;
+    uint32_t _count;      // drops in the current dropping state, protected by _lock
+    uint32_t _last_count; // count when the last dropping state was entered
+
+    perf_counter_wrapper _sojourn_counter;
+    perf_counter_wrapper _dropping_counter;
+    perf_counter_wrapper _not_accepted_counter;
+};
+}
+}
@@ -0,0 +1,135 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     earliest-deadline-first task queue
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include "deadline_task_queue.h"
+#include <algorithm>
+
+namespace dsn {
+namespace tools {
+
+deadline_task_queue::deadline_task_queue(task_worker_pool *pool,
+                                         int index,
+                                         task_queue *inner_provider)
+    : task_queue(pool, index, inner_provider), _seq(0)
+{
+}
+
+uint64_t deadline_task_queue::deadline_of(task *task)
+{
+    uint64_t deadline_ns = 0;
+    if (task->spec().type == TASK_TYPE_RPC_REQUEST) {
+        deadline_ns = static_cast<rpc_request_task *>(task)->deadline_ns();
+    }
+    if (deadline_ns == 0) {
+        deadline_ns = dsn_now_ns();
+    }
+    return deadline_ns;
+}
+
+void deadline_task_queue::enqueue(task *task)
+{
+    dassert(task->next == nullptr, "task is not alone");
+
+    uint64_t deadline_ns = deadline_of(task);
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        _heap.push_back(
+            entry{static_cast<uint32_t>(task->spec().priority), deadline_ns, _seq++, task});
+        std::push_heap(_heap.begin(), _heap.end());
+    }
+
+    _sema.signal();
+}
+
+void deadline_task_queue::enqueue_batch(task **tasks, int count)
+{
+    std::vector<uint64_t> deadlines(count);
+    for (int i = 0; i < count; i++) {
+        dassert(tasks[i]->next == nullptr, "task is not alone");
+        deadlines[i] = deadline_of(tasks[i]);
+    }
+
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        for (int i = 0; i < count; i++) {
+            _heap.push_back(entry{static_cast<uint32_t>(tasks[i]->spec().priority),
+                                  deadlines[i],
+                                  _seq++,
+                                  tasks[i]});
+            std::push_heap(_heap.begin(), _heap.end());
+        }
+    }
+
+    _sema.signal(count);
+}
+
+task *deadline_task_queue::dequeue(/*inout*/ int &batch_size)
+{
+    if (!_sema.try_wait()) {
+        uint64_t start_ns = park_begin();
+        _sema.wait();
+        park_end(start_ns);
+    }
+
+    // each count of the semaphore stands for a task in the heap, so the batch takes as many
+    // more as are there without waiting, and they are all popped under one lock
+    int count = 1;
+    if (batch_size > 1)
+        count += _sema.try_wait_many(batch_size - 1);
+
+    task *head = nullptr, *last = nullptr;
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        for (int i = 0; i < count; i++) {
+            std::pop_heap(_heap.begin(), _heap.end());
+            task *t = _heap.back().tsk;
+            _heap.pop_back();
+
+            if (last) {
+                last->next = t;
+            } else {
+                head = t;
+            }
+            last = t;
+        }
+    }
+    last->next = nullptr;
+
+    batch_size = count;
+    dassert(head != nullptr, "returned task cannot be null");
+    return head;
+}
+}
+}
@@ -0,0 +1,92 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     earliest-deadline-first task queue
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include <dsn/tool_api.h>
+#include <dsn/utility/synchronize.h>
+#include <vector>
+
+namespace dsn {
+namespace tools {
+
+//
+// as simple_task_queue, tasks of a higher priority are always dequeued first; tasks of
+// the same priority are dequeued in the order of their deadlines:
+// - an rpc request with a client timeout uses the deadline stamped when it is enqueued
+// - any other task uses its enqueue time, i.e., it should run as soon as possible
+// tasks with the same priority and deadline are dequeued in fifo order, and a batch of
+// them is popped under one lock.
+//
+// under overload, the requests closer to their deadlines run first, and combined with
+// rpc_request_dropped_before_execution_when_timeout, the expired ones are dropped right
+// after dequeue instead of being executed.
+//
+class deadline_task_queue : public task_queue
+{
+public:
+    deadline_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
+
+    void enqueue(task *task) override;
+    void enqueue_batch(task **tasks, int count) override;
+    task *dequeue(/*inout*/ int &batch_size) override;
+
+private:
+    static uint64_t deadline_of(task *task);
+
+    struct entry
+    {
+        uint32_t priority;
+        uint64_t deadline_ns;
+        uint64_t seq;
+        task *tsk;
+
+        // for the heap on (priority desc, deadline_ns, seq)
+        bool operator<(const entry &other) const
+        {
+            if (priority != other.priority)
+                return priority < other.priority;
+            return deadline_ns != other.deadline_ns ? deadline_ns > other.deadline_ns
+                                                    : seq > other.seq;
+        }
+    };
+
+    utils::ex_lock_nr_spin _lock;
+    std::vector<entry> _heap;
+    uint64_t _seq;
+    utils::semaphore _sema;
+};
+}
+}
@@ -35,9 +35,346 @@
 
 #include "dsn_message_parser.h"
 #include <dsn/service_api_c.h>
+#include <dsn/cpp/perf_counter_wrapper.h>
 #include <dsn/utility/crc.h>
+#include <chrono>
+
+#ifdef DSN_ENABLE_RPC_COMPRESSION
+#include <lz4.h>
+#include <zstd.h>
+// announced to the peers in hdr_version, so that they may send compressed bodies
+#define DSN_MSG_HDR_LOCAL_COMPRESSION_READY DSN_MSG_HDR_COMPRESSION_READY
+#else
+#define DSN_MSG_HDR_LOCAL_COMPRESSION_READY 0
+#endif
+
+//
+// compact header (hdr_version = 2) on the wire:
+//
+//   uint32_t hdr_type;     // "RDSN", same as message_header
+//   uint32_t hdr_version;  // 2
+//   uint32_t hdr_length;   // length of the compact header, body follows it
+//   uint32_t hdr_crc32;    // crc of the compact header, or CRC_INVALID
+//   varint flags;          // COMPACT_HDR_xxx, which optional fields are present
+//   varint body_length;
+//   varint id;
+//   varint rpc_code;       // code of the sender, see below
+//   [varint name_length; char name[name_length]]  if COMPACT_HDR_RPC_NAME
+//   [uint32_t body_crc32]                         if COMPACT_HDR_BODY_CRC
+//   [varint trace_id]                             if COMPACT_HDR_TRACE_ID
+//   [varint gpid]                                 if COMPACT_HDR_GPID
+//   [varint context]                              if COMPACT_HDR_CONTEXT
+//   [uint64_t from_address]                       if COMPACT_HDR_FROM_ADDRESS
+//   [varint timeout_ms]                           if COMPACT_HDR_TIMEOUT
+//   [varint thread_hash]                          if COMPACT_HDR_THREAD_HASH
+//   [varint partition_hash]                       if COMPACT_HDR_PARTITION_HASH
+//   [varint error_code]                           if COMPACT_HDR_ERROR
+//   [varint name_length; char name[name_length]]  if COMPACT_HDR_ERROR_NAME
+//
+// rpc and error codes are process-local, so the name of a code is sent along
+// with it the first time the code is used on a session, and the receiver maps
+// the code of the sender to its own one since then. from_address is sent only
+// when it changes on the session. fixed-size fields are in host byte order as
+// in message_header.
+//
+// a peer announces it can receive the compact header by setting hdr_version to 1
+// in the v1 headers it sends, so v1 peers (hdr_version = 0) never receive it.
+//
+// compressed body (DSN_MSG_HDR_COMPRESSION_MASK bits of hdr_version are set):
+//
+//   uint32_t raw_body_length;
+//   char compressed_body[body_length - sizeof(uint32_t)];
+//
+// the body is compressed in prepare_on_send() as required by the task_spec of the
+// message, and only when the peer has announced DSN_MSG_HDR_COMPRESSION_READY, so
+// v1 peers never receive it either.
+//
+#define COMPACT_HDR_RPC_NAME (0x1 << 0)
+#define COMPACT_HDR_BODY_CRC (0x1 << 1)
+#define COMPACT_HDR_TRACE_ID (0x1 << 2)
+#define COMPACT_HDR_GPID (0x1 << 3)
+#define COMPACT_HDR_CONTEXT (0x1 << 4)
+#define COMPACT_HDR_FROM_ADDRESS (0x1 << 5)
+#define COMPACT_HDR_TIMEOUT (0x1 << 6)
+#define COMPACT_HDR_THREAD_HASH (0x1 << 7)
+#define COMPACT_HDR_PARTITION_HASH (0x1 << 8)
+#define COMPACT_HDR_ERROR (0x1 << 9)
+#define COMPACT_HDR_ERROR_NAME (0x1 << 10)
+#define COMPACT_HDR_ALL ((0x1 << 11) - 1)
+
+#define COMPACT_HDR_PREFIX_LENGTH (sizeof(uint32_t) * 4)
+#define COMPACT_HDR_MAX_LENGTH 256
+#define COMPACT_HDR_MAX_REMOTE_CODE 65535
+#define COMPACT_HDR_SEND_CHUNK_SIZE 4096
+
+// hdr_crc32 of a v1 header to be sent as a compact one, which tells get_buffers_on_send to
+// compute the crc, of the compact header or of the v1 one if it is sent after all
+#define HDR_CRC_DEFERRED 0xffffffff
+
+// the largest message whose whole size is asked for before its header is checked, which is
+// the largest size class of recv_buffer_pool, see get_message_on_receive
+#define EARLY_READ_MAX_LENGTH (8 * 1024 * 1024)
 
 namespace dsn {
+
+namespace {
+
+inline char *put_varint(char *p, uint64_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (char)v;
+    return p;
+}
+
+inline bool get_varint(const char *&p, const char *end, /*out*/ uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = (uint8_t)*p++;
+        v |= ((uint64_t)(b & 0x7f)) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline char *put_fixed(char *p, const void *v, size_t sz)
+{
+    memcpy(p, v, sz);
+    return p + sz;
+}
+
+inline bool get_fixed(const char *&p, const char *end, void *v, size_t sz)
+{
+    if (end - p < (ptrdiff_t)sz)
+        return false;
+    memcpy(v, p, sz);
+    p += sz;
+    return true;
+}
+
+inline char *put_name(char *p, const char *name, size_t max_length)
+{
+    size_t len = strnlen(name, max_length - 1);
+    p = put_varint(p, len);
+    return put_fixed(p, name, len);
+}
+
+inline bool get_name(const char *&p, const char *end, size_t max_length, std::string &name)
+{
+    uint64_t len;
+    if (!get_varint(p, end, len) || len >= max_length || end - p < (ptrdiff_t)len)
+        return false;
+    name.assign(p, (size_t)len);
+    p += len;
+    return true;
+}
+
+inline void mark_sent(std::vector<bool> &sent, int code)
+{
+    if ((size_t)code >= sent.size())
+        sent.resize(code + 1, false);
+    sent[code] = true;
+}
+
+inline bool is_sent(const std::vector<bool> &sent, int code)
+{
+    return (size_t)code < sent.size() && sent[code];
+}
+
+// the compressed body of a message, attached to the message in prepare_on_send() so
+// that it is compressed out of the session lock, and only once if it is resent
+struct compressed_body
+{
+    uint32_t compression; // DSN_MSG_HDR_COMPRESSION_MASK bits
+    blob data;            // raw body length + compressed body
+
+    static void deletor(void *p) { delete (compressed_body *)p; }
+};
+
+typedef object_extension_helper<compressed_body, message_ex> compressed_body_ext;
+uint32_t s_compressed_body_slot = compressed_body_ext::register_ext(compressed_body::deletor);
+
+struct compression_counters
+{
+    compression_counters()
+    {
+        compress_raw_bytes.init_global_counter("core",
+                                               "network",
+                                               "rpc.compress.raw.bytes",
+                                               COUNTER_TYPE_RATE,
+                                               "raw body bytes compressed per second");
+        compress_compressed_bytes.init_global_counter(
+            "core",
+            "network",
+            "rpc.compress.compressed.bytes",
+            COUNTER_TYPE_RATE,
+            "compressed body bytes sent per second, in place of rpc.compress.raw.bytes");
+        compress_cpu_us.init_global_counter("core",
+                                            "network",
+                                            "rpc.compress.cpu.us",
+                                            COUNTER_TYPE_RATE,
+                                            "microseconds spent per second compressing bodies");
+        decompress_raw_bytes.init_global_counter("core",
+                                                 "network",
+                                                 "rpc.decompress.raw.bytes",
+                                                 COUNTER_TYPE_RATE,
+                                                 "raw body bytes decompressed per second");
+        decompress_compressed_bytes.init_global_counter(
+            "core",
+            "network",
+            "rpc.decompress.compressed.bytes",
+            COUNTER_TYPE_RATE,
+            "compressed body bytes received per second");
+        decompress_cpu_us.init_global_counter(
+            "core",
+            "network",
+            "rpc.decompress.cpu.us",
+            COUNTER_TYPE_RATE,
+            "microseconds spent per second decompressing bodies");
+    }
+
+    perf_counter_wrapper compress_raw_bytes;
+    perf_counter_wrapper compress_compressed_bytes;
+    perf_counter_wrapper compress_cpu_us;
+    perf_counter_wrapper decompress_raw_bytes;
+    perf_counter_wrapper decompress_compressed_bytes;
+    perf_counter_wrapper decompress_cpu_us;
+};
+
+compression_counters &get_compression_counters()
+{
+    static compression_counters counters;
+    return counters;
+}
+
+inline uint64_t elapsed_us(std::chrono::steady_clock::time_point start)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+#ifdef DSN_ENABLE_RPC_COMPRESSION
+int get_zstd_level()
+{
+    static int level = (int)dsn_config_get_value_uint64(
+        "network",
+        "rpc_compression_zstd_level",
+        1,
+        "zstd compression level for the bodies compressed with RPC_COMPRESSION_ZSTD");
+    return level;
+}
+
+// max size of 'size' bytes compressed with 'type', 0 if they cannot be compressed
+size_t compress_bound(rpc_compression_type_t type, size_t size)
+{
+    switch (type) {
+    case RPC_COMPRESSION_LZ4:
+        return size <= INT32_MAX ? (size_t)LZ4_compressBound((int)size) : 0;
+    case RPC_COMPRESSION_ZSTD:
+        return ZSTD_compressBound(size);
+    default:
+        return 0;
+    }
+}
+
+// return the compressed size, or 0 if it fails
+size_t
+compress_block(rpc_compression_type_t type, const char *src, size_t size, char *dst, size_t cap)
+{
+    switch (type) {
+    case RPC_COMPRESSION_LZ4: {
+        int r = LZ4_compress_default(src, dst, (int)size, (int)cap);
+        return r > 0 ? (size_t)r : 0;
+    }
+    case RPC_COMPRESSION_ZSTD: {
+        size_t r = ZSTD_compress(dst, cap, src, size, get_zstd_level());
+        return ZSTD_isError(r) ? 0 : r;
+    }
+    default:
+        return 0;
+    }
+}
+
+// check 'raw_size' claimed by the peer before allocating for it
+bool is_raw_size_valid(rpc_compression_type_t type, const char *src, size_t size, size_t raw_size)
+{
+    switch (type) {
+    case RPC_COMPRESSION_LZ4:
+        // lz4 cannot compress better than 255:1
+        return raw_size <= INT32_MAX && raw_size / 255 <= size;
+    case RPC_COMPRESSION_ZSTD:
+        return ZSTD_getFrameContentSize(src, size) == (unsigned long long)raw_size;
+    default:
+        return false;
+    }
+}
+
+bool decompress_block(
+    rpc_compression_type_t type, const char *src, size_t size, char *dst, size_t raw_size)
+{
+    switch (type) {
+    case RPC_COMPRESSION_LZ4:
+        return size <= INT32_MAX &&
+               LZ4_decompress_safe(src, dst, (int)size, (int)raw_size) == (int)raw_size;
+    case RPC_COMPRESSION_ZSTD: {
+        size_t r = ZSTD_decompress(dst, raw_size, src, size);
+        return !ZSTD_isError(r) && r == raw_size;
+    }
+    default:
+        return false;
+    }
+}
+#else
+// built without ENABLE_RPC_COMPRESSION, so no body is compressed, and as
+// DSN_MSG_HDR_COMPRESSION_READY is never announced, the peers never compress either
+size_t compress_bound(rpc_compression_type_t type, size_t size) { return 0; }
+
+size_t
+compress_block(rpc_compression_type_t type, const char *src, size_t size, char *dst, size_t cap)
+{
+    return 0;
+}
+
+bool is_raw_size_valid(rpc_compression_type_t type, const char *src, size_t size, size_t raw_size)
+{
+    return false;
+}
+
+bool decompress_block(
+    rpc_compression_type_t type, const char *src, size_t size, char *dst, size_t raw_size)
+{
+    return false;
+}
+#endif
+}
+
+/*static*/ bool dsn_message_parser::is_compact_header_enabled()
+{
+    static bool enabled = dsn_config_get_value_bool(
+        "network",
+        "compact_message_header",
+        false,
+        "whether to send the compact message header (hdr_version = 2) to the peers supporting it");
+    return enabled;
+}
+
+dsn_message_parser::dsn_message_parser(bool compact_header_enabled)
+    : _header_checked(false),
+      _compact_header_enabled(compact_header_enabled),
+      _peer_compact_ready(false),
+      _peer_compression_ready(false),
+      _last_sent_from_address(0),
+      _send_chunk_index(0),
+      _send_chunk_used(0),
+      _last_recv_from_address(0)
+{
+}
+
 void dsn_message_parser::reset() { _header_checked = false; }
 
 message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
@@ -49,6 +386,12 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
     char *buf_ptr = (char *)buf.data();
     unsigned int buf_len = reader->_buffer_occupied;
 
+    if (buf_len >= COMPACT_HDR_PREFIX_LENGTH &&
+        (((message_header *)buf_ptr)->hdr_version & DSN_MSG_HDR_VERSION_MASK) >=
+            DSN_MSG_HDR_VERSION_COMPACT) {
+        return get_compact_message_on_receive(reader, read_next);
+    }
+
     if (buf_len >= sizeof(message_header)) {
         if (!_header_checked) {
             if (!is_right_header(buf_ptr)) {
@@ -65,6 +408,25 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
         // msg done
         if (buf_len >= msg_sz) {
             dsn::blob msg_bb = buf.range(0, msg_sz);
+            uint32_t hdr_version = ((message_header *)buf_ptr)->hdr_version;
+            if (hdr_version & DSN_MSG_HDR_COMPRESSION_MASK) {
+                // make the message of the header followed by the raw body
+                dsn::blob raw_bb;
+                if (!decompress_on_receive(hdr_version,
+                                           msg_bb.range((int)sizeof(message_header)),
+                                           sizeof(message_header),
+                                           raw_bb)) {
+                    derror("dsn message body decompress failed, rpc_name = %s",
+                           ((message_header *)buf_ptr)->rpc_name);
+                    read_next = -1;
+                    return nullptr;
+                }
+                message_header *raw_header = (message_header *)raw_bb.data();
+                memcpy((void *)raw_header, buf_ptr, sizeof(message_header));
+                raw_header->hdr_version &= ~DSN_MSG_HDR_COMPRESSION_MASK;
+                raw_header->body_length = raw_bb.length() - sizeof(message_header);
+                msg_bb = raw_bb;
+            }
             message_ex *msg = message_ex::create_receive_message(msg_bb);
             if (!is_right_body(msg)) {
                 message_header *header = (message_header *)buf_ptr;
@@ -77,12 +439,21 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
                 read_next = -1;
                 return nullptr;
             } else {
+                if ((hdr_version & DSN_MSG_HDR_VERSION_MASK) ==
+                        DSN_MSG_HDR_VERSION_V1_COMPACT_READY &&
+                    _compact_header_enabled) {
+                    _peer_compact_ready.store(true);
+                }
+                if (hdr_version & DSN_MSG_HDR_COMPRESSION_READY) {
+                    _peer_compression_ready.store(true);
+                }
+
                 reader->_buffer = buf.range(msg_sz);
                 reader->_buffer_occupied -= msg_sz;
                 _header_checked = false;
-                read_next = (reader->_buffer_occupied >= sizeof(message_header)
+                read_next = (reader->_buffer_occupied >= COMPACT_HDR_PREFIX_LENGTH
                                  ? 0
-                                 : sizeof(message_header) - reader->_buffer_occupied);
+                                 : COMPACT_HDR_PREFIX_LENGTH - reader->_buffer_occupied);
                 msg->hdr_format = NET_HDR_DSN;
                 return msg;
             }
@@ -90,12 +461,239 @@ message_ex *dsn_message_parser::get_message_on_receive(message_reader *reader,
             read_next = msg_sz - buf_len;
             return nullptr;
         }
-    } else { // buf_len < sizeof(message_header)
+    } else if (buf_len >= FIELD_OFFSET(message_header, body_length) + sizeof(uint32_t) &&
+               ((message_header *)buf_ptr)->hdr_length == sizeof(message_header) &&
+               (uint64_t)sizeof(message_header) + message_ex::get_body_length(buf_ptr) <=
+                   EARLY_READ_MAX_LENGTH) {
+        // the body length is known before the header is complete, so ask for the whole
+        // message, then the reader may allocate a buffer for it at once rather than read it
+        // into a block first and copy it to a larger buffer later; as the header is not
+        // checked yet, a larger length is not trusted but left to the check below
+        read_next = (int)(sizeof(message_header) + message_ex::get_body_length(buf_ptr) - buf_len);
+        return nullptr;
+    } else if (buf_len >= COMPACT_HDR_PREFIX_LENGTH) {
         read_next = sizeof(message_header) - buf_len;
         return nullptr;
+    } else { // buf_len < COMPACT_HDR_PREFIX_LENGTH
+        read_next = COMPACT_HDR_PREFIX_LENGTH - buf_len;
+        return nullptr;
     }
 }
 
+message_ex *dsn_message_parser::get_compact_message_on_receive(message_reader *reader,
+                                                               /*out*/ int &read_next)
+{
+    dsn::blob &buf = reader->_buffer;
+    char *buf_ptr = (char *)buf.data();
+    unsigned int buf_len = reader->_buffer_occupied;
+
+    message_header *prefix = (message_header *)buf_ptr;
+    unsigned int hdr_len = prefix->hdr_length;
+    uint32_t hdr_version = prefix->hdr_version;
+    if ((hdr_version & DSN_MSG_HDR_VERSION_MASK) != DSN_MSG_HDR_VERSION_COMPACT ||
+        hdr_len < COMPACT_HDR_PREFIX_LENGTH ||
+        hdr_len > COMPACT_HDR_MAX_LENGTH) {
+        derror("dsn compact message header check failed, hdr_version = %u, hdr_length = %u",
+               prefix->hdr_version,
+               hdr_len);
+        read_next = -1;
+        return nullptr;
+    }
+
+    if (buf_len < hdr_len) {
+        read_next = hdr_len - buf_len;
+        return nullptr;
+    }
+
+    if (!_header_checked) {
+        uint32_t *pcrc = &prefix->hdr_crc32;
+        uint32_t crc32 = *pcrc;
+        if (crc32 != CRC_INVALID) {
+            *pcrc = CRC_INVALID;
+            bool r = (crc32 == dsn::utils::crc32_calc(buf_ptr, hdr_len, 0));
+            *pcrc = crc32;
+            if (!r) {
+                derror("dsn compact message header crc check failed");
+                read_next = -1;
+                return nullptr;
+            }
+        }
+        _header_checked = true;
+    }
+
+    // body_length is the second field, peek it before decoding the header
+    const char *p = buf_ptr + COMPACT_HDR_PREFIX_LENGTH;
+    uint64_t flags, body_length;
+    if (!get_varint(p, buf_ptr + hdr_len, flags) ||
+        !get_varint(p, buf_ptr + hdr_len, body_length) || body_length > UINT32_MAX) {
+        derror("dsn compact message header decode failed");
+        read_next = -1;
+        return nullptr;
+    }
+
+    unsigned int msg_sz = hdr_len + (unsigned int)body_length;
+    if (buf_len < msg_sz) {
+        read_next = msg_sz - buf_len;
+        return nullptr;
+    }
+
+    dsn::blob body = buf.range(hdr_len, (int)body_length);
+    if (hdr_version & DSN_MSG_HDR_COMPRESSION_MASK) {
+        dsn::blob raw_body;
+        if (!decompress_on_receive(hdr_version, body, 0, raw_body)) {
+            derror("dsn compact message body decompress failed");
+            read_next = -1;
+            return nullptr;
+        }
+        body = raw_body;
+    }
+
+    message_ex *msg = message_ex::create_receive_message_with_standalone_header(body);
+    message_header &header = *msg->header;
+    if (!decode_compact_header(buf_ptr, hdr_len, header)) {
+        derror("dsn compact message header decode failed");
+        msg->add_ref();
+        msg->release_ref();
+        read_next = -1;
+        return nullptr;
+    }
+    header.body_length = body.length();
+
+    if (header.body_crc32 != CRC_INVALID &&
+        header.body_crc32 != dsn::utils::crc32_calc(body.data(), body.length(), 0)) {
+        derror("dsn message body check failed, id = %" PRIu64 ", trace_id = %016" PRIx64
+               ", rpc_name = %s, from_addr = %s",
+               header.id,
+               header.trace_id,
+               header.rpc_name,
+               header.from_address.to_string());
+        msg->add_ref();
+        msg->release_ref();
+        read_next = -1;
+        return nullptr;
+    }
+
+    _peer_compact_ready.store(true);
+    if (hdr_version & DSN_MSG_HDR_COMPRESSION_READY) {
+        _peer_compression_ready.store(true);
+    }
+
+    reader->_buffer = buf.range(msg_sz);
+    reader->_buffer_occupied -= msg_sz;
+    _header_checked = false;
+    read_next = (reader->_buffer_occupied >= COMPACT_HDR_PREFIX_LENGTH
+                     ? 0
+                     : COMPACT_HDR_PREFIX_LENGTH - reader->_buffer_occupied);
+    msg->hdr_format = NET_HDR_DSN;
+    return msg;
+}
+
+bool dsn_message_parser::decode_compact_header(const char *hdr,
+                                               unsigned int hdr_length,
+                                               message_header &header)
+{
+    const char *p = hdr + COMPACT_HDR_PREFIX_LENGTH;
+    const char *end = hdr + hdr_length;
+    uint64_t flags, v;
+
+    // the header is zeroed by create_receive_message_with_standalone_header()
+    header.hdr_type = *(uint32_t *)"RDSN";
+    // the decoded header is a v1 one, from a peer able to receive the compact header
+    uint32_t hdr_version = ((const message_header *)hdr)->hdr_version;
+    header.hdr_version =
+        DSN_MSG_HDR_VERSION_V1_COMPACT_READY | (hdr_version & DSN_MSG_HDR_COMPRESSION_READY);
+    header.hdr_length = sizeof(message_header);
+    header.hdr_crc32 = CRC_INVALID;
+    header.body_crc32 = CRC_INVALID;
+
+    if (!get_varint(p, end, flags) || (flags & ~(uint64_t)COMPACT_HDR_ALL) != 0)
+        return false;
+
+    if (!get_varint(p, end, v) || v > UINT32_MAX)
+        return false;
+    header.body_length = (uint32_t)v;
+
+    if (!get_varint(p, end, header.id))
+        return false;
+
+    // rpc code, mapped to the local one by the name announced the first time
+    if (!get_varint(p, end, v) || v > COMPACT_HDR_MAX_REMOTE_CODE)
+        return false;
+    if (v >= _recv_rpc_codes.size())
+        _recv_rpc_codes.resize(v + 1, remote_code{-1, std::string()});
+    remote_code &rc = _recv_rpc_codes[v];
+    if (flags & COMPACT_HDR_RPC_NAME) {
+        if (!get_name(p, end, DSN_MAX_TASK_CODE_NAME_LENGTH, rc.name))
+            return false;
+        rc.local_code = task_code::try_get(rc.name, TASK_CODE_INVALID).code();
+    } else if (rc.local_code == -1) {
+        derror("rpc code %" PRIu64 " is used before announced", v);
+        return false;
+    }
+    memcpy(header.rpc_name, rc.name.c_str(), rc.name.length());
+    if (rc.local_code != TASK_CODE_INVALID.code()) {
+        header.rpc_code.local_code = (uint32_t)rc.local_code;
+        header.rpc_code.local_hash = message_ex::s_local_hash;
+    }
+
+    if ((flags & COMPACT_HDR_BODY_CRC) && !get_fixed(p, end, &header.body_crc32, sizeof(uint32_t)))
+        return false;
+
+    if ((flags & COMPACT_HDR_TRACE_ID) && !get_varint(p, end, header.trace_id))
+        return false;
+
+    if (flags & COMPACT_HDR_GPID) {
+        if (!get_varint(p, end, v))
+            return false;
+        header.gpid.set_value(v);
+    }
+
+    if ((flags & COMPACT_HDR_CONTEXT) && !get_varint(p, end, header.context.context))
+        return false;
+
+    if ((flags & COMPACT_HDR_FROM_ADDRESS) &&
+        !get_fixed(p, end, &_last_recv_from_address, sizeof(uint64_t)))
+        return false;
+    static_assert(sizeof(rpc_address) == sizeof(uint64_t), "from_address must be 64 bits");
+    memcpy((void *)&header.from_address, &_last_recv_from_address, sizeof(uint64_t));
+
+    if (flags & COMPACT_HDR_TIMEOUT) {
+        if (!get_varint(p, end, v))
+            return false;
+        header.client.timeout_ms = (int32_t)(uint32_t)v;
+    }
+
+    if (flags & COMPACT_HDR_THREAD_HASH) {
+        if (!get_varint(p, end, v))
+            return false;
+        header.client.thread_hash = (int32_t)(uint32_t)v;
+    }
+
+    if ((flags & COMPACT_HDR_PARTITION_HASH) && !get_varint(p, end, header.client.partition_hash))
+        return false;
+
+    if (flags & COMPACT_HDR_ERROR) {
+        if (!get_varint(p, end, v) || v > COMPACT_HDR_MAX_REMOTE_CODE)
+            return false;
+        if (v >= _recv_error_codes.size())
+            _recv_error_codes.resize(v + 1, remote_code{-1, std::string()});
+        remote_code &ec = _recv_error_codes[v];
+        if (flags & COMPACT_HDR_ERROR_NAME) {
+            if (!get_name(p, end, DSN_MAX_ERROR_CODE_NAME_LENGTH, ec.name))
+                return false;
+            ec.local_code = error_code::try_get(ec.name, ERR_UNKNOWN);
+        } else if (ec.local_code == -1) {
+            derror("error code %" PRIu64 " is used before announced", v);
+            return false;
+        }
+        memcpy(header.server.error_name, ec.name.c_str(), ec.name.length());
+        header.server.error_code.local_code = (uint32_t)ec.local_code;
+        header.server.error_code.local_hash = message_ex::s_local_hash;
+    }
+
+    return p == end;
+}
+
 void dsn_message_parser::prepare_on_send(message_ex *msg)
 {
     auto &header = msg->header;
@@ -110,6 +708,12 @@ void dsn_message_parser::prepare_on_send(message_ex *msg)
     dassert(len == (size_t)header->body_length + sizeof(message_header), "data length is wrong");
 #endif
 
+    // tell the peer whether we can receive the compact header, the version may be
+    // copied from another message (e.g. in create_response()) so it is always reset
+    header->hdr_version =
+        (_compact_header_enabled ? DSN_MSG_HDR_VERSION_V1_COMPACT_READY : DSN_MSG_HDR_VERSION_V1) |
+        DSN_MSG_HDR_LOCAL_COMPRESSION_READY;
+
     if (task_spec::get(msg->local_rpc_code)->rpc_message_crc_required) {
         // compute data crc if necessary (only once for the first time)
         if (header->body_crc32 == CRC_INVALID) {
@@ -139,28 +743,326 @@ void dsn_message_parser::prepare_on_send(message_ex *msg)
             header->body_crc32 = crc32;
         }
 
-        // always compute header crc
+        // compute header crc, unless the v1 header is to be replaced by the compact one,
+        // which is checked by its own crc
         header->hdr_crc32 = CRC_INVALID;
-        header->hdr_crc32 = dsn::utils::crc32_calc(header, sizeof(message_header), 0);
+        if (_compact_header_enabled && _peer_compact_ready.load(std::memory_order_relaxed)) {
+            header->hdr_crc32 = HDR_CRC_DEFERRED;
+        } else {
+            header->hdr_crc32 = dsn::utils::crc32_calc(header, sizeof(message_header), 0);
+        }
     }
+
+    compress_on_send(msg);
+}
+
+void dsn_message_parser::compress_on_send(message_ex *msg)
+{
+    task_spec *spec = task_spec::get(msg->local_rpc_code);
+    rpc_compression_type_t type = spec->rpc_message_compression;
+    size_t raw_size = msg->header->body_length;
+    if (type == RPC_COMPRESSION_NONE ||
+        raw_size < (size_t)spec->rpc_message_compression_threshold ||
+        !_peer_compression_ready.load(std::memory_order_relaxed) ||
+        compressed_body_ext::get(msg) != nullptr) {
+        return;
+    }
+
+    size_t bound = compress_bound(type, raw_size);
+    if (bound == 0)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+
+    // the body follows the header in the first buffer, gather it if it is not contiguous
+    const char *raw = nullptr;
+    std::unique_ptr<char[]> gathered;
+    for (size_t i = 0, offset = 0; i < msg->buffers.size(); i++) {
+        const blob &buf = msg->buffers[i];
+        const char *ptr = buf.data() + (i == 0 ? sizeof(message_header) : 0);
+        size_t sz = buf.length() - (i == 0 ? sizeof(message_header) : 0);
+        if (sz == 0)
+            continue;
+        if (sz == raw_size) {
+            raw = ptr;
+            break;
+        }
+        if (gathered == nullptr)
+            gathered.reset(new char[raw_size]);
+        memcpy(gathered.get() + offset, ptr, sz);
+        offset += sz;
+        raw = gathered.get();
+    }
+
+    std::shared_ptr<char> buffer = utils::make_shared_array<char>(sizeof(uint32_t) + bound);
+    size_t compressed_size =
+        compress_block(type, raw, raw_size, buffer.get() + sizeof(uint32_t), bound);
+
+    auto &counters = get_compression_counters();
+    counters.compress_cpu_us->add(elapsed_us(start));
+
+    // send the raw body if it is not compressible
+    if (compressed_size == 0 || sizeof(uint32_t) + compressed_size >= raw_size)
+        return;
+
+    counters.compress_raw_bytes->add(raw_size);
+    counters.compress_compressed_bytes->add(sizeof(uint32_t) + compressed_size);
+
+    uint32_t raw_length = (uint32_t)raw_size;
+    memcpy(buffer.get(), &raw_length, sizeof(uint32_t));
+
+    // the message may be kept long, e.g. a request is kept until its response, so do
+    // not keep the unused space of the bound
+    size_t length = sizeof(uint32_t) + compressed_size;
+    if (length < bound / 2) {
+        std::shared_ptr<char> fit = utils::make_shared_array<char>(length);
+        memcpy(fit.get(), buffer.get(), length);
+        buffer = std::move(fit);
+    }
+
+    compressed_body *cb = new compressed_body();
+    cb->compression = (uint32_t)type << DSN_MSG_HDR_COMPRESSION_SHIFT;
+    cb->data = blob(std::move(buffer), (unsigned int)length);
+    compressed_body_ext::set(msg, cb);
+}
+
+/*static*/ bool dsn_message_parser::decompress_on_receive(uint32_t hdr_version,
+                                                        const blob &body,
+                                                        unsigned int reserved_head,
+                                                        /*out*/ blob &raw)
+{
+    auto type = (rpc_compression_type_t)((hdr_version & DSN_MSG_HDR_COMPRESSION_MASK) >>
+                                         DSN_MSG_HDR_COMPRESSION_SHIFT);
+    if (body.length() < sizeof(uint32_t))
+        return false;
+
+    uint32_t raw_size;
+    memcpy(&raw_size, body.data(), sizeof(uint32_t));
+    const char *src = body.data() + sizeof(uint32_t);
+    size_t size = body.length() - sizeof(uint32_t);
+    if (!is_raw_size_valid(type, src, size, raw_size)) {
+        derror("invalid raw body length %u of compression type %s",
+               raw_size,
+               enum_to_string(type));
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::shared_ptr<char> buffer = utils::make_shared_array<char>(reserved_head + raw_size);
+    if (!decompress_block(type, src, size, buffer.get() + reserved_head, raw_size))
+        return false;
+
+    auto &counters = get_compression_counters();
+    counters.decompress_cpu_us->add(elapsed_us(start));
+    counters.decompress_raw_bytes->add(raw_size);
+    counters.decompress_compressed_bytes->add(body.length());
+
+    raw = blob(std::move(buffer), reserved_head + raw_size);
+    return true;
 }
 
 int dsn_message_parser::get_buffer_count_on_send(message_ex *msg)
 {
-    return (int)msg->buffers.size();
+    // one more for the compact header, or for the v1 header of the compressed body
+    bool extra_header = _compact_header_enabled || compressed_body_ext::get(msg) != nullptr;
+    return (int)msg->buffers.size() + (extra_header ? 1 : 0);
 }
 
 int dsn_message_parser::get_buffers_on_send(message_ex *msg, /*out*/ send_buf *buffers)
 {
     int i = 0;
+    unsigned int skip = 0;
+
+    // the body compressed in prepare_on_send(), unless the message is resent to a peer
+    // not able to decompress it
+    const compressed_body *cb = compressed_body_ext::get(msg);
+    if (cb != nullptr && !_peer_compression_ready.load(std::memory_order_relaxed))
+        cb = nullptr;
+    uint32_t compression = (cb != nullptr ? cb->compression : 0);
+    uint32_t body_length = (cb != nullptr ? cb->data.length() : msg->header->body_length);
+
+    char *hdr;
+    unsigned int hdr_len;
+    if (_compact_header_enabled && _peer_compact_ready.load(std::memory_order_relaxed) &&
+        (hdr_len = encode_compact_header(msg, compression, body_length, hdr)) > 0) {
+        buffers[i].buf = (void *)hdr;
+        buffers[i].sz = hdr_len;
+        ++i;
+
+        // the v1 header is always at the head of the first buffer
+        skip = sizeof(message_header);
+    } else if (cb != nullptr) {
+        // a copy of the v1 header describing the compressed body
+        message_header wire_header = *msg->header;
+        wire_header.hdr_version |= compression;
+        wire_header.body_length = body_length;
+        if (wire_header.hdr_crc32 != CRC_INVALID) {
+            wire_header.hdr_crc32 = CRC_INVALID;
+            wire_header.hdr_crc32 = dsn::utils::crc32_calc(&wire_header, sizeof(message_header), 0);
+        }
+
+        hdr = alloc_send_buffer(sizeof(message_header));
+        memcpy(hdr, (const void *)&wire_header, sizeof(message_header));
+        buffers[i].buf = (void *)hdr;
+        buffers[i].sz = sizeof(message_header);
+        ++i;
+    }
+
+    if (cb != nullptr) {
+        buffers[i].buf = (void *)cb->data.data();
+        buffers[i].sz = cb->data.length();
+        return i + 1;
+    }
+
+    // the v1 header is sent though the compact one is expected in prepare_on_send
+    if (skip == 0 && msg->header->hdr_crc32 == HDR_CRC_DEFERRED) {
+        msg->header->hdr_crc32 = CRC_INVALID;
+        msg->header->hdr_crc32 = dsn::utils::crc32_calc(msg->header, sizeof(message_header), 0);
+    }
+
     for (auto &buf : msg->buffers) {
-        buffers[i].buf = (void *)buf.data();
-        buffers[i].sz = buf.length();
+        if (skip >= buf.length()) {
+            skip -= buf.length();
+            continue;
+        }
+        buffers[i].buf = (void *)(buf.data() + skip);
+        buffers[i].sz = buf.length() - skip;
+        skip = 0;
         ++i;
     }
     return i;
 }
 
+void dsn_message_parser::on_buffers_sent()
+{
+    // keep the chunks for the next batch
+    _send_chunk_index = 0;
+    _send_chunk_used = 0;
+}
+
+char *dsn_message_parser::alloc_send_buffer(unsigned int size)
+{
+    if (_send_chunk_index < _send_chunks.size() &&
+        _send_chunk_used + size > COMPACT_HDR_SEND_CHUNK_SIZE) {
+        _send_chunk_index++;
+        _send_chunk_used = 0;
+    }
+
+    if (_send_chunk_index == _send_chunks.size()) {
+        _send_chunks.emplace_back(new char[COMPACT_HDR_SEND_CHUNK_SIZE]);
+        _send_chunk_used = 0;
+    }
+
+    char *ptr = _send_chunks[_send_chunk_index].get() + _send_chunk_used;
+    _send_chunk_used += size;
+    return ptr;
+}
+
+unsigned int dsn_message_parser::encode_compact_header(message_ex *msg,
+                                                       uint32_t compression,
+                                                       uint32_t body_length,
+                                                       /*out*/ char *&hdr)
+{
+    auto &header = *msg->header;
+
+    // the names of the codes must be well known locally, otherwise send it in v1
+    int rpc_code = msg->rpc_code().code();
+    if (rpc_code == TASK_CODE_INVALID.code())
+        return 0;
+
+    int err_code = -1;
+    if (header.server.error_name[0] != '\0') {
+        if (header.server.error_code.local_hash != message_ex::s_local_hash)
+            return 0;
+        err_code = (int)header.server.error_code.local_code;
+    }
+
+    uint64_t flags = 0;
+    uint64_t from_address;
+    memcpy(&from_address, (const void *)&header.from_address, sizeof(uint64_t));
+
+    if (!is_sent(_sent_rpc_codes, rpc_code))
+        flags |= COMPACT_HDR_RPC_NAME;
+    if (header.body_crc32 != CRC_INVALID)
+        flags |= COMPACT_HDR_BODY_CRC;
+    if (header.trace_id != 0)
+        flags |= COMPACT_HDR_TRACE_ID;
+    if (header.gpid.value() != 0)
+        flags |= COMPACT_HDR_GPID;
+    if (header.context.context != 0)
+        flags |= COMPACT_HDR_CONTEXT;
+    if (from_address != _last_sent_from_address)
+        flags |= COMPACT_HDR_FROM_ADDRESS;
+    if (header.client.timeout_ms != 0)
+        flags |= COMPACT_HDR_TIMEOUT;
+    if (header.client.thread_hash != 0)
+        flags |= COMPACT_HDR_THREAD_HASH;
+    if (header.client.partition_hash != 0)
+        flags |= COMPACT_HDR_PARTITION_HASH;
+    if (err_code != -1) {
+        flags |= COMPACT_HDR_ERROR;
+        if (!is_sent(_sent_error_codes, err_code))
+            flags |= COMPACT_HDR_ERROR_NAME;
+    }
+
+    hdr = alloc_send_buffer(COMPACT_HDR_MAX_LENGTH);
+    char *p = hdr + COMPACT_HDR_PREFIX_LENGTH;
+
+    p = put_varint(p, flags);
+    p = put_varint(p, body_length);
+    p = put_varint(p, header.id);
+    p = put_varint(p, (uint64_t)rpc_code);
+    if (flags & COMPACT_HDR_RPC_NAME) {
+        p = put_name(p, task_code(rpc_code).to_string(), DSN_MAX_TASK_CODE_NAME_LENGTH);
+        mark_sent(_sent_rpc_codes, rpc_code);
+    }
+    if (flags & COMPACT_HDR_BODY_CRC)
+        p = put_fixed(p, &header.body_crc32, sizeof(uint32_t));
+    if (flags & COMPACT_HDR_TRACE_ID)
+        p = put_varint(p, header.trace_id);
+    if (flags & COMPACT_HDR_GPID)
+        p = put_varint(p, header.gpid.value());
+    if (flags & COMPACT_HDR_CONTEXT)
+        p = put_varint(p, header.context.context);
+    if (flags & COMPACT_HDR_FROM_ADDRESS) {
+        p = put_fixed(p, &from_address, sizeof(uint64_t));
+        _last_sent_from_address = from_address;
+    }
+    if (flags & COMPACT_HDR_TIMEOUT)
+        p = put_varint(p, (uint32_t)header.client.timeout_ms);
+    if (flags & COMPACT_HDR_THREAD_HASH)
+        p = put_varint(p, (uint32_t)header.client.thread_hash);
+    if (flags & COMPACT_HDR_PARTITION_HASH)
+        p = put_varint(p, header.client.partition_hash);
+    if (flags & COMPACT_HDR_ERROR) {
+        p = put_varint(p, (uint64_t)err_code);
+        if (flags & COMPACT_HDR_ERROR_NAME) {
+            p = put_name(p, header.server.error_name, DSN_MAX_ERROR_CODE_NAME_LENGTH);
+            mark_sent(_sent_error_codes, err_code);
+        }
+    }
+
+    unsigned int hdr_len = (unsigned int)(p - hdr);
+    dassert(hdr_len <= COMPACT_HDR_MAX_LENGTH, "compact header is too long, %u", hdr_len);
+
+    // give back the unused space
+    _send_chunk_used -= COMPACT_HDR_MAX_LENGTH - hdr_len;
+
+    message_header *prefix = (message_header *)hdr;
+    prefix->hdr_type = header.hdr_type;
+    prefix->hdr_version =
+        DSN_MSG_HDR_VERSION_COMPACT | DSN_MSG_HDR_LOCAL_COMPRESSION_READY | compression;
+    prefix->hdr_length = hdr_len;
+    prefix->hdr_crc32 = CRC_INVALID;
+
+    // crc is required when prepare_on_send() computes or defers the v1 header crc
+    if (header.hdr_crc32 != CRC_INVALID)
+        prefix->hdr_crc32 = dsn::utils::crc32_calc(hdr, hdr_len, 0);
+
+    return hdr_len;
+}
+
 /*static*/ bool dsn_message_parser::is_right_header(char *hdr)
 {
     uint32_t *pcrc = reinterpret_cast<uint32_t *>(hdr + FIELD_OFFSET(message_header, hdr_crc32));
@@ -38,12 +38,38 @@
 #include <dsn/tool-api/message_parser.h>
 #include <dsn/tool-api/rpc_message.h>
 #include <dsn/utility/ports.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace dsn {
+
+// hdr_version of the rDSN message header, the lowest byte is the header layout:
+//  - 0: v1 peer, fixed-size message_header
+//  - 1: v1 message_header, but the sender is able to receive the compact header
+//  - 2: compact header, see dsn_message_parser.cpp for the wire layout
+#define DSN_MSG_HDR_VERSION_V1 0
+#define DSN_MSG_HDR_VERSION_V1_COMPACT_READY 1
+#define DSN_MSG_HDR_VERSION_COMPACT 2
+#define DSN_MSG_HDR_VERSION_MASK 0xff
+
+// the higher bits of hdr_version are flags, which v1 peers never set nor check:
+//  - the sender is able to receive compressed bodies
+//  - the rpc_compression_type_t of the body on the wire, which is then a uint32_t
+//    raw body length followed by the compressed raw body. body_length and body_crc32
+//    in the header are of the compressed and the raw body respectively
+#define DSN_MSG_HDR_COMPRESSION_READY (0x1 << 8)
+#define DSN_MSG_HDR_COMPRESSION_SHIFT 16
+#define DSN_MSG_HDR_COMPRESSION_MASK (0xff << DSN_MSG_HDR_COMPRESSION_SHIFT)
+
 class dsn_message_parser : public message_parser
 {
 public:
-    dsn_message_parser() : _header_checked(false) {}
+    // the compact header is sent only when it is enabled by [network] compact_message_header
+    // and the remote peer has announced it can receive it (hdr_version >= 1)
+    dsn_message_parser() : dsn_message_parser(is_compact_header_enabled()) {}
+    explicit dsn_message_parser(bool compact_header_enabled);
     virtual ~dsn_message_parser() {}
 
     virtual void reset() override;
@@ -57,12 +83,73 @@ public:
 
     virtual int get_buffers_on_send(message_ex *msg, /*out*/ send_buf *buffers) override;
 
+    virtual void on_buffers_sent() override;
+
+    bool is_peer_compact_ready() const { return _peer_compact_ready.load(); }
+
+    bool is_peer_compression_ready() const { return _peer_compression_ready.load(); }
+
+    static bool is_compact_header_enabled();
+
 private:
     static bool is_right_header(char *hdr);
 
     static bool is_right_body(message_ex *msg);
 
+    message_ex *get_compact_message_on_receive(message_reader *reader, /*out*/ int &read_next);
+
+    // decode the compact header in [hdr, hdr + hdr_length) into 'header',
+    // return false if the header is corrupted
+    bool decode_compact_header(const char *hdr, unsigned int hdr_length, message_header &header);
+
+    // encode the header of 'msg' as a compact header, return its length,
+    // or 0 if the header cannot be encoded compactly (then v1 is sent)
+    // 'compression' is the DSN_MSG_HDR_COMPRESSION_MASK bits of the body sent, whose
+    // length on the wire is 'body_length'
+    unsigned int encode_compact_header(message_ex *msg,
+                                       uint32_t compression,
+                                       uint32_t body_length,
+                                       /*out*/ char *&hdr);
+
+    char *alloc_send_buffer(unsigned int size);
+
+    // compress the body of 'msg' in prepare_on_send() if it is required by its task_spec
+    void compress_on_send(message_ex *msg);
+
+    // decompress 'body' received with 'hdr_version' into 'raw', leaving 'reserved_head'
+    // bytes ahead of the raw body, return false if the body is corrupted
+    static bool decompress_on_receive(uint32_t hdr_version,
+                                      const blob &body,
+                                      unsigned int reserved_head,
+                                      /*out*/ blob &raw);
+
 private:
     bool _header_checked;
+
+    const bool _compact_header_enabled;
+    std::atomic<bool> _peer_compact_ready;
+    std::atomic<bool> _peer_compression_ready;
+
+    // send states, protected by the session lock as get_buffers_on_send() is
+    // called in wire order under the lock.
+    // codes already announced with names to the peer, indexed by local code
+    std::vector<bool> _sent_rpc_codes;
+    std::vector<bool> _sent_error_codes;
+    uint64_t _last_sent_from_address;
+    // compact headers of the messages being sent, recycled in on_buffers_sent()
+    std::vector<std::unique_ptr<char[]>> _send_chunks;
+    size_t _send_chunk_index;
+    unsigned int _send_chunk_used;
+
+    // receive states, accessed by the reading thread only.
+    // codes announced by the peer, indexed by the peer's code
+    struct remote_code
+    {
+        int local_code; // -1 if not announced yet
+        std::string name;
+    };
+    std::vector<remote_code> _recv_rpc_codes;
+    std::vector<remote_code> _recv_error_codes;
+    uint64_t _last_recv_from_address;
 };
 }
@@ -169,6 +169,7 @@ static bool fault_on_aio_call(task *caller, aio_task *callee)
         }
         break;
     case AIO_Write:
+    case AIO_Sync:
         if (dsn_probability() < s_fj_opts[callee->spec().code].disk_write_fail_ratio) {
             ddebug("fault inject %s at %s", callee->spec().name.c_str(), __FUNCTION__);
             callee->set_error_code(ERR_FILE_OPERATION_FAILED);
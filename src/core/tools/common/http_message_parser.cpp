@@ -42,6 +42,7 @@
 #include <iomanip>
 #include "http_message_parser.h"
 #include <dsn/cpp/serialization.h>
+#include <dsn/tool-api/perf_counters.h>
 
 namespace dsn {
 
@@ -75,15 +76,21 @@ http_message_parser::http_message_parser()
 
         dinfo("http call %s", url.c_str());
 
+        auto owner = static_cast<http_message_parser *>(parser->data);
+        auto &hdr = owner->_current_message->header;
+
+        // e.g., /metrics or /metrics?name[]=xxx from prometheus
+        if (url == "/metrics" || url.compare(0, 9, "/metrics?") == 0) {
+            strcpy(hdr->rpc_name, RPC_HTTP_METRICS.to_string());
+            return 0;
+        }
+
         if (args.size() != 3) {
             dinfo("skip url parse for %s, could be done in headers if not cross-domain",
                   url.c_str());
             return 0;
         }
 
-        auto owner = static_cast<http_message_parser *>(parser->data);
-        auto &hdr = owner->_current_message->header;
-
         // serialize-type
         dsn_msg_serialize_format fmt = enum_from_string(args[0].c_str(), DSF_INVALID);
         if (fmt == DSF_INVALID) {
@@ -298,6 +305,19 @@ http_message_parser::http_message_parser()
         owner->_received_messages.emplace(std::move(owner->_current_message));
         return 0;
     };
+    _parser_setting.on_message_complete = [](http_parser *parser) -> int {
+        // a message without body, which is only valid for GET /metrics, while the others
+        // are dropped as before, e.g., a GET or a cross-domain OPTIONS to a rpc url, whose
+        // handler expects a request body
+        auto owner = static_cast<http_message_parser *>(parser->data);
+        if (owner->_current_message != nullptr &&
+            strcmp(owner->_current_message->header->rpc_name, RPC_HTTP_METRICS.to_string()) ==
+                0) {
+            owner->_current_message->header->body_length = 0;
+            owner->_received_messages.emplace(std::move(owner->_current_message));
+        }
+        return 0;
+    };
     http_parser_init(&_parser, HTTP_BOTH);
 }
 
@@ -370,7 +390,11 @@ void http_message_parser::prepare_on_send(message_ex *msg)
         ss << "HTTP/1.1 200 OK\r\n";
         ss << "Access-Control-Allow-Headers: Content-Type, Access-Control-Allow-Headers, "
               "Access-Control-Allow-Origin\r\n";
-        ss << "Content-Type: text/plain\r\n";
+        if (msg->local_rpc_code == RPC_HTTP_METRICS_ACK) {
+            ss << "Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n";
+        } else {
+            ss << "Content-Type: text/plain\r\n";
+        }
         ss << "Access-Control-Allow-Origin: *\r\n";
         ss << "Access-Control-Allow-Methods: POST, GET, OPTIONS\r\n";
         ss << "id: " << header->id << "\r\n";
@@ -102,6 +102,9 @@ void nativerun::install(service_spec &spec)
     for (auto it = spec.threadpool_specs.begin(); it != spec.threadpool_specs.end(); ++it) {
         threadpool_spec &tspec = *it;
 
+        if (tspec.work_stealing)
+            tspec.queue_factory_name = "dsn::tools::work_stealing_task_queue";
+
         if (tspec.worker_factory_name == "")
             tspec.worker_factory_name = ("dsn::task_worker");
 
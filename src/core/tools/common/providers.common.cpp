@@ -43,6 +43,10 @@
 #include "simple_perf_counter_v2_atomic.h"
 #include "simple_perf_counter_v2_fast.h"
 #include "simple_task_queue.h"
+#include "work_stealing_task_queue.h"
+#include "wheel_timer_service.h"
+#include "deadline_task_queue.h"
+#include "codel_admission_controller.h"
 #include "network.sim.h"
 #include "simple_logger.h"
 #include "empty_aio_provider.h"
@@ -68,6 +72,12 @@ void register_common_providers()
     register_component_provider<sim_network_provider>("dsn::tools::sim_network_provider");
     register_component_provider<simple_task_queue>("dsn::tools::simple_task_queue");
     register_component_provider<simple_timer_service>("dsn::tools::simple_timer_service");
+    register_component_provider<wheel_timer_service>("dsn::tools::wheel_timer_service");
+    register_component_provider<deadline_task_queue>("dsn::tools::deadline_task_queue");
+    register_component_provider<codel_admission_controller>(
+        "dsn::tools::codel_admission_controller");
+    register_component_provider<work_stealing_task_queue>(
+        "dsn::tools::work_stealing_task_queue");
 
     register_message_header_parser<dsn_message_parser>(NET_HDR_DSN, {"RDSN"});
     register_message_header_parser<thrift_message_parser>(NET_HDR_THRIFT, {"THFT"});
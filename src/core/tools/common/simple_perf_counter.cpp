@@ -111,7 +111,7 @@ public:
                       const char *name,
                       dsn_perf_counter_type_t type,
                       const char *dsptr)
-        : perf_counter(app, section, name, type, dsptr), _val(0)
+        : perf_counter(app, section, name, type, dsptr), _val(0), _last_val(0)
     {
         qts = 0;
     }
@@ -125,12 +125,13 @@ public:
     {
         uint64_t now = dsn_now_ns();
         uint64_t interval = now - qts;
-        double val = static_cast<double>(_val.load(std::memory_order_relaxed));
+        uint64_t total = _val.load(std::memory_order_relaxed);
+        double val = static_cast<double>(static_cast<int64_t>(total - _last_val.exchange(total)));
         qts = now;
-        _val = 0;
         return val / interval * 1000 * 1000 * 1000;
     }
     virtual uint64_t get_integer_value() { return (uint64_t)get_value(); }
+    virtual uint64_t get_total() const { return _val.load(std::memory_order_relaxed); }
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
     {
         dassert(false, "invalid execution flow");
@@ -138,7 +139,8 @@ public:
     }
 
 private:
-    std::atomic<uint64_t> _val;
+    std::atomic<uint64_t> _val; // accumulated, never reset
+    std::atomic<uint64_t> _last_val;
     std::atomic<uint64_t> qts;
 };
 
@@ -154,7 +154,7 @@ public:
                               const char *name,
                               dsn_perf_counter_type_t type,
                               const char *dsptr)
-        : perf_counter(app, section, name, type, dsptr), _rate(0)
+        : perf_counter(app, section, name, type, dsptr), _rate(0), _last_total(0)
     {
         _last_time = ::dsn::utils::get_current_physical_time_ns();
         for (int i = 0; i < DIVIDE_CONTAINER; i++) {
@@ -181,25 +181,27 @@ public:
     virtual void set(uint64_t val) { dassert(false, "invalid execution flow"); }
     virtual double get_value()
     {
-        double val = 0;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            val += _val[i];
-        }
-
         uint64_t now = ::dsn::utils::get_current_physical_time_ns();
         double interval = (now - _last_time) / 1e9;
         if (interval <= 0.1)
             return _rate;
 
         _last_time = now;
-        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
-            _val[i] = 0;
-        }
+        uint64_t total = get_total();
+        double val = static_cast<double>(static_cast<int64_t>(total - _last_total.exchange(total)));
 
         _rate = val / interval;
         return _rate;
     }
     virtual uint64_t get_integer_value() { return (uint64_t)get_value(); }
+    virtual uint64_t get_total() const
+    {
+        uint64_t total = 0;
+        for (int i = 0; i < DIVIDE_CONTAINER; i++) {
+            total += _val[i];
+        }
+        return total;
+    }
     virtual double get_percentile(dsn_perf_counter_percentile_type_t type)
     {
         dassert(false, "invalid execution flow");
@@ -209,7 +211,8 @@ public:
 private:
     std::atomic<double> _rate;
     std::atomic<uint64_t> _last_time;
-    uint64_t _val[DIVIDE_CONTAINER];
+    std::atomic<uint64_t> _last_total;
+    uint64_t _val[DIVIDE_CONTAINER]; // accumulated, never reset
 };
 
 // -----------   NUMBER_PERCENTILE perf counter ---------------------------------
@@ -87,11 +87,23 @@ simple_task_queue::simple_task_queue(task_worker_pool *pool, int index, task_que
 
 void simple_task_queue::enqueue(task *task) { _samples.enqueue(task, task->spec().priority); }
 
+void simple_task_queue::enqueue_batch(task **tasks, int count)
+{
+    _samples.enqueue_batch(
+        tasks, count, [](task *t) { return static_cast<uint32_t>(t->spec().priority); });
+}
+
 // always return 1 or 0 task so far
 task *simple_task_queue::dequeue(/*inout*/ int &batch_size)
 {
     long c = 0;
-    auto t = _samples.dequeue(c);
+    auto t = _samples.try_dequeue(c);
+    if (t == nullptr) {
+        // account only the time really blocked waiting for new tasks
+        uint64_t start_ns = park_begin();
+        t = _samples.dequeue(c);
+        park_end(start_ns);
+    }
     dassert(t != nullptr, "dequeue does not return empty tasks");
     batch_size = 1;
     return t;
@@ -47,6 +47,7 @@ public:
     simple_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
 
     virtual void enqueue(task *task) override;
+    virtual void enqueue_batch(task **tasks, int count) override;
     virtual task *dequeue(/*inout*/ int &batch_size) override;
 
 private:
@@ -253,7 +253,7 @@ dsn::message_ex *thrift_message_parser::parse_message(const thrift_message_heade
     ::dsn::binary_reader_transport binary_transport(stream);
     boost::shared_ptr<::dsn::binary_reader_transport> trans_ptr(
         &binary_transport, [](::dsn::binary_reader_transport *) {});
-    ::apache::thrift::protocol::TBinaryProtocol iprot(trans_ptr);
+    ::dsn::binary_reader_protocol iprot(trans_ptr);
 
     std::string fname;
     ::apache::thrift::protocol::TMessageType mtype;
@@ -0,0 +1,278 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     timer service based on a hierarchical timing wheel
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include "wheel_timer_service.h"
+
+namespace dsn {
+namespace tools {
+
+// values of _wake_tick besides a real tick
+static const int64_t WAKE_TICK_AWAKE = -1;
+static const int64_t WAKE_TICK_BLOCKED = INT64_MAX;
+
+wheel_timer_service::wheel_timer_service(service_node *node, timer_service *inner_provider)
+    : timer_service(node, inner_provider), _incoming(nullptr), _wake_tick(WAKE_TICK_AWAKE)
+{
+    _tick_ms = dsn_config_get_value_uint64(
+        "tools.wheel_timer_service", "tick_granularity_ms", 1, "tick granularity in milliseconds");
+    if (_tick_ms == 0)
+        _tick_ms = 1;
+
+    _start_ms = dsn_now_ms();
+    _current_tick = 0;
+    _count = 0;
+    memset(_root, 0, sizeof(_root));
+    memset(_levels, 0, sizeof(_levels));
+    _worker = nullptr;
+}
+
+void wheel_timer_service::start(io_modifer &ctx)
+{
+    _worker = std::shared_ptr<std::thread>(new std::thread([this, ctx]() {
+        task::set_tls_dsn_context(node(), nullptr, ctx.queue);
+
+        char buffer[128];
+        sprintf(buffer,
+                "%s.%s.timer",
+                get_service_node_name(node()),
+                ctx.queue ? ctx.queue->get_name().c_str() : "");
+
+        task_worker::set_name(buffer);
+        task_worker::set_priority(worker_priority_t::THREAD_xPRIORITY_ABOVE_NORMAL);
+
+        run();
+    }));
+}
+
+void wheel_timer_service::add_timer(task *task)
+{
+    // round up so that the timer never fires earlier than expected
+    uint64_t expire_ms = dsn_now_ms() - _start_ms + task->delay_milliseconds();
+    uint32_t expire = static_cast<uint32_t>((expire_ms + _tick_ms - 1) / _tick_ms);
+    task->timer.expire_tick = expire;
+    task->timer.owner = this;
+
+    // push to the incoming list, which is moved into the wheel by the ticking thread
+    auto head = _incoming.load(std::memory_order_relaxed);
+    do {
+        task->next = head;
+    } while (!_incoming.compare_exchange_weak(head, task));
+
+    // wake up the ticking thread only if it would sleep past the new timer; paired with the
+    // store of _wake_tick before the ticking thread checks _incoming and waits
+    int64_t wake = _wake_tick.load();
+    if (wake == WAKE_TICK_AWAKE)
+        return;
+    if (wake == WAKE_TICK_BLOCKED ||
+        static_cast<int32_t>(expire - static_cast<uint32_t>(wake)) < 0) {
+        std::lock_guard<std::mutex> l(_lock);
+        _cond.notify_one();
+    }
+}
+
+void wheel_timer_service::cancel_timer(task *task)
+{
+    {
+        std::lock_guard<std::mutex> l(_lock);
+
+        // otherwise it is still in the incoming list, or has been taken out to fire,
+        // and it is dropped there
+        if (task->timer.slot == nullptr)
+            return;
+        unlink(task);
+    }
+
+    // to consume the added ref count by task::enqueue for add_timer
+    task->release_ref();
+}
+
+size_t wheel_timer_service::timer_count()
+{
+    std::lock_guard<std::mutex> l(_lock);
+    return _count;
+}
+
+void wheel_timer_service::run()
+{
+    while (true) {
+        task *expired = nullptr, *t, *next;
+        {
+            std::unique_lock<std::mutex> l(_lock);
+
+            t = _incoming.exchange(nullptr);
+            while (t) {
+                next = t->next;
+                place(t, expired);
+                t = next;
+            }
+
+            // catch up all the passed ticks
+            uint64_t now_ms = dsn_now_ms();
+            uint32_t now_tick = static_cast<uint32_t>((now_ms - _start_ms) / _tick_ms);
+            while (static_cast<int32_t>(now_tick - _current_tick) >= 0) {
+                tick(_current_tick, expired);
+                _current_tick++;
+            }
+
+            if (expired == nullptr) {
+                int64_t wake = next_wake_tick();
+                _wake_tick.store(wake == -1 ? WAKE_TICK_BLOCKED : wake);
+
+                if (_incoming.load() == nullptr) {
+                    if (wake == -1) {
+                        _cond.wait(l);
+                    } else {
+                        uint64_t wake_ms =
+                            _start_ms + ((now_ms - _start_ms) / _tick_ms +
+                                         static_cast<uint32_t>(wake - now_tick)) *
+                                            _tick_ms;
+                        now_ms = dsn_now_ms();
+                        if (wake_ms > now_ms) {
+                            _cond.wait_for(l, std::chrono::milliseconds(wake_ms - now_ms));
+                        }
+                    }
+                }
+                _wake_tick.store(WAKE_TICK_AWAKE);
+            }
+        }
+
+        // fire out of the lock, as cancel_timer may be called in the callbacks
+        t = expired;
+        while (t) {
+            next = t->next;
+            fire(t);
+            t = next;
+        }
+    }
+}
+
+int64_t wheel_timer_service::next_wake_tick()
+{
+    if (_count == 0)
+        return -1;
+
+    // the first occupied slot in the current round of the root level, or the end of the
+    // round where the upper levels are cascaded
+    uint32_t round_end = (_current_tick | (ROOT_SLOTS - 1)) + 1;
+    for (uint32_t t = _current_tick; t != round_end; t++) {
+        if (_root[t & (ROOT_SLOTS - 1)] != nullptr)
+            return t;
+    }
+    return round_end;
+}
+
+void wheel_timer_service::tick(uint32_t t, /*out*/ task *&expired)
+{
+    // move the timers in the upper levels down when the lower level finishes a round
+    uint32_t index = t & (ROOT_SLOTS - 1);
+    for (int level = 0; index == 0 && level < LEVEL_COUNT; level++) {
+        index = (t >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SLOTS - 1);
+        task *tsk;
+        while ((tsk = _levels[level][index]) != nullptr) {
+            unlink(tsk);
+            place(tsk, expired);
+        }
+    }
+
+    task *tsk;
+    while ((tsk = _root[t & (ROOT_SLOTS - 1)]) != nullptr) {
+        unlink(tsk);
+        tsk->next = expired;
+        expired = tsk;
+    }
+}
+
+void wheel_timer_service::place(task *t, /*out*/ task *&expired)
+{
+    uint32_t expire = t->timer.expire_tick;
+    int32_t delta = static_cast<int32_t>(expire - _current_tick);
+
+    // cancelled before being placed, cancel_timer has found nothing to unlink
+    if (delta < 0 || t->state() == TASK_STATE_CANCELLED) {
+        t->next = expired;
+        expired = t;
+    } else if (delta < ROOT_SLOTS) {
+        link(&_root[expire & (ROOT_SLOTS - 1)], t);
+    } else {
+        int level = 0;
+        while (level < LEVEL_COUNT - 1 &&
+               delta >= (int64_t)1 << (ROOT_BITS + (level + 1) * LEVEL_BITS)) {
+            level++;
+        }
+        link(&_levels[level][(expire >> (ROOT_BITS + level * LEVEL_BITS)) & (LEVEL_SLOTS - 1)],
+             t);
+    }
+}
+
+void wheel_timer_service::link(task **slot, task *t)
+{
+    t->timer.slot = slot;
+    t->timer.prev = nullptr;
+    t->next = *slot;
+    if (*slot != nullptr)
+        (*slot)->timer.prev = t;
+    *slot = t;
+    _count++;
+}
+
+void wheel_timer_service::unlink(task *t)
+{
+    if (t->timer.prev != nullptr)
+        t->timer.prev->next = t->next;
+    else
+        *t->timer.slot = t->next;
+    if (t->next != nullptr)
+        t->next->timer.prev = t->timer.prev;
+
+    t->timer.slot = nullptr;
+    t->timer.prev = nullptr;
+    t->next = nullptr;
+    _count--;
+}
+
+void wheel_timer_service::fire(task *t)
+{
+    t->set_delay(0);
+
+    // cancelled timers are dropped here instead of going through the worker queues
+    if (t->state() != TASK_STATE_CANCELLED) {
+        t->enqueue();
+    }
+
+    // to consume the added ref count by task::enqueue for add_timer
+    t->release_ref();
+}
+}
+}
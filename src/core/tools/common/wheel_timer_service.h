@@ -0,0 +1,117 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     timer service based on a hierarchical timing wheel
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include <dsn/tool_api.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace dsn {
+namespace tools {
+
+//
+// a hierarchical timing wheel with 5 levels: the first level has 256 slots of one tick each,
+// and each of the upper levels has 64 slots, each of which covers a whole round of the level
+// below; so the wheel covers 2^32 ticks, which is enough for any int delay in milliseconds.
+//
+// - add_timer is O(1): the timer is pushed to a lock-free incoming list, which is moved into
+//   the wheel by the ticking thread, and the thread is woken up only when the new timer
+//   expires earlier than its next planned wake-up
+// - cancel is O(1): the cancelled timer is unlinked from its slot through cancel_timer
+// - a timer in the upper levels is cascaded at most once per level on its way down
+// - the ticking thread sleeps until the next occupied slot of the root level (or the end
+//   of the current root round when only upper levels are occupied), and blocks when the
+//   wheel is empty
+//
+// with timer_io_mode = IOE_PER_QUEUE, each queue (so each worker of a partitioned pool) has
+// its own wheel and ticking thread.
+//
+// the tick granularity is configured by:
+//   [tools.wheel_timer_service]
+//   tick_granularity_ms = 1
+//
+class wheel_timer_service : public timer_service
+{
+public:
+    wheel_timer_service(service_node *node, timer_service *inner_provider);
+
+    // after milliseconds, the provider should call task->enqueue()
+    virtual void add_timer(task *task) override;
+
+    virtual void cancel_timer(task *task) override;
+
+    virtual void start(io_modifer &ctx) override;
+
+    // inquery, only for test
+    size_t timer_count();
+
+private:
+    void run();
+    // return the tick to wake up at, or -1 if the wheel is empty
+    int64_t next_wake_tick();
+    void tick(uint32_t t, /*out*/ task *&expired);
+    void place(task *t, /*out*/ task *&expired);
+    void link(task **slot, task *t);
+    void unlink(task *t);
+    void fire(task *t);
+
+    static const int ROOT_BITS = 8;
+    static const int LEVEL_BITS = 6;
+    static const int ROOT_SLOTS = 1 << ROOT_BITS;
+    static const int LEVEL_SLOTS = 1 << LEVEL_BITS;
+    static const int LEVEL_COUNT = 4; // except the root level
+
+private:
+    uint64_t _tick_ms;
+    uint64_t _start_ms;
+    uint32_t _current_tick; // next tick to be processed, only accessed by the ticking thread
+
+    std::atomic<task *> _incoming;
+    // the tick the ticking thread is going to wake up at, INT64_MAX when blocked
+    std::atomic<int64_t> _wake_tick;
+
+    // protects the slots, as cancel_timer may be called from any thread
+    std::mutex _lock;
+    std::condition_variable _cond;
+    size_t _count; // timers in the slots
+    task *_root[ROOT_SLOTS];
+    task *_levels[LEVEL_COUNT][LEVEL_SLOTS];
+
+    std::shared_ptr<std::thread> _worker;
+};
+}
+}
@@ -0,0 +1,252 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "work_stealing_task_queue.h"
+#include <map>
+#include <mutex>
+
+namespace dsn {
+namespace tools {
+
+class work_stealing_group
+{
+public:
+    explicit work_stealing_group(int queue_count) : _queues(queue_count, nullptr), _parked(0) {}
+
+    // queues of the same pool are created one by one when the pool is created,
+    // they are grouped by the pool they belong to
+    static std::shared_ptr<work_stealing_group>
+    join(task_worker_pool *pool, int index, int queue_count, work_stealing_task_queue *q)
+    {
+        static std::mutex s_lock;
+        static std::map<task_worker_pool *, std::weak_ptr<work_stealing_group>> s_groups;
+
+        std::lock_guard<std::mutex> l(s_lock);
+        auto g = s_groups[pool].lock();
+        if (g == nullptr) {
+            g = std::make_shared<work_stealing_group>(queue_count);
+            s_groups[pool] = g;
+        }
+
+        dassert(index >= 0 && index < static_cast<int>(g->_queues.size()),
+                "invalid queue index %d, queue count = %d",
+                index,
+                static_cast<int>(g->_queues.size()));
+        g->_queues[index] = q;
+        return g;
+    }
+
+    void leave(int index) { _queues[index] = nullptr; }
+
+    int size() const { return static_cast<int>(_queues.size()); }
+    work_stealing_task_queue *get(int index) const { return _queues[index]; }
+
+    bool has_pending() const
+    {
+        for (auto q : _queues) {
+            if (q != nullptr && q->pending() > 0)
+                return true;
+        }
+        return false;
+    }
+
+    // called after "task_count" tasks are added to q: wake up the owner of q if it is parked,
+    // and wake up parked peers for the remaining tasks so that they can steal them
+    void notify(work_stealing_task_queue *q, int task_count = 1)
+    {
+        if (q->try_unpark() && --task_count == 0)
+            return;
+
+        if (_parked.load(std::memory_order_seq_cst) == 0)
+            return;
+
+        int count = size();
+        for (int i = 1; i < count; i++) {
+            auto peer = _queues[(q->index() + i) % count];
+            if (peer != nullptr && peer->try_unpark() && --task_count == 0)
+                return;
+        }
+    }
+
+    std::atomic<int> &parked_count() { return _parked; }
+
+private:
+    std::vector<work_stealing_task_queue *> _queues;
+    std::atomic<int> _parked;
+};
+
+work_stealing_task_queue::work_stealing_task_queue(task_worker_pool *pool,
+                                                   int index,
+                                                   task_queue *inner_provider)
+    : task_queue(pool, index, inner_provider), _pending(0), _parked(false)
+{
+    _group = work_stealing_group::join(pool, index, worker_count(), this);
+}
+
+work_stealing_task_queue::~work_stealing_task_queue() { _group->leave(index()); }
+
+void work_stealing_task_queue::enqueue(task *task)
+{
+    dassert(task->next == nullptr, "task is not alone");
+    auto idx = static_cast<int>(task->spec().priority);
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        _tasks[idx].add(task);
+        _pending.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    _group->notify(this);
+}
+
+void work_stealing_task_queue::enqueue_batch(task **tasks, int count)
+{
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        for (int i = 0; i < count; i++) {
+            dassert(tasks[i]->next == nullptr, "task is not alone");
+            _tasks[static_cast<int>(tasks[i]->spec().priority)].add(tasks[i]);
+        }
+        _pending.fetch_add(count, std::memory_order_seq_cst);
+    }
+
+    _group->notify(this, count);
+}
+
+task *work_stealing_task_queue::dequeue(/*inout*/ int &batch_size)
+{
+    const int best_batch_size = batch_size;
+    while (true) {
+        batch_size = best_batch_size;
+        task *t = pop_batch(batch_size, best_batch_size);
+        if (t != nullptr)
+            return t;
+
+        batch_size = best_batch_size;
+        t = steal_from_peers(batch_size);
+        if (t != nullptr)
+            return t;
+
+        park();
+    }
+}
+
+bool work_stealing_task_queue::is_empty() const { return !_group->has_pending(); }
+
+task *work_stealing_task_queue::steal(/*inout*/ int &batch_size)
+{
+    // leave at least half of the pending tasks to the owner
+    int limit = std::min(batch_size, (pending() + 1) / 2);
+    if (limit <= 0) {
+        batch_size = 0;
+        return nullptr;
+    }
+    return pop_batch(batch_size, limit);
+}
+
+task *work_stealing_task_queue::pop_batch(/*inout*/ int &batch_size, int limit)
+{
+    task *head = nullptr, *tail = nullptr;
+    int count = 0;
+
+    utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+    // higher priority first
+    for (int i = TASK_PRIORITY_COUNT - 1; i >= 0 && count < limit; --i) {
+        if (_tasks[i].is_empty())
+            continue;
+
+        int c = limit - count;
+        task *t = _tasks[i].pop_batch(c);
+        if (tail != nullptr)
+            tail->next = t;
+        else
+            head = t;
+
+        count += c;
+        tail = t;
+        while (tail->next != nullptr)
+            tail = tail->next;
+    }
+
+    _pending.fetch_sub(count, std::memory_order_seq_cst);
+    batch_size = count;
+    return head;
+}
+
+task *work_stealing_task_queue::steal_from_peers(/*inout*/ int &batch_size)
+{
+    int count = _group->size();
+    for (int i = 1; i < count; i++) {
+        auto peer = _group->get((index() + i) % count);
+        if (peer == nullptr || peer->pending() == 0)
+            continue;
+
+        int c = batch_size;
+        task *t = peer->steal(c);
+        if (t != nullptr) {
+            // the stolen tasks are accounted to this queue from now on,
+            // as the worker decreases the length of its own queue after dequeue
+            peer->decrease_count(c);
+            increase_count(c);
+            batch_size = c;
+            return t;
+        }
+    }
+
+    batch_size = 0;
+    return nullptr;
+}
+
+bool work_stealing_task_queue::try_unpark()
+{
+    if (_parked.load(std::memory_order_seq_cst) && _parked.exchange(false)) {
+        _group->parked_count().fetch_sub(1, std::memory_order_seq_cst);
+        _sema.signal();
+        return true;
+    }
+    return false;
+}
+
+void work_stealing_task_queue::park()
+{
+    _parked.store(true, std::memory_order_seq_cst);
+    _group->parked_count().fetch_add(1, std::memory_order_seq_cst);
+
+    // re-check after being marked as parked, so that an enqueue racing with us
+    // either sees the mark or its task is seen here
+    if (_group->has_pending()) {
+        if (_parked.exchange(false)) {
+            _group->parked_count().fetch_sub(1, std::memory_order_seq_cst);
+            return;
+        }
+        // someone else has unparked us, consume its signal
+    }
+
+    uint64_t start_ns = park_begin();
+    _sema.wait();
+    park_end(start_ns);
+}
+}
+}
@@ -0,0 +1,93 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     work-stealing task queue, each worker of a non-partitioned pool owns one of them
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include <dsn/tool_api.h>
+#include <dsn/utility/link.h>
+#include <dsn/utility/synchronize.h>
+
+namespace dsn {
+namespace tools {
+
+class work_stealing_group;
+
+//
+// when threadpool_spec::work_stealing is on, the pool creates one queue per worker;
+// tasks enqueued from a worker of the same pool go to the worker's own queue, and
+// an idle worker tries to steal tasks from its peers before parking itself.
+//
+// all the queues of a pool form a work_stealing_group, which is shared among them.
+//
+class work_stealing_task_queue : public task_queue
+{
+public:
+    work_stealing_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
+    ~work_stealing_task_queue() override;
+
+    void enqueue(task *task) override;
+    void enqueue_batch(task **tasks, int count) override;
+    task *dequeue(/*inout*/ int &batch_size) override;
+
+    // the tasks of the peers may be stolen, so they are polled as well
+    bool is_empty() const override;
+
+    // steal at most batch_size (and at most half of the pending) tasks from this queue,
+    // the returned tasks are linked by task::next
+    task *steal(/*inout*/ int &batch_size);
+
+    // number of tasks now in this queue, may be stale
+    int pending() const { return _pending.load(std::memory_order_seq_cst); }
+
+    // wake up the owner worker if it is parked, return false if it is not
+    bool try_unpark();
+
+private:
+    task *pop_batch(/*inout*/ int &batch_size, int limit);
+    task *steal_from_peers(/*inout*/ int &batch_size);
+    void park();
+
+private:
+    std::shared_ptr<work_stealing_group> _group;
+
+    utils::ex_lock_nr_spin _lock;
+    slist<task> _tasks[TASK_PRIORITY_COUNT];
+    std::atomic<int> _pending;
+
+    std::atomic<bool> _parked;
+    utils::semaphore _sema;
+};
+}
+}
@@ -114,6 +114,14 @@ void fastrun::install(service_spec &spec)
     for (auto it = spec.threadpool_specs.begin(); it != spec.threadpool_specs.end(); ++it) {
         threadpool_spec &tspec = *it;
 
+        if (tspec.work_stealing) {
+            if (use_mixed_queue) {
+                tspec.work_stealing = false;
+            } else {
+                tspec.queue_factory_name = "dsn::tools::work_stealing_task_queue";
+            }
+        }
+
         if (tspec.worker_factory_name == "")
             tspec.worker_factory_name =
                 use_mixed_queue ? ("dsn::tools::io_looper_task_worker") : "dsn::task_worker";
@@ -93,6 +93,8 @@ hpc_network_provider::hpc_network_provider(rpc_engine *srv, network *inner_provi
     _max_buffer_block_count_per_send = 1; // TODO: after fixing we can increase it
 }
 
+hpc_network_provider::~hpc_network_provider() {}
+
 error_code
 hpc_network_provider::start(rpc_channel channel, int port, bool client_only, io_modifer &ctx)
 {
@@ -55,16 +55,22 @@ typedef int socket_t;
 namespace dsn {
 namespace tools {
 
+#ifdef __linux__
+// create a non-blocking tcp socket, and bind it when addr is not null
+extern socket_t create_tcp_socket(sockaddr_in *addr);
+#endif
+
 class hpc_network_provider : public connection_oriented_network
 {
 public:
     hpc_network_provider(rpc_engine *srv, network *inner_provider);
+    virtual ~hpc_network_provider();
 
     virtual error_code start(rpc_channel channel, int port, bool client_only, io_modifer &ctx);
     virtual ::dsn::rpc_address address() { return _address; }
     virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr);
 
-private:
+protected:
     socket_t _listen_fd;
     ::dsn::rpc_address _address;
     io_looper *_looper;
@@ -72,6 +78,27 @@ private:
 private:
     void do_accept();
 
+#ifdef __linux__
+    // when listener_count() > 1, each listener owns a listening socket on the port
+    // (SO_REUSEPORT) and an io looper of its own with one thread, so that the kernel
+    // shards the connections among them, and all io of a session stays on one thread
+    struct listener
+    {
+        socket_t fd;
+        io_looper *looper;
+        io_loop_callback accept_callback;
+        perf_counter_wrapper session_count;
+
+        listener() : fd(-1), looper(nullptr) {}
+        // stops the looper and closes the socket
+        ~listener();
+    };
+    std::vector<std::unique_ptr<listener>> _listeners;
+
+    error_code start_listeners(int port);
+    void do_accept(socket_t listen_fd, io_looper *looper, perf_counter_wrapper *session_count);
+#endif
+
 public:
     struct ready_event
     {
@@ -117,6 +144,10 @@ public:
     virtual void close_on_fault_injection() override { close(); }
 
     void bind_looper(io_looper *looper, bool delay = false);
+#ifdef __linux__
+    virtual ~hpc_rpc_session();
+    void track_by(perf_counter_wrapper *session_count);
+#endif
     virtual void do_read(int read_next) override;
 
 private:
@@ -143,6 +174,9 @@ protected:
     io_loop_callback _ready_event;
     struct sockaddr_in _peer_addr;
     io_looper *_looper;
+#ifdef __linux__
+    perf_counter_wrapper *_session_count; // of the listener accepting the session, if any
+#endif
 
     // due to the bad design of EPOLLET, we need to
     // use locks to avoid concurrent send/recv
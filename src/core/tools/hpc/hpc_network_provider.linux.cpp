@@ -41,7 +41,7 @@
 
 namespace dsn {
 namespace tools {
-static socket_t create_tcp_socket(sockaddr_in *addr)
+socket_t create_tcp_socket(sockaddr_in *addr)
 {
     socket_t s = -1;
     if ((s = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP)) == -1) {
@@ -93,6 +93,26 @@ hpc_network_provider::hpc_network_provider(rpc_engine *srv, network *inner_provi
     _max_buffer_block_count_per_send = 128;
 }
 
+hpc_network_provider::~hpc_network_provider()
+{
+    if (!_listeners.empty()) {
+        // the loopers are joined before their sockets are closed
+        _listeners.clear();
+    } else if (_listen_fd != -1) {
+        _looper->unbind_io_handle((dsn_handle_t)(intptr_t)_listen_fd, &_accept_event.callback);
+        ::close(_listen_fd);
+    }
+    _listen_fd = -1;
+}
+
+hpc_network_provider::listener::~listener()
+{
+    // deleting the looper stops it and joins its thread
+    delete looper;
+    if (fd != -1)
+        ::close(fd);
+}
+
 error_code
 hpc_network_provider::start(rpc_channel channel, int port, bool client_only, io_modifer &ctx)
 {
@@ -107,6 +127,12 @@ hpc_network_provider::start(rpc_channel channel, int port, bool client_only, io_
 
     _address.assign_ipv4(get_local_ipv4(), port);
 
+    if (!client_only && _listener_count > 1) {
+        if (ctx.mode == IOE_PER_NODE)
+            return start_listeners(port);
+        dwarn("listener_count = %d is ignored as the io loopers are per queue", _listener_count);
+    }
+
     if (!client_only) {
         struct sockaddr_in addr;
         addr.sin_family = AF_INET;
@@ -161,19 +187,92 @@ rpc_session_ptr hpc_network_provider::create_client_session(::dsn::rpc_address s
     return c;
 }
 
-void hpc_network_provider::do_accept()
+error_code hpc_network_provider::start_listeners(int port)
+{
+    const char *node_name = ::dsn::tools::get_service_node_name(node());
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    // all the listeners are set up before any of them accepts, so that on failure they
+    // are simply dropped, with no session bound to their loopers yet
+    for (int i = 0; i < _listener_count; i++) {
+        std::unique_ptr<listener> l(new listener());
+        l->fd = create_tcp_socket(nullptr);
+        if (l->fd == -1) {
+            derror("cannot create listen socket %d on port %d", i, port);
+            _listeners.clear();
+            return ERR_NETWORK_START_FAILED;
+        }
+
+        // must be set on all the sockets before they are bound
+        int reuseport = 1;
+        if (setsockopt(l->fd, SOL_SOCKET, SO_REUSEPORT, (char *)&reuseport, sizeof(reuseport)) !=
+            0) {
+            derror("setsockopt SO_REUSEPORT failed, err = %s", strerror(errno));
+            _listeners.clear();
+            return ERR_NETWORK_START_FAILED;
+        }
+
+        if (bind(l->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(l->fd, SOMAXCONN) != 0) {
+            derror("bind or listen failed, err = %s", strerror(errno));
+            _listeners.clear();
+            return ERR_NETWORK_START_FAILED;
+        }
+
+        char name[128];
+        snprintf(name, sizeof(name), "%d.listener.%d.session.count", port, i);
+        l->session_count.init_global_counter(node_name,
+                                             "network",
+                                             name,
+                                             COUNTER_TYPE_NUMBER,
+                                             "count of the sessions accepted by the listener");
+
+        snprintf(name, sizeof(name), "%d.listener.%d.loop.utilization(%%)", port, i);
+        l->looper = new io_looper();
+        l->looper->init_utilization_counter(node_name, name);
+        l->looper->start(node(), 1);
+        _listeners.push_back(std::move(l));
+    }
+
+    for (auto &l : _listeners) {
+        auto lp = l.get();
+        lp->accept_callback = [this, lp](int err, uint32_t size, uintptr_t lpolp) {
+            this->do_accept(lp->fd, lp->looper, &lp->session_count);
+        };
+        lp->looper->bind_io_handle((dsn_handle_t)(intptr_t)lp->fd,
+                                   &lp->accept_callback,
+                                   EPOLLIN | EPOLLET,
+                                   nullptr // network_provider is a global object
+                                   );
+    }
+
+    _listen_fd = _listeners[0]->fd;
+    return ERR_OK;
+}
+
+void hpc_network_provider::do_accept() { do_accept(_listen_fd, _looper, nullptr); }
+
+void hpc_network_provider::do_accept(socket_t listen_fd,
+                                     io_looper *looper,
+                                     perf_counter_wrapper *session_count)
 {
     while (true) {
         struct sockaddr_in addr;
         socklen_t addr_len = (socklen_t)sizeof(addr);
-        socket_t s = ::accept(_listen_fd, (struct sockaddr *)&addr, &addr_len);
+        socket_t s = ::accept(listen_fd, (struct sockaddr *)&addr, &addr_len);
         if (s != -1) {
             ::dsn::rpc_address client_addr(ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port));
             message_parser_ptr null_parser;
             auto rs = new hpc_rpc_session(s, null_parser, *this, client_addr, false);
             rpc_session_ptr s1(rs);
 
-            rs->bind_looper(_looper);
+            if (session_count) {
+                rs->track_by(session_count);
+            }
+            rs->bind_looper(looper);
             this->on_server_session_accepted(s1);
         } else {
             if (errno != EAGAIN && errno != EWOULDBLOCK) {
@@ -184,6 +283,19 @@ void hpc_network_provider::do_accept()
     }
 }
 
+hpc_rpc_session::~hpc_rpc_session()
+{
+    if (_session_count) {
+        (*_session_count)->decrement();
+    }
+}
+
+void hpc_rpc_session::track_by(perf_counter_wrapper *session_count)
+{
+    _session_count = session_count;
+    (*_session_count)->increment();
+}
+
 void hpc_rpc_session::bind_looper(io_looper *looper, bool delay)
 {
     _looper = looper;
@@ -399,6 +511,7 @@ hpc_rpc_session::hpc_rpc_session(socket_t sock,
     _sending_signature = 0;
     _sending_buffer_start_index = 0;
     _looper = nullptr;
+    _session_count = nullptr;
 
     memset((void *)&_peer_addr, 0, sizeof(_peer_addr));
     _peer_addr.sin_family = AF_INET;
@@ -36,6 +36,12 @@
 #include "hpc_task_queue.h"
 #include <boost/function_output_iterator.hpp>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace dsn {
 namespace tools {
 hpc_task_queue::hpc_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider)
@@ -53,12 +59,35 @@ void hpc_task_queue::enqueue(task *task)
     _cond.notify_one();
 }
 
+void hpc_task_queue::enqueue_batch(task **tasks, int count)
+{
+    {
+        utils::auto_lock<::dsn::utils::ex_lock_nr_spin> l(_lock);
+        for (int i = 0; i < count; i++) {
+            dassert(tasks[i]->next == nullptr, "task is not alone");
+            _tasks.add(tasks[i]);
+        }
+    }
+
+    if (count >= worker_count()) {
+        _cond.notify_all();
+    } else {
+        for (int i = 0; i < count; i++) {
+            _cond.notify_one();
+        }
+    }
+}
+
 task *hpc_task_queue::dequeue(/*inout*/ int &batch_size)
 {
     task *t;
 
     _lock.lock();
-    _cond.wait(_lock, [=] { return !_tasks.is_empty(); });
+    if (_tasks.is_empty()) {
+        uint64_t start_ns = park_begin();
+        _cond.wait(_lock, [=] { return !_tasks.is_empty(); });
+        park_end(start_ns);
+    }
     t = _tasks.pop_batch(batch_size);
     _lock.unlock();
 
@@ -84,11 +113,38 @@ void hpc_task_priority_queue::enqueue(task *task)
     _sema.signal();
 }
 
+void hpc_task_priority_queue::enqueue_batch(task **tasks, int count)
+{
+    for (int p = 0; p < TASK_PRIORITY_COUNT; p++) {
+        bool locked = false;
+        for (int i = 0; i < count; i++) {
+            if (static_cast<int>(tasks[i]->spec().priority) != p)
+                continue;
+
+            dassert(tasks[i]->next == nullptr, "task is not alone");
+            if (!locked) {
+                _lock[p].lock();
+                locked = true;
+            }
+            _tasks[p].add(tasks[i]);
+        }
+        if (locked) {
+            _lock[p].unlock();
+        }
+    }
+
+    _sema.signal(count);
+}
+
 task *hpc_task_priority_queue::dequeue(/*inout*/ int &batch_size)
 {
     task *t = nullptr;
 
-    _sema.wait();
+    if (!_sema.try_wait()) {
+        uint64_t start_ns = park_begin();
+        _sema.wait();
+        park_end(start_ns);
+    }
 
     for (auto i = TASK_PRIORITY_COUNT - 1; i >= 0; --i) {
         _lock[i].lock();
@@ -104,6 +160,170 @@ task *hpc_task_priority_queue::dequeue(/*inout*/ int &batch_size)
     return t;
 }
 
+hpc_mpsc_task_queue::hpc_mpsc_task_queue(task_worker_pool *pool,
+                                         int index,
+                                         task_queue *inner_provider)
+    : task_queue(pool, index, inner_provider), _sleeping(0)
+{
+    dassert(!is_shared(),
+            "%s: hpc_mpsc_task_queue only allows one consumer, "
+            "please use it for partitioned pools or pools with one worker",
+            get_name().c_str());
+
+    for (auto &p : _pushed) {
+        p.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+void hpc_mpsc_task_queue::enqueue(task *task)
+{
+    dassert(task->next == nullptr, "task is not alone");
+    auto &head = _pushed[task->spec().priority];
+
+    task->next = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(
+        task->next, task, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+    }
+
+    if (_sleeping.load(std::memory_order_seq_cst) != 0) {
+        unpark();
+    }
+}
+
+void hpc_mpsc_task_queue::enqueue_batch(task **tasks, int count)
+{
+    // link the tasks of each priority in reversed order, as the consumer reverses
+    // the pushed stack, and push each chain with one CAS
+    for (int p = 0; p < TASK_PRIORITY_COUNT; p++) {
+        task *first = nullptr, *last = nullptr;
+        for (int i = 0; i < count; i++) {
+            if (static_cast<int>(tasks[i]->spec().priority) != p)
+                continue;
+
+            dassert(tasks[i]->next == nullptr, "task is not alone");
+            tasks[i]->next = first;
+            first = tasks[i];
+            if (last == nullptr)
+                last = tasks[i];
+        }
+        if (first == nullptr)
+            continue;
+
+        auto &head = _pushed[p];
+        last->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(
+            last->next, first, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        }
+    }
+
+    if (_sleeping.load(std::memory_order_seq_cst) != 0) {
+        unpark();
+    }
+}
+
+task *hpc_mpsc_task_queue::dequeue(/*inout*/ int &batch_size)
+{
+    const int best_batch_size = batch_size;
+    task *head = nullptr, *tail = nullptr;
+    int count = 0;
+
+    while (true) {
+        for (int i = TASK_PRIORITY_COUNT - 1; i >= 0 && count < best_batch_size; --i) {
+            if (_local[i].is_empty() &&
+                _pushed[i].load(std::memory_order_relaxed) != nullptr) {
+                // take all the pushed tasks at once, which are in LIFO order
+                task *t = _pushed[i].exchange(nullptr, std::memory_order_acquire);
+                task *reversed = nullptr;
+                while (t != nullptr) {
+                    task *next = t->next;
+                    t->next = reversed;
+                    reversed = t;
+                    t = next;
+                }
+                _local[i]._first = reversed;
+                _local[i]._last = reversed;
+                while (_local[i]._last != nullptr && _local[i]._last->next != nullptr) {
+                    _local[i]._last = _local[i]._last->next;
+                }
+            }
+
+            if (_local[i].is_empty())
+                continue;
+
+            int c = best_batch_size - count;
+            task *t = _local[i].pop_batch(c);
+            if (tail != nullptr)
+                tail->next = t;
+            else
+                head = t;
+
+            count += c;
+            tail = t;
+            while (tail->next != nullptr)
+                tail = tail->next;
+        }
+
+        if (count > 0) {
+            batch_size = count;
+            return head;
+        }
+
+        park();
+    }
+}
+
+bool hpc_mpsc_task_queue::has_pushed_tasks() const
+{
+    for (auto &p : _pushed) {
+        if (p.load(std::memory_order_seq_cst) != nullptr)
+            return true;
+    }
+    return false;
+}
+
+void hpc_mpsc_task_queue::park()
+{
+    _sleeping.store(1, std::memory_order_seq_cst);
+
+    // re-check after the mark is set, so that a racing producer either sees
+    // the mark and wakes us up, or its task is seen here
+    if (!has_pushed_tasks()) {
+        uint64_t start_ns = park_begin();
+#ifdef __linux__
+        // returns immediately if the word is no longer 1
+        syscall(SYS_futex,
+                reinterpret_cast<int *>(&_sleeping),
+                FUTEX_WAIT_PRIVATE,
+                1,
+                nullptr,
+                nullptr,
+                0);
+#else
+        _wakeup.wait();
+#endif
+        park_end(start_ns);
+    }
+
+    _sleeping.store(0, std::memory_order_relaxed);
+}
+
+void hpc_mpsc_task_queue::unpark()
+{
+    if (_sleeping.exchange(0, std::memory_order_seq_cst) == 1) {
+#ifdef __linux__
+        syscall(SYS_futex,
+                reinterpret_cast<int *>(&_sleeping),
+                FUTEX_WAKE_PRIVATE,
+                1,
+                nullptr,
+                nullptr,
+                0);
+#else
+        _wakeup.notify();
+#endif
+    }
+}
+
 hpc_concurrent_task_queue::hpc_concurrent_task_queue(task_worker_pool *pool,
                                                      int index,
                                                      task_queue *inner_provider)
@@ -116,9 +336,28 @@ void hpc_concurrent_task_queue::enqueue(task *task)
     _queues[task->spec().priority].q.enqueue(task);
     _sema.signal(1);
 }
+
+void hpc_concurrent_task_queue::enqueue_batch(task **tasks, int count)
+{
+    // tasks of a batch usually share the same priority
+    int begin = 0;
+    for (int i = 1; i <= count; i++) {
+        if (i == count || tasks[i]->spec().priority != tasks[begin]->spec().priority) {
+            _queues[tasks[begin]->spec().priority].q.enqueue_bulk(tasks + begin, i - begin);
+            begin = i;
+        }
+    }
+    _sema.signal(count);
+}
 task *hpc_concurrent_task_queue::dequeue(int &batch_size)
 {
-    batch_size = _sema.waitMany(batch_size);
+    auto n = _sema.tryWaitMany(batch_size);
+    if (n == 0) {
+        uint64_t start_ns = park_begin();
+        n = _sema.waitMany(batch_size);
+        park_end(start_ns);
+    }
+    batch_size = static_cast<int>(n);
     if (batch_size == 0) {
         return nullptr;
     }
@@ -48,6 +48,7 @@ public:
     hpc_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
 
     void enqueue(task *task) override;
+    void enqueue_batch(task **tasks, int count) override;
     task *dequeue(/*inout*/ int &batch_size) override;
 
 private:
@@ -62,6 +63,7 @@ public:
     hpc_task_priority_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
 
     void enqueue(task *task) override;
+    void enqueue_batch(task **tasks, int count) override;
     task *dequeue(/*inout*/ int &batch_size) override;
 
 private:
@@ -70,6 +72,40 @@ private:
     utils::semaphore _sema;
 };
 
+//
+// lock-free queue for single-consumer queues, i.e., the queues of partitioned pools
+// (or of pools with only one worker):
+// - producers push tasks onto a per-priority intrusive stack linked by task::next;
+// - the consumer takes all the pushed tasks of a priority with one atomic exchange,
+//   and keeps them in a private list for the following dequeues;
+// - the consumer parks itself on a futex when there is nothing to do.
+//
+class hpc_mpsc_task_queue : public task_queue
+{
+public:
+    hpc_mpsc_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
+
+    void enqueue(task *task) override;
+    void enqueue_batch(task **tasks, int count) override;
+    task *dequeue(/*inout*/ int &batch_size) override;
+
+private:
+    bool has_pushed_tasks() const;
+    void park();
+    void unpark();
+
+private:
+    // shared with producers
+    std::atomic<task *> _pushed[TASK_PRIORITY_COUNT];
+    std::atomic<int> _sleeping; // futex word, 1 when the consumer is parked
+
+    // owned by the consumer
+    slist<task> _local[TASK_PRIORITY_COUNT];
+#ifndef __linux__
+    utils::notify_event _wakeup;
+#endif
+};
+
 class hpc_concurrent_task_queue : public task_queue
 {
     moodycamel::details::mpmc_sema::LightweightSemaphore _sema;
@@ -82,6 +118,7 @@ public:
     hpc_concurrent_task_queue(task_worker_pool *pool, int index, task_queue *inner_provider);
 
     void enqueue(task *task) override;
+    void enqueue_batch(task **tasks, int count) override;
 
     task *dequeue(/*inout*/ int &batch_size) override;
 };
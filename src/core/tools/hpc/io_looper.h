@@ -36,6 +36,7 @@
 
 #include <dsn/utility/ports.h>
 #include <dsn/tool_api.h>
+#include <dsn/cpp/perf_counter_wrapper.h>
 
 #ifndef _WIN32
 
@@ -110,6 +111,10 @@ public:
 
     void add_timer(task *timer); // return next firing delay ms
 
+    // report the percentage of time the loop workers spend on handling the events,
+    // refreshed every second
+    void init_utilization_counter(const char *app, const char *name);
+
 protected:
     virtual bool is_shared_timer_queue() { return true; }
     void exec_timer_tasks(bool local_exec);
@@ -147,6 +152,12 @@ private:
     ::dsn::utils::ex_lock_nr_spin _remote_timer_tasks_lock;
     std::map<uint64_t, slist<task>> _remote_timer_tasks; // ts (ms) => task
     std::map<uint64_t, slist<task>> _local_timer_tasks;
+
+    // utilization
+    perf_counter_wrapper _utilization_counter;
+    std::atomic<uint64_t> _busy_ns;
+    std::atomic<uint64_t> _utilization_window_start_ns;
+    void account_busy_time(uint64_t start_ns, uint64_t end_ns);
 };
 
 // --------------- inline implementation -------------------------
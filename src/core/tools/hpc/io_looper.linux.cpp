@@ -36,6 +36,7 @@
 #if defined(__linux__)
 
 #include "io_looper.h"
+#include <dsn/utility/numa.h>
 #include <sys/eventfd.h>
 
 namespace dsn {
@@ -176,6 +177,9 @@ void io_looper::start(service_node *node, int worker_count)
             sprintf(buffer, "%s.io-loop.%d", name, i);
             task_worker::set_name(buffer);
 
+            // so that the receive buffers allocated in this thread are node-local
+            utils::numa_bind_io_thread();
+
             this->loop_worker();
         });
         _workers.push_back(thr);
@@ -201,7 +205,8 @@ void io_looper::loop_worker()
 
     while (true) {
         int nfds = epoll_wait(_io_queue, _events, max_event_count, 1); // 1ms for timers
-        if (nfds == 0)                                                 // timeout
+        uint64_t start_ns = _utilization_counter.get() ? dsn_now_ns() : 0;
+        if (nfds == 0) // timeout
         {
             handle_local_queues();
         } else if (-1 == nfds) {
@@ -250,6 +255,10 @@ void io_looper::loop_worker()
                 (*cb)(0, 0, (uintptr_t)_events[i].events);
             }
         }
+
+        if (start_ns != 0) {
+            account_busy_time(start_ns, dsn_now_ns());
+        }
     }
 }
 }
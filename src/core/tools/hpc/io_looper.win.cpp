@@ -36,6 +36,7 @@
 #ifdef _WIN32
 
 #include "io_looper.h"
+#include <dsn/utility/numa.h>
 
 #define NON_IO_TASK_NOTIFICATION_KEY 2
 
@@ -97,6 +98,9 @@ void io_looper::start(service_node *node, int worker_count)
             sprintf(buffer, "%s.io-loop.%d", name, i);
             task_worker::set_name(buffer);
 
+            // so that the receive buffers allocated in this thread are node-local
+            utils::numa_bind_io_thread();
+
             this->loop_worker();
         });
         _workers.push_back(thr);
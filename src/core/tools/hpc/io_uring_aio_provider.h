@@ -0,0 +1,97 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     disk aio provider based on io_uring
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include "hpc_aio_provider.h"
+#include "io_uring_queue.h"
+#include <atomic>
+
+#ifdef DSN_HAS_IO_URING
+
+namespace dsn {
+namespace tools {
+
+//
+// disk aio provider based on io_uring, one ring for all files of the disk engine:
+//  - a write with disk_aio::sync_data is submitted together with a fdatasync linked
+//    after it, so e.g., a log append and its sync take one submission
+//  - AIO_Sync is a standalone fdatasync
+//  - completions are reaped in bulk on the io_looper when the eventfd registered to
+//    the ring is signaled, and the reads/writes issued meanwhile (e.g., the next
+//    ones in the queues of the disk files) are submitted at once
+//  - the sqes prepared on other threads are submitted by the looper as well, which
+//    is woken up through the same eventfd, so they are batched too
+//
+// it falls back to hpc_aio_provider (libaio) when io_uring is not usable
+//
+class io_uring_aio_provider : public aio_provider
+{
+public:
+    io_uring_aio_provider(disk_engine *disk, aio_provider *inner_provider);
+    virtual ~io_uring_aio_provider();
+
+    virtual dsn_handle_t open(const char *file_name, int flag, int pmode) override;
+    virtual error_code close(dsn_handle_t fh) override;
+    virtual error_code flush(dsn_handle_t fh) override;
+    virtual void aio(aio_task *aio) override;
+    virtual disk_aio *prepare_aio_context(aio_task *tsk) override;
+    virtual bool support_async_sync() const override { return _fallback == nullptr; }
+
+    virtual void start(io_modifer &ctx) override;
+
+private:
+    bool open_ring();
+    void on_ring_ready();
+    void on_completed(const struct io_uring_cqe &cqe);
+
+private:
+    std::unique_ptr<hpc_aio_provider> _fallback;
+    io_uring_queue _ring;
+    int _event_fd;
+    io_looper *_looper;
+    io_loop_callback _ring_event;
+
+    // sqes are prepared out of the looper and a wake-up is pending for submitting them
+    std::atomic<bool> _submit_pending;
+
+    // cqes are reaped by one looper thread at a time
+    ::dsn::utils::ex_lock_nr_spin _reap_lock;
+    static __thread io_uring_aio_provider *s_reaping_provider;
+};
+}
+}
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     disk aio provider based on io_uring
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include "io_uring_aio_provider.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include "mix_all_io_looper.h"
+#include <fcntl.h>
+#include <sys/eventfd.h>
+
+namespace dsn {
+namespace tools {
+
+struct io_uring_disk_aio_context : public disk_aio
+{
+    aio_task *tsk;
+    int pending;     // cqes not reaped yet
+    int result;      // of the read/write/sync
+    int sync_result; // of the sync linked after the write
+};
+
+// user_data of the sync linked after a write, the context is at least 8-byte aligned
+static const uint64_t LINKED_SYNC_TAG = 1;
+
+__thread io_uring_aio_provider *io_uring_aio_provider::s_reaping_provider = nullptr;
+
+io_uring_aio_provider::io_uring_aio_provider(disk_engine *disk, aio_provider *inner_provider)
+    : aio_provider(disk, inner_provider)
+{
+    _event_fd = -1;
+    _looper = nullptr;
+    _submit_pending = false;
+
+    if (!open_ring()) {
+        dwarn("io_uring is not usable, fall back to hpc_aio_provider");
+        _fallback.reset(new hpc_aio_provider(disk, inner_provider));
+    }
+}
+
+io_uring_aio_provider::~io_uring_aio_provider()
+{
+    _ring.close();
+    if (_event_fd != -1) {
+        ::close(_event_fd);
+        _event_fd = -1;
+    }
+}
+
+bool io_uring_aio_provider::open_ring()
+{
+    unsigned int queue_depth = (unsigned int)dsn_config_get_value_uint64(
+        "core", "aio_io_uring_queue_depth", 256, "submission queue depth of the disk io_uring");
+
+    if (!_ring.open(queue_depth))
+        return false;
+
+    for (auto opcode : {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC}) {
+        if (!_ring.is_supported(opcode)) {
+            dwarn("io_uring op %d is not supported", (int)opcode);
+            _ring.close();
+            return false;
+        }
+    }
+
+    _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd == -1 || !_ring.register_eventfd(_event_fd)) {
+        dwarn("create eventfd for io_uring failed, err = %s", strerror(errno));
+        _ring.close();
+        return false;
+    }
+
+    return true;
+}
+
+void io_uring_aio_provider::start(io_modifer &ctx)
+{
+    if (_fallback) {
+        _fallback->start(ctx);
+        return;
+    }
+
+    _looper = get_io_looper(node(), ctx.queue, ctx.mode);
+    _ring_event = [this](int err, uint32_t size, uintptr_t lpolp) { this->on_ring_ready(); };
+    _looper->bind_io_handle((dsn_handle_t)(intptr_t)_event_fd, &_ring_event, EPOLLIN | EPOLLET);
+}
+
+dsn_handle_t io_uring_aio_provider::open(const char *file_name, int oflag, int pmode)
+{
+    return (dsn_handle_t)(uintptr_t)::open(file_name, oflag, pmode);
+}
+
+error_code io_uring_aio_provider::close(dsn_handle_t fh)
+{
+    if (fh == DSN_INVALID_FILE_HANDLE || ::close((int)(uintptr_t)(fh)) == 0) {
+        return ERR_OK;
+    } else {
+        derror("close file failed, err = %s", strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+}
+
+error_code io_uring_aio_provider::flush(dsn_handle_t fh)
+{
+    if (fh == DSN_INVALID_FILE_HANDLE || ::fsync((int)(uintptr_t)(fh)) == 0) {
+        return ERR_OK;
+    } else {
+        derror("flush file failed, err = %s", strerror(errno));
+        return ERR_FILE_OPERATION_FAILED;
+    }
+}
+
+disk_aio *io_uring_aio_provider::prepare_aio_context(aio_task *tsk)
+{
+    if (_fallback)
+        return _fallback->prepare_aio_context(tsk);
+
+    auto r = new io_uring_disk_aio_context;
+    r->tsk = tsk;
+    r->pending = 0;
+    r->result = 0;
+    r->sync_result = 0;
+    return r;
+}
+
+void io_uring_aio_provider::aio(aio_task *aio_tsk)
+{
+    if (_fallback) {
+        _fallback->aio(aio_tsk);
+        return;
+    }
+
+    auto aio = (io_uring_disk_aio_context *)aio_tsk->aio();
+    int fd = static_cast<int>((ssize_t)aio->file);
+    bool link_sync = (aio->type == AIO_Write && aio->sync_data);
+
+    aio->pending = link_sync ? 2 : 1;
+    aio->result = 0;
+    aio->sync_result = 0;
+
+    bool queued = false;
+    {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_ring.sq_lock());
+        if (_ring.reserve((unsigned int)aio->pending)) {
+            auto sqe = _ring.get_sqe();
+            switch (aio->type) {
+            case AIO_Read:
+                sqe->opcode = IORING_OP_READ;
+                break;
+            case AIO_Write:
+                sqe->opcode = IORING_OP_WRITE;
+                break;
+            case AIO_Sync:
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                break;
+            default:
+                dassert(false, "unknown aio type %u", static_cast<int>(aio->type));
+            }
+            sqe->fd = fd;
+            if (aio->type != AIO_Sync) {
+                sqe->addr = (uint64_t)(uintptr_t)aio->buffer;
+                sqe->len = aio->buffer_size;
+                sqe->off = aio->file_offset;
+            }
+            sqe->user_data = (uint64_t)(uintptr_t)aio;
+
+            // the sync starts after the write completes, and is cancelled
+            // with -ECANCELED when the write fails or is short
+            if (link_sync) {
+                sqe->flags |= IOSQE_IO_LINK;
+
+                sqe = _ring.get_sqe();
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                sqe->fd = fd;
+                sqe->user_data = (uint64_t)(uintptr_t)aio | LINKED_SYNC_TAG;
+            }
+            queued = true;
+        }
+    }
+
+    // aio may be completed and freed from now on
+    if (queued) {
+        // the sqes are submitted in batch by the looper rather than one syscall per call,
+        // the reaping thread does it when it is done with the cqes, others wake the looper
+        // unless a wake-up is on the way already
+        if (s_reaping_provider != this && !_submit_pending.exchange(true)) {
+            int64_t one = 1;
+            if (write(_event_fd, &one, sizeof(one)) < 0) {
+                derror("wake up io_uring looper failed, err = %s", strerror(errno));
+            }
+        }
+        return;
+    }
+
+    derror("io_uring submission queue is full, required = %d", aio->pending);
+    complete_io(aio_tsk, ERR_FILE_OPERATION_FAILED, 0);
+}
+
+void io_uring_aio_provider::on_ring_ready()
+{
+    // the eventfd is merely a wake-up signal, consume it before reaping
+    // so that the completions posted later are notified again
+    int64_t notify_count = 0;
+    if (read(_event_fd, &notify_count, sizeof(notify_count)) < 0) {
+        // possibly consumed already by other looper threads
+    }
+
+    // the sqes prepared by aio() out of the looper since the last wake-up, cleared before
+    // submitting so that the ones prepared meanwhile wake the looper again
+    if (_submit_pending.exchange(false)) {
+        utils::auto_lock<utils::ex_lock_nr_spin> l(_ring.sq_lock());
+        _ring.submit();
+    }
+
+    while (_ring.has_completions()) {
+        // completions are left to the thread already reaping, which checks
+        // for them again after unlocking
+        if (!_reap_lock.try_lock())
+            return;
+
+        s_reaping_provider = this;
+        _ring.reap([this](const struct io_uring_cqe &cqe) { this->on_completed(cqe); });
+
+        // batch submission of the sqes prepared during reaping
+        {
+            utils::auto_lock<utils::ex_lock_nr_spin> l(_ring.sq_lock());
+            _ring.submit();
+        }
+        s_reaping_provider = nullptr;
+        _reap_lock.unlock();
+    }
+}
+
+void io_uring_aio_provider::on_completed(const struct io_uring_cqe &cqe)
+{
+    auto aio = (io_uring_disk_aio_context *)(uintptr_t)(cqe.user_data & ~LINKED_SYNC_TAG);
+    if (cqe.user_data & LINKED_SYNC_TAG) {
+        aio->sync_result = cqe.res;
+    } else {
+        aio->result = cqe.res;
+    }
+
+    if (--aio->pending > 0)
+        return;
+
+    error_code ec;
+    uint32_t bytes = 0;
+    if (aio->result < 0) {
+        derror("aio error, err = %s", strerror(-aio->result));
+        ec = ERR_FILE_OPERATION_FAILED;
+    } else if (aio->sync_result < 0) {
+        derror("sync after write failed, written = %d, err = %s",
+               aio->result,
+               strerror(-aio->sync_result));
+        ec = ERR_FILE_OPERATION_FAILED;
+        bytes = (uint32_t)aio->result;
+    } else {
+        bytes = (uint32_t)aio->result;
+        ec = (bytes > 0 || aio->type == AIO_Sync) ? ERR_OK : ERR_HANDLE_EOF;
+    }
+
+    complete_io(aio->tsk, ec, bytes);
+}
+}
+} // end namespace dsn::tools
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     tcp network provider based on io_uring
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include "hpc_network_provider.h"
+#include "io_uring_queue.h"
+
+#ifdef DSN_HAS_IO_URING
+
+namespace dsn {
+namespace tools {
+
+class io_uring_network_provider;
+class io_uring_rpc_session;
+
+//
+// the io_uring of an io looper, shared by all the io_uring network providers on the looper,
+// so that the sockets of different loopers are served by different rings:
+//  - completions are reaped on the looper when the eventfd registered to the ring is
+//    signaled, and all sqes prepared meanwhile are submitted at once
+//  - the reaping is only serialized among the threads of the same looper
+//
+class io_uring_looper_ring
+{
+public:
+    // tag of the sqes, passed as the user_data
+    struct op
+    {
+        enum op_type
+        {
+            OP_ACCEPT,
+            OP_CONNECT,
+            OP_RECV,
+            OP_SEND,
+            OP_CANCEL
+        };
+
+        op_type type;
+        io_uring_network_provider *provider; // for OP_ACCEPT
+        io_uring_rpc_session *session;       // for OP_CONNECT, OP_RECV and OP_SEND
+    };
+
+    // the ring of the looper, which is opened on the first call;
+    // return nullptr when io_uring is not usable
+    static io_uring_looper_ring *of(io_looper *looper);
+
+    // prepare count sqes under the sq lock by prepare(sqe, index), and submit them
+    // (or leave them to the batched submission when called during reaping);
+    // return false when the submission queue is full
+    template <typename TPrepare>
+    bool submit(int count, TPrepare &&prepare);
+
+    // cancel the in-flight sqe tagged by target, which is then completed with -ECANCELED
+    bool cancel(op *target);
+
+private:
+    io_uring_looper_ring();
+    ~io_uring_looper_ring();
+
+    bool open(io_looper *looper);
+    void on_ring_ready();
+    void on_completed(const struct io_uring_cqe &cqe);
+
+private:
+    io_uring_queue _ring;
+    int _event_fd;
+    io_loop_callback _ring_event;
+    op _cancel_op;
+
+    // cqes are reaped by one thread of the looper at a time
+    ::dsn::utils::ex_lock_nr_spin _reap_lock;
+    static __thread io_uring_looper_ring *s_reaping_ring;
+};
+
+//
+// tcp network provider based on io_uring, the sockets are served by the ring of the
+// io looper of the provider, see io_uring_looper_ring:
+//  - accept is multishot
+//  - recv reads into the message_reader of the session directly, one recv at a time
+//  - the buffers unlinked by rpc_session::unlink_message_for_send are sent with
+//    one sendmsg, or several linked sendmsg when there are more than IOV_MAX of them
+//
+// it falls back to hpc_network_provider (epoll) when io_uring is not usable,
+// and to single-shot accept on kernels without the multishot one
+//
+class io_uring_network_provider : public hpc_network_provider
+{
+public:
+    io_uring_network_provider(rpc_engine *srv, network *inner_provider);
+    virtual ~io_uring_network_provider();
+
+    virtual error_code
+    start(rpc_channel channel, int port, bool client_only, io_modifer &ctx) override;
+    virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
+
+    io_uring_looper_ring *ring() const { return _ring; }
+    void on_accept_completed(const struct io_uring_cqe &cqe);
+
+private:
+    void arm_accept();
+
+private:
+    io_uring_looper_ring *_ring; // nullptr when falling back to hpc_network_provider
+    io_uring_looper_ring::op _accept_op;
+    volatile bool _multishot_accept;
+    std::atomic<bool> _accept_armed;
+};
+
+class io_uring_rpc_session : public rpc_session
+{
+public:
+    io_uring_rpc_session(socket_t sock,
+                         message_parser_ptr &parser,
+                         io_uring_network_provider &net,
+                         ::dsn::rpc_address remote_addr,
+                         bool is_client);
+    virtual ~io_uring_rpc_session();
+
+    virtual void connect() override;
+    virtual void send(uint64_t signature) override;
+    virtual void do_read(int read_next) override;
+    virtual void close_on_fault_injection() override { close(); }
+
+    void on_connect_completed(const struct io_uring_cqe &cqe);
+    void on_recv_completed(const struct io_uring_cqe &cqe);
+    void on_write_completed(const struct io_uring_cqe &cqe);
+
+private:
+    // return the read_next for the next recv, or -1 on failure
+    int on_data_received(int length);
+    void do_write();
+    void close();
+    void on_failure(bool is_write);
+
+private:
+    io_uring_looper_ring *_ring;
+    socket_t _socket;
+    struct sockaddr_in _connect_addr;
+
+    io_uring_looper_ring::op _connect_op;
+    io_uring_looper_ring::op _recv_op;
+    io_uring_looper_ring::op _send_op;
+
+    // recv, only one is in flight at a time
+    std::atomic<bool> _recv_armed;
+
+    // send, only one batch of buffers is sent at a time
+    uint64_t _sending_signature;
+    int _sending_buffer_start_index;
+    std::vector<struct msghdr> _send_hdrs;
+    int _send_pending_count; // sqes not completed yet
+    int _send_bytes;
+    int _send_error;
+};
+
+// --------------- inline implementation -------------------------
+template <typename TPrepare>
+inline bool io_uring_looper_ring::submit(int count, TPrepare &&prepare)
+{
+    utils::auto_lock<utils::ex_lock_nr_spin> l(_ring.sq_lock());
+    if (!_ring.reserve((unsigned int)count)) {
+        derror("io_uring submission queue is full, count = %d", count);
+        return false;
+    }
+
+    for (int i = 0; i < count; i++) {
+        prepare(_ring.get_sqe(), i);
+    }
+
+    // the reaping thread submits the sqes in batch when it is done with the cqes
+    if (s_reaping_ring != this) {
+        _ring.submit();
+    }
+    return true;
+}
+}
+}
+
+#endif
@@ -0,0 +1,596 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     tcp network provider based on io_uring
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include "io_uring_network_provider.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include "mix_all_io_looper.h"
+#include <sys/eventfd.h>
+#include <climits>
+
+namespace dsn {
+namespace tools {
+
+__thread io_uring_looper_ring *io_uring_looper_ring::s_reaping_ring = nullptr;
+
+class io_uring_looper_ring_holder : public utils::singleton<io_uring_looper_ring_holder>
+{
+public:
+    ::dsn::utils::ex_lock_nr lock;
+    std::unordered_map<io_looper *, io_uring_looper_ring *> rings; // nullptr if not usable
+};
+
+io_uring_looper_ring *io_uring_looper_ring::of(io_looper *looper)
+{
+    auto &holder = io_uring_looper_ring_holder::instance();
+    utils::auto_lock<utils::ex_lock_nr> l(holder.lock);
+    auto it = holder.rings.find(looper);
+    if (it != holder.rings.end())
+        return it->second;
+
+    // the rings live as long as the loopers, which are never stopped
+    io_uring_looper_ring *ring = new io_uring_looper_ring();
+    if (!ring->open(looper)) {
+        delete ring;
+        ring = nullptr;
+    }
+    holder.rings[looper] = ring;
+    return ring;
+}
+
+io_uring_looper_ring::io_uring_looper_ring()
+{
+    _event_fd = -1;
+    _cancel_op.type = op::OP_CANCEL;
+    _cancel_op.provider = nullptr;
+    _cancel_op.session = nullptr;
+}
+
+io_uring_looper_ring::~io_uring_looper_ring()
+{
+    _ring.close();
+    if (_event_fd != -1) {
+        ::close(_event_fd);
+        _event_fd = -1;
+    }
+}
+
+bool io_uring_looper_ring::open(io_looper *looper)
+{
+    unsigned int queue_depth = (unsigned int)dsn_config_get_value_uint64(
+        "network", "io_uring_queue_depth", 1024, "submission queue depth of each io_uring");
+
+    if (!_ring.open(queue_depth))
+        return false;
+
+    for (auto opcode :
+         {IORING_OP_ACCEPT, IORING_OP_CONNECT, IORING_OP_RECV, IORING_OP_SENDMSG,
+          IORING_OP_ASYNC_CANCEL}) {
+        if (!_ring.is_supported(opcode)) {
+            dwarn("io_uring op %d is not supported", (int)opcode);
+            return false;
+        }
+    }
+
+    _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_event_fd == -1 || !_ring.register_eventfd(_event_fd)) {
+        dwarn("create eventfd for io_uring failed, err = %s", strerror(errno));
+        return false;
+    }
+
+    _ring_event = [this](int err, uint32_t size, uintptr_t lpolp) { this->on_ring_ready(); };
+    looper->bind_io_handle((dsn_handle_t)(intptr_t)_event_fd,
+                           &_ring_event,
+                           EPOLLIN | EPOLLET,
+                           nullptr // the ring lives as long as the looper
+                           );
+    return true;
+}
+
+bool io_uring_looper_ring::cancel(op *target)
+{
+    return submit(1, [this, target](struct io_uring_sqe *sqe, int) {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t)(uintptr_t)target;
+        sqe->user_data = (uint64_t)(uintptr_t)&_cancel_op;
+    });
+}
+
+void io_uring_looper_ring::on_ring_ready()
+{
+    // the eventfd is merely a wake-up signal, consume it before reaping
+    // so that the completions posted later are notified again
+    int64_t notify_count = 0;
+    if (read(_event_fd, &notify_count, sizeof(notify_count)) < 0) {
+        // possibly consumed already by other threads of the looper
+    }
+
+    while (_ring.has_completions()) {
+        // completions are left to the thread already reaping, which checks
+        // for them again after unlocking
+        if (!_reap_lock.try_lock())
+            return;
+
+        s_reaping_ring = this;
+        _ring.reap([this](const struct io_uring_cqe &cqe) { this->on_completed(cqe); });
+
+        // batch submission of the sqes prepared during reaping
+        {
+            utils::auto_lock<utils::ex_lock_nr_spin> l(_ring.sq_lock());
+            _ring.submit();
+        }
+        s_reaping_ring = nullptr;
+        _reap_lock.unlock();
+    }
+}
+
+void io_uring_looper_ring::on_completed(const struct io_uring_cqe &cqe)
+{
+    auto o = (op *)(uintptr_t)cqe.user_data;
+    switch (o->type) {
+    case op::OP_ACCEPT:
+        o->provider->on_accept_completed(cqe);
+        break;
+    case op::OP_CONNECT:
+        o->session->on_connect_completed(cqe);
+        break;
+    case op::OP_RECV:
+        o->session->on_recv_completed(cqe);
+        break;
+    case op::OP_SEND:
+        o->session->on_write_completed(cqe);
+        break;
+    case op::OP_CANCEL:
+        // the cancelled sqe is completed with its own cqe
+        break;
+    default:
+        dassert(false, "invalid io_uring op type %d", (int)o->type);
+    }
+}
+
+io_uring_network_provider::io_uring_network_provider(rpc_engine *srv, network *inner_provider)
+    : hpc_network_provider(srv, inner_provider)
+{
+    _ring = nullptr;
+    _accept_op.type = io_uring_looper_ring::op::OP_ACCEPT;
+    _accept_op.provider = this;
+    _accept_op.session = nullptr;
+    _multishot_accept = true;
+    _accept_armed = false;
+}
+
+io_uring_network_provider::~io_uring_network_provider()
+{
+    if (_ring == nullptr || _listen_fd == -1)
+        return;
+
+    // the ring outlives the provider, so the accept must be completed before the
+    // provider is gone, which is done by the looper
+    if (_ring->cancel(&_accept_op)) {
+        while (_accept_armed.load())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ::close(_listen_fd);
+    _listen_fd = -1;
+}
+
+error_code
+io_uring_network_provider::start(rpc_channel channel, int port, bool client_only, io_modifer &ctx)
+{
+    if (_listen_fd != -1 || _ring != nullptr)
+        return ERR_SERVICE_ALREADY_RUNNING;
+
+    _looper = get_io_looper(node(), ctx.queue, ctx.mode);
+    _ring = io_uring_looper_ring::of(_looper);
+    if (_ring == nullptr) {
+        dwarn("io_uring is not usable, fall back to hpc_network_provider");
+        return hpc_network_provider::start(channel, port, client_only, ctx);
+    }
+
+    // all sockets share the ring of the looper, so there is nothing to shard
+    if (!client_only && _listener_count > 1) {
+        dwarn("listener_count = %d is ignored by io_uring_network_provider", _listener_count);
+    }
+
+    dassert(channel == RPC_CHANNEL_TCP || channel == RPC_CHANNEL_UDP,
+            "invalid given channel %s",
+            channel.to_string());
+
+    _address.assign_ipv4(get_local_ipv4(), port);
+
+    if (!client_only) {
+        struct sockaddr_in addr;
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+
+        _listen_fd = create_tcp_socket(&addr);
+        if (_listen_fd == -1) {
+            dassert(false, "cannot create listen socket");
+        }
+
+        if (listen(_listen_fd, SOMAXCONN) != 0) {
+            dwarn("listen failed, err = %s", strerror(errno));
+            return ERR_NETWORK_START_FAILED;
+        }
+
+        arm_accept();
+    }
+
+    return ERR_OK;
+}
+
+rpc_session_ptr io_uring_network_provider::create_client_session(::dsn::rpc_address server_addr)
+{
+    if (_ring == nullptr)
+        return hpc_network_provider::create_client_session(server_addr);
+
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = 0;
+
+    auto sock = create_tcp_socket(&addr);
+    dassert(sock != -1, "create client tcp socket failed!");
+    message_parser_ptr parser(new_message_parser(_client_hdr_format));
+    auto client = new io_uring_rpc_session(sock, parser, *this, server_addr, true);
+    rpc_session_ptr c(client);
+    return c;
+}
+
+void io_uring_network_provider::arm_accept()
+{
+    bool multishot = _multishot_accept;
+    _accept_armed = true;
+    bool r = _ring->submit(1, [this, multishot](struct io_uring_sqe *sqe, int) {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = _listen_fd;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        sqe->ioprio = multishot ? IORING_ACCEPT_MULTISHOT : 0;
+        sqe->user_data = (uint64_t)(uintptr_t)&_accept_op;
+    });
+    dassert(r, "submit accept to io_uring failed");
+}
+
+void io_uring_network_provider::on_accept_completed(const struct io_uring_cqe &cqe)
+{
+    if (cqe.res >= 0) {
+        socket_t s = cqe.res;
+        struct sockaddr_in addr;
+        socklen_t addr_len = (socklen_t)sizeof(addr);
+        if (getpeername(s, (struct sockaddr *)&addr, &addr_len) == -1) {
+            derror("(s = %d) (server) getpeername failed, err = %s", s, strerror(errno));
+            ::close(s);
+        } else {
+            ::dsn::rpc_address client_addr(ntohl(addr.sin_addr.s_addr), ntohs(addr.sin_port));
+            message_parser_ptr null_parser;
+            auto rs = new io_uring_rpc_session(s, null_parser, *this, client_addr, false);
+            rpc_session_ptr s1(rs);
+
+            this->on_server_session_accepted(s1);
+            rs->start_read_next();
+        }
+    } else if (cqe.res == -ECANCELED) {
+        // cancelled when the provider is destroyed
+        _accept_armed = false;
+        return;
+    } else if (cqe.res == -EINVAL && _multishot_accept) {
+        dwarn("multishot accept is not supported by io_uring, fall back to single-shot accept");
+        _multishot_accept = false;
+    } else {
+        derror("accept failed, err = %s", strerror(-cqe.res));
+    }
+
+    // multishot accept is terminated on failures
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        arm_accept();
+    }
+}
+
+io_uring_rpc_session::io_uring_rpc_session(socket_t sock,
+                                           message_parser_ptr &parser,
+                                           io_uring_network_provider &net,
+                                           ::dsn::rpc_address remote_addr,
+                                           bool is_client)
+    : rpc_session(net, remote_addr, parser, is_client), _ring(net.ring()), _socket(sock)
+{
+    dassert(sock != -1, "invalid given socket handle");
+
+    _connect_op.type = io_uring_looper_ring::op::OP_CONNECT;
+    _connect_op.provider = nullptr;
+    _connect_op.session = this;
+    _recv_op.type = io_uring_looper_ring::op::OP_RECV;
+    _recv_op.provider = nullptr;
+    _recv_op.session = this;
+    _send_op.type = io_uring_looper_ring::op::OP_SEND;
+    _send_op.provider = nullptr;
+    _send_op.session = this;
+
+    _recv_armed = false;
+
+    _sending_signature = 0;
+    _sending_buffer_start_index = 0;
+    _send_pending_count = 0;
+    _send_bytes = 0;
+    _send_error = 0;
+
+    memset((void *)&_connect_addr, 0, sizeof(_connect_addr));
+    _connect_addr.sin_family = AF_INET;
+    _connect_addr.sin_addr.s_addr = htonl(remote_addr.ip());
+    _connect_addr.sin_port = htons(remote_addr.port());
+}
+
+io_uring_rpc_session::~io_uring_rpc_session() { close(); }
+
+void io_uring_rpc_session::connect()
+{
+    if (!try_connecting())
+        return;
+
+    dassert(_socket != -1, "invalid given socket handle");
+
+    this->add_ref(); // released in on_connect_completed
+    if (!_ring->submit(1, [this](struct io_uring_sqe *sqe, int) {
+            sqe->opcode = IORING_OP_CONNECT;
+            sqe->fd = _socket;
+            sqe->addr = (uint64_t)(uintptr_t)&_connect_addr;
+            sqe->off = sizeof(_connect_addr);
+            sqe->user_data = (uint64_t)(uintptr_t)&_connect_op;
+        })) {
+        on_failure(true);
+        this->release_ref();
+    }
+}
+
+void io_uring_rpc_session::on_connect_completed(const struct io_uring_cqe &cqe)
+{
+    if (cqe.res == 0) {
+        dinfo("(s = %d) client session %s connected", _socket, _remote_addr.to_string());
+
+        set_connected();
+        start_read_next();
+
+        // start first round send
+        rpc_session::on_send_completed();
+    } else {
+        derror("(s = %d) connect to %s failed, err = %s",
+               _socket,
+               _remote_addr.to_string(),
+               strerror(-cqe.res));
+        on_failure(true);
+    }
+
+    this->release_ref();
+}
+
+void io_uring_rpc_session::do_read(int read_next)
+{
+    if (_recv_armed.exchange(true))
+        return;
+
+    // the data is received into the reader in place, as hpc_rpc_session::do_read does,
+    // and the buffer is kept by the reader till the recv is completed as it is the only
+    // one in flight; a recv into no room would be taken as the connection closed
+    char *ptr = _reader.read_buffer_ptr(read_next > 0 ? read_next : 256);
+    unsigned int length = _reader.read_buffer_capacity();
+
+    this->add_ref(); // released in on_recv_completed
+    if (!_ring->submit(1, [this, ptr, length](struct io_uring_sqe *sqe, int) {
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = _socket;
+            sqe->addr = (uint64_t)(uintptr_t)ptr;
+            sqe->len = length;
+            sqe->user_data = (uint64_t)(uintptr_t)&_recv_op;
+        })) {
+        _recv_armed = false;
+        on_failure(false);
+        this->release_ref();
+    }
+}
+
+void io_uring_rpc_session::on_recv_completed(const struct io_uring_cqe &cqe)
+{
+    int read_next = -1;
+    if (cqe.res > 0) {
+        if (!is_disconnected()) {
+            read_next = on_data_received(cqe.res);
+        }
+    } else if (!is_disconnected()) {
+        if (cqe.res == 0) {
+            dinfo("(s = %d) connection closed by %s", _socket, _remote_addr.to_string());
+        } else {
+            derror("(s = %d) recv failed on %s, err = %s",
+                   _socket,
+                   _remote_addr.to_string(),
+                   strerror(-cqe.res));
+        }
+        on_failure(false);
+    }
+
+    _recv_armed = false;
+    if (read_next != -1 && !is_disconnected()) {
+        start_read_next(read_next);
+    }
+    this->release_ref();
+}
+
+int io_uring_rpc_session::on_data_received(int length)
+{
+    _reader.mark_read(length);
+
+    int read_next = 0;
+    if (!_parser) {
+        read_next = prepare_parser();
+    }
+
+    if (_parser) {
+        message_ex *msg = _parser->get_message_on_receive(&_reader, read_next);
+        while (msg != nullptr) {
+            if (!on_recv_message(msg, 0)) {
+                on_failure(false);
+                return -1;
+            }
+            msg = _parser->get_message_on_receive(&_reader, read_next);
+        }
+    }
+
+    if (read_next == -1) {
+        derror("(s = %d) recv failed on %s, parse failed", _socket, _remote_addr.to_string());
+        on_failure(false);
+    }
+    return read_next;
+}
+
+void io_uring_rpc_session::send(uint64_t signature)
+{
+    dbg_dassert(signature != 0, "cannot send empty msg");
+    dassert(_sending_signature == 0, "only one sending msg is possible");
+
+    _sending_signature = signature;
+    _sending_buffer_start_index = 0;
+    do_write();
+}
+
+void io_uring_rpc_session::do_write()
+{
+    static_assert(sizeof(message_parser::send_buf) == sizeof(struct iovec),
+                  "make sure they are compatible");
+
+    // one sendmsg can take no more than IOV_MAX buffers, more are sent with linked sendmsg
+    int buffer_count = (int)_sending_buffers.size() - _sending_buffer_start_index;
+    int sqe_count = (buffer_count + IOV_MAX - 1) / IOV_MAX;
+    _send_hdrs.resize(sqe_count);
+    for (int i = 0; i < sqe_count; i++) {
+        struct msghdr &hdr = _send_hdrs[i];
+        memset((void *)&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = (struct iovec *)&_sending_buffers[_sending_buffer_start_index + i * IOV_MAX];
+        hdr.msg_iovlen = (size_t)std::min(IOV_MAX, buffer_count - i * IOV_MAX);
+    }
+
+    _send_pending_count = sqe_count;
+    _send_bytes = 0;
+    _send_error = 0;
+
+    this->add_ref(); // released in on_write_completed
+    if (!_ring->submit(sqe_count, [this, sqe_count](struct io_uring_sqe *sqe, int i) {
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = _socket;
+            sqe->addr = (uint64_t)(uintptr_t)&_send_hdrs[i];
+            sqe->len = 1;
+            // retry on short sends so the linked ones are not cut off
+            sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+            if (i + 1 < sqe_count)
+                sqe->flags = IOSQE_IO_LINK;
+            sqe->user_data = (uint64_t)(uintptr_t)&_send_op;
+        })) {
+        on_failure(true);
+        this->release_ref();
+    }
+}
+
+void io_uring_rpc_session::on_write_completed(const struct io_uring_cqe &cqe)
+{
+    if (cqe.res > 0) {
+        _send_bytes += cqe.res;
+    } else if (cqe.res < 0 && cqe.res != -ECANCELED && _send_error == 0) {
+        _send_error = -cqe.res;
+    }
+
+    // the linked sendmsg after a short one are cancelled
+    if (--_send_pending_count > 0)
+        return;
+
+    if (_send_error != 0 || _send_bytes == 0) {
+        if (!is_disconnected()) {
+            derror("(s = %d) sendmsg failed on %s, err = %s",
+                   _socket,
+                   _remote_addr.to_string(),
+                   strerror(_send_error != 0 ? _send_error : EPIPE));
+            on_failure(true);
+        }
+        this->release_ref();
+        return;
+    }
+
+    int len = _send_bytes;
+    int buf_i = _sending_buffer_start_index;
+    while (len > 0) {
+        auto &buf = _sending_buffers[buf_i];
+        if (len >= (int)buf.sz) {
+            buf_i++;
+            len -= (int)buf.sz;
+        } else {
+            buf.buf = (char *)buf.buf + len;
+            buf.sz -= len;
+            break;
+        }
+    }
+    _sending_buffer_start_index = buf_i;
+
+    // message completed, continue next message
+    if (_sending_buffer_start_index == (int)_sending_buffers.size()) {
+        auto csig = _sending_signature;
+        _sending_signature = 0;
+        rpc_session::on_send_completed(csig);
+    } else {
+        // continue sending current msg
+        do_write();
+    }
+
+    this->release_ref();
+}
+
+void io_uring_rpc_session::close()
+{
+    if (-1 != _socket) {
+        // pending recv and sendmsg on the socket are completed after shutdown
+        ::shutdown(_socket, SHUT_RDWR);
+        ::close(_socket);
+        dinfo("(s = %d) close socket %p", _socket, this);
+        _socket = -1;
+    }
+}
+
+void io_uring_rpc_session::on_failure(bool is_write)
+{
+    if (on_disconnected(is_write))
+        close();
+}
+}
+}
+
+#endif
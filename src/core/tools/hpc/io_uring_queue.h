@@ -0,0 +1,164 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     a thin wrapper of the raw io_uring syscalls used by the hpc providers
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include <dsn/tool_api.h>
+#include <dsn/utility/synchronize.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// multishot accept (linux 5.19) is the newest feature the io_uring providers rely on,
+// older kernels are still detected at runtime, see io_uring_queue::open
+#ifdef IORING_ACCEPT_MULTISHOT
+#define DSN_HAS_IO_URING 1
+#endif
+
+#ifdef DSN_HAS_IO_URING
+
+namespace dsn {
+namespace tools {
+//
+// submission and completion queues of one io_uring instance, talking to
+// the kernel by the raw syscalls so no extra library (e.g., liburing) is required
+//
+// - sqes are got and submitted under sq_lock() by any thread
+// - cqes are reaped by one thread at a time
+//
+class io_uring_queue
+{
+public:
+    io_uring_queue();
+    ~io_uring_queue();
+
+    // return false when io_uring is not usable, e.g., on older kernels or when
+    // it is disabled by sysctl or seccomp, so the caller can fall back to epoll
+    bool open(unsigned int entries);
+    void close();
+    bool is_open() const { return _fd != -1; }
+    int native_handle() const { return _fd; }
+
+    // whether the opcode (IORING_OP_XXX) is supported by the running kernel
+    bool is_supported(int opcode) const;
+
+    // let the kernel signal the eventfd upon completions
+    bool register_eventfd(int efd);
+
+    ::dsn::utils::ex_lock_nr_spin &sq_lock() { return _sq_lock; }
+
+    // called under sq_lock(), make sure there are room for count sqes, submit the
+    // pending ones when necessary; return false when the queue is still full
+    bool reserve(unsigned int count);
+
+    // called under sq_lock(), return nullptr when the submission queue is full
+    struct io_uring_sqe *get_sqe();
+
+    // called under sq_lock(), return the count of submitted sqes or -errno
+    int submit();
+
+    // called by one thread at a time, the callback is invoked with a copy of
+    // each cqe so it can submit new sqes freely; return the count of cqes
+    template <typename TCallback>
+    int reap(TCallback &&callback);
+
+    bool has_completions() const
+    {
+        return __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE) !=
+               __atomic_load_n(_cq_head, __ATOMIC_RELAXED);
+    }
+
+private:
+    int enter(unsigned int to_submit, unsigned int flags);
+
+private:
+    int _fd;
+    ::dsn::utils::ex_lock_nr_spin _sq_lock;
+
+    void *_sq_ring;
+    size_t _sq_ring_size;
+    void *_cq_ring;
+    size_t _cq_ring_size;
+    struct io_uring_sqe *_sqes;
+    size_t _sqes_size;
+
+    unsigned int *_sq_head;
+    unsigned int *_sq_tail;
+    unsigned int *_sq_flags;
+    unsigned int *_sq_array;
+    unsigned int _sq_mask;
+    unsigned int _sq_entries;
+    unsigned int _sq_local_tail; // sqes got but not yet published to the kernel
+
+    unsigned int *_cq_head;
+    unsigned int *_cq_tail;
+    unsigned int _cq_mask;
+    struct io_uring_cqe *_cqes;
+
+    std::vector<bool> _supported_ops;
+};
+
+// --------------- inline implementation -------------------------
+template <typename TCallback>
+inline int io_uring_queue::reap(TCallback &&callback)
+{
+    int count = 0;
+    unsigned int head = *_cq_head;
+    while (true) {
+        unsigned int tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            // completions overflowed are kept by the kernel until they are flushed
+            if (__atomic_load_n(_sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+                enter(0, IORING_ENTER_GETEVENTS);
+                if (__atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE) != head)
+                    continue;
+            }
+            break;
+        }
+
+        struct io_uring_cqe cqe = _cqes[head & _cq_mask];
+        __atomic_store_n(_cq_head, ++head, __ATOMIC_RELEASE);
+        callback(cqe);
+        ++count;
+    }
+    return count;
+}
+}
+}
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     a thin wrapper of the raw io_uring syscalls used by the hpc providers
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include "io_uring_queue.h"
+
+#ifdef DSN_HAS_IO_URING
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace dsn {
+namespace tools {
+static int sys_io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+    return (int)::syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int
+sys_io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+    return (int)::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned int opcode, const void *arg, unsigned int nr_args)
+{
+    return (int)::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+io_uring_queue::io_uring_queue()
+{
+    _fd = -1;
+    _sq_ring = MAP_FAILED;
+    _sq_ring_size = 0;
+    _cq_ring = MAP_FAILED;
+    _cq_ring_size = 0;
+    _sqes = (struct io_uring_sqe *)MAP_FAILED;
+    _sqes_size = 0;
+    _sq_local_tail = 0;
+}
+
+io_uring_queue::~io_uring_queue() { close(); }
+
+bool io_uring_queue::open(unsigned int entries)
+{
+    dassert(_fd == -1, "io_uring is already opened");
+
+    // multishot ops may post many cqes for a single sqe
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL;
+    p.cq_entries = entries * 4;
+    _fd = sys_io_uring_setup(entries, &p);
+    if (_fd < 0 && errno == EINVAL) {
+        memset(&p, 0, sizeof(p));
+        _fd = sys_io_uring_setup(entries, &p);
+    }
+
+    if (_fd < 0) {
+        dwarn("io_uring_setup failed, err = %s", strerror(errno));
+        _fd = -1;
+        return false;
+    }
+
+    if (!(p.features & IORING_FEAT_NODROP) || !(p.features & IORING_FEAT_SUBMIT_STABLE)) {
+        dwarn("io_uring is too old, features = 0x%x", p.features);
+        close();
+        return false;
+    }
+
+    _sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    _cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+    }
+
+    _sq_ring = mmap(nullptr,
+                    _sq_ring_size,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE,
+                    _fd,
+                    IORING_OFF_SQ_RING);
+    if (_sq_ring == MAP_FAILED) {
+        dwarn("mmap io_uring sq ring failed, err = %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        _cq_ring = _sq_ring;
+    } else {
+        _cq_ring = mmap(nullptr,
+                        _cq_ring_size,
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE,
+                        _fd,
+                        IORING_OFF_CQ_RING);
+        if (_cq_ring == MAP_FAILED) {
+            dwarn("mmap io_uring cq ring failed, err = %s", strerror(errno));
+            close();
+            return false;
+        }
+    }
+
+    _sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    _sqes = (struct io_uring_sqe *)mmap(nullptr,
+                                        _sqes_size,
+                                        PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE,
+                                        _fd,
+                                        IORING_OFF_SQES);
+    if (_sqes == MAP_FAILED) {
+        dwarn("mmap io_uring sqes failed, err = %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    char *sq = (char *)_sq_ring;
+    _sq_head = (unsigned int *)(sq + p.sq_off.head);
+    _sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+    _sq_flags = (unsigned int *)(sq + p.sq_off.flags);
+    _sq_array = (unsigned int *)(sq + p.sq_off.array);
+    _sq_mask = *(unsigned int *)(sq + p.sq_off.ring_mask);
+    _sq_entries = p.sq_entries;
+    _sq_local_tail = *_sq_tail;
+
+    char *cq = (char *)_cq_ring;
+    _cq_head = (unsigned int *)(cq + p.cq_off.head);
+    _cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+    _cq_mask = *(unsigned int *)(cq + p.cq_off.ring_mask);
+    _cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // probe the supported ops (linux 5.6)
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    std::unique_ptr<char[]> probe_buffer(new char[probe_size]);
+    memset(probe_buffer.get(), 0, probe_size);
+    auto probe = (struct io_uring_probe *)probe_buffer.get();
+    if (sys_io_uring_register(_fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        dwarn("probe io_uring ops failed, err = %s", strerror(errno));
+        close();
+        return false;
+    }
+
+    _supported_ops.assign(256, false);
+    for (int i = 0; i < (int)probe->ops_len && i < 256; i++) {
+        _supported_ops[probe->ops[i].op] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+
+    dinfo("io_uring opened, fd = %d, sq_entries = %u, cq_entries = %u, features = 0x%x",
+          _fd,
+          p.sq_entries,
+          p.cq_entries,
+          p.features);
+    return true;
+}
+
+void io_uring_queue::close()
+{
+    if (_sqes != MAP_FAILED) {
+        munmap(_sqes, _sqes_size);
+        _sqes = (struct io_uring_sqe *)MAP_FAILED;
+    }
+
+    if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring) {
+        munmap(_cq_ring, _cq_ring_size);
+    }
+    _cq_ring = MAP_FAILED;
+
+    if (_sq_ring != MAP_FAILED) {
+        munmap(_sq_ring, _sq_ring_size);
+        _sq_ring = MAP_FAILED;
+    }
+
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+
+    _supported_ops.clear();
+}
+
+bool io_uring_queue::is_supported(int opcode) const
+{
+    return opcode >= 0 && opcode < (int)_supported_ops.size() && _supported_ops[opcode];
+}
+
+bool io_uring_queue::register_eventfd(int efd)
+{
+    if (sys_io_uring_register(_fd, IORING_REGISTER_EVENTFD, &efd, 1) < 0) {
+        dwarn("register eventfd to io_uring failed, err = %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool io_uring_queue::reserve(unsigned int count)
+{
+    if (_sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) + count <= _sq_entries)
+        return true;
+
+    submit();
+    return _sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) + count <= _sq_entries;
+}
+
+struct io_uring_sqe *io_uring_queue::get_sqe()
+{
+    if (!reserve(1))
+        return nullptr;
+
+    unsigned int index = _sq_local_tail & _sq_mask;
+    _sq_array[index] = index;
+    ++_sq_local_tail;
+
+    struct io_uring_sqe *sqe = &_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int io_uring_queue::submit()
+{
+    __atomic_store_n(_sq_tail, _sq_local_tail, __ATOMIC_RELEASE);
+
+    unsigned int to_submit = _sq_local_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE);
+    if (to_submit == 0)
+        return 0;
+
+    return enter(to_submit, 0);
+}
+
+int io_uring_queue::enter(unsigned int to_submit, unsigned int flags)
+{
+    while (true) {
+        int r = sys_io_uring_enter(_fd, to_submit, 0, flags);
+        if (r >= 0)
+            return r;
+
+        int err = errno;
+        if (err == EINTR)
+            continue;
+
+        // EAGAIN/EBUSY: short of resources or too many completions are not reaped yet,
+        // the remaining sqes are submitted with the next call
+        if (err != EAGAIN && err != EBUSY) {
+            derror("io_uring_enter failed, fd = %d, err = %s", _fd, strerror(err));
+        }
+        return -err;
+    }
+}
+}
+}
+
+#endif
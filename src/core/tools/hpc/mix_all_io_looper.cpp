@@ -91,15 +91,30 @@ void io_looper_task_queue::start(service_node *node, int worker_count)
 
 void io_looper_task_queue::stop() { io_looper::stop(); }
 
+// see task_worker::loop, the clock is read at most once per batch
+static void drop_expired_request(task *t, /*inout*/ uint64_t &now_ns)
+{
+    if (t->spec().type == TASK_TYPE_RPC_REQUEST) {
+        auto rtask = static_cast<rpc_request_task *>(t);
+        if (rtask->need_drop_check()) {
+            if (now_ns == 0)
+                now_ns = dsn_now_ns();
+            rtask->drop_if_expired(now_ns);
+        }
+    }
+}
+
 void io_looper_task_queue::handle_local_queues()
 {
     // execute timers in current thread
     exec_timer_tasks(true);
 
     // execute local queue
+    uint64_t now_ns = 0;
     task *t = _local_tasks.pop_all(), *next;
     while (t) {
         next = t->next;
+        drop_expired_request(t, now_ns);
         t->exec_internal();
         t = next;
     }
@@ -112,6 +127,7 @@ void io_looper_task_queue::handle_local_queues()
 
     while (t) {
         next = t->next;
+        drop_expired_request(t, now_ns);
         t->exec_internal();
         t = next;
     }
@@ -200,6 +216,36 @@ void io_looper::add_timer(task *timer)
     }
 }
 
+void io_looper::init_utilization_counter(const char *app, const char *name)
+{
+    _busy_ns.store(0);
+    _utilization_window_start_ns.store(dsn_now_ns());
+    _utilization_counter.init_global_counter(
+        app,
+        "network",
+        name,
+        COUNTER_TYPE_NUMBER,
+        "percentage of time the io looper spends on handling events over the last second");
+}
+
+void io_looper::account_busy_time(uint64_t start_ns, uint64_t end_ns)
+{
+    _busy_ns.fetch_add(end_ns - start_ns, std::memory_order_relaxed);
+
+    uint64_t window_start_ns = _utilization_window_start_ns.load(std::memory_order_relaxed);
+    uint64_t window_ns = end_ns - window_start_ns;
+    if (end_ns <= window_start_ns || window_ns < 1000000000ULL)
+        return;
+
+    // only one worker closes the window
+    if (!_utilization_window_start_ns.compare_exchange_strong(window_start_ns, end_ns))
+        return;
+
+    uint64_t busy_ns = _busy_ns.exchange(0, std::memory_order_relaxed);
+    uint64_t worker_count = _workers.empty() ? 1 : _workers.size();
+    _utilization_counter->set(std::min(busy_ns * 100 / (window_ns * worker_count), (uint64_t)100));
+}
+
 void io_looper_task_queue::enqueue(task *task)
 {
     // put into locked queue when it is shared or from remote threads
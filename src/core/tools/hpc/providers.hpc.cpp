@@ -39,6 +39,9 @@
 #include "hpc_logger.h"
 #include "hpc_aio_provider.h"
 #include "hpc_network_provider.h"
+#include "io_uring_network_provider.h"
+#include "shm_network_provider.h"
+#include "io_uring_aio_provider.h"
 #include "hpc_env_provider.h"
 #include "mix_all_io_looper.h"
 
@@ -51,10 +54,28 @@ void register_hpc_providers()
     register_component_provider<hpc_task_queue>("dsn::tools::hpc_task_queue");
     register_component_provider<hpc_task_priority_queue>("dsn::tools::hpc_task_priority_queue");
     register_component_provider<hpc_concurrent_task_queue>("dsn::tools::hpc_concurrent_task_queue");
+    register_component_provider<hpc_mpsc_task_queue>("dsn::tools::hpc_mpsc_task_queue");
     register_component_provider<hpc_env_provider>("dsn::tools::hpc_env_provider");
 
     register_component_provider<hpc_aio_provider>("dsn::tools::hpc_aio_provider");
+#ifdef DSN_HAS_IO_URING
+    register_component_provider<io_uring_aio_provider>("dsn::tools::io_uring_aio_provider");
+#else
+    register_component_provider<hpc_aio_provider>("dsn::tools::io_uring_aio_provider");
+#endif
     register_component_provider<hpc_network_provider>("dsn::tools::hpc_network_provider");
+#ifdef DSN_HAS_IO_URING
+    register_component_provider<io_uring_network_provider>(
+        "dsn::tools::io_uring_network_provider");
+#else
+    // so that the same config works where io_uring is not available
+    register_component_provider<hpc_network_provider>("dsn::tools::io_uring_network_provider");
+#endif
+#ifdef __linux__
+    register_component_provider<shm_network_provider>("dsn::tools::shm_network_provider");
+#else
+    register_component_provider<hpc_network_provider>("dsn::tools::shm_network_provider");
+#endif
     register_component_provider<io_looper_task_queue>("dsn::tools::io_looper_task_queue");
     register_component_provider<io_looper_task_worker>("dsn::tools::io_looper_task_worker");
     register_component_provider<io_looper_timer_service>("dsn::tools::io_looper_timer_service");
@@ -0,0 +1,201 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     network provider for the peers on the same host, over shared memory rings
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include "hpc_network_provider.h"
+#include "shm_ring.h"
+
+#ifdef __linux__
+
+namespace dsn {
+namespace tools {
+
+//
+// the shared memory and eventfds of a shm session, created by the client and
+// passed to the server over the unix socket of the session; it is kept alive by the
+// blobs over its slots after the session is closed
+//
+class shm_channel
+{
+public:
+    struct layout
+    {
+        uint32_t ring_size;
+        uint32_t slot_size;
+        uint32_t slot_count;
+    };
+
+    // client side, return nullptr when the shared memory cannot be created
+    static std::shared_ptr<shm_channel> create(const layout &lo);
+
+    // server side, the fds are owned by the channel once called
+    static std::shared_ptr<shm_channel>
+    open(const layout &lo, int mem_fd, int client_event_fd, int server_event_fd);
+
+    ~shm_channel();
+
+    shm_ring &tx() { return _tx; }
+    shm_ring &rx() { return _rx; }
+    const layout &get_layout() const { return _layout; }
+
+    int mem_fd() const { return _mem_fd; }
+    int client_event_fd() const { return _is_client ? _local_event_fd : _peer_event_fd; }
+    int server_event_fd() const { return _is_client ? _peer_event_fd : _local_event_fd; }
+
+    // bound to the io looper of the session, signaled by the peer
+    int local_event_fd() const { return _local_event_fd; }
+    void notify_peer();
+
+private:
+    shm_channel(const layout &lo, bool is_client);
+    bool map(int mem_fd);
+
+private:
+    layout _layout;
+    bool _is_client;
+    int _mem_fd;
+    int _local_event_fd;
+    int _peer_event_fd;
+    char *_base;
+    size_t _size;
+    shm_ring _tx; // client to server for the client, and vice versa
+    shm_ring _rx;
+};
+
+//
+// network provider which talks to the peers on the same host over shared memory:
+//  - the server listens on an abstract unix socket named after its port besides the tcp one
+//  - a client session to a local address connects to the unix socket, and passes the
+//    shared memory (memfd) of a ring pair and two eventfds over it (SCM_RIGHTS); the
+//    server acks it with one byte, and the unix socket is then kept for the liveness of
+//    the peer only
+//  - a server run by another user, or failing to map the shared memory, closes the unix
+//    socket instead of the ack, and the client connects to it by tcp for a while
+//  - the buffers of a send batch are copied into the ring once, and a batch no
+//    smaller than zero_copy_min_size is copied into a slot instead and passed by its
+//    index, the messages received are then parsed in place out of the slot
+//
+// remote addresses, and the local servers which do not listen on the unix socket
+// (e.g., served by another provider), are connected by tcp as hpc_network_provider
+//
+class shm_network_provider : public hpc_network_provider
+{
+public:
+    shm_network_provider(rpc_engine *srv, network *inner_provider);
+
+    virtual error_code
+    start(rpc_channel channel, int port, bool client_only, io_modifer &ctx) override;
+    virtual rpc_session_ptr create_client_session(::dsn::rpc_address server_addr) override;
+
+    uint32_t zero_copy_min_size() const { return _zero_copy_min_size; }
+
+    // the server rejects the shm session, so connect to it by tcp for a while
+    void on_shm_rejected(::dsn::rpc_address server_addr);
+
+private:
+    bool is_local(::dsn::rpc_address addr);
+    bool is_shm_rejected(::dsn::rpc_address server_addr);
+    rpc_session_ptr create_shm_client_session(::dsn::rpc_address server_addr);
+    void do_accept_local();
+
+private:
+    shm_channel::layout _layout;
+    uint32_t _zero_copy_min_size;
+
+    socket_t _local_listen_fd;
+    io_loop_callback _local_accept_event;
+
+    // the server sessions are identified by 127.254.x.y:port made of it
+    std::atomic<uint32_t> _next_peer_id;
+
+    // server address => when to try shm again, in milliseconds
+    ::dsn::utils::ex_lock_nr _rejected_lock;
+    std::unordered_map<::dsn::rpc_address, uint64_t> _rejected_servers;
+};
+
+class shm_rpc_session : public rpc_session
+{
+public:
+    // the server session is given a null channel, which is received as the first
+    // message on the unix socket
+    shm_rpc_session(socket_t sock,
+                    std::shared_ptr<shm_channel> channel,
+                    message_parser_ptr &parser,
+                    shm_network_provider &net,
+                    ::dsn::rpc_address remote_addr,
+                    bool is_client);
+    virtual ~shm_rpc_session();
+
+    virtual void connect() override;
+    virtual void send(uint64_t signature) override { do_safe_write(signature); }
+    virtual void do_read(int read_next) override;
+    virtual void close_on_fault_injection() override;
+
+    void bind_looper(io_looper *looper);
+
+private:
+    bool on_handshake();
+    bool on_handshake_ack(uint32_t events);
+    void bind_notify_event();
+    void on_socket_events_ready(uint32_t events);
+    void on_notified();
+    void do_safe_write(uint64_t signature);
+    bool do_write();
+    bool write_slot();
+    bool parse(message_reader *reader, /*inout*/ int &read_next);
+    void on_failure(bool is_write = false);
+    void close();
+
+private:
+    shm_network_provider &_provider;
+    socket_t _socket;
+    std::shared_ptr<shm_channel> _channel;
+    io_looper *_looper;
+    io_loop_callback _socket_event;
+    io_loop_callback _notify_event;
+    std::atomic<bool> _handshake_done; // ack received by the client, or handshake by the server
+
+    uint64_t _sending_signature;
+    int _sending_buffer_start_index;
+    bool _sending_fresh; // nothing of the batch is written yet
+
+    ::dsn::utils::ex_lock_nr _send_lock;
+    ::dsn::utils::ex_lock_nr _recv_lock;
+};
+}
+}
+
+#endif
@@ -0,0 +1,889 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     network provider for the peers on the same host, over shared memory rings
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#ifdef __linux__
+
+#include "shm_network_provider.h"
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+namespace dsn {
+namespace tools {
+
+static const uint32_t SHM_HANDSHAKE_MAGIC = 0x4d485344; // "DSHM"
+static const uint32_t SHM_HANDSHAKE_VERSION = 1;
+
+// the first message sent over the unix socket, by the client along with the memfd
+// and the eventfds of the client and the server, which is then answered by the server
+// with SHM_HANDSHAKE_ACK, or by closing the socket when the server rejects it
+struct shm_handshake
+{
+    uint32_t magic;
+    uint32_t version;
+    shm_channel::layout layout;
+};
+
+static const int SHM_HANDSHAKE_FD_COUNT = 3;
+static const char SHM_HANDSHAKE_ACK = 'A';
+
+// how long to connect by tcp to a server which rejects the shm session
+static const uint64_t SHM_REJECTED_RETRY_INTERVAL_MS = 60 * 1000;
+
+union shm_handshake_control
+{
+    char buf[CMSG_SPACE(SHM_HANDSHAKE_FD_COUNT * sizeof(int))];
+    struct cmsghdr align;
+};
+
+// abstract, so nothing is left on the file system when the process exits
+static socklen_t make_local_address(int port, /*out*/ struct sockaddr_un &addr)
+{
+    memset((void *)&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    int n = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "rdsn-shm-%d", port);
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + 1 + n);
+}
+
+static int create_memfd(const char *name)
+{
+#ifdef SYS_memfd_create
+    return (int)syscall(SYS_memfd_create, name, MFD_CLOEXEC);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+//------------------------------- shm_channel -------------------------------
+shm_channel::shm_channel(const layout &lo, bool is_client)
+    : _layout(lo),
+      _is_client(is_client),
+      _mem_fd(-1),
+      _local_event_fd(-1),
+      _peer_event_fd(-1),
+      _base(nullptr),
+      _size(0)
+{
+}
+
+shm_channel::~shm_channel()
+{
+    if (_base != nullptr)
+        munmap(_base, _size);
+    for (int fd : {_mem_fd, _local_event_fd, _peer_event_fd}) {
+        if (fd != -1)
+            ::close(fd);
+    }
+}
+
+/*static*/ std::shared_ptr<shm_channel> shm_channel::create(const layout &lo)
+{
+    std::shared_ptr<shm_channel> ch(new shm_channel(lo, true));
+    ch->_mem_fd = create_memfd("rdsn-shm");
+    if (ch->_mem_fd == -1) {
+        dwarn("memfd_create failed, err = %s", strerror(errno));
+        return nullptr;
+    }
+
+    size_t size = 2 * shm_ring::region_size(lo.ring_size, lo.slot_size, lo.slot_count);
+    if (ftruncate(ch->_mem_fd, (off_t)size) != 0) {
+        dwarn("ftruncate memfd to %" PRIu64 " failed, err = %s", (uint64_t)size, strerror(errno));
+        return nullptr;
+    }
+
+    ch->_local_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ch->_peer_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ch->_local_event_fd == -1 || ch->_peer_event_fd == -1) {
+        dwarn("eventfd failed, err = %s", strerror(errno));
+        return nullptr;
+    }
+
+    if (!ch->map(ch->_mem_fd))
+        return nullptr;
+
+    ch->_tx.init_waiting();
+    ch->_rx.init_waiting();
+    return ch;
+}
+
+/*static*/ std::shared_ptr<shm_channel>
+shm_channel::open(const layout &lo, int mem_fd, int client_event_fd, int server_event_fd)
+{
+    std::shared_ptr<shm_channel> ch(new shm_channel(lo, false));
+    ch->_mem_fd = mem_fd;
+    ch->_local_event_fd = server_event_fd;
+    ch->_peer_event_fd = client_event_fd;
+
+    if (!shm_ring::is_valid_layout(lo.ring_size, lo.slot_size, lo.slot_count)) {
+        derror("invalid shm layout, ring_size = %u, slot_size = %u, slot_count = %u",
+               lo.ring_size,
+               lo.slot_size,
+               lo.slot_count);
+        return nullptr;
+    }
+
+    return ch->map(mem_fd) ? ch : nullptr;
+}
+
+bool shm_channel::map(int mem_fd)
+{
+    size_t region = shm_ring::region_size(_layout.ring_size, _layout.slot_size, _layout.slot_count);
+    _size = 2 * region;
+
+    // the size is checked, or a peer could make us access beyond the end of the memfd
+    struct stat st;
+    if (fstat(mem_fd, &st) != 0 || (size_t)st.st_size != _size) {
+        derror("shm size mismatch, expect = %" PRIu64 ", err = %s",
+               (uint64_t)_size,
+               strerror(errno));
+        return false;
+    }
+
+    void *base = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, mem_fd, 0);
+    if (base == MAP_FAILED) {
+        derror("mmap shm failed, size = %" PRIu64 ", err = %s", (uint64_t)_size, strerror(errno));
+        return false;
+    }
+    _base = (char *)base;
+
+    char *c2s = _base;
+    char *s2c = _base + region;
+    _tx.attach(_is_client ? c2s : s2c, _layout.ring_size, _layout.slot_size, _layout.slot_count);
+    _rx.attach(_is_client ? s2c : c2s, _layout.ring_size, _layout.slot_size, _layout.slot_count);
+    return true;
+}
+
+void shm_channel::notify_peer()
+{
+    uint64_t c = 1;
+    if (::write(_peer_event_fd, &c, sizeof(c)) < 0) {
+        // the peer is gone, which is found by the unix socket
+        dinfo("notify shm peer failed, err = %s", strerror(errno));
+    }
+}
+
+//------------------------------- shm_network_provider -------------------------------
+shm_network_provider::shm_network_provider(rpc_engine *srv, network *inner_provider)
+    : hpc_network_provider(srv, inner_provider), _local_listen_fd(-1), _next_peer_id(0)
+{
+    uint64_t ring_size =
+        1024 * dsn_config_get_value_uint64("network",
+                                           "shm_ring_size_kb",
+                                           1024,
+                                           "size of the shared memory ring of each direction "
+                                           "of a shm session, in KB, rounded up to a power of 2");
+    uint64_t slot_size =
+        1024 * dsn_config_get_value_uint64("network",
+                                           "shm_slot_size_kb",
+                                           1024,
+                                           "size of the shared memory slots which pass the large "
+                                           "batches of messages of a shm session, in KB");
+    uint64_t slot_count =
+        dsn_config_get_value_uint64("network",
+                                    "shm_slot_count",
+                                    8,
+                                    "count of the shared memory slots of each direction of a shm "
+                                    "session, at most 64");
+    _zero_copy_min_size = (uint32_t)dsn_config_get_value_uint64(
+        "network",
+        "shm_zero_copy_min_size",
+        64 * 1024,
+        "a batch of messages no smaller than it is passed by a shared memory slot, and the "
+        "messages are parsed in place by the peer, rather than copied out of the ring");
+
+    _layout.ring_size = shm_ring::MIN_CAPACITY;
+    while (_layout.ring_size < ring_size && _layout.ring_size < (1u << 30))
+        _layout.ring_size <<= 1;
+    _layout.slot_size = (uint32_t)std::min(((slot_size + 4095) / 4096) * 4096, (uint64_t)1 << 30);
+    _layout.slot_count = (uint32_t)std::min(slot_count, (uint64_t)shm_ring::MAX_SLOT_COUNT);
+}
+
+error_code
+shm_network_provider::start(rpc_channel channel, int port, bool client_only, io_modifer &ctx)
+{
+    error_code err = hpc_network_provider::start(channel, port, client_only, ctx);
+    if (err != ERR_OK || client_only)
+        return err;
+
+    struct sockaddr_un addr;
+    socklen_t addr_len = make_local_address(port, addr);
+    _local_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (_local_listen_fd == -1 || bind(_local_listen_fd, (struct sockaddr *)&addr, addr_len) != 0 ||
+        listen(_local_listen_fd, SOMAXCONN) != 0) {
+        // the local peers then fall back to tcp
+        dwarn("listen for the local peers on %s failed, err = %s",
+              addr.sun_path + 1,
+              strerror(errno));
+        if (_local_listen_fd != -1) {
+            ::close(_local_listen_fd);
+            _local_listen_fd = -1;
+        }
+        return ERR_OK;
+    }
+
+    _local_accept_event = [this](int err, uint32_t size, uintptr_t lpolp) {
+        this->do_accept_local();
+    };
+    _looper->bind_io_handle((dsn_handle_t)(intptr_t)_local_listen_fd,
+                            &_local_accept_event,
+                            EPOLLIN | EPOLLET,
+                            nullptr // network_provider is a global object
+                            );
+    return ERR_OK;
+}
+
+bool shm_network_provider::is_local(::dsn::rpc_address addr)
+{
+    return addr.type() == HOST_TYPE_IPV4 && ((addr.ip() >> 24) == 127 || addr.ip() == _address.ip());
+}
+
+void shm_network_provider::on_shm_rejected(::dsn::rpc_address server_addr)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_rejected_lock);
+    _rejected_servers[server_addr] = dsn_now_ms() + SHM_REJECTED_RETRY_INTERVAL_MS;
+}
+
+bool shm_network_provider::is_shm_rejected(::dsn::rpc_address server_addr)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_rejected_lock);
+    auto it = _rejected_servers.find(server_addr);
+    if (it == _rejected_servers.end())
+        return false;
+    if (dsn_now_ms() < it->second)
+        return true;
+    _rejected_servers.erase(it);
+    return false;
+}
+
+rpc_session_ptr shm_network_provider::create_client_session(::dsn::rpc_address server_addr)
+{
+    if (is_local(server_addr) && !is_shm_rejected(server_addr)) {
+        rpc_session_ptr c = create_shm_client_session(server_addr);
+        if (c != nullptr)
+            return c;
+    }
+    return hpc_network_provider::create_client_session(server_addr);
+}
+
+rpc_session_ptr shm_network_provider::create_shm_client_session(::dsn::rpc_address server_addr)
+{
+    socket_t s = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s == -1) {
+        dwarn("create unix socket failed, err = %s", strerror(errno));
+        return nullptr;
+    }
+
+    // fails at once when the server does not listen for the local peers,
+    // or its backlog is full
+    struct sockaddr_un addr;
+    socklen_t addr_len = make_local_address(server_addr.port(), addr);
+    if (::connect(s, (struct sockaddr *)&addr, addr_len) != 0) {
+        dinfo("(s = %d) connect to %s by shm failed, err = %s, fall back to tcp",
+              s,
+              server_addr.to_string(),
+              strerror(errno));
+        ::close(s);
+        return nullptr;
+    }
+
+    // the server rejects the peers of another user, see do_accept_local
+    struct ucred cred;
+    socklen_t cred_len = (socklen_t)sizeof(cred);
+    if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, (void *)&cred, &cred_len) != 0 ||
+        cred.uid != getuid()) {
+        dinfo("(s = %d) %s is run by another user, err = %s, fall back to tcp",
+              s,
+              server_addr.to_string(),
+              strerror(errno));
+        ::close(s);
+        on_shm_rejected(server_addr);
+        return nullptr;
+    }
+
+    std::shared_ptr<shm_channel> ch = shm_channel::create(_layout);
+    if (ch == nullptr) {
+        ::close(s);
+        return nullptr;
+    }
+
+    shm_handshake hs;
+    hs.magic = SHM_HANDSHAKE_MAGIC;
+    hs.version = SHM_HANDSHAKE_VERSION;
+    hs.layout = ch->get_layout();
+
+    struct iovec iov;
+    iov.iov_base = (void *)&hs;
+    iov.iov_len = sizeof(hs);
+
+    shm_handshake_control ctrl;
+    struct msghdr msg;
+    memset((void *)&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    int fds[SHM_HANDSHAKE_FD_COUNT] = {ch->mem_fd(), ch->client_event_fd(), ch->server_event_fd()};
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(s, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(hs)) {
+        dwarn("(s = %d) send shm handshake to %s failed, err = %s, fall back to tcp",
+              s,
+              server_addr.to_string(),
+              strerror(errno));
+        ::close(s);
+        return nullptr;
+    }
+
+    message_parser_ptr parser(new_message_parser(_client_hdr_format));
+    auto client = new shm_rpc_session(s, std::move(ch), parser, *this, server_addr, true);
+    rpc_session_ptr c(client);
+    client->bind_looper(_looper);
+    return c;
+}
+
+void shm_network_provider::do_accept_local()
+{
+    while (true) {
+        socket_t s = ::accept4(_local_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (s == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                derror("accept local peer failed, err = %s", strerror(errno));
+            }
+            break;
+        }
+
+        // the shared memory is used like the memory of the process itself,
+        // so only the peers run by the same user are accepted
+        struct ucred cred;
+        socklen_t cred_len = (socklen_t)sizeof(cred);
+        if (getsockopt(s, SOL_SOCKET, SO_PEERCRED, (void *)&cred, &cred_len) != 0 ||
+            cred.uid != getuid()) {
+            dwarn("(s = %d) local peer of another user is rejected, err = %s",
+                  s,
+                  strerror(errno));
+            ::close(s);
+            continue;
+        }
+
+        uint32_t id = ++_next_peer_id;
+        if ((id & 0xffff) == 0)
+            id = ++_next_peer_id;
+        ::dsn::rpc_address client_addr(0x7ffe0000 | (id >> 16), (uint16_t)(id & 0xffff));
+
+        message_parser_ptr null_parser;
+        auto rs = new shm_rpc_session(s, nullptr, null_parser, *this, client_addr, false);
+        rpc_session_ptr s1(rs);
+        rs->bind_looper(_looper);
+        this->on_server_session_accepted(s1);
+    }
+}
+
+//------------------------------- shm_rpc_session -------------------------------
+shm_rpc_session::shm_rpc_session(socket_t sock,
+                                 std::shared_ptr<shm_channel> channel,
+                                 message_parser_ptr &parser,
+                                 shm_network_provider &net,
+                                 ::dsn::rpc_address remote_addr,
+                                 bool is_client)
+    : rpc_session(net, remote_addr, parser, is_client),
+      _provider(net),
+      _socket(sock),
+      _channel(std::move(channel)),
+      _looper(nullptr),
+      _handshake_done(false),
+      _sending_signature(0),
+      _sending_buffer_start_index(0),
+      _sending_fresh(false)
+{
+    dassert(sock != -1, "invalid given socket handle");
+
+    _socket_event = [this](int err, uint32_t length, uintptr_t lolp_or_events) {
+        this->on_socket_events_ready((uint32_t)lolp_or_events);
+    };
+    _notify_event = [this](int err, uint32_t length, uintptr_t lolp_or_events) {
+        this->on_notified();
+    };
+}
+
+shm_rpc_session::~shm_rpc_session()
+{
+    // closed here rather than in close(), so the fd is not reused while the
+    // callbacks of the session may still be running
+    ::close(_socket);
+}
+
+void shm_rpc_session::bind_looper(io_looper *looper)
+{
+    _looper = looper;
+    if (!is_client()) {
+        // for the handshake
+        _looper->bind_io_handle((dsn_handle_t)(intptr_t)_socket,
+                                &_socket_event,
+                                EPOLLIN | EPOLLRDHUP | EPOLLET,
+                                this);
+    }
+}
+
+void shm_rpc_session::connect()
+{
+    if (!try_connecting())
+        return;
+
+    // the handshake is sent already, and the session is connected once the server
+    // acks it, see on_handshake_ack
+    _looper->bind_io_handle(
+        (dsn_handle_t)(intptr_t)_socket, &_socket_event, EPOLLIN | EPOLLRDHUP | EPOLLET, this);
+}
+
+bool shm_rpc_session::on_handshake_ack(uint32_t events)
+{
+    char ack = 0;
+    ssize_t sz = recv(_socket, &ack, sizeof(ack), 0);
+    if (sz == (ssize_t)sizeof(ack) && ack == SHM_HANDSHAKE_ACK) {
+        bind_notify_event();
+        dinfo("(s = %d) client session %s connected by shm", _socket, _remote_addr.to_string());
+        set_connected();
+
+        // start first round send
+        do_safe_write(0);
+        return true;
+    }
+
+    // not yet
+    if (sz < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+        (events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) == 0) {
+        return true;
+    }
+
+    dwarn("(s = %d) shm session is rejected by %s, return %d, err = %s, connect to it by tcp "
+          "for a while",
+          _socket,
+          _remote_addr.to_string(),
+          (int)sz,
+          strerror(errno));
+    _provider.on_shm_rejected(_remote_addr);
+    return false;
+}
+
+void shm_rpc_session::bind_notify_event()
+{
+    _looper->bind_io_handle((dsn_handle_t)(intptr_t)_channel->local_event_fd(),
+                            &_notify_event,
+                            EPOLLIN | EPOLLET,
+                            this);
+    _handshake_done.store(true);
+}
+
+bool shm_rpc_session::on_handshake()
+{
+    shm_handshake hs;
+    struct iovec iov;
+    iov.iov_base = (void *)&hs;
+    iov.iov_len = sizeof(hs);
+
+    shm_handshake_control ctrl;
+    struct msghdr msg;
+    memset((void *)&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    ssize_t sz = recvmsg(_socket, &msg, MSG_CMSG_CLOEXEC);
+    if (sz < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+
+    int fds[SHM_HANDSHAKE_FD_COUNT] = {-1, -1, -1};
+    struct cmsghdr *cmsg = sz > 0 ? CMSG_FIRSTHDR(&msg) : nullptr;
+    if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    }
+
+    if (sz != (ssize_t)sizeof(hs) || (msg.msg_flags & MSG_CTRUNC) || fds[0] == -1 ||
+        hs.magic != SHM_HANDSHAKE_MAGIC || hs.version != SHM_HANDSHAKE_VERSION) {
+        derror("(s = %d) bad shm handshake from %s, size = %d, err = %s",
+               _socket,
+               _remote_addr.to_string(),
+               (int)sz,
+               strerror(errno));
+        for (int fd : fds) {
+            if (fd != -1)
+                ::close(fd);
+        }
+        return false;
+    }
+
+    std::shared_ptr<shm_channel> ch = shm_channel::open(hs.layout, fds[0], fds[1], fds[2]);
+    if (ch == nullptr)
+        return false;
+
+    {
+        utils::auto_lock<utils::ex_lock_nr> l(_recv_lock);
+        _channel = std::move(ch);
+    }
+    bind_notify_event();
+
+    if (::send(_socket, &SHM_HANDSHAKE_ACK, sizeof(SHM_HANDSHAKE_ACK), MSG_NOSIGNAL) !=
+        (ssize_t)sizeof(SHM_HANDSHAKE_ACK)) {
+        derror("(s = %d) send shm handshake ack to %s failed, err = %s",
+               _socket,
+               _remote_addr.to_string(),
+               strerror(errno));
+        return false;
+    }
+
+    dinfo("(s = %d) server session %s accepted by shm", _socket, _remote_addr.to_string());
+
+    // the requests written before the eventfd is bound
+    start_read_next();
+    return true;
+}
+
+void shm_rpc_session::on_socket_events_ready(uint32_t events)
+{
+    if (is_client() && !_handshake_done.load()) {
+        if (!on_handshake_ack(events)) {
+            on_failure();
+            return;
+        }
+        if (!_handshake_done.load())
+            return;
+    }
+
+    // the peer is closed
+    if ((events & EPOLLHUP) || (events & EPOLLRDHUP) || (events & EPOLLERR)) {
+        dinfo("(s = %d) epoll failure on %s, events = 0x%x", _socket, _remote_addr.to_string(), events);
+        on_failure();
+        return;
+    }
+
+    if (events & EPOLLIN) {
+        bool has_channel;
+        {
+            utils::auto_lock<utils::ex_lock_nr> l(_recv_lock);
+            has_channel = (_channel != nullptr);
+        }
+
+        if (!has_channel) {
+            if (!on_handshake())
+                on_failure();
+            return;
+        }
+
+        // nothing else is sent over the unix socket after the handshake and its ack
+        char c;
+        ssize_t sz = recv(_socket, &c, sizeof(c), 0);
+        if (sz >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            derror("(s = %d) unexpected read on %s, return %d, err = %s",
+                   _socket,
+                   _remote_addr.to_string(),
+                   (int)sz,
+                   strerror(errno));
+            on_failure();
+        }
+    }
+}
+
+void shm_rpc_session::on_notified()
+{
+    uint64_t c;
+    if (::read(_channel->local_event_fd(), &c, sizeof(c)) < 0) {
+        // possibly consumed already by others
+    }
+
+    // either space is released by the peer, or records are published
+    do_safe_write(0);
+    start_read_next();
+}
+
+void shm_rpc_session::do_read(int read_next)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_recv_lock);
+
+    // server, before the handshake
+    if (_channel == nullptr)
+        return;
+
+    shm_ring &rx = _channel->rx();
+    bool notify = false;
+    while (true) {
+        const shm_ring::record *r;
+        if (!rx.peek(r)) {
+            derror("(s = %d) recv failed on %s, bad record", _socket, _remote_addr.to_string());
+            on_failure();
+            break;
+        }
+
+        if (r == nullptr) {
+            if (notify) {
+                _channel->notify_peer();
+                notify = false;
+            }
+            if (rx.wait_for_data())
+                break;
+            continue;
+        }
+
+        const char *data;
+        uint32_t length;
+        int slot = -1;
+        if (r->type == shm_ring::REC_SLOT) {
+            auto ref = (const shm_ring::slot_ref *)rx.payload(r);
+            slot = (int)ref->index;
+            data = rx.slot_data(ref->index);
+            length = ref->length;
+        } else {
+            data = rx.payload(r);
+            length = r->length;
+        }
+
+        if (slot != -1 && _parser && _reader._buffer_occupied == 0) {
+            // the messages are parsed in place, and the slot is freed when they
+            // are all released, while the record is released at once
+            notify |= rx.release(r);
+            std::shared_ptr<shm_channel> ch = _channel;
+            std::shared_ptr<char> buffer((char *)data,
+                                         [ch, slot](char *) { ch->rx().free_slot(slot); });
+
+            message_reader reader(_reader._buffer_block_size);
+            reader._buffer.assign(std::move(buffer), 0, length);
+            reader._buffer_occupied = length;
+            if (!parse(&reader, read_next))
+                break;
+
+            // a batch is made of whole messages, the rest is not expected but handled anyway
+            if (reader._buffer_occupied > 0) {
+                char *ptr = _reader.read_buffer_ptr(reader._buffer_occupied);
+                memcpy(ptr, reader._buffer.data(), reader._buffer_occupied);
+                _reader.mark_read(reader._buffer_occupied);
+            }
+            continue;
+        }
+
+        char *ptr = _reader.read_buffer_ptr(std::max(length, (uint32_t)std::max(read_next, 0)));
+        memcpy(ptr, data, length);
+        _reader.mark_read(length);
+        if (slot != -1)
+            rx.free_slot((uint32_t)slot);
+        notify |= rx.release(r);
+
+        if (!parse(&_reader, read_next))
+            break;
+    }
+}
+
+bool shm_rpc_session::parse(message_reader *reader, /*inout*/ int &read_next)
+{
+    // only the copying path reads before the parser is ready
+    if (!_parser) {
+        read_next = prepare_parser();
+    }
+
+    if (_parser) {
+        message_ex *msg = _parser->get_message_on_receive(reader, read_next);
+        while (msg != nullptr) {
+            if (!on_recv_message(msg, 0)) {
+                on_failure();
+                return false;
+            }
+            msg = _parser->get_message_on_receive(reader, read_next);
+        }
+    }
+
+    if (read_next == -1) {
+        derror("(s = %d) recv failed on %s, parse failed", _socket, _remote_addr.to_string());
+        on_failure();
+        return false;
+    }
+    return true;
+}
+
+void shm_rpc_session::do_safe_write(uint64_t sig)
+{
+    utils::auto_lock<utils::ex_lock_nr> l(_send_lock);
+
+    if (0 == sig) {
+        if (_sending_signature == 0) {
+            _send_lock.unlock(); // avoid recursion
+            on_send_completed(); // send next msg if there is.
+            _send_lock.lock();
+            return;
+        }
+    } else {
+        dassert(_sending_signature == 0, "only one sending msg is possible");
+        _sending_signature = sig;
+        _sending_buffer_start_index = 0;
+        _sending_fresh = true;
+    }
+
+    if (do_write()) {
+        auto csig = _sending_signature;
+        _sending_signature = 0;
+
+        _send_lock.unlock(); // avoid recursion
+        // try next msg recursively
+        on_send_completed(csig);
+        _send_lock.lock();
+    }
+}
+
+bool shm_rpc_session::do_write()
+{
+    shm_ring &tx = _channel->tx();
+    int count = (int)_sending_buffers.size();
+
+    while (true) {
+        if (_sending_fresh && write_slot()) {
+            _sending_buffer_start_index = count;
+        }
+
+        // copy the rest of the batch inline, a record is filled with as many
+        // buffers as it can hold
+        while (true) {
+            uint64_t remaining = 0;
+            for (int i = _sending_buffer_start_index; i < count; i++)
+                remaining += _sending_buffers[i].sz;
+            if (remaining == 0) {
+                _sending_buffer_start_index = count;
+                break;
+            }
+
+            uint32_t length = (uint32_t)std::min(remaining, (uint64_t)UINT32_MAX);
+            char *ptr = tx.reserve(1, length);
+            if (ptr == nullptr)
+                break;
+
+            _sending_fresh = false;
+            uint32_t filled = 0;
+            while (filled < length) {
+                auto &buf = _sending_buffers[_sending_buffer_start_index];
+                uint32_t n = (uint32_t)std::min((size_t)(length - filled), buf.sz);
+                memcpy(ptr + filled, buf.buf, n);
+                filled += n;
+                buf.buf = (char *)buf.buf + n;
+                buf.sz -= n;
+                if (buf.sz == 0)
+                    _sending_buffer_start_index++;
+            }
+            tx.commit(shm_ring::REC_DATA, length);
+        }
+
+        if (tx.publish())
+            _channel->notify_peer();
+
+        if (_sending_buffer_start_index == count)
+            return true;
+
+        // notified by the peer when it releases some records
+        if (tx.wait_for_space(1))
+            return false;
+    }
+}
+
+bool shm_rpc_session::write_slot()
+{
+    shm_ring &tx = _channel->tx();
+
+    uint64_t total = 0;
+    for (auto &buf : _sending_buffers)
+        total += buf.sz;
+    if (total < _provider.zero_copy_min_size() || total > tx.slot_size())
+        return false;
+
+    int index = tx.acquire_slot();
+    if (index == -1)
+        return false;
+
+    uint32_t length = (uint32_t)sizeof(shm_ring::slot_ref);
+    auto ref = (shm_ring::slot_ref *)tx.reserve(length, length);
+    if (ref == nullptr) {
+        tx.free_slot((uint32_t)index);
+        return false;
+    }
+
+    char *ptr = tx.slot_data((uint32_t)index);
+    for (auto &buf : _sending_buffers) {
+        memcpy(ptr, buf.buf, buf.sz);
+        ptr += buf.sz;
+    }
+
+    ref->index = (uint32_t)index;
+    ref->length = (uint32_t)total;
+    tx.commit(shm_ring::REC_SLOT, length);
+    _sending_fresh = false;
+    return true;
+}
+
+void shm_rpc_session::close_on_fault_injection()
+{
+    // the session is then closed upon EPOLLRDHUP of the socket, and so is the peer
+    ::shutdown(_socket, SHUT_RDWR);
+}
+
+void shm_rpc_session::on_failure(bool is_write)
+{
+    if (on_disconnected(is_write))
+        close();
+}
+
+void shm_rpc_session::close()
+{
+    _looper->unbind_io_handle((dsn_handle_t)(intptr_t)_socket, &_socket_event);
+    if (_handshake_done.load()) {
+        _looper->unbind_io_handle((dsn_handle_t)(intptr_t)_channel->local_event_fd(),
+                                  &_notify_event);
+    }
+    ::shutdown(_socket, SHUT_RDWR);
+    dinfo("(s = %d) close shm session %p", _socket, this);
+}
+}
+}
+
+#endif
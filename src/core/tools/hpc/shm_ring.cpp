@@ -0,0 +1,223 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     single-producer single-consumer ring in shared memory
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#include "shm_ring.h"
+#include <dsn/c/api_utilities.h>
+#include <algorithm>
+
+namespace dsn {
+namespace tools {
+
+static_assert(sizeof(shm_ring::control) <= shm_ring::CONTROL_SIZE, "control is too large");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "atomics in shared memory must be lock free");
+
+/*static*/ bool shm_ring::is_valid_layout(uint32_t capacity, uint32_t slot_size, uint32_t slot_count)
+{
+    return capacity >= MIN_CAPACITY && (capacity & (capacity - 1)) == 0 &&
+           slot_size % 4096 == 0 && slot_count <= MAX_SLOT_COUNT;
+}
+
+/*static*/ size_t shm_ring::region_size(uint32_t capacity, uint32_t slot_size, uint32_t slot_count)
+{
+    return CONTROL_SIZE + (size_t)capacity + (size_t)slot_size * slot_count;
+}
+
+shm_ring::shm_ring()
+    : _ctrl(nullptr),
+      _ring(nullptr),
+      _slots(nullptr),
+      _capacity(0),
+      _slot_size(0),
+      _slot_count(0),
+      _write_pos(0),
+      _read_pos(0),
+      _next_slot(0)
+{
+}
+
+void shm_ring::attach(char *base, uint32_t capacity, uint32_t slot_size, uint32_t slot_count)
+{
+    dassert(is_valid_layout(capacity, slot_size, slot_count),
+            "invalid shm ring layout, capacity = %u, slot_size = %u, slot_count = %u",
+            capacity,
+            slot_size,
+            slot_count);
+
+    _ctrl = (control *)base;
+    _ring = base + CONTROL_SIZE;
+    _slots = _ring + capacity;
+    _capacity = capacity;
+    _slot_size = slot_size;
+    _slot_count = slot_count;
+
+    // both sides may attach after some records are written, e.g., the server
+    // attaches after the client has sent the first requests
+    _write_pos = _ctrl->head.load(std::memory_order_acquire);
+    _read_pos = _ctrl->tail.load(std::memory_order_acquire);
+}
+
+char *shm_ring::reserve(uint32_t min_length, /*inout*/ uint32_t &length)
+{
+    uint64_t tail = _ctrl->tail.load(std::memory_order_acquire);
+    uint32_t free_bytes = _capacity - (uint32_t)(_write_pos - tail);
+    uint32_t to_end = _capacity - (uint32_t)(_write_pos & (_capacity - 1));
+    uint32_t need = RECORD_SIZE + align(min_length);
+
+    if (to_end < need) {
+        // skip to the beginning, the padding is committed along with the record
+        if (free_bytes < to_end + need)
+            return nullptr;
+
+        record *pad = at(_write_pos);
+        pad->length = to_end - RECORD_SIZE;
+        pad->type = REC_PADDING;
+        _write_pos += to_end;
+        free_bytes -= to_end;
+        to_end = _capacity;
+    } else if (free_bytes < need) {
+        return nullptr;
+    }
+
+    // a record is at most a quarter of the ring, so the consumer releases the
+    // space in steps while the producer is filling the rest
+    uint32_t room = std::min(std::min(free_bytes, to_end) - RECORD_SIZE, _capacity / 4);
+    length = std::min(length, room);
+    return (char *)at(_write_pos) + RECORD_SIZE;
+}
+
+void shm_ring::commit(record_type type, uint32_t length)
+{
+    record *r = at(_write_pos);
+    r->length = length;
+    r->type = type;
+    _write_pos += RECORD_SIZE + align(length);
+}
+
+bool shm_ring::publish()
+{
+    if (_ctrl->head.load(std::memory_order_relaxed) == _write_pos)
+        return false;
+
+    _ctrl->head.store(_write_pos);
+    return _ctrl->consumer_waiting.load() != 0 && _ctrl->consumer_waiting.exchange(0) != 0;
+}
+
+bool shm_ring::wait_for_space(uint32_t min_length)
+{
+    _ctrl->producer_waiting.store(1);
+
+    // check again the same as reserve()
+    uint64_t tail = _ctrl->tail.load();
+    uint32_t free_bytes = _capacity - (uint32_t)(_write_pos - tail);
+    uint32_t to_end = _capacity - (uint32_t)(_write_pos & (_capacity - 1));
+    uint32_t need = RECORD_SIZE + align(min_length);
+    return free_bytes < (to_end < need ? to_end + need : need);
+}
+
+int shm_ring::acquire_slot()
+{
+    for (uint32_t i = 0; i < _slot_count; i++) {
+        uint32_t index = (_next_slot + i) % _slot_count;
+        if (_ctrl->slot_busy[index].load(std::memory_order_acquire) == 0) {
+            _ctrl->slot_busy[index].store(1, std::memory_order_relaxed);
+            _next_slot = index + 1;
+            return (int)index;
+        }
+    }
+    return -1;
+}
+
+bool shm_ring::peek(/*out*/ const record *&r)
+{
+    while (true) {
+        uint64_t head = _ctrl->head.load(std::memory_order_acquire);
+        if (_read_pos == head) {
+            r = nullptr;
+            return true;
+        }
+
+        // the records are written by another process, so check them before use
+        record *rec = at(_read_pos);
+        uint32_t to_end = _capacity - (uint32_t)(_read_pos & (_capacity - 1));
+        uint32_t size = RECORD_SIZE + align(rec->length);
+        if (rec->length > _capacity || size > to_end || size > head - _read_pos) {
+            derror("malformed shm record, type = %u, length = %u", rec->type, rec->length);
+            return false;
+        }
+
+        switch (rec->type) {
+        case REC_PADDING:
+            _read_pos += size;
+            _ctrl->tail.store(_read_pos, std::memory_order_release);
+            continue;
+        case REC_DATA:
+            break;
+        case REC_SLOT: {
+            const slot_ref *ref = (const slot_ref *)payload(rec);
+            if (rec->length != sizeof(slot_ref) || ref->index >= _slot_count ||
+                ref->length > _slot_size) {
+                derror("malformed shm slot record, index = %u, length = %u",
+                       ref->index,
+                       ref->length);
+                return false;
+            }
+            break;
+        }
+        default:
+            derror("malformed shm record, type = %u, length = %u", rec->type, rec->length);
+            return false;
+        }
+
+        r = rec;
+        return true;
+    }
+}
+
+bool shm_ring::release(const record *r)
+{
+    dbg_dassert(r == at(_read_pos), "records must be released in order");
+    _read_pos += RECORD_SIZE + align(r->length);
+    _ctrl->tail.store(_read_pos);
+    return _ctrl->producer_waiting.load() != 0 && _ctrl->producer_waiting.exchange(0) != 0;
+}
+
+bool shm_ring::wait_for_data()
+{
+    _ctrl->consumer_waiting.store(1);
+    return _ctrl->head.load() == _read_pos;
+}
+}
+}
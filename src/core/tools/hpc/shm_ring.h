@@ -0,0 +1,169 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Microsoft Corporation
+ *
+ * -=- Robust Distributed System Nucleus (rDSN) -=-
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Description:
+ *     single-producer single-consumer ring in shared memory, one direction of
+ *     a shm_network_provider session
+ *
+ * Revision history:
+ *     xxxx-xx-xx, author, first version
+ *     xxxx-xx-xx, author, fix bug about xxx
+ */
+
+#pragma once
+
+#include <dsn/utility/ports.h>
+#include <atomic>
+#include <cstdint>
+
+namespace dsn {
+namespace tools {
+//
+// the memory of a direction, zeroed when created, is laid out as
+//
+//   [control][ring: capacity bytes][slot 0][slot 1]...[slot slot_count - 1]
+//
+// - the ring is a stream of 8-byte aligned records, each one a record header followed
+//   by its payload; a record never wraps, the bytes before the end of the ring are
+//   skipped by a padding record instead
+// - REC_DATA carries the bytes of the stream inline, which the consumer copies out
+//   and releases right away, so the ring is always released in order
+// - REC_SLOT passes a slot by its index: a batch of messages large enough is written
+//   once into a free slot, and the consumer uses it in place till the messages are
+//   all released, in any order, without holding up the ring
+//
+// head and tail are byte positions which never wrap; the waiting flags let either
+// side sleep on its eventfd, and are checked by the other side after it has published
+// or released (both in seq_cst, so no wakeup is lost)
+//
+class shm_ring
+{
+public:
+    enum record_type
+    {
+        REC_DATA = 1,
+        REC_PADDING = 2,
+        REC_SLOT = 3
+    };
+
+    struct record
+    {
+        uint32_t length; // of the payload, excluding the alignment
+        uint32_t type;
+    };
+
+    // payload of REC_SLOT
+    struct slot_ref
+    {
+        uint32_t index;
+        uint32_t length;
+    };
+
+    static const int MAX_SLOT_COUNT = 64;
+    static const uint32_t RECORD_SIZE = (uint32_t)sizeof(record);
+    static const uint32_t CONTROL_SIZE = 4096;
+    static const uint32_t MIN_CAPACITY = 64 * 1024;
+
+    struct control
+    {
+        alignas(64) std::atomic<uint64_t> head; // advanced by the producer
+        alignas(64) std::atomic<uint64_t> tail; // advanced by the consumer
+        alignas(64) std::atomic<uint32_t> consumer_waiting;
+        std::atomic<uint32_t> producer_waiting;
+        alignas(64) std::atomic<uint32_t> slot_busy[MAX_SLOT_COUNT];
+    };
+
+    // capacity must be a power of two no less than MIN_CAPACITY,
+    // slot_size a multiple of 4096
+    static bool is_valid_layout(uint32_t capacity, uint32_t slot_size, uint32_t slot_count);
+    static size_t region_size(uint32_t capacity, uint32_t slot_size, uint32_t slot_count);
+
+    shm_ring();
+
+    // attach to the memory of a direction, init_waiting is to be set by the creator
+    // so the first records are notified before the consumer ever waits
+    void attach(char *base, uint32_t capacity, uint32_t slot_size, uint32_t slot_count);
+    void init_waiting() { _ctrl->consumer_waiting.store(1); }
+
+    uint32_t capacity() const { return _capacity; }
+    uint32_t slot_size() const { return _slot_size; }
+    uint32_t slot_count() const { return _slot_count; }
+    char *slot_data(uint32_t index) const { return _slots + (size_t)index * _slot_size; }
+
+    // ------------------ producer ------------------
+    // return the payload of a new record with at least min_length and at most length
+    // bytes (updated to what is available), or nullptr when the ring is full
+    char *reserve(uint32_t min_length, /*inout*/ uint32_t &length);
+
+    // fill the header of the record reserved, it is seen by the consumer after publish()
+    void commit(record_type type, uint32_t length);
+
+    // make the committed records visible, return true when the consumer is to be notified
+    bool publish();
+
+    // called when reserve(min_length, ...) fails, return false when there is space already
+    // so the producer should try again rather than wait to be notified
+    bool wait_for_space(uint32_t min_length);
+
+    // return the index of a free slot now owned by the producer, or -1
+    int acquire_slot();
+
+    // ------------------ consumer ------------------
+    // get the next record which is not padding, or nullptr when there is none;
+    // return false when the record is malformed
+    bool peek(/*out*/ const record *&r);
+
+    const char *payload(const record *r) const { return (const char *)r + RECORD_SIZE; }
+
+    // release the record returned by peek(), return true when the producer is to be notified
+    bool release(const record *r);
+
+    // give the slot back to the producer, may be called on any thread
+    void free_slot(uint32_t index) { _ctrl->slot_busy[index].store(0, std::memory_order_release); }
+
+    // called when peek() returns nothing, return false when there are records already
+    // so the consumer should go on rather than wait to be notified
+    bool wait_for_data();
+
+private:
+    record *at(uint64_t pos) const { return (record *)(_ring + (pos & (_capacity - 1))); }
+    static uint32_t align(uint32_t length) { return (length + RECORD_SIZE - 1) & ~(RECORD_SIZE - 1); }
+
+private:
+    control *_ctrl;
+    char *_ring;
+    char *_slots;
+    uint32_t _capacity;
+    uint32_t _slot_size;
+    uint32_t _slot_count;
+
+    uint64_t _write_pos; // producer, committed but maybe not published
+    uint64_t _read_pos;  // consumer, peeked but maybe not released
+    uint32_t _next_slot; // producer, where acquire_slot() starts to search
+};
+}
+}
@@ -110,6 +110,13 @@ void simulator::install(service_spec &spec)
     for (auto it = spec.threadpool_specs.begin(); it != spec.threadpool_specs.end(); ++it) {
         threadpool_spec &tspec = *it;
 
+        // tasks are scheduled by the simulator itself
+        tspec.work_stealing = false;
+        tspec.numa_aware = false;
+        tspec.idle_spin_count = 0;
+        tspec.idle_yield_count = 0;
+        tspec.elastic_max_worker_count = 0;
+
         if (tspec.worker_factory_name == "")
             tspec.worker_factory_name = ("dsn::task_worker");
 
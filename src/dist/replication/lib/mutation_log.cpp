@@ -172,13 +172,6 @@ void mutation_log_shared::write_pending_mutations(bool release_lock_required)
                         (int)sz,
                         (int)sizeof(log_block_header),
                         hdr->length);
-
-                if (_force_flush) {
-                    // flush to ensure that shared log data synced to disk
-                    //
-                    // FIXME : the file could have been closed
-                    lf->flush();
-                }
             } else {
                 derror("write shared log failed, err = %s", err.to_string());
             }
@@ -205,7 +198,8 @@ void mutation_log_shared::write_pending_mutations(bool release_lock_required)
                 }
             }
         },
-        0);
+        0,
+        _force_flush /* sync to ensure that shared log data is on disk */);
 }
 
 ////////////////////////////////////////////////////
@@ -385,12 +379,6 @@ void mutation_log_private::write_pending_mutations(bool release_lock_required)
                         (int)sizeof(log_block_header),
                         hdr->length);
 
-                // flush to ensure that there is no gap between private log and in-memory buffer
-                // so that we can get all mutations in learning process.
-                //
-                // FIXME : the file could have been closed
-                lf->flush();
-
                 // update _private_max_commit_on_disk after writen into log file done
                 update_max_commit_on_disk(max_commit);
             } else {
@@ -422,7 +410,9 @@ void mutation_log_private::write_pending_mutations(bool release_lock_required)
                 }
             }
         },
-        0);
+        0,
+        true /* sync to ensure that there is no gap between private log and in-memory buffer
+                so that we can get all mutations in learning process */);
 }
 
 ///////////////////////////////////////////////////////////////
@@ -2106,7 +2096,8 @@ aio_task_ptr log_file::commit_log_block(log_block &block,
                                         dsn::task_code evt,
                                         dsn::task_tracker *tracker,
                                         aio_handler &&callback,
-                                        int hash)
+                                        int hash,
+                                        bool sync_data)
 {
     dassert(!_is_read, "log file must be of write mode");
     dassert(block.size() > 0, "log_block can not be empty");
@@ -2146,7 +2137,8 @@ aio_task_ptr log_file::commit_log_block(log_block &block,
                                  evt,
                                  tracker,
                                  std::forward<aio_handler>(callback),
-                                 hash);
+                                 hash,
+                                 sync_data);
     } else {
         tsk = file::write_vector(_handle,
                                  buffer_vector,
@@ -2155,7 +2147,8 @@ aio_task_ptr log_file::commit_log_block(log_block &block,
                                  evt,
                                  tracker,
                                  nullptr,
-                                 hash);
+                                 hash,
+                                 sync_data);
     }
 
     _end_offset.fetch_add(size);
@@ -558,6 +558,8 @@ public:
     // 'callback_host' is used to get tracer
     // 'callback' is to indicate the callback handler
     // 'hash' helps to choose which thread in the thread pool to execute the callback
+    // 'sync_data' is to sync the entry to disk before the callback, by the same io
+    //    submission as the write when supported by the aio provider
     // returns:
     //   - non-null if io task is in pending
     //   - null if error
@@ -566,7 +568,8 @@ public:
                                        dsn::task_code evt,
                                        dsn::task_tracker *tracker,
                                        aio_handler &&callback,
-                                       int hash);
+                                       int hash,
+                                       bool sync_data = false);
 
     //
     // others
@@ -1112,22 +1112,26 @@ void replica_stub::on_node_query_reply(error_code err,
             rs = _replicas;
         }
 
+        std::vector<task_ptr> tasks;
+        tasks.reserve(resp.partitions.size() + rs.size());
         for (auto it = resp.partitions.begin(); it != resp.partitions.end(); ++it) {
             rs.erase(it->config.pid);
-            tasking::enqueue(LPC_QUERY_NODE_CONFIGURATION_SCATTER,
-                             &_tracker,
-                             std::bind(&replica_stub::on_node_query_reply_scatter, this, this, *it),
-                             it->config.pid.thread_hash());
+            tasks.push_back(tasking::create_task(
+                LPC_QUERY_NODE_CONFIGURATION_SCATTER,
+                &_tracker,
+                std::bind(&replica_stub::on_node_query_reply_scatter, this, this, *it),
+                it->config.pid.thread_hash()));
         }
 
         // for rps not exist on meta_servers
         for (auto it = rs.begin(); it != rs.end(); ++it) {
-            tasking::enqueue(
+            tasks.push_back(tasking::create_task(
                 LPC_QUERY_NODE_CONFIGURATION_SCATTER2,
                 &_tracker,
                 std::bind(&replica_stub::on_node_query_reply_scatter2, this, this, it->first),
-                it->first.thread_hash());
+                it->first.thread_hash()));
         }
+        tasking::enqueue_batch(tasks);
 
         // handle the replicas which need to be gc
         if (resp.__isset.gc_replicas) {
@@ -1151,12 +1155,16 @@ void replica_stub::set_meta_server_connected_for_test(
     dassert(_state != NS_Connected, "");
     _state = NS_Connected;
 
+    std::vector<task_ptr> tasks;
+    tasks.reserve(resp.partitions.size());
     for (auto it = resp.partitions.begin(); it != resp.partitions.end(); ++it) {
-        tasking::enqueue(LPC_QUERY_NODE_CONFIGURATION_SCATTER,
-                         &_tracker,
-                         std::bind(&replica_stub::on_node_query_reply_scatter, this, this, *it),
-                         it->config.pid.thread_hash());
+        tasks.push_back(tasking::create_task(
+            LPC_QUERY_NODE_CONFIGURATION_SCATTER,
+            &_tracker,
+            std::bind(&replica_stub::on_node_query_reply_scatter, this, this, *it),
+            it->config.pid.thread_hash()));
     }
+    tasking::enqueue_batch(tasks);
 }
 
 void replica_stub::set_replica_state_subscriber_for_test(replica_state_subscriber subscriber,
@@ -1251,13 +1259,16 @@ void replica_stub::on_meta_server_disconnected()
         rs = _replicas;
     }
 
+    std::vector<task_ptr> tasks;
+    tasks.reserve(rs.size());
     for (auto it = rs.begin(); it != rs.end(); ++it) {
-        tasking::enqueue(
+        tasks.push_back(tasking::create_task(
             LPC_CM_DISCONNECTED_SCATTER,
             &_tracker,
             std::bind(&replica_stub::on_meta_server_disconnected_scatter, this, this, it->first),
-            it->first.thread_hash());
+            it->first.thread_hash()));
     }
+    tasking::enqueue_batch(tasks);
 }
 
 // this_ is used to hold a ref to replica_stub so we don't need to cancel the task on